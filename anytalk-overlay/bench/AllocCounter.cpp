@@ -0,0 +1,53 @@
+#include "AllocCounter.h"
+
+#include <cstddef>
+
+#if defined(__GLIBC__)
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+}
+
+namespace {
+// constinit + trivial: static TLS, so touching it inside malloc can never
+// allocate (and recurse) on a thread's first access.
+constinit thread_local alloc::Counts tCounts;
+} // namespace
+
+extern "C" {
+
+void *malloc(std::size_t size) {
+    ++tCounts.calls;
+    tCounts.bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) {
+    ++tCounts.calls;
+    tCounts.bytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, std::size_t size) {
+    ++tCounts.calls;
+    tCounts.bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+} // extern "C"
+
+namespace alloc {
+bool available() { return true; }
+Counts thisThread() { return tCounts; }
+} // namespace alloc
+
+#else
+
+namespace alloc {
+bool available() { return false; }
+Counts thisThread() { return {}; }
+} // namespace alloc
+
+#endif
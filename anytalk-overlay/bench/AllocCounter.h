@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+/// Per-thread heap counters for anytalk-bench.
+///
+/// The bench executable interposes malloc / calloc / realloc (glibc's
+/// __libc_* underneath), so Qt's containers — which allocate with malloc,
+/// not operator new — are counted too. Per thread, so the mock server's
+/// own traffic on its thread stays out of the client's numbers. Other C
+/// libraries: available() is false and the counters stay at zero.
+namespace alloc {
+
+struct Counts {
+    std::uint64_t calls = 0;
+    std::uint64_t bytes = 0;
+
+    Counts operator-(const Counts &o) const { return {calls - o.calls, bytes - o.bytes}; }
+};
+
+bool available();
+/// This thread's totals since it started.
+Counts thisThread();
+
+} // namespace alloc
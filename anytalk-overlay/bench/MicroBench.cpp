@@ -0,0 +1,214 @@
+#include "MicroBench.h"
+
+#include "AllocCounter.h"
+#include "MockVolcengineServer.h"
+#include "asr/VolcengineProtocol.h"
+#include "audio/LevelKernel.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace microbench {
+
+namespace {
+
+constexpr int kChunkBytes = 1280;  // one 40 ms capture chunk
+constexpr int kRounds = 3;
+
+// A mid-session bidi_async response: two definite segments and a live one.
+const QByteArray kResponse = QByteArrayLiteral(
+    R"({"audio_info":{"duration":6120},"result":{"text":"今天天气不错。我们去公园散步吧，顺便买点水果",)"
+    R"("utterances":[{"definite":true,"end_time":2240,"start_time":300,"text":"今天天气不错。"},)"
+    R"({"definite":true,"end_time":4580,"start_time":2560,"text":"我们去公园散步吧，"},)"
+    R"({"definite":false,"end_time":6120,"start_time":4700,"text":"顺便买点水果"}]}})");
+
+// Keeps results observable so the loops aren't optimised away.
+volatile std::uint64_t gSink = 0;
+
+template <typename F>
+Result measure(const char *name, int minMs, F &&op) {
+    // Calibrate: double the batch until one takes ~1/10 of the budget.
+    qint64 batch = 1;
+    for (QElapsedTimer t;;) {
+        t.start();
+        for (qint64 i = 0; i < batch; ++i) op();
+        if (t.nsecsElapsed() >= qint64(minMs) * 100'000 || batch >= (qint64(1) << 30)) break;
+        batch *= 2;
+    }
+
+    Result r{QString::fromLatin1(name), std::numeric_limits<double>::max(), 0};
+    for (int round = 0; round < kRounds; ++round) {
+        qint64 ops = 0;
+        QElapsedTimer t;
+        const alloc::Counts before = alloc::thisThread();
+        t.start();
+        while (t.nsecsElapsed() < qint64(minMs) * 1'000'000) {
+            for (qint64 i = 0; i < batch; ++i) op();
+            ops += batch;
+        }
+        const double ns = static_cast<double>(t.nsecsElapsed()) / static_cast<double>(ops);
+        const alloc::Counts used = alloc::thisThread() - before;
+        r.nsPerOp = std::min(r.nsPerOp, ns);
+        r.allocsPerOp = alloc::available()
+                            ? static_cast<double>(used.calls) / static_cast<double>(ops)
+                            : -1;
+    }
+    return r;
+}
+
+using ParseFn = volcengine::AsrParsed (*)(const QByteArray &, volcengine::AsrParseState &,
+                                          const QString &);
+
+// One session's responses through `parse`, with the state a session has.
+void parseSession(const QList<QByteArray> &responses, ParseFn parse, const QString &mode) {
+    volcengine::AsrParseState state;
+    for (const QByteArray &r : responses) {
+        const auto parsed = parse(r, state, mode);
+        gSink += static_cast<std::uint64_t>(parsed.finals.size());
+    }
+}
+
+// Side by side over one session: scanner, then the DOM path. ns/op is
+// what the whole session's parsing costs the main thread.
+void benchSession(QList<Result> &out, const QString &name, const QList<QByteArray> &responses,
+                  int minMs) {
+    const QString mode = QStringLiteral("bidi_async");
+    qint64 bytes = 0;
+    for (const QByteArray &r : responses) bytes += r.size();
+    std::printf("session %s: %lld responses, %.1f KiB of JSON, last %.1f KiB\n",
+                qPrintable(name), static_cast<long long>(responses.size()), bytes / 1024.0,
+                responses.isEmpty() ? 0.0 : responses.last().size() / 1024.0);
+    const struct {
+        const char *path;
+        ParseFn parse;
+    } paths[] = {{"scanner", &volcengine::parseAsrResponse},
+                 {"QJsonDocument", &volcengine::parseAsrResponseDom}};
+    for (const auto &p : paths) {
+        const QByteArray label = QStringLiteral("session %1 (%2)").arg(name, QLatin1String(p.path))
+                                     .toUtf8();
+        out.append(measure(label.constData(), minMs,
+                           [&]() { parseSession(responses, p.parse, mode); }));
+    }
+}
+
+QList<QByteArray> payloads(const QList<MockVolcengineServer::Entry> &script) {
+    QList<QByteArray> out;
+    out.reserve(script.size());
+    for (const auto &e : script) out.append(e.payload);
+    return out;
+}
+
+} // namespace
+
+QList<Result> runAll(int minMs, const QList<QByteArray> &capture) {
+    QList<Result> out;
+
+    // Fresh state each op: the cost of a response the first time it's seen.
+    const QString mode = QStringLiteral("bidi_async");
+    out.append(measure("parseAsrResponse", minMs, [&]() {
+        volcengine::AsrParseState state;
+        const auto parsed = volcengine::parseAsrResponse(kResponse, state, mode);
+        gSink += static_cast<std::uint64_t>(parsed.finals.size());
+    }));
+
+    // Where the DOM path went quadratic: each response re-parses all of
+    // the session so far, so the total grows with the square of its length.
+    for (const int minutes : {1, 3}) {
+        benchSession(out, QStringLiteral("%1 min").arg(minutes),
+                     payloads(MockVolcengineServer::syntheticScript(minutes * 60'000)), minMs);
+    }
+    if (!capture.isEmpty()) benchSession(out, QStringLiteral("capture"), capture, minMs);
+
+    const QByteArray pcm(kChunkBytes, '\x11');
+    qint32 seq = 2;
+    out.append(measure("buildAudioOnlyRequest", minMs, [&]() {
+        const QByteArray frame = volcengine::buildAudioOnlyRequest(pcm, false, seq++);
+        gSink += static_cast<std::uint64_t>(frame.size());
+    }));
+
+    // What VolcengineBackend actually sends through since the writer landed.
+    volcengine::AudioFrameWriter writer(kChunkBytes);
+    out.append(measure("AudioFrameWriter::build", minMs, [&]() {
+        const QByteArray &frame = writer.build(pcm.constData(), kChunkBytes, false, seq++);
+        gSink += static_cast<std::uint64_t>(frame.size());
+    }));
+
+    // AudioCapture's per-chunk level pass (what replaced computeRms).
+    std::vector<std::int16_t> samples(kChunkBytes / 2);
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = static_cast<std::int16_t>(std::lround(8000 * std::sin(0.07 * double(i))));
+    }
+    out.append(measure("level::measure", minMs, [&]() {
+        const auto stats = level::measure(samples.data(), static_cast<int>(samples.size()));
+        gSink += stats.sumSquares;
+    }));
+    return out;
+}
+
+bool writeBaseline(const QString &path, const QList<Result> &results, QString &error) {
+    QJsonObject root;
+    for (const Result &r : results) {
+        QJsonObject o{{"ns_per_op", r.nsPerOp}};
+        if (r.allocsPerOp >= 0) o.insert("allocs_per_op", r.allocsPerOp);
+        root.insert(r.name, o);
+    }
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        error = f.errorString();
+        return false;
+    }
+    f.write(QJsonDocument(root).toJson());
+    if (!f.commit()) {
+        error = f.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool compareBaseline(const QString &path, const QList<Result> &results, double tolerance,
+                     QString &error) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        error = f.errorString();
+        return false;
+    }
+    QJsonParseError perr{};
+    const QJsonObject root = QJsonDocument::fromJson(f.readAll(), &perr).object();
+    if (perr.error != QJsonParseError::NoError) {
+        error = perr.errorString();
+        return false;
+    }
+
+    bool ok = true;
+    for (const Result &r : results) {
+        const QByteArray name = r.name.toUtf8();
+        if (!root.contains(r.name)) {
+            std::printf("  %-32s %10.1f ns/op  (not in baseline)\n", name.constData(), r.nsPerOp);
+            continue;
+        }
+        const QJsonObject b = root.value(r.name).toObject();
+        const double baseNs = b.value("ns_per_op").toDouble();
+        const double ratio = baseNs > 0 ? r.nsPerOp / baseNs : 1.0;
+        const bool slower = ratio > 1.0 + tolerance;
+        // Allocation counts are deterministic: any increase is a regression.
+        const bool moreAllocs = r.allocsPerOp >= 0 && b.contains("allocs_per_op") &&
+                                r.allocsPerOp > b.value("allocs_per_op").toDouble() + 0.01;
+        std::printf("  %-32s %10.1f ns/op  baseline %10.1f  %+6.1f%%%s%s\n", name.constData(),
+                    r.nsPerOp, baseNs, (ratio - 1.0) * 100, slower ? "  SLOWER" : "",
+                    moreAllocs ? "  MORE ALLOCS" : "");
+        ok = ok && !slower && !moreAllocs;
+    }
+    return ok;
+}
+
+} // namespace microbench
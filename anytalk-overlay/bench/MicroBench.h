@@ -0,0 +1,35 @@
+#pragma once
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/// Hot-path micro-benchmarks for anytalk-bench --micro: the per-response
+/// parse, the per-chunk frame build and the per-chunk level pass. Each
+/// runs until it has spent at least `minMs`, best of three rounds.
+///
+/// The parse is also timed over whole result_type "full" sessions, where
+/// every response repeats the ones before it: the scanner next to the
+/// QJsonDocument path it replaced, on a scripted session growing for
+/// 1 and for 3 minutes (MockVolcengineServer::syntheticScript) and on `capture`
+/// when one is given (--responses). One op is the whole session.
+namespace microbench {
+
+struct Result {
+    QString name;
+    double nsPerOp = 0;
+    double allocsPerOp = 0;  // -1 when the allocation counter is unavailable
+};
+
+QList<Result> runAll(int minMs, const QList<QByteArray> &capture = {});
+
+/// Baseline file: {"<name>": {"ns_per_op": x, "allocs_per_op": y}, …}.
+bool writeBaseline(const QString &path, const QList<Result> &results, QString &error);
+
+/// Print each result against `path` and return false if any got slower
+/// than the baseline by more than `tolerance` (0.25 = 25 %), or allocates
+/// more per op at all. Names missing from the baseline are reported, not
+/// failed.
+bool compareBaseline(const QString &path, const QList<Result> &results, double tolerance,
+                     QString &error);
+
+} // namespace microbench
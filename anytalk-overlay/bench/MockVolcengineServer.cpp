@@ -0,0 +1,231 @@
+#include "MockVolcengineServer.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QWebSocket>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include <zlib.h>
+
+namespace {
+constexpr int kPcmBytesPerMs = 32;  // 16 kHz S16LE
+constexpr quint8 kMsgFullClientReq = 0b0001;
+constexpr quint8 kMsgAudioOnly = 0b0010;
+constexpr quint8 kFlagLast = 0b0010;  // NEG_WITH_SEQUENCE carries this bit
+constexpr quint8 kCompressionGzip = 0b0001;
+// Ogg/Opus isn't decoded; its payload bytes are counted at the encoder's
+// ~32 kbit/s instead.
+constexpr int kOpusBytesPerMs = 4;
+
+// Inflated size of a gzip member, 0 on corrupt input.
+qint64 gunzippedSize(const char *data, int size) {
+    z_stream zs{};
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return 0;
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    zs.avail_in = static_cast<uInt>(size);
+    char sink[4096];
+    int rc = Z_OK;
+    while (rc == Z_OK) {
+        zs.next_out = reinterpret_cast<Bytef *>(sink);
+        zs.avail_out = sizeof sink;
+        rc = inflate(&zs, Z_NO_FLUSH);
+    }
+    const qint64 n = rc == Z_STREAM_END ? static_cast<qint64>(zs.total_out) : 0;
+    inflateEnd(&zs);
+    return n;
+}
+
+// 4B header + 4B BE sequence + 4B BE size + JSON; flags 0b0011 = final.
+QByteArray serverFrame(const QByteArray &json, qint32 seq, bool final) {
+    QByteArray out(12 + json.size(), Qt::Uninitialized);
+    out[0] = 0x11;
+    out[1] = static_cast<char>((0b1001 << 4) | (final ? 0b0011 : 0b0001));
+    out[2] = 0x10;  // JSON, uncompressed
+    out[3] = 0;
+    qToBigEndian(static_cast<quint32>(final ? -seq : seq), out.data() + 4);
+    qToBigEndian(static_cast<quint32>(json.size()), out.data() + 8);
+    std::copy(json.begin(), json.end(), out.begin() + 12);
+    return out;
+}
+
+QByteArray response(const QString &text, const QJsonArray &utterances) {
+    QJsonObject result{{"text", text}, {"utterances", utterances}};
+    return QJsonDocument(QJsonObject{{"result", result}}).toJson(QJsonDocument::Compact);
+}
+} // namespace
+
+QList<MockVolcengineServer::Entry> MockVolcengineServer::loadScript(const QString &path,
+                                                                   QString &error) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = f.errorString();
+        return {};
+    }
+    QList<Entry> script;
+    int lineNo = 0;
+    while (!f.atEnd()) {
+        const QByteArray line = f.readLine().trimmed();
+        ++lineNo;
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        QJsonParseError perr{};
+        const QJsonObject o = QJsonDocument::fromJson(line, &perr).object();
+        if (perr.error != QJsonParseError::NoError || !o.value("payload").isObject()) {
+            error = QStringLiteral("line %1: expected {\"after_ms\"|\"on_last\", \"payload\"}")
+                        .arg(lineNo);
+            return {};
+        }
+        Entry e;
+        e.afterAudioMs = o.value("after_ms").toInt();
+        e.onLast = o.value("on_last").toBool();
+        e.payload = QJsonDocument(o.value("payload").toObject()).toJson(QJsonDocument::Compact);
+        script.append(std::move(e));
+    }
+    // Audio-clocked entries in audio order; on_last ones keep file order.
+    std::stable_sort(script.begin(), script.end(), [](const Entry &a, const Entry &b) {
+        if (a.onLast != b.onLast) return !a.onLast;
+        return !a.onLast && a.afterAudioMs < b.afterAudioMs;
+    });
+    return script;
+}
+
+QList<MockVolcengineServer::Entry> MockVolcengineServer::syntheticScript(int audioMs) {
+    static const QString kText = QStringLiteral("今天天气不错我们去公园散步吧，");
+    constexpr int kStepMs = 200;
+    constexpr int kUtteranceMs = 2000;
+    QList<Entry> script;
+    QJsonArray done;
+    QString doneText;
+    QString live;
+    int utteranceStart = 0;
+    for (int t = kStepMs; t <= audioMs; t += kStepMs) {
+        live += kText.at((t / kStepMs - 1) % kText.size());
+        const bool definite = t - utteranceStart >= kUtteranceMs;
+        QJsonArray utterances = done;
+        utterances.append(QJsonObject{{"text", live}, {"start_time", utteranceStart},
+                                      {"end_time", t}, {"definite", definite}});
+        script.append({t, false, response(doneText + live, utterances)});
+        if (definite) {
+            done = utterances;
+            doneText += live;
+            live.clear();
+            utteranceStart = t;
+        }
+    }
+    QJsonArray utterances = done;
+    if (!live.isEmpty()) {
+        utterances.append(QJsonObject{{"text", live}, {"start_time", utteranceStart},
+                                      {"end_time", audioMs}, {"definite", true}});
+    }
+    script.append({0, true, response(doneText + live, utterances)});
+    return script;
+}
+
+MockVolcengineServer::MockVolcengineServer(QList<Entry> script, Options options,
+                                           QObject *parent)
+    : QObject(parent), script_(std::move(script)), options_(options),
+      tcp_(this), ws_(QStringLiteral("anytalk-bench"), QWebSocketServer::NonSecureMode, this),
+      rng_(options.seed) {
+    connect(&tcp_, &QTcpServer::newConnection, this, &MockVolcengineServer::onTcpConnection);
+    connect(&ws_, &QWebSocketServer::newConnection, this, &MockVolcengineServer::onWsConnection);
+    clock_.start();
+}
+
+MockVolcengineServer::~MockVolcengineServer() = default;
+
+QString MockVolcengineServer::listen() {
+    if (!tcp_.listen(QHostAddress::LocalHost, 0)) return {};
+    return QStringLiteral("ws://127.0.0.1:%1").arg(tcp_.serverPort());
+}
+
+int MockVolcengineServer::delayMs() {
+    const int j = options_.jitterMs;
+    const int d = options_.rttMs + (j > 0 ? std::uniform_int_distribution<int>(-j, j)(rng_) : 0);
+    return std::max(d, 0);
+}
+
+void MockVolcengineServer::onTcpConnection() {
+    while (QTcpSocket *sock = tcp_.nextPendingConnection()) {
+        // Hold the upgrade request back for a round trip; QWebSocketServer
+        // picks up whatever the socket already buffered.
+        QTimer::singleShot(delayMs(), this, [this, sock]() { ws_.handleConnection(sock); });
+    }
+}
+
+void MockVolcengineServer::onWsConnection() {
+    while (QWebSocket *ws = ws_.nextPendingConnection()) {
+        sessions_.insert(ws, Session{});
+        connect(ws, &QWebSocket::binaryMessageReceived, this,
+                [this, ws](const QByteArray &frame) { onClientFrame(ws, frame); });
+        connect(ws, &QWebSocket::disconnected, this, [this, ws]() {
+            sessions_.remove(ws);
+            ws->deleteLater();
+        });
+    }
+}
+
+void MockVolcengineServer::onClientFrame(QWebSocket *ws, const QByteArray &frame) {
+    auto it = sessions_.find(ws);
+    if (it == sessions_.end() || frame.size() < 12) return;
+    Session &s = it.value();
+    const auto b1 = static_cast<quint8>(frame[1]);
+    const quint8 type = b1 >> 4;
+    if (type == kMsgFullClientReq) {
+        const QJsonObject audio = QJsonDocument::fromJson(frame.mid(12)).object()
+                                      .value("audio").toObject();
+        s.opus = audio.value("format").toString() == QLatin1String("ogg");
+        return;
+    }
+    if (type != kMsgAudioOnly) return;
+    const int payload = static_cast<int>(frame.size() - 12);
+    if (s.firstAudioAtMs < 0) s.firstAudioAtMs = clock_.elapsed();
+    if (s.opus) {
+        s.audioBytes += qint64(payload) * kPcmBytesPerMs / kOpusBytesPerMs;
+    } else if ((static_cast<quint8>(frame[2]) & 0xF) == kCompressionGzip) {
+        s.audioBytes += gunzippedSize(frame.constData() + 12, payload);
+    } else {
+        s.audioBytes += payload;
+    }
+    if (b1 & kFlagLast) s.last = true;
+    releaseDue(ws, s);
+}
+
+void MockVolcengineServer::releaseDue(QWebSocket *ws, Session &s) {
+    const qint64 audioMs = s.audioBytes / kPcmBytesPerMs;
+    while (s.next < script_.size()) {
+        const Entry &e = script_.at(s.next);
+        if (e.onLast && !s.last) return;
+        if (!e.onLast && !s.last && e.afterAudioMs > audioMs) return;
+        ++s.next;
+        const bool final = e.onLast && s.next == script_.size();
+        sendLater(ws, s, e.payload, final);
+    }
+    if (s.last && s.next == script_.size()) {
+        ++s.next;  // past the end: the final went out (or goes out now)
+        if (script_.isEmpty() || !script_.last().onLast) {
+            sendLater(ws, s, response(QString(), {}), /*final=*/true);
+        }
+    }
+}
+
+void MockVolcengineServer::sendLater(QWebSocket *ws, Session &s, const QByteArray &payload,
+                                     bool final) {
+    const qint64 now = clock_.elapsed();
+    qint64 ready = now;
+    if (options_.decodeSpeed > 0 && s.firstAudioAtMs >= 0) {
+        const double audioMs = static_cast<double>(s.audioBytes) / kPcmBytesPerMs;
+        ready = std::max(ready, s.firstAudioAtMs +
+                                    static_cast<qint64>(audioMs / options_.decodeSpeed));
+    }
+    s.sendAtMs = std::max(s.sendAtMs, ready + delayMs());
+    const QByteArray frame = serverFrame(payload, s.seq++, final);
+    QTimer::singleShot(static_cast<int>(s.sendAtMs - now), ws, [ws, frame, final]() {
+        ws->sendBinaryMessage(frame);
+        if (final) ws->close();
+    });
+}
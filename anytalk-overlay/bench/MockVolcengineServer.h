@@ -0,0 +1,93 @@
+#pragma once
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <QWebSocketServer>
+
+#include <random>
+
+class QWebSocket;
+
+/// Plain-ws stand-in for the SAUC endpoint, for anytalk-bench. Speaks the
+/// client side of VolcengineProtocol in reverse: takes a full client
+/// request and audio_only frames, answers with full server responses from
+/// a script, and closes after the final one.
+///
+/// Script: one entry per server response.
+///   afterAudioMs  sent once that much audio arrived (as PCM: gzip frames
+///                 are inflated, Opus is estimated from its bitrate)
+///   onLast        sent only after the client's LAST frame; the final
+///                 entry carries the end-of-stream flags. With no onLast
+///                 entry an empty final response is sent.
+/// On disk (loadScript) that's JSONL, one {"after_ms": n, "payload": {…}}
+/// or {"on_last": true, "payload": {…}} per line — the payload is the
+/// server JSON verbatim, e.g. a capture of a real session.
+///
+/// Latency model: the upgrade is answered one RTT (± jitter) after the TCP
+/// accept — TCP and TLS round trips aren't modelled, the bench is
+/// plain ws. Every response goes out one RTT (± jitter) after it became
+/// due, never ahead of the one before it (TCP keeps order). With
+/// decodeSpeed set, no response leaves before the server could have
+/// recognised the audio it covers at that multiple of real time — a
+/// per-stream ceiling, as a real recogniser has, which is what makes a
+/// buffer upload split into parallel sessions (BatchTranscriber) pay off.
+///
+/// Lives on its own thread, so its work stays out of the client's CPU and
+/// allocation counts.
+class MockVolcengineServer : public QObject {
+    Q_OBJECT
+public:
+    struct Entry {
+        int afterAudioMs = 0;
+        bool onLast = false;
+        QByteArray payload;
+    };
+    struct Options {
+        int rttMs = 40;
+        int jitterMs = 10;
+        double decodeSpeed = 0;  // × real time per stream; 0 = instant
+        quint32 seed = 1;
+    };
+
+    static QList<Entry> loadScript(const QString &path, QString &error);
+    /// Partials growing every 200 ms of audio, a definite utterance every
+    /// 2 s, like a bidi_async session over `audioMs` of speech.
+    static QList<Entry> syntheticScript(int audioMs);
+
+    MockVolcengineServer(QList<Entry> script, Options options, QObject *parent = nullptr);
+    ~MockVolcengineServer() override;
+
+    /// Listen on 127.0.0.1, any port. ws://127.0.0.1:<port>, or empty.
+    QString listen();
+
+private:
+    struct Session {
+        qint64 audioBytes = 0;
+        int next = 0;           // next script entry
+        bool last = false;      // client sent its LAST frame
+        bool opus = false;      // audio.format "ogg": payloads are Opus
+        qint64 sendAtMs = 0;    // when the previous response leaves
+        qint64 firstAudioAtMs = -1;
+        qint32 seq = 1;
+    };
+
+    void onTcpConnection();
+    void onWsConnection();
+    void onClientFrame(QWebSocket *ws, const QByteArray &frame);
+    void releaseDue(QWebSocket *ws, Session &s);
+    void sendLater(QWebSocket *ws, Session &s, const QByteArray &payload, bool final);
+    int delayMs();
+
+    QList<Entry> script_;
+    Options options_;
+    // Children, so moveToThread() takes them along.
+    QTcpServer tcp_;
+    QWebSocketServer ws_;
+    QHash<QWebSocket *, Session> sessions_;
+    QElapsedTimer clock_;
+    std::mt19937 rng_;
+};
@@ -0,0 +1,160 @@
+#include "ResultTypeDiff.h"
+
+#include "asr/VolcengineProtocol.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <algorithm>
+
+namespace resultdiff {
+
+namespace {
+
+// What the caller of a backend sees, in order.
+struct Transcript {
+    QStringList events;  // "partial: …" / "final: …"
+    QStringList finals;
+    QString committed;   // finals as AsrController's TranscriptBuffer joins them
+};
+
+Transcript replay(const QList<QByteArray> &payloads, const QString &mode, bool incremental) {
+    Transcript t;
+    volcengine::AsrParseState state;
+    state.incremental = incremental;
+    for (const QByteArray &payload : payloads) {
+        const auto parsed = volcengine::parseAsrResponse(payload, state, mode);
+        if (parsed.partial) t.events.append(QStringLiteral("partial: ") + *parsed.partial);
+        for (const auto &f : parsed.finals) {
+            t.events.append(QStringLiteral("final: ") + f);
+            t.finals.append(f);
+            t.committed += f;
+        }
+    }
+    return t;
+}
+
+QList<QByteArray> payloads(const QList<MockVolcengineServer::Entry> &script) {
+    QList<QByteArray> out;
+    for (const auto &e : script) out.append(e.payload);
+    return out;
+}
+
+// Index of the first entry where `a` and `b` differ (the shorter one's
+// end when one is a prefix of the other).
+qsizetype firstDifference(const QStringList &a, const QStringList &b) {
+    const qsizetype n = std::min(a.size(), b.size());
+    qsizetype i = 0;
+    while (i < n && a.at(i) == b.at(i)) ++i;
+    return i;
+}
+
+QString at(const QStringList &list, qsizetype i) {
+    return i < list.size() ? list.at(i) : QStringLiteral("(end)");
+}
+
+QByteArray withoutUtterances(const QByteArray &payload) {
+    QJsonObject root = QJsonDocument::fromJson(payload).object();
+    QJsonObject result = root.value(QStringLiteral("result")).toObject();
+    result.remove(QStringLiteral("utterances"));
+    root.insert(QStringLiteral("result"), result);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+} // namespace
+
+QByteArray SingleModeServer::thin(const QByteArray &full) {
+    QJsonObject root = QJsonDocument::fromJson(full).object();
+    QJsonObject result = root.value(QStringLiteral("result")).toObject();
+    const QJsonValue utterancesVal = result.value(QStringLiteral("utterances"));
+
+    if (!utterancesVal.isArray()) {
+        // Text only: the server still leaves out what it already finished.
+        QString text = result.value(QStringLiteral("text")).toString();
+        if (text.startsWith(finishedText_)) text.remove(0, finishedText_.size());
+        result.insert(QStringLiteral("text"), text);
+    } else {
+        const QJsonArray all = utterancesVal.toArray();
+        QJsonArray kept;
+        QString text;
+        for (qsizetype i = finishedCount_; i < all.size(); ++i) {
+            kept.append(all.at(i));
+            text += all.at(i).toObject().value(QStringLiteral("text")).toString();
+        }
+        // Definite segments come first; the ones this response finishes
+        // are sent now and never again.
+        int lead = 0;
+        while (lead < all.size() &&
+               all.at(lead).toObject().value(QStringLiteral("definite")).toBool()) {
+            ++lead;
+        }
+        for (; finishedCount_ < lead; ++finishedCount_) {
+            finishedText_ +=
+                all.at(finishedCount_).toObject().value(QStringLiteral("text")).toString();
+        }
+        result.insert(QStringLiteral("utterances"), kept);
+        result.insert(QStringLiteral("text"), text);
+    }
+    root.insert(QStringLiteral("result"), result);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QList<MockVolcengineServer::Entry> scriptedSession(int audioMs) {
+    QList<MockVolcengineServer::Entry> script = MockVolcengineServer::syntheticScript(audioMs);
+    if (script.isEmpty()) return script;
+    const MockVolcengineServer::Entry first = script.first();
+    const MockVolcengineServer::Entry last = script.last();
+    script.prepend({first.afterAudioMs / 2, false, withoutUtterances(first.payload)});
+    script.append({0, true, withoutUtterances(last.payload)});
+    return script;
+}
+
+bool compare(const QList<MockVolcengineServer::Entry> &script, const QString &mode,
+             QString &report, bool &weak) {
+    const QList<QByteArray> full = payloads(script);
+    QList<QByteArray> thinned;
+    SingleModeServer server;
+    for (const QByteArray &p : full) thinned.append(server.thin(p));
+
+    const Transcript a = replay(full, mode, /*incremental=*/false);
+    const Transcript b = replay(thinned, mode, /*incremental=*/true);
+    const Transcript control = replay(thinned, mode, /*incremental=*/false);
+    weak = control.events == a.events && control.committed == a.committed;
+
+    if (a.events == b.events && a.committed == b.committed) {
+        report = QStringLiteral("%1 event(s), %2 committed char(s)")
+                     .arg(a.events.size())
+                     .arg(a.committed.size());
+        if (weak) report += QStringLiteral(" — weak: nothing in it needs stitching");
+        return true;
+    }
+    const qsizetype i = firstDifference(a.events, b.events);
+    report = QStringLiteral("event %1: full \"%2\", single \"%3\"; committed full \"%4\", "
+                            "single \"%5\"")
+                 .arg(i + 1)
+                 .arg(at(a.events, i), at(b.events, i), a.committed, b.committed);
+    return false;
+}
+
+bool compareCaptures(const QList<MockVolcengineServer::Entry> &full,
+                     const QList<MockVolcengineServer::Entry> &single, const QString &mode,
+                     QString &report) {
+    const Transcript a = replay(payloads(full), mode, /*incremental=*/false);
+    const Transcript b = replay(payloads(single), mode, /*incremental=*/true);
+    if (a.finals == b.finals && a.committed == b.committed) {
+        report = QStringLiteral("%1 final(s), %2 committed char(s)")
+                     .arg(a.finals.size())
+                     .arg(a.committed.size());
+        return true;
+    }
+    const qsizetype i = firstDifference(a.finals, b.finals);
+    report = QStringLiteral("final %1: full \"%2\", single \"%3\"; committed full \"%4\", "
+                            "single \"%5\"")
+                 .arg(i + 1)
+                 .arg(at(a.finals, i), at(b.finals, i), a.committed, b.committed);
+    return false;
+}
+
+} // namespace resultdiff
@@ -0,0 +1,55 @@
+#pragma once
+#include "MockVolcengineServer.h"
+
+#include <QList>
+#include <QString>
+
+/// anytalk-bench --diff-result-type: a session parsed as result_type
+/// "full" and as "single", which must give the same text.
+///
+/// The "single" side comes from SingleModeServer, a model of the server
+/// that knows nothing of the parser: it tracks by position which leading
+/// utterances it has already sent as definite and leaves them out of
+/// every later response, result.text included — a text-only response
+/// carries only what follows the finished segments. Both sides run
+/// through volcengine::parseAsrResponse() with their own AsrParseState —
+/// the exact per-response path of VolcengineBackend — and are compared on
+/// every partial, every final and the committed text.
+///
+/// To show the script tells the modes apart at all, the thinned side is
+/// also parsed as if it were "full"; a script where that agrees too has
+/// nothing that needs stitching and is reported as weak.
+///
+/// Real captures can be paired instead (--single-responses): a "single"
+/// session and a "full" one of the same audio are compared on finals and
+/// committed text, not partials, since their timing differs.
+namespace resultdiff {
+
+class SingleModeServer {
+public:
+    /// What a "single" server sends in place of `full`, the next response
+    /// of a result_type "full" session.
+    QByteArray thin(const QByteArray &full);
+
+private:
+    int finishedCount_ = 0;  // leading utterances already sent as definite
+    QString finishedText_;   // their text, in order
+};
+
+/// syntheticScript(audioMs), plus the text-only responses a session can
+/// have: one before the first utterance, and a last one after the final
+/// with only result.text.
+QList<MockVolcengineServer::Entry> scriptedSession(int audioMs);
+
+/// True when both modes agree on `script`; otherwise `report` says where
+/// they first part. `weak` is set when the control run agrees as well.
+bool compare(const QList<MockVolcengineServer::Entry> &script, const QString &mode,
+             QString &report, bool &weak);
+
+/// A recorded "full" session against a recorded "single" one of the same
+/// audio: true when finals and committed text match.
+bool compareCaptures(const QList<MockVolcengineServer::Entry> &full,
+                     const QList<MockVolcengineServer::Entry> &single, const QString &mode,
+                     QString &report);
+
+} // namespace resultdiff
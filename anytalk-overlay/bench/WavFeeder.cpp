@@ -0,0 +1,90 @@
+#include "WavFeeder.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr int kChunkMs = 40;
+
+quint32 le32(const char *p) { return qFromLittleEndian<quint32>(p); }
+quint16 le16(const char *p) { return qFromLittleEndian<quint16>(p); }
+} // namespace
+
+QByteArray WavFeeder::load(const QString &path, QString &error) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        error = f.errorString();
+        return {};
+    }
+    const QByteArray file = f.readAll();
+    if (file.size() < 12 || !file.startsWith("RIFF") || file.mid(8, 4) != "WAVE") {
+        error = QStringLiteral("not a RIFF/WAVE file");
+        return {};
+    }
+    bool formatOk = false;
+    // Chunks are word-aligned; walk them until "data".
+    for (qsizetype at = 12; at + 8 <= file.size();) {
+        const char *hdr = file.constData() + at;
+        const qsizetype size = le32(hdr + 4);
+        const qsizetype body = at + 8;
+        if (body + size > file.size() && std::memcmp(hdr, "data", 4) != 0) break;
+        if (std::memcmp(hdr, "fmt ", 4) == 0 && size >= 16) {
+            const char *fmt = file.constData() + body;
+            // PCM (1) or WAVE_FORMAT_EXTENSIBLE (0xFFFE) wrapping PCM.
+            const quint16 tag = le16(fmt);
+            formatOk = (tag == 1 || tag == 0xFFFE) && le16(fmt + 2) == 1 &&
+                       le32(fmt + 4) == 16000 && le16(fmt + 14) == 16;
+            if (!formatOk) {
+                error = QStringLiteral("need 16 kHz mono S16LE PCM (try: sox in.wav -r 16000 "
+                                       "-c 1 -b 16 out.wav)");
+                return {};
+            }
+        } else if (std::memcmp(hdr, "data", 4) == 0) {
+            if (!formatOk) break;
+            // Streamed WAVs leave the size at 0 / 0xFFFFFFFF: take the rest.
+            const qsizetype n = std::min(size, file.size() - body);
+            return file.mid(body, n & ~qsizetype(1));
+        }
+        at = body + size + (size & 1);
+    }
+    error = formatOk ? QStringLiteral("no data chunk") : QStringLiteral("no fmt chunk");
+    return {};
+}
+
+WavFeeder::WavFeeder(QByteArray pcm, double speed, QObject *parent)
+    : QObject(parent), pcm_(std::move(pcm)), speed_(std::max(speed, 0.0)) {
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &WavFeeder::tick);
+}
+
+void WavFeeder::start() {
+    offset_ = 0;
+    clock_.start();
+    timer_.start(speed_ > 0 ? static_cast<int>(std::lround(kChunkMs / speed_)) : 0);
+    tick();
+}
+
+void WavFeeder::stop() { timer_.stop(); }
+
+void WavFeeder::tick() {
+    // Audio the capture clock has produced by now; the first chunk goes
+    // out at once, like a warmed-up mic.
+    const qsizetype due =
+        speed_ > 0
+            ? (static_cast<qsizetype>(static_cast<double>(clock_.nsecsElapsed()) * speed_ /
+                                      (kChunkMs * 1e6)) + 1) * kChunkBytes
+            : offset_ + kChunkBytes;
+    while (offset_ < std::min(due, pcm_.size())) {
+        const qsizetype n = std::min<qsizetype>(kChunkBytes, pcm_.size() - offset_);
+        emit chunk(QByteArray::fromRawData(pcm_.constData() + offset_, n));
+        offset_ += n;
+    }
+    if (offset_ >= pcm_.size()) {
+        timer_.stop();
+        emit finished();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+/// Stands in for AudioCapture in anytalk-bench: plays a WAV file out as
+/// 40 ms S16LE chunks on the capture clock, scaled by `speed` (2 = twice
+/// real time, 0 = as fast as the event loop goes). Chunks are scheduled
+/// against the session start rather than the previous tick, so a slow
+/// event loop catches up instead of stretching the recording.
+class WavFeeder : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int kChunkBytes = 1280;  // same as AudioCapture
+
+    /// 16 kHz mono S16LE PCM data of `path`; empty + `error` otherwise.
+    static QByteArray load(const QString &path, QString &error);
+
+    WavFeeder(QByteArray pcm, double speed, QObject *parent = nullptr);
+
+    void start();
+    void stop();
+    int durationMs() const { return static_cast<int>(pcm_.size() / 32); }
+
+signals:
+    void chunk(const QByteArray &pcm);
+    void finished();
+
+private:
+    void tick();
+
+    QByteArray pcm_;
+    double speed_;
+    qsizetype offset_ = 0;
+    QElapsedTimer clock_;
+    QTimer timer_;
+};
@@ -0,0 +1,467 @@
+// anytalk-bench — replay-driven end-to-end benchmark for the Volcengine
+// path, plus hot-path micro-benchmarks. Not installed; built with
+// -DANYTALK_BUILD_BENCH=ON. See docs/architecture.md ("Benchmarks").
+//
+//   anytalk-bench --wav speech.wav [--responses session.jsonl] [--sessions 20]
+//                 [--rtt 40] [--jitter 10] [--speed 1] [--frame-ms 40]
+//   anytalk-bench --wav memo.wav --batch [--parallel 4] [--piece-sec 60]
+//                 [--server-speed 4]
+//   anytalk-bench --micro [--responses capture.jsonl]
+//                 [--baseline bench/baseline.json | --write-baseline FILE]
+//   anytalk-bench --diff-result-type [--responses full.jsonl [--single-responses single.jsonl]]...
+//                 [--mode bidi_async]
+
+#include "AllocCounter.h"
+#include "MicroBench.h"
+#include "MockVolcengineServer.h"
+#include "ResultTypeDiff.h"
+#include "WavFeeder.h"
+#include "asr/BatchTranscriber.h"
+#include "asr/VolcengineBackend.h"
+#include "audio/LevelKernel.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QThread>
+#include <QTimer>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct SessionResult {
+    qint64 recordingMs = -1;     // start() → connected and first chunk in
+    qint64 firstPartialMs = -1;  // start() → first non-empty partial
+    qint64 commitMs = -1;        // stop() → finished()
+    double cpuMs = 0;            // this thread's user + system time
+    alloc::Counts allocs;
+    AsrTransportStats transport;
+    QString error;
+};
+
+double threadCpuMs() {
+    rusage ru{};
+    getrusage(RUSAGE_THREAD, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+SessionResult runSession(VolcengineBackend &backend, WavFeeder &feeder, int timeoutMs) {
+    SessionResult r;
+    QEventLoop loop;
+    QElapsedTimer clock;
+    qint64 stopAt = -1;
+    bool connected = false;
+    bool audio = false;
+    auto maybeRecording = [&]() {
+        if (connected && audio && r.recordingMs < 0) r.recordingMs = clock.elapsed();
+    };
+
+    QList<QMetaObject::Connection> wires;
+    wires << QObject::connect(&feeder, &WavFeeder::chunk, &backend, [&](const QByteArray &pcm) {
+        backend.pushPcm(pcm);
+        audio = true;
+        maybeRecording();
+    });
+    wires << QObject::connect(&feeder, &WavFeeder::finished, &backend, [&]() {
+        stopAt = clock.elapsed();
+        backend.stop();
+    });
+    wires << QObject::connect(&backend, &AsrBackend::connected, &loop, [&]() {
+        connected = true;
+        maybeRecording();
+    });
+    wires << QObject::connect(&backend, &AsrBackend::partial, &loop, [&](const QString &text) {
+        if (!text.isEmpty() && r.firstPartialMs < 0) r.firstPartialMs = clock.elapsed();
+    });
+    wires << QObject::connect(&backend, &AsrBackend::finished, &loop, [&]() {
+        if (stopAt >= 0) r.commitMs = clock.elapsed() - stopAt;
+        loop.quit();
+    });
+    wires << QObject::connect(&backend, &AsrBackend::error, &loop, [&](const QString &msg) {
+        r.error = msg;
+        loop.quit();
+    });
+    QTimer guard;
+    guard.setSingleShot(true);
+    wires << QObject::connect(&guard, &QTimer::timeout, &loop, [&]() {
+        r.error = QStringLiteral("timed out");
+        backend.cancel();
+        loop.quit();
+    });
+
+    const double cpu0 = threadCpuMs();
+    const alloc::Counts alloc0 = alloc::thisThread();
+    clock.start();
+    guard.start(timeoutMs);
+    backend.start();
+    feeder.start();
+    loop.exec();
+    feeder.stop();
+    r.allocs = alloc::thisThread() - alloc0;
+    r.cpuMs = threadCpuMs() - cpu0;
+    r.transport = backend.transportStats();
+    for (const auto &c : wires) QObject::disconnect(c);
+    return r;
+}
+
+struct BatchResult {
+    qint64 wallMs = -1;  // submitBuffer() → finished()
+    int finals = 0;
+    AsrTransportStats transport;
+    QString error;
+};
+
+BatchResult runBatch(AsrBackend &backend, const QByteArray &pcm, int timeoutMs) {
+    BatchResult r;
+    QEventLoop loop;
+    QElapsedTimer clock;
+    QList<QMetaObject::Connection> wires;
+    wires << QObject::connect(&backend, &AsrBackend::final_, &loop,
+                              [&](const QString &) { ++r.finals; });
+    wires << QObject::connect(&backend, &AsrBackend::finished, &loop, [&]() {
+        r.wallMs = clock.elapsed();
+        loop.quit();
+    });
+    wires << QObject::connect(&backend, &AsrBackend::error, &loop, [&](const QString &msg) {
+        r.error = msg;
+        loop.quit();
+    });
+    QTimer guard;
+    guard.setSingleShot(true);
+    wires << QObject::connect(&guard, &QTimer::timeout, &loop, [&]() {
+        r.error = QStringLiteral("timed out");
+        backend.cancel();
+        loop.quit();
+    });
+
+    clock.start();
+    guard.start(timeoutMs);
+    backend.submitBuffer(pcm);
+    loop.exec();
+    r.transport = backend.transportStats();
+    for (const auto &c : wires) QObject::disconnect(c);
+    return r;
+}
+
+// Nearest-rank percentile over the non-negative samples.
+qint64 percentile(std::vector<qint64> v, double p) {
+    v.erase(std::remove_if(v.begin(), v.end(), [](qint64 x) { return x < 0; }), v.end());
+    if (v.empty()) return -1;
+    std::sort(v.begin(), v.end());
+    const auto rank = static_cast<std::size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+    return v[std::min(rank, v.size() - 1)];
+}
+
+void printSummary(const char *name, const std::vector<qint64> &v) {
+    std::printf("  %-22s p50 %5lld  p90 %5lld  max %5lld ms\n", name,
+                static_cast<long long>(percentile(v, 0.5)),
+                static_cast<long long>(percentile(v, 0.9)),
+                static_cast<long long>(percentile(v, 1.0)));
+}
+
+int runMicro(const QCommandLineParser &parser, int minMs) {
+    std::printf("level kernel: %s, allocation counter: %s\n", level::kernelName(),
+                alloc::available() ? "on" : "unavailable");
+    // --responses: a capture to time next to the scripted sessions.
+    QList<QByteArray> capture;
+    if (parser.isSet(QStringLiteral("responses"))) {
+        const QString path = parser.value(QStringLiteral("responses"));
+        QString error;
+        const auto script = MockVolcengineServer::loadScript(path, error);
+        if (script.isEmpty()) {
+            std::fprintf(stderr, "anytalk-bench: %s: %s\n", qPrintable(path),
+                         qPrintable(error.isEmpty() ? QStringLiteral("empty script") : error));
+            return 2;
+        }
+        for (const auto &e : script) capture.append(e.payload);
+    }
+    const auto results = microbench::runAll(minMs, capture);
+    for (const auto &r : results) {
+        std::printf("  %-32s %10.1f ns/op  %6.2f allocs/op\n", r.name.toUtf8().constData(),
+                    r.nsPerOp, r.allocsPerOp);
+    }
+    QString error;
+    if (parser.isSet(QStringLiteral("write-baseline"))) {
+        const QString path = parser.value(QStringLiteral("write-baseline"));
+        if (!microbench::writeBaseline(path, results, error)) {
+            std::fprintf(stderr, "anytalk-bench: %s: %s\n", qPrintable(path), qPrintable(error));
+            return 2;
+        }
+        std::printf("baseline written to %s\n", qPrintable(path));
+    }
+    if (parser.isSet(QStringLiteral("baseline"))) {
+        const QString path = parser.value(QStringLiteral("baseline"));
+        const double tolerance = parser.value(QStringLiteral("tolerance")).toDouble() / 100.0;
+        std::printf("against %s (tolerance %.0f%%):\n", qPrintable(path), tolerance * 100);
+        const bool ok = microbench::compareBaseline(path, results, tolerance, error);
+        if (!error.isEmpty()) {
+            std::fprintf(stderr, "anytalk-bench: %s: %s\n", qPrintable(path), qPrintable(error));
+            return 2;
+        }
+        if (!ok) return 1;
+    }
+    return 0;
+}
+
+// Exit 1 if result_type "single" and "full" disagree on any script.
+int runResultTypeDiff(const QCommandLineParser &parser) {
+    const QString mode = parser.value(QStringLiteral("mode"));
+    const QStringList paths = parser.values(QStringLiteral("responses"));
+    const QStringList singlePaths = parser.values(QStringLiteral("single-responses"));
+    if (!singlePaths.isEmpty() && singlePaths.size() != paths.size()) {
+        std::fprintf(stderr, "anytalk-bench: --single-responses pairs with --responses, one each\n");
+        return 2;
+    }
+    auto load = [](const QString &path, QList<MockVolcengineServer::Entry> &script) {
+        QString error;
+        script = MockVolcengineServer::loadScript(path, error);
+        if (script.isEmpty()) {
+            std::fprintf(stderr, "anytalk-bench: %s: %s\n", qPrintable(path),
+                         qPrintable(error.isEmpty() ? QStringLiteral("empty script") : error));
+        }
+        return !script.isEmpty();
+    };
+    int failed = 0;
+    auto print = [&](bool same, const QString &name, const QString &report) {
+        if (!same) ++failed;
+        std::printf("  %-4s %s: %s\n", same ? "ok" : "FAIL", qPrintable(name),
+                    qPrintable(report));
+    };
+    auto check = [&](const QString &name, const QList<MockVolcengineServer::Entry> &script) {
+        QString report;
+        bool weak = false;
+        const bool same = resultdiff::compare(script, mode, report, weak);
+        print(same, name, report);
+    };
+
+    std::printf("result_type single vs full, mode %s:\n", qPrintable(mode));
+    if (paths.isEmpty()) {
+        for (const int seconds : {10, 180}) {
+            check(QStringLiteral("scripted %1 s").arg(seconds),
+                  resultdiff::scriptedSession(seconds * 1000));
+        }
+    }
+    for (qsizetype i = 0; i < paths.size(); ++i) {
+        QList<MockVolcengineServer::Entry> full;
+        if (!load(paths.at(i), full)) return 2;
+        if (singlePaths.isEmpty()) {
+            check(paths.at(i), full);
+            continue;
+        }
+        QList<MockVolcengineServer::Entry> single;
+        if (!load(singlePaths.at(i), single)) return 2;
+        QString report;
+        const bool same = resultdiff::compareCaptures(full, single, mode, report);
+        print(same, paths.at(i) + QStringLiteral(" / ") + singlePaths.at(i), report);
+    }
+    return failed ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("anytalk-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Replay WAV audio through VolcengineBackend against a local mock server and "
+        "report per-session latency, CPU and allocations; or run the micro-benchmarks.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"wav", "16 kHz mono S16LE WAV to feed as the microphone.", "file"},
+        {"responses", "JSONL response script for the mock server (default: synthetic); "
+                      "--diff-result-type takes several, --micro times its parse.", "file"},
+        {"sessions", "Sessions to run back to back.", "n", "10"},
+        {"rtt", "Modelled network round trip.", "ms", "40"},
+        {"jitter", "Uniform ± jitter on every modelled round trip.", "ms", "10"},
+        {"speed", "Feed speed: 1 = real time, 0 = as fast as possible.", "x", "1"},
+        {"frame-ms", "[Volcengine] FrameMs: 40..200 or adaptive.", "ms", "40"},
+        {"encoding", "[Volcengine] AudioEncoding: pcm, gzip or opus.", "name", "pcm"},
+        {"mode", "[Volcengine] Mode.", "mode", "bidi_async"},
+        {"spare", "Keep a pre-handshaken spare socket between sessions."},
+        {"batch", "Recognise the WAV as a buffer (BatchTranscriber) instead of live."},
+        {"parallel", "--batch: sessions at a time.", "n", "4"},
+        {"piece-sec", "--batch: cut at the first pause past this.", "s", "60"},
+        {"server-speed", "Mock recognition speed per stream, × real time (0 = instant).", "x",
+         "0"},
+        {"micro", "Run the micro-benchmarks instead."},
+        {"diff-result-type",
+         "Parse each --responses script (default: scripted) as result_type full and, thinned "
+         "by a model single-mode server, as single; exit 1 unless both give the same "
+         "partials, finals and text."},
+        {"single-responses",
+         "--diff-result-type: a recorded result_type single session of the same audio as the "
+         "--responses one it pairs with; finals and text must match.", "file"},
+        {"min-ms", "Micro-benchmark time per round.", "ms", "200"},
+        {"baseline", "Compare micro-benchmarks against this file; exit 1 on regression.", "file"},
+        {"write-baseline", "Write the micro-benchmark results to this file.", "file"},
+        {"tolerance", "Allowed slowdown against --baseline.", "percent", "25"},
+    });
+    parser.addPositionalArgument("wav", "Same as --wav.", "[wav]");
+    parser.process(app);
+
+    if (parser.isSet(QStringLiteral("diff-result-type"))) return runResultTypeDiff(parser);
+    if (parser.isSet(QStringLiteral("micro"))) {
+        return runMicro(parser, std::max(parser.value(QStringLiteral("min-ms")).toInt(), 10));
+    }
+
+    QString wavPath = parser.value(QStringLiteral("wav"));
+    if (wavPath.isEmpty() && !parser.positionalArguments().isEmpty()) {
+        wavPath = parser.positionalArguments().first();
+    }
+    if (wavPath.isEmpty()) {
+        std::fprintf(stderr, "anytalk-bench: need --wav (or --micro)\n");
+        return 2;
+    }
+    QString error;
+    QByteArray pcm = WavFeeder::load(wavPath, error);
+    if (pcm.isEmpty()) {
+        std::fprintf(stderr, "anytalk-bench: %s: %s\n", qPrintable(wavPath),
+                     qPrintable(error.isEmpty() ? QStringLiteral("no audio") : error));
+        return 2;
+    }
+    const double speed = parser.value(QStringLiteral("speed")).toDouble();
+    const QByteArray audio = pcm;  // shared, for --batch
+    WavFeeder feeder(std::move(pcm), speed);
+
+    QList<MockVolcengineServer::Entry> script;
+    if (parser.isSet(QStringLiteral("responses"))) {
+        const QString path = parser.value(QStringLiteral("responses"));
+        script = MockVolcengineServer::loadScript(path, error);
+        if (script.isEmpty()) {
+            std::fprintf(stderr, "anytalk-bench: %s: %s\n", qPrintable(path),
+                         qPrintable(error.isEmpty() ? QStringLiteral("empty script") : error));
+            return 2;
+        }
+    } else {
+        script = MockVolcengineServer::syntheticScript(feeder.durationMs());
+    }
+
+    MockVolcengineServer::Options net;
+    net.rttMs = std::max(parser.value(QStringLiteral("rtt")).toInt(), 0);
+    net.jitterMs = std::max(parser.value(QStringLiteral("jitter")).toInt(), 0);
+    net.decodeSpeed = std::max(parser.value(QStringLiteral("server-speed")).toDouble(), 0.0);
+
+    // The server gets its own thread (and event loop), so only the
+    // client's work lands in the per-thread CPU and allocation counts.
+    QThread serverThread;
+    serverThread.setObjectName(QStringLiteral("mock-server"));
+    auto *server = new MockVolcengineServer(std::move(script), net);
+    server->moveToThread(&serverThread);
+    QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread.start();
+    QString endpoint;
+    QMetaObject::invokeMethod(server, &MockVolcengineServer::listen,
+                              Qt::BlockingQueuedConnection, &endpoint);
+    if (endpoint.isEmpty()) {
+        std::fprintf(stderr, "anytalk-bench: mock server failed to listen\n");
+        serverThread.quit();
+        serverThread.wait();
+        return 2;
+    }
+
+    VolcengineBackend::Settings s;
+    s.appId = QStringLiteral("bench");
+    s.accessToken = QStringLiteral("bench");
+    s.endpoint = endpoint;
+    s.mode = parser.value(QStringLiteral("mode"));
+    s.spareConnections = parser.isSet(QStringLiteral("spare")) ? 1 : 0;
+    const QString frameMs = parser.value(QStringLiteral("frame-ms"));
+    if (frameMs == QLatin1String("adaptive")) {
+        s.adaptiveFrames = true;
+    } else {
+        s.frameMs = std::clamp(frameMs.toInt(), 40, 200);
+    }
+    if (const auto e = volcengine::parseAudioEncoding(parser.value(QStringLiteral("encoding")))) {
+        s.audioEncoding = *e;
+    }
+    const int sessions = std::max(parser.value(QStringLiteral("sessions")).toInt(), 1);
+    if (parser.isSet(QStringLiteral("batch"))) {
+        s.spareConnections = 0;
+        BatchTranscriber::Settings b;
+        b.maxParallel = std::max(parser.value(QStringLiteral("parallel")).toInt(), 1);
+        b.pieceMs = std::max(parser.value(QStringLiteral("piece-sec")).toInt(), 1) * 1000;
+        b.maxPieceMs = 2 * b.pieceMs;
+        BatchTranscriber batch([s]() { return std::make_unique<VolcengineBackend>(s); }, b);
+        const int pieces = static_cast<int>(BatchTranscriber::cutPoints(audio, b).size()) + 1;
+        std::printf("%s: %d ms of audio as a buffer, %d piece(s), %d at a time, rtt %d±%d ms, "
+                    "server %sx\n",
+                    qPrintable(wavPath), feeder.durationMs(), pieces, b.maxParallel, net.rttMs,
+                    net.jitterMs,
+                    net.decodeSpeed > 0 ? qPrintable(QString::number(net.decodeSpeed)) : "∞");
+        const int timeoutMs =
+            (net.decodeSpeed > 0 ? static_cast<int>(feeder.durationMs() / net.decodeSpeed) : 0) +
+            30'000;
+        std::vector<qint64> wall;
+        int failed = 0;
+        for (int i = 0; i < sessions; ++i) {
+            const BatchResult r = runBatch(batch, audio, timeoutMs);
+            if (!r.error.isEmpty()) {
+                ++failed;
+                std::printf("  %3d error: %s\n", i + 1, qPrintable(r.error));
+                continue;
+            }
+            wall.push_back(r.wallMs);
+            std::printf("  %3d %7lldms  %6.1fx real time  %d final(s)  %lld frames\n", i + 1,
+                        static_cast<long long>(r.wallMs),
+                        r.wallMs > 0 ? feeder.durationMs() / static_cast<double>(r.wallMs) : 0.0,
+                        r.finals, static_cast<long long>(r.transport.framesSent));
+        }
+        std::printf("summary (%d ok, %d failed):\n", sessions - failed, failed);
+        if (sessions > failed) printSummary("buffer → text", wall);
+        serverThread.quit();
+        serverThread.wait();
+        return failed ? 1 : 0;
+    }
+    VolcengineBackend backend(s);
+
+    const int feedMs = speed > 0 ? static_cast<int>(feeder.durationMs() / speed) : 0;
+    const int timeoutMs = feedMs + 10'000 + 20 * (net.rttMs + net.jitterMs);
+    std::printf("%s: %d ms of audio at %sx, rtt %d±%d ms, %d session(s), endpoint %s\n",
+                qPrintable(wavPath), feeder.durationMs(),
+                speed > 0 ? qPrintable(QString::number(speed)) : "max", net.rttMs, net.jitterMs,
+                sessions, qPrintable(endpoint));
+    std::printf("  %3s %9s %9s %9s %8s %8s %10s %7s %7s\n", "#", "record", "partial",
+                "commit", "cpu", "allocs", "alloc KiB", "tx", "rx");
+
+    std::vector<qint64> recording, firstPartial, commit;
+    int failed = 0;
+    for (int i = 0; i < sessions; ++i) {
+        const SessionResult r = runSession(backend, feeder, timeoutMs);
+        if (!r.error.isEmpty()) {
+            ++failed;
+            std::printf("  %3d error: %s\n", i + 1, qPrintable(r.error));
+            continue;
+        }
+        recording.push_back(r.recordingMs);
+        firstPartial.push_back(r.firstPartialMs);
+        commit.push_back(r.commitMs);
+        std::printf("  %3d %7lldms %7lldms %7lldms %6.1fms %8llu %10.1f %7lld %7lld\n", i + 1,
+                    static_cast<long long>(r.recordingMs),
+                    static_cast<long long>(r.firstPartialMs), static_cast<long long>(r.commitMs),
+                    r.cpuMs, static_cast<unsigned long long>(r.allocs.calls),
+                    static_cast<double>(r.allocs.bytes) / 1024.0,
+                    static_cast<long long>(r.transport.framesSent),
+                    static_cast<long long>(r.transport.framesReceived));
+    }
+
+    std::printf("summary (%d ok, %d failed):\n", sessions - failed, failed);
+    if (sessions > failed) {
+        printSummary("F2 → recording", recording);
+        printSummary("F2 → first partial", firstPartial);
+        printSummary("stop → commit", commit);
+    }
+
+    serverThread.quit();
+    serverThread.wait();
+    return failed ? 1 : 0;
+}
@@ -6,13 +6,51 @@
 
 #include <QDateTime>
 #include <QDebug>
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <utility>
 
 using state::State;
 
-AsrController::AsrController(QObject *parent) : QObject(parent) {}
+namespace {
+// Upper bound for the time-bounded hot-mic window; past that, use
+// HotMicHours so the intent is explicit.
+constexpr int kMaxHotMicSec = 4 * 60 * 60;
+
+// "HH:MM-HH:MM"; an overnight window (22:00-06:00) wraps midnight.
+bool parseHours(const QString &spec, QTime &from, QTime &to) {
+    const auto parts = spec.split(QLatin1Char('-'));
+    if (parts.size() != 2) return false;
+    from = QTime::fromString(parts[0].trimmed(), QStringLiteral("H:mm"));
+    to = QTime::fromString(parts[1].trimmed(), QStringLiteral("H:mm"));
+    return from.isValid() && to.isValid() && from != to;
+}
+
+} // namespace
+
+AsrController::AsrController(QObject *parent) : QObject(parent) {
+    hotMicTimer_.setSingleShot(true);
+    hotMicTimer_.setTimerType(Qt::VeryCoarseTimer);
+    connect(&hotMicTimer_, &QTimer::timeout, this, &AsrController::onHotMicTimeout);
+    prewarmTimer_.setSingleShot(true);
+    connect(&prewarmTimer_, &QTimer::timeout, this, &AsrController::onPrewarmTimeout);
+}
 AsrController::~AsrController() = default;
 
+void AsrController::wireBackend(AsrBackend *backend) {
+    connect(backend, &AsrBackend::partial, this, &AsrController::onBackendPartial);
+    connect(backend, &AsrBackend::final_, this, &AsrController::onBackendFinal);
+    connect(backend, &AsrBackend::error, this, &AsrController::onBackendError);
+    connect(backend, &AsrBackend::connected, this, &AsrController::onBackendConnected);
+    connect(backend, &AsrBackend::finished, this, &AsrController::onBackendFinished);
+    connect(backend, &AsrBackend::congestion, this, &AsrController::onBackendCongestion);
+}
+
+AsrBackend *AsrController::sessionBackend() const {
+    return replaying_ && batch_ ? batch_.get() : backend_.get();
+}
+
 bool AsrController::applyConfig(const OverlayConfig &cfg) {
     // Reject mid-session config swaps. backend_ would be torn down here while
     // the state machine still believes it's Recording / Connecting, leaving
@@ -20,35 +58,167 @@ bool AsrController::applyConfig(const OverlayConfig &cfg) {
     // from idle; CLI startup is naturally idle.
     if (currentState_ != State::Idle) return false;
 
-    removeTrailingPunctuation_ = cfg.removeTrailingPunctuation;
+    // A reload that only touched [Overlay] / [Audio] keeps the backend —
+    // and with it a warm spare socket.
+    if (!backend_ || !applied_ || !cfg.sameBackendAs(*applied_)) {
+        // Built aside: a broken edit of a watched file must not cost the
+        // backend that still works, nor change anything else.
+        auto backend = asr::create(cfg, this);
+        if (!backend) return false;
+        backendName_ = cfg.backend;
+        const QString hedge = cfg.str(QStringLiteral("Asr"), QStringLiteral("Hedge"));
+        if (!hedge.isEmpty()) backendName_ += QLatin1Char('+') + hedge;
 
-    backend_ = asr::create(cfg, this);
-    if (!backend_) return false;
+        wireBackend(backend.get());
+        // Config is applied at startup (the auto-activating F2 is already on
+        // its way) and from idle; either way a session is likely next.
+        // Before the swap: a local-whisper backend picks up the model the
+        // old one still holds instead of reading it from disk again.
+        backend->prewarm();
+        backend_ = std::move(backend);
+        batch_ = asr::createBatch(cfg, this);
+        if (batch_) wireBackend(batch_.get());
+    }
+    applied_ = cfg;
 
-    connect(backend_.get(), &AsrBackend::partial, this, &AsrController::onBackendPartial);
-    connect(backend_.get(), &AsrBackend::final_, this, &AsrController::onBackendFinal);
-    connect(backend_.get(), &AsrBackend::error, this, &AsrController::onBackendError);
-    connect(backend_.get(), &AsrBackend::connected, this, &AsrController::onBackendConnected);
-    connect(backend_.get(), &AsrBackend::finished, this, &AsrController::onBackendFinished);
+    removeTrailingPunctuation_ = cfg.removeTrailingPunctuation;
+    streamCommit_ = cfg.overlay.streamCommit;
+    statsSink_.configure(cfg.overlay.statsFile, cfg.overlay.statsTextfile);
 
     if (!audio_) {
         audio_ = std::make_unique<AudioCapture>(this);
-        // AudioCapture::captureLoop runs on a worker QThread. Pin
+        // pcm / level are emitted on this (main) thread by AudioCapture's
+        // ring drain, batched per wakeup — direct calls, no per-chunk
+        // event. `chunk` aliases ring storage for the duration of the call.
+        connect(audio_.get(), &AudioCapture::pcm, this,
+                &AsrController::onAudioPcm, Qt::DirectConnection);
+        connect(audio_.get(), &AudioCapture::level, this,
+                &AsrController::onAudioLevel, Qt::DirectConnection);
+        // error / warmedUp come straight from the capture QThread. Pin
         // QueuedConnection so the cross-thread contract is explicit at the
         // call site (AutoConnection would behave the same way here, but
         // hides the contract behind runtime thread comparison).
-        connect(audio_.get(), &AudioCapture::pcm, this,
-                &AsrController::onAudioPcm, Qt::QueuedConnection);
-        connect(audio_.get(), &AudioCapture::level, this,
-                &AsrController::onAudioLevel, Qt::QueuedConnection);
         connect(audio_.get(), &AudioCapture::error, this,
                 &AsrController::onAudioError, Qt::QueuedConnection);
+        connect(audio_.get(), &AudioCapture::streamOpened, this,
+                &AsrController::onAudioOpened, Qt::QueuedConnection);
         connect(audio_.get(), &AudioCapture::warmedUp, this,
                 &AsrController::onAudioWarmedUp, Qt::QueuedConnection);
+        connect(audio_.get(), &AudioCapture::trailingSilence, this,
+                &AsrController::onAudioTrailingSilence, Qt::QueuedConnection);
     }
+    const AudioOptions &a = cfg.audio;
+    VoiceActivityDetector::Settings vad;
+    vad.enabled = a.vad;
+    if (a.vadAutoStopMs > 0) vad.autoStopMs = std::max(a.vadAutoStopMs, vad.hangoverMs);
+    audio_->setVadSettings(vad);
+
+    // Native PipeWire capture (when built in); quantum is what we ask the
+    // graph for, independent of the 40 ms chunks sent upstream.
+    audio_->setCaptureBackend(parseCaptureBackend(a.captureBackend.toStdString()),
+                              a.quantumMs > 0 ? std::clamp(a.quantumMs, 5, 40) : 20);
+
+    // Hot mic only pays off when the process outlives the session.
+    hotMicSec_ = std::min(a.hotMicSec, kMaxHotMicSec);
+    if (a.hotMicHours.isEmpty() || !parseHours(a.hotMicHours, hotMicFrom_, hotMicTo_)) {
+        if (!a.hotMicHours.isEmpty()) {
+            qWarning() << "AsrController: ignoring HotMicHours" << a.hotMicHours;
+        }
+        hotMicFrom_ = hotMicTo_ = QTime();
+    }
+    hotMicEnabled_ = cfg.resident && (hotMicSec_ > 0 || hotMicFrom_.isValid());
+    hotMicTimer_.stop();
+    audio_->setHotStandby(hotMicEnabled_ || prewarmTimer_.isActive());
+    // Pre-roll leaves the held stream running (mic indicator stays on), so
+    // it only applies on top of hot mic and is off unless asked for.
+    audio_->setPreRollMs(hotMicEnabled_ ? a.preRollMs : 0);
+    prewarmSec_ = std::min(cfg.overlay.prewarmSec, 120);
+
+    SessionRecorder::Settings rec;
+    rec.enabled = a.record;
+    rec.maxStoreBytes = static_cast<std::int64_t>(a.recordMaxMB) * 1024 * 1024;
+    recorder_.configure(rec);
     return true;
 }
 
+void AsrController::applyConfigWhenIdle(const OverlayConfig &cfg) {
+    pendingConfig_ = cfg;
+    if (currentState_ == State::Idle) applyPendingConfig();
+}
+
+void AsrController::applyPendingConfig() {
+    if (!pendingConfig_) return;
+    // A reload that came in mid-session; applying it re-arms hot mic.
+    const OverlayConfig cfg = std::move(*pendingConfig_);
+    pendingConfig_.reset();
+    if (!applyConfig(cfg)) {
+        qWarning() << "AsrController: reloaded config has no usable backend — keeping the current one";
+    }
+}
+
+bool AsrController::hotMicScheduledNow() const {
+    if (!hotMicFrom_.isValid()) return false;
+    const QTime now = QTime::currentTime();
+    return hotMicFrom_ < hotMicTo_ ? (now >= hotMicFrom_ && now < hotMicTo_)
+                                   : (now >= hotMicFrom_ || now < hotMicTo_);
+}
+
+void AsrController::armHotMicStandby() {
+    if (!hotMicEnabled_ || !audio_ || !audio_->inHotStandby()) return;
+    qint64 ms = static_cast<qint64>(hotMicSec_) * 1000;
+    if (hotMicScheduledNow()) {
+        qint64 untilEnd = QTime::currentTime().msecsTo(hotMicTo_);
+        if (untilEnd <= 0) untilEnd += 24LL * 60 * 60 * 1000;
+        ms = std::max(ms, untilEnd);
+    }
+    if (ms <= 0) {
+        onHotMicTimeout();
+        return;
+    }
+    hotMicTimer_.start(static_cast<int>(std::min<qint64>(ms, std::numeric_limits<int>::max())));
+}
+
+void AsrController::onHotMicTimeout() {
+    if (currentState_ != State::Idle && currentState_ != State::Error) return;
+    if (prewarmTimer_.isActive()) return;  // onPrewarmTimeout decides then
+    // Coarse timers can fire a little early; still inside the window means
+    // keep holding until its end.
+    if (hotMicScheduledNow()) {
+        armHotMicStandby();
+        return;
+    }
+    // Close now; the next session re-enables standby and opens a fresh
+    // stream.
+    audio_->setHotStandby(false);
+    qInfo() << "AsrController: hot-mic standby ended, capture stream closed";
+}
+
+void AsrController::prewarm() {
+    if (currentState_ != State::Idle) return;
+    if (!backend_ || prewarmSec_ <= 0) {
+        // Nothing to hold: over straight away.
+        emit prewarmExpired();
+        return;
+    }
+    backend_->prewarm();
+    audio_->setHotStandby(true);
+    if (!audio_->openStandby()) qInfo() << "AsrController: prewarm without a held mic stream";
+    prewarmTimer_.start(prewarmSec_ * 1000);
+}
+
+void AsrController::onPrewarmTimeout() {
+    if (currentState_ != State::Idle) return;
+    // Hot mic may keep the stream on; otherwise it closes now. The
+    // backend's spare lapses on its own (SpareWarmSec).
+    if (hotMicEnabled_) {
+        armHotMicStandby();
+    } else {
+        audio_->setHotStandby(false);
+    }
+    qInfo() << "AsrController: prewarm expired unused";
+    emit prewarmExpired();
+}
+
 QString AsrController::postProcess(const QString &text) const {
     if (!removeTrailingPunctuation_) return text;
     static const QString puncts = QStringLiteral("，。！？、；：,.!?;:");
@@ -57,9 +227,18 @@ QString AsrController::postProcess(const QString &text) const {
     return out;
 }
 
+bool AsrController::audioWedged() const {
+    return audio_ && audio_->hasLeakedStream();
+}
+
 // ---- Recording lifecycle ----
 
 void AsrController::startRecording() {
+    if (currentState_ == State::Error && pendingConfig_) {
+        // The error never went through enterIdle(); its reload is still held.
+        currentState_ = State::Idle;
+        applyPendingConfig();
+    }
     if (!backend_) {
         // Caller should have invoked applyConfig() and got false back; surface
         // for them so the overlay can pop the SettingsDialog.
@@ -71,22 +250,94 @@ void AsrController::startRecording() {
         currentState_ == State::Connecting) {
         return;
     }
+    stopRequested_ = false;
+    queuedStartUs_.reset();
+    // A commit the addon never acknowledged still gets its line.
+    flushTrace();
+    trace_.begin(keyPressUs_, backendName_);
     finalBuffer_.clear();
+    streamedAny_ = false;
     wsConnected_ = false;
-    audioWarmedUp_ = false;
+    uplinkCongested_ = false;
+    hotMicTimer_.stop();
+    // A prewarmed stream is started as it is (an uncork); a replay doesn't
+    // want it.
+    const bool prewarmed = prewarmTimer_.isActive() && !replaying_;
+    prewarmTimer_.stop();
+    audio_->setHotStandby(hotMicEnabled_ || prewarmed);
+    // A replay has its audio already; the mic stays as it is.
+    audioWarmedUp_ = replaying_;
     currentState_ = State::Connecting;
     emit stateChanged(state::toString(currentState_));
     // Both return immediately; WS handshake, pa_simple_new(), and PA
     // warm-up all overlap. PA failure surfaces via onAudioError.
+    if (replaying_) {
+        sessionBackend()->submitBuffer(std::exchange(replayPcm_, {}));
+        return;
+    }
     backend_->start();
+    recorder_.begin();
     audio_->start();
+    // Held for this start only: without hot mic, the session's stop()
+    // closes the stream as usual.
+    if (prewarmed && !hotMicEnabled_) audio_->setHotStandby(false);
+}
+
+bool AsrController::resubmitLastSession() {
+    if (!backend_ || currentState_ != State::Idle || resubmitReading_) return false;
+    if (recorder_.lastSessionPath().isEmpty()) return false;
+    // Up to RecordMaxMB to read and inflate: the recorder's I/O thread
+    // does it, behind whatever the last session still has to write.
+    const bool queued = recorder_.readLast(
+        this, [this](QByteArray pcm, QString path, QString error) {
+            onResubmitRead(std::move(pcm), path, error);
+        });
+    resubmitReading_ = queued;
+    return queued;
+}
+
+void AsrController::onResubmitRead(QByteArray pcm, const QString &path, const QString &error) {
+    resubmitReading_ = false;
+    if (pcm.isEmpty()) {
+        qWarning() << "AsrController: cannot resubmit" << path << "-" << error;
+        return;
+    }
+    if (!backend_ || currentState_ != State::Idle) {
+        qInfo() << "AsrController: resubmit dropped, a session started meanwhile";
+        return;
+    }
+    qInfo() << "AsrController: resubmitting" << path << pcm.size() / 32 << "ms";
+    replayPcm_ = std::move(pcm);
+    replaying_ = true;
+    startRecording();
+}
+
+void AsrController::stopAudio() {
+    // A resubmit never started the mic; a hot stream stays as it is.
+    if (!replaying_ && audio_) audio_->stop();
+}
+
+void AsrController::endSessionAudio() {
+    recorder_.end();
+    replaying_ = false;
+    replayPcm_.clear();
 }
 
 void AsrController::stopRecording() {
     if (currentState_ != State::Recording &&
         currentState_ != State::Connecting) return;
-    if (audio_) audio_->stop();
-    if (backend_) backend_->stop();
+    if (stopRequested_) {
+        // Already draining. A push-to-talk release here takes back the
+        // press queued since.
+        queuedStartUs_.reset();
+        return;
+    }
+    trace_.mark(SessionTrace::Mark::Stop, keyPressUs_);
+    stopRequested_ = true;
+    stopAudio();
+    // A resubmit is a buffer the backend finishes on its own; this is a
+    // no-op for it.
+    if (AsrBackend *b = sessionBackend()) b->stop();
     // Don't enterIdle yet — the backend still needs to drain remaining
     // server-side finals after our LAST audio frame. enterIdle runs in
     // onBackendFinished, which fires after the WebSocket cleanly closes.
@@ -101,23 +352,100 @@ void AsrController::toggleRecording() {
     }
 }
 
+void AsrController::toggleRecordingAt(qint64 keyPressUs) {
+    keyPressUs_ = keyPressUs;
+    toggleRecording();
+    keyPressUs_ = 0;
+}
+
+void AsrController::startRecordingAt(qint64 keyPressUs) {
+    if (currentState_ == State::Recording || currentState_ == State::Connecting) {
+        if (stopRequested_) queuedStartUs_ = keyPressUs;
+        return;
+    }
+    keyPressUs_ = keyPressUs;
+    startRecording();
+    keyPressUs_ = 0;
+}
+
+void AsrController::acknowledged() {
+    if (!trace_.active() || trace_.outcome() != SessionTrace::Outcome::Commit) return;
+    trace_.mark(SessionTrace::Mark::Ack);
+    recordTrace();
+}
+
+void AsrController::flushTrace() {
+    if (trace_.active() && trace_.outcome() != SessionTrace::Outcome::None) recordTrace();
+}
+
+void AsrController::endTrace(SessionTrace::Outcome outcome) {
+    if (!trace_.active() || trace_.outcome() != SessionTrace::Outcome::None) return;
+    if (AsrBackend *b = sessionBackend()) trace_.setTransport(b->transportStats());
+    trace_.setOutcome(outcome);
+    if (outcome != SessionTrace::Outcome::Commit) recordTrace();
+}
+
+void AsrController::recordTrace() {
+    trace_.close();
+    lastTrace_ = trace_;
+    statsSink_.record(lastTrace_);
+}
+
+void AsrController::dismissError() {
+    if (currentState_ != State::Error) return;
+    enterIdle(/*fromError=*/true);
+}
+
 void AsrController::cancelRecording() {
-    if (audio_) audio_->stop();
-    if (backend_) backend_->cancel();
+    const bool live = currentState_ != State::Idle && currentState_ != State::Error;
+    // Outcome first: a backend reporting finished() from inside cancel()
+    // must not get the session logged as an empty one.
+    if (live && trace_.active()) trace_.setOutcome(SessionTrace::Outcome::Cancelled);
+    stopAudio();
+    AsrBackend *session = sessionBackend();
+    if (session) session->cancel();
+    if (live && trace_.active()) {
+        if (session) trace_.setTransport(session->transportStats());
+        recordTrace();
+    } else {
+        flushTrace();
+    }
     // Cancel discards: drop accumulated text, no commit. Going straight to
     // idle is correct here because we don't expect any further finals.
+    // Streamed segments are already in the app and stay there; only the
+    // preedit goes.
     finalBuffer_.clear();
+    streamedAny_ = false;
+    queuedStartUs_.reset();
     enterIdle(/*fromError=*/false);
     emit cancelled();
 }
 
 void AsrController::enterIdle(bool fromError) {
     currentState_ = State::Idle;
-    if (!fromError && !finalBuffer_.isEmpty()) {
-        emit commitText(finalBuffer_);
+    stopRequested_ = false;
+    if (streamCommit_) emit streamPreedit(QString());
+    if (!fromError && (!finalBuffer_.isEmpty() || streamedAny_)) {
+        trace_.mark(SessionTrace::Mark::Commit);
+        trace_.addCommittedChars(static_cast<int>(finalBuffer_.size()));
+        endTrace(SessionTrace::Outcome::Commit);
+        emit commitText(finalBuffer_.text());
+    } else if (!fromError) {
+        endTrace(SessionTrace::Outcome::Empty);
     }
+    endSessionAudio();
     finalBuffer_.clear();
+    streamedAny_ = false;
     emit stateChanged(state::toString(currentState_));
+    applyPendingConfig();
+    if (queuedStartUs_) {
+        // Push-to-talk pressed again while this session drained.
+        const qint64 at = *queuedStartUs_;
+        queuedStartUs_.reset();
+        startRecordingAt(at);
+        return;
+    }
+    armHotMicStandby();
 }
 
 // ---- Audio events ----
@@ -126,6 +454,7 @@ void AsrController::onAudioPcm(const QByteArray &chunk) {
     if (backend_ && currentState_ != State::Idle &&
         currentState_ != State::Error) {
         backend_->pushPcm(chunk);
+        recorder_.append(chunk.constData(), static_cast<int>(chunk.size()));
     }
 }
 
@@ -142,7 +471,16 @@ void AsrController::onAudioLevel(double level) {
     emit audioLevel(bucket);
 }
 
+void AsrController::onAudioTrailingSilence() {
+    // Same path as Enter: LAST frame now, commit once the server drains.
+    // Connecting can't get here — no speech reached the ring before warm-up.
+    if (currentState_ != State::Recording) return;
+    qInfo() << "AsrController: VAD auto-stop after trailing silence";
+    stopRecording();
+}
+
 void AsrController::onAudioError(const QString &msg) {
+    queuedStartUs_.reset();  // the mic it would record from just failed
     // Recording state: drain via backend->stop() so any partials we have
     // become a final commit instead of being dropped on the floor.
     if (backend_ && currentState_ == State::Recording) {
@@ -151,7 +489,10 @@ void AsrController::onAudioError(const QString &msg) {
         return;
     }
     finalBuffer_.clear();
+    if (streamCommit_) emit streamPreedit(QString());
     if (backend_) backend_->cancel();
+    endTrace(SessionTrace::Outcome::Error);
+    endSessionAudio();
     emit errorOccurred(msg);
     currentState_ = State::Error;
     emit stateChanged(state::toString(currentState_));
@@ -160,11 +501,15 @@ void AsrController::onAudioError(const QString &msg) {
 // ---- Backend events ----
 
 void AsrController::onBackendConnected() {
+    trace_.mark(SessionTrace::Mark::Connected);
     wsConnected_ = true;
     maybeEnterRecording();
 }
 
+void AsrController::onAudioOpened() { trace_.mark(SessionTrace::Mark::AudioOpen); }
+
 void AsrController::onAudioWarmedUp() {
+    trace_.mark(SessionTrace::Mark::WarmedUp);
     audioWarmedUp_ = true;
     maybeEnterRecording();
 }
@@ -174,29 +519,57 @@ void AsrController::maybeEnterRecording() {
     if (!wsConnected_ || !audioWarmedUp_) return;
     currentState_ = State::Recording;
     emit stateChanged(state::toString(currentState_));
+    // The handshake flush alone can already have backed the uplink up.
+    if (uplinkCongested_) emit stateChanged(state::Congested);
 }
 
 void AsrController::onBackendPartial(const QString &text) {
+    if (!text.isEmpty()) trace_.mark(SessionTrace::Mark::FirstPartial);
     emit transcriptPartial(text);
+    if (streamCommit_) emit streamPreedit(text);
 }
 
 void AsrController::onBackendFinal(const QString &text) {
     const QString processed = postProcess(text);
-    finalBuffer_ += processed;
+    trace_.mark(SessionTrace::Mark::LastFinal);
     emit transcriptFinal(processed);
+    if (streamCommit_) {
+        // Preedit first, so the app never shows the segment twice.
+        emit streamPreedit(QString());
+        if (!processed.isEmpty()) emit streamCommit(processed);
+        trace_.addCommittedChars(static_cast<int>(processed.size()));
+        streamedAny_ = true;
+        return;
+    }
+    finalBuffer_.append(processed);
 }
 
 void AsrController::onBackendError(const QString &msg) {
     finalBuffer_.clear();
-    if (audio_) audio_->stop();
+    queuedStartUs_.reset();
+    if (streamCommit_) emit streamPreedit(QString());
+    stopAudio();
+    endTrace(SessionTrace::Outcome::Error);
+    endSessionAudio();
     emit errorOccurred(msg);
     currentState_ = State::Error;
     emit stateChanged(state::toString(currentState_));
+    // A pending reload waits for enterIdle() / the next start: applyConfig()
+    // only runs from Idle.
+    armHotMicStandby();
+}
+
+void AsrController::onBackendCongestion(bool congested, int queuedMs) {
+    if (congested == uplinkCongested_) return;
+    uplinkCongested_ = congested;
+    if (currentState_ != State::Recording) return;
+    emit uplinkQueue(queuedMs);
+    emit stateChanged(congested ? state::Congested : state::toString(currentState_));
 }
 
 void AsrController::onBackendFinished() {
     if (currentState_ == State::Idle ||
         currentState_ == State::Error) return;
-    if (audio_) audio_->stop();
+    stopAudio();
     enterIdle(/*fromError=*/false);
 }
@@ -1,18 +1,26 @@
 #pragma once
+#include "Config.h"
 #include "OverlayState.h"
+#include "SessionTrace.h"
+#include "TranscriptBuffer.h"
+#include "audio/SessionRecorder.h"
 
 #include <QObject>
 #include <QString>
+#include <QTime>
+#include <QTimer>
+#include <QVariantMap>
 #include <memory>
+#include <optional>
 
 class AsrBackend;
 class AudioCapture;
-struct OverlayConfig;
 
 /// Wires AudioCapture (mic input) and an AsrBackend (transcription engine)
 /// together; presents a uniform set of Qt signals to the rest of the app.
 /// Backend-specific knowledge stays inside the AsrBackend implementation.
-/// Owned by main(); single session per process.
+/// Owned by main(); one session at a time — a resident overlay runs many
+/// sessions back to back through the same instance.
 class AsrController : public QObject {
     Q_OBJECT
 public:
@@ -21,13 +29,29 @@ public:
 
     /// Plug in a fresh config. Replaces current backend if necessary.
     /// Returns false if the configured backend cannot be instantiated
-    /// (missing credentials, unknown backend name).
+    /// (missing credentials, unknown backend name); nothing is changed then
+    /// and the current backend stays.
     bool applyConfig(const OverlayConfig &cfg);
+    /// applyConfig() now if idle, else once the session in progress (or
+    /// the error on screen) is over. A later call replaces an earlier one
+    /// still waiting.
+    void applyConfigWhenIdle(const OverlayConfig &cfg);
 
     /// Best-effort post-processing applied to a final segment before
     /// commit (e.g. trailing punctuation removal).
     QString postProcess(const QString &text) const;
 
+    /// True once AudioCapture abandoned a wedged PA thread. The leaked
+    /// stream holds the mic until exit, so a resident overlay must exit
+    /// instead of waiting for the next session.
+    bool audioWedged() const;
+    /// No session, no error on screen.
+    bool isIdle() const { return currentState_ == State::Idle; }
+
+    /// SessionTrace of the last finished session (see SessionTrace::
+    /// toVariantMap); empty before the first one.
+    QVariantMap lastSessionStats() const { return lastTrace_.toVariantMap(); }
+
 public slots:
     void startRecording();
     void stopRecording();
@@ -35,42 +59,144 @@ public slots:
     /// Idempotent toggle for the dumb-forward fcitx5 addon: starts a new
     /// session if idle/error, otherwise stops the active one.
     void toggleRecording();
+    /// toggleRecording() for a key the addon stamped at `keyPressUs`
+    /// (CLOCK_MONOTONIC µs); the stamp goes into the session trace.
+    void toggleRecordingAt(qint64 keyPressUs);
+    /// Push-to-talk press: start from Idle / Error, never stop. A press
+    /// while a stopped session still drains its finals starts the next one
+    /// as soon as that is committed; a running session ignores it.
+    void startRecordingAt(qint64 keyPressUs);
+    /// The addon acknowledged the commit: closes the session trace.
+    void acknowledged();
+    /// Close a trace still waiting for Acknowledge as is (ack timeout,
+    /// Esc past the commit). No-op otherwise.
+    void flushTrace();
+    /// Leave the Error state without starting a session (resident overlay
+    /// dismissing the error tooltip). No-op in any other state.
+    void dismissError();
+    /// Send the newest recording ([Audio] Record) through the current
+    /// backend again as a buffer (AsrBackend::submitBuffer — parallel
+    /// pieces where the backend has a BatchTranscriber), and commit the
+    /// result like a normal session. Idle only; false when there is
+    /// nothing to send. The file is read off the main thread and the
+    /// session starts once it is in — unless one started meanwhile.
+    bool resubmitLastSession();
+    /// A session is likely within `[Overlay] PrewarmSec`: have the backend
+    /// open its spare socket and the mic stream opened corked, with no
+    /// session, UI or audio. Idle only; repeating it extends the hold.
+    /// What the next session doesn't take is let go when it runs out; with
+    /// nothing to hold (no backend, PrewarmSec = 0) it runs out at once.
+    void prewarm();
 
 signals:
     /// Mirrors backend events for the UI / D-Bus surface.
     void transcriptPartial(const QString &text);
     void transcriptFinal(const QString &text);
-    void stateChanged(const QString &state); // idle / connecting / recording / error
+    void stateChanged(const QString &state); // idle / connecting / recording / congested / error
     void audioLevel(double level);            // 0..1, ~25 Hz
     void errorOccurred(const QString &text);
 
-    /// Final accumulated transcript ready to be committed (one shot per session).
+    /// Final accumulated transcript ready to be committed (one shot per
+    /// session). With StreamCommit on, this carries only what was not
+    /// already streamed — normally nothing — and still fires once so the
+    /// commit/Acknowledge exit path runs.
     void commitText(const QString &text);
+    /// StreamCommit only: a finished segment to commit right away.
+    void streamCommit(const QString &segment);
+    /// StreamCommit only: the in-progress tail to show as client preedit;
+    /// empty clears it (segment finished, session over, cancel, error).
+    void streamPreedit(const QString &text);
     /// Cancellation completed (no commit, no error). Drives short-lived
     /// overlay's exit on Esc/cancel paths.
     void cancelled();
+    /// Audio waiting in the backend's send queue, at each congestion
+    /// transition; emitted just before the matching stateChanged.
+    void uplinkQueue(int queuedMs);
+    /// A prewarm() ran out without a session; a short-lived overlay that
+    /// was only started for it exits.
+    void prewarmExpired();
 
 private:
     void onAudioPcm(const QByteArray &chunk);
     void onAudioLevel(double level);
     void onAudioError(const QString &msg);
+    void onAudioOpened();
     void onAudioWarmedUp();
+    void onAudioTrailingSilence();
 
     void onBackendPartial(const QString &text);
     void onBackendFinal(const QString &text);
     void onBackendConnected();
     void onBackendFinished();
     void onBackendError(const QString &msg);
+    void onBackendCongestion(bool congested, int queuedMs);
 
     void maybeEnterRecording();
     void enterIdle(bool fromError);
 
+    /// The backend is done with the session: take its counters, and
+    /// record the trace unless it still waits for Acknowledge (Commit).
+    void endTrace(SessionTrace::Outcome outcome);
+    void recordTrace();
+
+    /// Hot-mic policy: whether the stream may stay corked-open right now,
+    /// and (re)arm the timer that ends the standby.
+    bool hotMicScheduledNow() const;
+    void armHotMicStandby();
+    void onHotMicTimeout();
+    void onPrewarmTimeout();
+
+    void wireBackend(AsrBackend *backend);
+    /// Idle only: apply the reload held in pendingConfig_, if any.
+    void applyPendingConfig();
+    /// What the session in progress runs on: batch_ for a resubmit when
+    /// there is one, backend_ otherwise.
+    AsrBackend *sessionBackend() const;
+    /// Stop the mic, unless the session is a resubmit.
+    void stopAudio();
+    /// The session's audio is over, however it ended: close the
+    /// recording, drop the resubmit.
+    void endSessionAudio();
+    /// resubmitLastSession()'s read is done.
+    void onResubmitRead(QByteArray pcm, const QString &path, const QString &error);
+
     std::unique_ptr<AudioCapture> audio_;
     std::unique_ptr<AsrBackend> backend_;
+    // Recorded audio goes here instead (asr::createBatch); may be null.
+    std::unique_ptr<AsrBackend> batch_;
+    // What backend_ was built from (sameBackendAs), and a reload waiting
+    // for the next idle point.
+    std::optional<OverlayConfig> applied_;
+    std::optional<OverlayConfig> pendingConfig_;
 
     bool removeTrailingPunctuation_ = false;
+    // [Overlay] StreamCommit: finals go to the IC as they arrive instead
+    // of in one CommitText at the end.
+    bool streamCommit_ = false;
+    bool streamedAny_ = false;
+
+    // [Audio] HotMicSec / HotMicHours, resident only. After a session the
+    // capture stream is kept corked for hotMicSec_, or for as long as the
+    // clock is inside [hotMicFrom_, hotMicTo_).
+    bool hotMicEnabled_ = false;
+    int hotMicSec_ = 0;
+    QTime hotMicFrom_;
+    QTime hotMicTo_;
+    QTimer hotMicTimer_;
+    // Prewarm(): the mic is held in standby regardless of hot mic while
+    // this runs.
+    int prewarmSec_ = 20;
+    QTimer prewarmTimer_;
+
+    // [Audio] Record, and resubmitLastSession()'s replay of it: the mic is
+    // left alone and replayPcm_ goes to submitBuffer() in one piece.
+    SessionRecorder recorder_;
+    bool replaying_ = false;
+    bool resubmitReading_ = false;
+    QByteArray replayPcm_;
+
     state::State currentState_ = state::State::Idle;
-    QString finalBuffer_;
+    TranscriptBuffer finalBuffer_;
     qint64 lastLevelEmitMs_ = 0;
     double lastEmittedLevel_ = -1.0;  // sentinel: never matches a [0,1] bucket
     // Recording = ws connected AND mic produced real audio. Both flags are
@@ -78,4 +204,18 @@ private:
     // maybeEnterRecording() once both are true.
     bool wsConnected_ = false;
     bool audioWarmedUp_ = false;
+    bool uplinkCongested_ = false;  // Recording is reported as state::Congested
+
+    // Per-session latency trace; lives on past enterIdle() until the
+    // addon's Acknowledge. keyPressUs_ carries a stamped toggle into
+    // start/stop.
+    SessionTrace trace_;
+    SessionTrace lastTrace_;
+    SessionStatsSink statsSink_;
+    QString backendName_;
+    qint64 keyPressUs_ = 0;
+    // stopRecording() ran for the session in progress; a start pressed
+    // meanwhile waits in queuedStartUs_ for its commit.
+    bool stopRequested_ = false;
+    std::optional<qint64> queuedStartUs_;
 };
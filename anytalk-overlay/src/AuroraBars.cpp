@@ -1,59 +1,180 @@
 #include "AuroraBars.h"
-#include "Theme.h"
-#include <QPainter>
+
+#include <QEvent>
 #include <QLinearGradient>
-#include <QTimer>
+#include <QPainter>
+#include <QWindow>
+#include <algorithm>
 #include <cmath>
 
+namespace {
+constexpr double kSideMargin = 4.0;
+constexpr double kBarGap = 1.5;
+constexpr double kBarOpacity = 0.85;
+// Below this the level term is a pixel or two: noise is invisible and only
+// the slow baseline breathes, so the idle timer is enough.
+constexpr double kIdleLevel = 0.02;
+constexpr int kIdleFrameMs = 100;
+} // namespace
+
 AuroraBars::AuroraBars(QWidget *parent) : QWidget(parent) {
     setAttribute(Qt::WA_TranslucentBackground);
     setMinimumSize(Theme::BAR_AREA_WIDTH, Theme::BAR_AREA_HEIGHT);
     clock_.start();
 
-    // ~60 fps refresh, the noise term needs continuous repaint even when level is steady.
-    auto *timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, QOverload<>::of(&QWidget::update));
-    timer->start(16);
+    for (int i = 0; i < Theme::BAR_COUNT; ++i) {
+        sinA_[i] = std::sin(i * 0.4);
+        cosA_[i] = std::cos(i * 0.4);
+        sinB_[i] = std::sin(i * 0.9);
+        cosB_[i] = std::cos(i * 0.9);
+        sinC_[i] = std::sin(i * 0.2);
+        cosC_[i] = std::cos(i * 0.2);
+    }
+
+    idleTimer_.setTimerType(Qt::CoarseTimer);
+    connect(&idleTimer_, &QTimer::timeout, this, [this]() {
+        update();
+        if (level_ >= kIdleLevel) kick();
+    });
 }
 
 void AuroraBars::setLevel(double level) {
     level_ = std::clamp(level, 0.0, 1.0);
+    kick();
 }
 
-void AuroraBars::paintEvent(QPaintEvent *) {
-    QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing);
+void AuroraBars::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+    kick();
+}
 
-    const double t = clock_.elapsed() / 1000.0;
+void AuroraBars::hideEvent(QHideEvent *event) {
+    QWidget::hideEvent(event);
+    idleTimer_.stop();
+    frameWanted_ = false;
+}
+
+void AuroraBars::kick() {
+    if (!isVisible()) return;
+    if (level_ >= kIdleLevel) {
+        idleTimer_.stop();
+        if (!frameWanted_) requestFrame();
+    } else if (!idleTimer_.isActive()) {
+        frameWanted_ = false;
+        idleTimer_.start(kIdleFrameMs);
+    }
+}
+
+void AuroraBars::requestFrame() {
+    QWindow *w = window()->windowHandle();
+    if (!w) {
+        // No platform window yet (first show in flight): fall back to a
+        // plain repaint; the next setLevel() retries.
+        update();
+        return;
+    }
+    if (w != frameWindow_) {
+        if (frameWindow_) frameWindow_->removeEventFilter(this);
+        frameWindow_ = w;
+        w->installEventFilter(this);
+    }
+    frameWanted_ = true;
+    w->requestUpdate();
+}
+
+bool AuroraBars::eventFilter(QObject *watched, QEvent *event) {
+    // Observe only: QWidgetWindow still gets the UpdateRequest and flushes
+    // the backing store, including the update() marked here.
+    if (watched == frameWindow_ && event->type() == QEvent::UpdateRequest && frameWanted_) {
+        frameWanted_ = false;
+        if (isVisible()) {
+            update();
+            if (level_ >= kIdleLevel) {
+                frameWanted_ = true;
+                frameWindow_->requestUpdate();
+            } else {
+                kick();
+            }
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void AuroraBars::rebuildSprites() {
     const int N = Theme::BAR_COUNT;
     const double w = static_cast<double>(width());
-    const double h = static_cast<double>(height());
-    const double sideMargin = 4.0;
-    const double barW = (w - sideMargin * 2.0) / N;
+    const double barW = (w - kSideMargin * 2.0) / N;
+    const double capsuleW = barW - kBarGap;
+    spriteCap_ = capsuleW / 2.0;
+    // Two caps plus one straight row to stretch.
+    spriteHeight_ = std::ceil(spriteCap_ * 2.0) + 1.0;
+    spriteDpr_ = devicePixelRatioF();
+
+    sprites_ = QPixmap(QSize(static_cast<int>(std::ceil(w * spriteDpr_)),
+                             static_cast<int>(std::ceil(spriteHeight_ * spriteDpr_))));
+    sprites_.setDevicePixelRatio(spriteDpr_);
+    sprites_.fill(Qt::transparent);
 
+    QPainter p(&sprites_);
+    p.setRenderHint(QPainter::Antialiasing);
     QLinearGradient g(0, 0, w, 0);
     g.setColorAt(0.0, Theme::accent());
     g.setColorAt(0.5, Theme::accentDeep());
     g.setColorAt(1.0, Theme::accentDark());
     p.setBrush(g);
     p.setPen(Qt::NoPen);
+    p.setOpacity(kBarOpacity);
+    for (int i = 0; i < N; ++i) {
+        const double x = kSideMargin + i * barW;
+        p.drawRoundedRect(QRectF(x + 0.5, 0.0, capsuleW, spriteHeight_), spriteCap_, spriteCap_);
+    }
+}
+
+void AuroraBars::paintEvent(QPaintEvent *) {
+    if (sprites_.isNull() || !qFuzzyCompare(spriteDpr_, devicePixelRatioF())) rebuildSprites();
+
+    QPainter p(this);
+    p.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    const double t = clock_.elapsed() / 1000.0;
+    const int N = Theme::BAR_COUNT;
+    const double w = static_cast<double>(width());
+    const double h = static_cast<double>(height());
+    const double barW = (w - kSideMargin * 2.0) / N;
+    const double capsuleW = barW - kBarGap;
+    const double r = spriteCap_;
+    const double dpr = spriteDpr_;
+
+    // sin(i·k + ωt) = sin(i·k)cos(ωt) + cos(i·k)sin(ωt): the per-bar half
+    // is tabled, the per-frame half is computed once here.
+    const double sA = std::sin(t * 3.0), cA = std::cos(t * 3.0);
+    const double sB = std::sin(-t * 2.1), cB = std::cos(-t * 2.1);
+    const double sC = std::sin(t * 1.6), cC = std::cos(t * 1.6);
 
     for (int i = 0; i < N; ++i) {
-        const double noise =
-            0.45 +
-            0.30 * std::sin(i * 0.4 + t * 3.0) +
-            0.25 * std::sin(i * 0.9 - t * 2.1);
+        const double noise = 0.45 + 0.30 * (sinA_[i] * cA + cosA_[i] * sA) +
+                             0.25 * (sinB_[i] * cB + cosB_[i] * sB);
         const double scale = std::max(0.15, noise);
         // Always show a baseline "breathing" minimum so the dock doesn't feel
         // dead even when audio level is 0.
-        const double minH = 3.0 + 2.0 * std::abs(std::sin(t * 1.6 + i * 0.2));
+        const double minH = 3.0 + 2.0 * std::abs(sinC_[i] * cC + cosC_[i] * sC);
         const double bh = std::max(minH, level_ * (h - 6.0) * scale);
-        const double x = sideMargin + i * barW;
+        const double x = kSideMargin + i * barW + 0.5;
         const double y = (h - bh) / 2.0;
-        const QRectF rect(x + 0.5, y, barW - 1.5, bh);
-        const double r = (barW - 1.5) / 2.0;
-        p.setOpacity(0.85);
-        p.drawRoundedRect(rect, r, r);
+        const double sx = x * dpr;
+        const double sw = capsuleW * dpr;
+
+        if (bh < r * 2.0) {
+            // Shorter than two caps: squash the whole capsule, which is what
+            // drawRoundedRect's radius clamping amounted to.
+            p.drawPixmap(QRectF(x, y, capsuleW, bh), sprites_,
+                         QRectF(sx, 0.0, sw, spriteHeight_ * dpr));
+            continue;
+        }
+        p.drawPixmap(QRectF(x, y, capsuleW, r), sprites_, QRectF(sx, 0.0, sw, r * dpr));
+        p.drawPixmap(QRectF(x, y + r, capsuleW, bh - 2.0 * r), sprites_,
+                     QRectF(sx, r * dpr, sw, 1.0 * dpr));
+        p.drawPixmap(QRectF(x, y + bh - r, capsuleW, r), sprites_,
+                     QRectF(sx, (spriteHeight_ - r) * dpr, sw, r * dpr));
     }
-    p.setOpacity(1.0);
 }
@@ -1,9 +1,30 @@
 #pragma once
-#include <QWidget>
+#include "Theme.h"
+
 #include <QElapsedTimer>
+#include <QPixmap>
+#include <QPointer>
+#include <QTimer>
+#include <QWidget>
+#include <array>
 
+class QEvent;
+class QHideEvent;
 class QPaintEvent;
+class QShowEvent;
+class QWindow;
 
+/// Level-driven bar animation.
+///
+/// Frames are paced by the compositor: while the level is up, each repaint
+/// is triggered by the top-level window's UpdateRequest (QWindow::
+/// requestUpdate → Wayland frame callback / vsync timer on X11), so a
+/// hidden or occluded surface stops costing frames. Near silence the noise
+/// term is invisible anyway and the "breathing" baseline is slow, so it
+/// drops to a ~10 fps timer; hidden, nothing runs at all.
+///
+/// Each bar is blitted from a pre-rendered capsule strip (gradient and
+/// antialiasing baked in) as a three-slice: caps copied, middle stretched.
 class AuroraBars : public QWidget {
     Q_OBJECT
 public:
@@ -14,8 +35,32 @@ public slots:
 
 protected:
     void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private:
+    /// Pick the pacing mode for the current level and (re)arm it.
+    void kick();
+    void requestFrame();
+    void rebuildSprites();
+
     double level_ = 0.0;
     QElapsedTimer clock_;
+    QTimer idleTimer_;
+
+    // Frame pacing through the top-level window. Tracked with a QPointer
+    // because OverlayWindow::fadeIn() destroys and recreates the platform
+    // window on layer-shell.
+    QPointer<QWindow> frameWindow_;
+    bool frameWanted_ = false;
+
+    // Per-bar phase terms, so a frame costs a handful of sin/cos calls for
+    // the whole widget instead of three per bar.
+    std::array<double, Theme::BAR_COUNT> sinA_{}, cosA_{}, sinB_{}, cosB_{}, sinC_{}, cosC_{};
+
+    QPixmap sprites_;          // one capsule per bar, gradient baked in
+    qreal spriteDpr_ = 0.0;    // rebuilt when the output scale changes
+    double spriteCap_ = 0.0;   // cap radius (logical px)
+    double spriteHeight_ = 0.0;
 };
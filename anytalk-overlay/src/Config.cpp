@@ -6,6 +6,8 @@
 #include <QStringBuilder>
 #include <QTextStream>
 
+#include <algorithm>
+
 namespace {
 constexpr const char *kConfigSubpath = "/.config/fcitx5/conf/anytalk.conf";
 
@@ -50,12 +52,63 @@ bool OverlayConfig::isUsable() const {
     if (backend == QLatin1String("openai")) {
         return !str(QStringLiteral("OpenAI"), QStringLiteral("ApiKey")).isEmpty();
     }
-    return true; // unknown / local backends decide on their own
+    return true; // unknown / local / broker backends decide on their own
 }
 
-OverlayConfig OverlayConfig::load() {
+void OverlayConfig::resolve() {
+    const QString ov = QStringLiteral("Overlay");
+    const QString au = QStringLiteral("Audio");
+    auto toInt = [this](const QString &section, const char *key, int fallback) {
+        bool ok = false;
+        const int v = str(section, QLatin1String(key)).toInt(&ok);
+        return ok ? v : fallback;
+    };
+    auto path = [this, &ov](const char *key) {
+        QString p = str(ov, QLatin1String(key));
+        if (p.startsWith(QLatin1String("~/"))) p.replace(0, 1, QDir::homePath());
+        return p;
+    };
+
+    overlay = OverlayOptions();
+    overlay.streamCommit = boolean(ov, QStringLiteral("StreamCommit"), false);
+    bool ok = false;
+    const double hz = str(ov, QStringLiteral("SignalRateHz")).toDouble(&ok);
+    if (ok) overlay.signalRateHz = std::max(hz, 0.0);
+    overlay.statsFile = path("StatsFile");
+    overlay.statsTextfile = path("StatsTextfile");
+    overlay.prewarmSec = std::max(toInt(ov, "PrewarmSec", 20), 0);
+
+    audio = AudioOptions();
+    audio.vad = boolean(au, QStringLiteral("Vad"), false);
+    audio.vadAutoStopMs = std::max(toInt(au, "VadAutoStopMs", 0), 0);
+    audio.captureBackend = str(au, QStringLiteral("CaptureBackend"));
+    audio.quantumMs = std::max(toInt(au, "QuantumMs", 0), 0);
+    audio.hotMicSec = std::max(toInt(au, "HotMicSec", 0), 0);
+    audio.hotMicHours = str(au, QStringLiteral("HotMicHours"));
+    audio.preRollMs = std::max(toInt(au, "PreRollMs", 0), 0);
+    audio.record = boolean(au, QStringLiteral("Record"), false);
+    audio.recordMaxMB = std::max(toInt(au, "RecordMaxMB", 64), 1);
+}
+
+bool OverlayConfig::sameBackendAs(const OverlayConfig &other) const {
+    // Resident is the SpareConnection default, so it changes the backend too.
+    if (backend != other.backend || resident != other.resident) return false;
+    auto backendPart = [](const QVariantHash &bag) {
+        QVariantHash out;
+        for (auto it = bag.constBegin(); it != bag.constEnd(); ++it) {
+            if (it.key().startsWith(QLatin1String("Overlay/")) ||
+                it.key().startsWith(QLatin1String("Audio/")))
+                continue;
+            out.insert(it.key(), it.value());
+        }
+        return out;
+    };
+    return backendPart(backendOptions) == backendPart(other.backendOptions);
+}
+
+OverlayConfig OverlayConfig::load(const QString &path) {
     OverlayConfig cfg;
-    QFile f(configFilePath());
+    QFile f(path);
     if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
         return cfg;
     }
@@ -95,6 +148,16 @@ OverlayConfig OverlayConfig::load() {
             } else {
                 cfg.backendOptions.insert(joinKey(currentSection, key), val);
             }
+        } else if (currentSection == QLatin1String("Overlay")) {
+            if (key == QLatin1String("Resident")) {
+                cfg.resident = toBool(val, false);
+            } else if (key == QLatin1String("IdleTimeoutSec")) {
+                bool ok = false;
+                const int secs = val.toInt(&ok);
+                if (ok && secs > 0) cfg.residentIdleTimeoutSec = secs;
+            } else {
+                cfg.backendOptions.insert(joinKey(currentSection, key), val);
+            }
         } else {
             // Unknown sections fall through to the per-backend bag.
             cfg.backendOptions.insert(joinKey(currentSection, key), val);
@@ -111,6 +174,7 @@ OverlayConfig OverlayConfig::load() {
     fill(QStringLiteral("AppID"), legacyAppId);
     fill(QStringLiteral("AccessToken"), legacyToken);
 
+    cfg.resolve();
     return cfg;
 }
 
@@ -128,6 +192,9 @@ bool OverlayConfig::save() const {
     out << "[Asr]\n";
     out << "Backend = " << backend << "\n";
     out << "RemoveTrailingPunctuation = " << (removeTrailingPunctuation ? "True" : "False") << "\n";
+    out << "\n[Overlay]\n";
+    out << "Resident = " << (resident ? "True" : "False") << "\n";
+    out << "IdleTimeoutSec = " << residentIdleTimeoutSec << "\n";
 
     // Group backendOptions by section.
     QHash<QString, QVariantHash> bySection;
@@ -6,13 +6,62 @@
 ///
 /// New schema (recommended):
 ///   [Asr]
-///   Backend = volcengine          ; volcengine | openai | local-whisper | ...
+///   Backend = volcengine          ; volcengine | openai | local-whisper | broker | ...
 ///   RemoveTrailingPunctuation = false
+///   Hedge =                       ; optional, second backend raced against Backend (HedgedBackend)
+///   HedgeDelayMs = 1500           ; optional, start the hedge if Backend hasn't connected by then (0..10000)
+///
+///   [Overlay]
+///   Resident = false              ; keep the process alive between sessions
+///   IdleTimeoutSec = 1800         ; resident only: exit after this long idle
+///   StreamCommit = false          ; optional, commit finals as they arrive, partial as preedit
+///   SignalRateHz = 20             ; optional, cap for AudioLevel/TranscriptPartial broadcasts (0 = off)
+///   StatsFile =                   ; optional, append each session's latency trace here as a JSON line
+///   StatsTextfile =               ; optional, last session as Prometheus text (node_exporter *.prom)
+///   PrewarmSec = 20               ; optional, how long a Prewarm() holds the spare socket + corked mic (0 = ignore it, ..120)
+///
+///   [Addon]                       ; read by the fcitx5 addon (src/addon.cpp)
+///   PrewarmPrograms =             ; optional, comma-separated program names; focusing one sends Prewarm()
+///   PushToTalk = false            ; optional, hold F2 to talk: press starts, release stops
 ///
 ///   [Volcengine]
 ///   AppID = ...
 ///   AccessToken = ...
 ///   Mode = bidi_async             ; optional
+///   Endpoint =                    ; optional, ws[s]://host[:port] instead of the production server
+///   SpareConnection = true        ; optional, default = [Overlay] Resident or [Addon] PrewarmPrograms set
+///   SpareIdleSec = 5              ; optional, expire an unused spare socket
+///   SpareWarmSec = 30             ; optional, rotate spares this long after a session
+///   FrameMs = 40                  ; optional, 40 | 100 | 200 | adaptive
+///   AudioEncoding = pcm           ; optional, pcm | gzip | opus (needs libopus)
+///   ResultType = full             ; optional, full | single (incremental responses)
+///   BatchParallel = 4             ; optional, recordings: nostream sessions at a time (1..8)
+///   BatchPieceSec = 60            ; optional, recordings: cut at the first pause past this (10..600)
+///
+///   [Audio]
+///   Vad = false                   ; optional, hold back silence on the capture thread
+///   VadAutoStopMs = 0             ; optional, Vad only: stop after this much trailing silence
+///   CaptureBackend = pulse        ; optional, pulse | pipewire (native pw_stream, if built with it)
+///   QuantumMs = 20                ; optional, pipewire only: graph quantum to request (5..40)
+///   HotMicSec = 0                 ; optional, resident only: keep the mic stream corked-open this long after a session
+///   HotMicHours = 09:00-18:00     ; optional, resident only: keep it open across sessions inside this window
+///   PreRollMs = 0                 ; optional, hot mic only: keep the held stream live and send its last N ms (0..1000) first
+///   Record = false                ; optional, keep recent sessions' audio for ResubmitLastSession
+///   RecordMaxMB = 64              ; optional, Record only: size of the rolling store in $XDG_CACHE_HOME/anytalk/sessions
+///
+///   [LocalWhisper]                ; Backend = local-whisper (needs a whisper.cpp build)
+///   Model = ~/models/ggml-small.bin ; ggml model file, required
+///   Language = zh                 ; optional
+///   Threads = 0                   ; optional, decode threads (0 = min(4, cores))
+///   StepMs = 800                  ; optional, new audio between streaming decodes
+///   WindowSec = 15                ; optional, finalise an unbroken segment after this long (5..28)
+///   Gpu = false                   ; optional, if whisper.cpp was built with a GPU backend
+///
+///   [Broker]                      ; Backend = broker: sessions run in a shared anytalk-broker
+///   Socket = /run/anytalk/broker.sock ; optional
+///
+///   [Hedge]                       ; optional, keys overriding the hedge backend's own section,
+///   ResourceId = ...              ;   e.g. a second Volcengine resource / credentials
 ///
 ///   [OpenAI]                      ; future
 ///   ApiKey = sk-...
@@ -22,16 +71,68 @@
 ///   AppID                = ...
 ///   AccessToken          = ...
 ///   RemoveTrailingPunctuation = false
+///
+/// The [Overlay] and [Audio] keys are resolved into typed structs at
+/// load(); backends build their own typed Settings from the bag (see
+/// asr::create). A running overlay reloads the file when it changes
+/// (ConfigWatcher) and applies it at the next idle point.
+
+/// [Overlay] keys beyond the process lifecycle.
+struct OverlayOptions {
+    bool streamCommit = false;
+    double signalRateHz = 20.0;  // 0 = unthrottled
+    QString statsFile;           // "~/" expanded
+    QString statsTextfile;
+    int prewarmSec = 20;         // 0 = Prewarm() ignored
+
+    bool operator==(const OverlayOptions &) const = default;
+};
+
+/// [Audio], parsed; range policy stays with the consumers.
+struct AudioOptions {
+    bool vad = false;
+    int vadAutoStopMs = 0;       // 0 = off
+    QString captureBackend;      // raw name, see parseCaptureBackend()
+    int quantumMs = 0;           // 0 = unset
+    int hotMicSec = 0;
+    QString hotMicHours;         // raw "HH:MM-HH:MM", empty = off
+    int preRollMs = 0;
+    bool record = false;
+    int recordMaxMB = 64;
+
+    bool operator==(const AudioOptions &) const = default;
+};
 
 struct OverlayConfig {
     // Cross-backend
     QString backend = QStringLiteral("volcengine");
     bool removeTrailingPunctuation = false;
 
+    // Process lifecycle. Resident keeps the overlay (window, controller,
+    // D-Bus name) alive after CommitText / Cancel so the next F2 skips the
+    // Qt + LayerShellQt + D-Bus cold start. Bounded by idleTimeoutSec.
+    bool resident = false;
+    int residentIdleTimeoutSec = 1800;
+
     // Per-backend bag — each backend pulls the keys it needs.
-    // Stored flat as "Section/Key" → string.
+    // Stored flat as "Section/Key" → string. Keeps the [Overlay] / [Audio]
+    // keys too, so save() writes them back.
     QVariantHash backendOptions;
 
+    // Typed views of backendOptions, filled by resolve().
+    OverlayOptions overlay;
+    AudioOptions audio;
+
+    /// Re-derive `overlay` / `audio` from backendOptions. load() does this;
+    /// call it after editing those sections in the bag.
+    void resolve();
+
+    /// Same backend with the same settings — everything outside [Overlay]
+    /// and [Audio]. An unchanged backend can be kept across a reload.
+    bool sameBackendAs(const OverlayConfig &other) const;
+
+    bool operator==(const OverlayConfig &) const = default;
+
     /// Helpers for typed access.
     QString str(const QString &section, const QString &key,
                 const QString &fallback = {}) const;
@@ -43,6 +144,7 @@ struct OverlayConfig {
     bool isUsable() const;
 
     static QString configFilePath();
-    static OverlayConfig load();
+    /// `path` other than the user's file: anytalk-broker's own config.
+    static OverlayConfig load(const QString &path = configFilePath());
     bool save() const;
 };
@@ -0,0 +1,53 @@
+#include "ConfigWatcher.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+namespace {
+// A save is a burst of events (truncate + write, or write temp + rename);
+// reload once it has settled.
+constexpr int kDebounceMs = 200;
+} // namespace
+
+ConfigWatcher::ConfigWatcher(QObject *parent)
+    : QObject(parent), current_(OverlayConfig::load()) {
+    debounce_.setSingleShot(true);
+    debounce_.setInterval(kDebounceMs);
+    connect(&debounce_, &QTimer::timeout, this, &ConfigWatcher::reload);
+    connect(&watcher_, &QFileSystemWatcher::fileChanged, &debounce_,
+            qOverload<>(&QTimer::start));
+    connect(&watcher_, &QFileSystemWatcher::directoryChanged, &debounce_,
+            qOverload<>(&QTimer::start));
+}
+
+void ConfigWatcher::start() { rewatch(); }
+
+void ConfigWatcher::rewatch() {
+    const QString path = OverlayConfig::configFilePath();
+    // The file itself when it exists; otherwise the nearest existing
+    // ancestor, so creating ~/.config/fcitx5/conf/ is noticed too.
+    QStringList want;
+    if (QFileInfo::exists(path)) want << path;
+    QDir dir = QFileInfo(path).absoluteDir();
+    while (!dir.exists() && dir.cdUp()) {}
+    if (dir.exists()) want << dir.absolutePath();
+
+    QStringList have = watcher_.files() + watcher_.directories();
+    for (const QString &p : have) {
+        if (!want.contains(p)) watcher_.removePath(p);
+    }
+    for (const QString &p : want) {
+        if (!have.contains(p)) watcher_.addPath(p);
+    }
+}
+
+void ConfigWatcher::reload() {
+    // A rename-replace leaves the watch on the old inode; re-add.
+    rewatch();
+    OverlayConfig cfg = OverlayConfig::load();
+    if (cfg == current_) return;
+    qInfo() << "ConfigWatcher:" << OverlayConfig::configFilePath() << "changed — reloading";
+    current_ = std::move(cfg);
+    emit changed(current_);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Config.h"
+
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QTimer>
+
+/// The parsed anytalk.conf, loaded once and reloaded when the file changes,
+/// so a resident overlay picks up edits (SettingsDialog in another process,
+/// a fleet-managed config rollout) without a restart and nothing on the F2
+/// path reads the file.
+///
+/// Watches the file and its directory: editors and QSaveFile replace the
+/// file by rename, which drops an inotify watch on the old inode, and the
+/// directory is what sees the new file appear. Events are debounced, and
+/// changed() only fires when the parsed result differs from current().
+class ConfigWatcher : public QObject {
+    Q_OBJECT
+public:
+    /// Loads the config; start() begins watching.
+    explicit ConfigWatcher(QObject *parent = nullptr);
+
+    void start();
+    const OverlayConfig &current() const { return current_; }
+    /// Take `cfg` as current without a changed() — whoever saved it has
+    /// applied it already.
+    void adopt(const OverlayConfig &cfg) { current_ = cfg; }
+
+signals:
+    void changed(const OverlayConfig &cfg);
+
+private:
+    void rewatch();
+    void reload();
+
+    OverlayConfig current_;
+    QFileSystemWatcher watcher_;
+    QTimer debounce_;
+};
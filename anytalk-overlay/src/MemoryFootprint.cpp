@@ -0,0 +1,145 @@
+#include "MemoryFootprint.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace footprint {
+
+namespace {
+
+bool gEnabled = false;
+qint64 gLastRssKb = -1;
+
+// Mapped files listed by breakdown; the long tail is all Qt plugins and
+// locale data of a few kB each.
+constexpr int kBreakdownRows = 12;
+
+struct Status {
+    qint64 rssKb = -1;
+    qint64 anonKb = -1;
+    qint64 fileKb = -1;
+    qint64 hwmKb = -1;
+    qint64 pssKb = -1;
+};
+
+/// "Key:   123 kB" → 123, if `line` starts with `key`.
+bool field(const QByteArray &line, const char *key, qint64 &out) {
+    if (!line.startsWith(key)) return false;
+    out = line.mid(qstrlen(key)).trimmed().split(' ').value(0).toLongLong();
+    return true;
+}
+
+Status readStatus() {
+    Status s;
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (status.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : status.readAll().split('\n')) {
+            field(line, "VmRSS:", s.rssKb) || field(line, "RssAnon:", s.anonKb) ||
+                field(line, "RssFile:", s.fileKb) || field(line, "VmHWM:", s.hwmKb);
+        }
+    }
+    QFile rollup(QStringLiteral("/proc/self/smaps_rollup"));
+    if (rollup.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : rollup.readAll().split('\n')) {
+            if (field(line, "Pss:", s.pssKb)) break;
+        }
+    }
+    return s;
+}
+
+qint64 heapInUseKb() {
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+    return qint64(mallinfo2().uordblks) / 1024;
+#endif
+#endif
+    return -1;
+}
+
+/// Resident kB per mapped file, largest first; anonymous mappings are
+/// summed under "[anon]".
+std::vector<std::pair<QByteArray, qint64>> residentByFile() {
+    QHash<QByteArray, qint64> byFile;
+    QFile smaps(QStringLiteral("/proc/self/smaps"));
+    if (!smaps.open(QIODevice::ReadOnly)) return {};
+    QByteArray current = "[anon]";
+    for (const QByteArray &line : smaps.readAll().split('\n')) {
+        if (line.isEmpty()) continue;
+        // Mapping headers start with the hex address range; the fields of
+        // the mapping follow as "Key: value kB".
+        const QList<QByteArray> parts = line.simplified().split(' ');
+        if (parts.size() >= 5 && parts.at(0).contains('-') && !parts.at(0).endsWith(':')) {
+            const QByteArray path = parts.size() >= 6 ? parts.at(5) : QByteArray();
+            current = path.startsWith('/') ? path.mid(path.lastIndexOf('/') + 1)
+                                           : QByteArray("[anon]");
+            continue;
+        }
+        qint64 kb = 0;
+        if (field(line, "Rss:", kb)) byFile[current] += kb;
+    }
+    std::vector<std::pair<QByteArray, qint64>> rows;
+    rows.reserve(std::size_t(byFile.size()));
+    for (auto it = byFile.cbegin(); it != byFile.cend(); ++it) {
+        rows.emplace_back(it.key(), it.value());
+    }
+    std::sort(rows.begin(), rows.end(),
+              [](const auto &a, const auto &b) { return a.second > b.second; });
+    return rows;
+}
+
+QString mb(qint64 kb) {
+    return kb < 0 ? QStringLiteral("?") : QString::number(double(kb) / 1024.0, 'f', 1);
+}
+
+} // namespace
+
+void enable() { gEnabled = true; }
+
+bool enabled() { return gEnabled; }
+
+void sample(const QString &point, bool breakdown) {
+    if (!gEnabled) return;
+    const Status s = readStatus();
+    const QString delta = gLastRssKb < 0 || s.rssKb < 0
+                              ? QString()
+                              : QStringLiteral("  (%1%2 MB)")
+                                    .arg(s.rssKb >= gLastRssKb ? QStringLiteral("+") : QString())
+                                    .arg(mb(s.rssKb - gLastRssKb));
+    gLastRssKb = s.rssKb;
+    qInfo().noquote() << QStringLiteral("anytalk-overlay: memory %1: rss %2 MB (anon %3, file %4), "
+                                        "pss %5, heap %6, peak %7%8")
+                             .arg(point, mb(s.rssKb), mb(s.anonKb), mb(s.fileKb), mb(s.pssKb),
+                                  mb(heapInUseKb()), mb(s.hwmKb), delta);
+    if (!breakdown) return;
+    const auto rows = residentByFile();
+    for (std::size_t i = 0; i < rows.size() && i < kBreakdownRows; ++i) {
+        qInfo().noquote() << QStringLiteral("  %1 MB  %2")
+                                 .arg(mb(rows[i].second), 7)
+                                 .arg(QString::fromLocal8Bit(rows[i].first));
+    }
+}
+
+void capArenas(int arenas) {
+#ifdef __GLIBC__
+    mallopt(M_ARENA_MAX, arenas);
+#else
+    (void)arenas;
+#endif
+}
+
+void trim() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+} // namespace footprint
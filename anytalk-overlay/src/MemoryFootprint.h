@@ -0,0 +1,30 @@
+#pragma once
+#include <QString>
+
+/// `--measure-memory`: what the overlay costs in RAM at the points that
+/// matter for a process that may stay resident — after start, once the
+/// window exists, after every session. Read from /proc/self; Linux only.
+///
+/// Each sample() logs one line: RSS split into anonymous and file-backed,
+/// PSS (shared library pages divided among the processes mapping them),
+/// malloc's in-use heap, and the RSS change since the previous line. With
+/// `breakdown` it also lists the mapped files by resident size, which is
+/// where a Qt module or an optional library shows what it costs.
+/// Everything is a no-op until enable().
+namespace footprint {
+
+void enable();
+bool enabled();
+
+void sample(const QString &point, bool breakdown = false);
+
+/// ANYTALK_SLIM: at most `arenas` malloc arenas. glibc otherwise gives
+/// each thread that allocates (capture, whisper, Qt's pools) one of its
+/// own, and each keeps its high-water mark. Call before any thread
+/// starts. Not gated by enable(), as neither is trim().
+void capArenas(int arenas);
+/// ANYTALK_SLIM: hand freed heap back to the kernel (glibc malloc_trim),
+/// so a resident overlay between sessions keeps only what it still uses.
+void trim();
+
+} // namespace footprint
@@ -1,18 +1,52 @@
 #include "OverlayService.h"
 #include "AsrController.h"
-#include "OverlayWindow.h"
+#include "Config.h"
+#include "PeerChannel.h"
 
 #include <QDBusConnection>
+#include <QDBusConnectionInterface>
 #include <QDBusError>
+#include <QDBusMessage>
 #include <QDebug>
 
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+
 namespace {
 constexpr const char *kService = "org.fcitx.Fcitx5.AnyTalk.Overlay";
 constexpr const char *kPath = "/overlay";
+constexpr const char *kInterface = "org.fcitx.Fcitx5.AnyTalk.Overlay";
+// The only caller AttachPeer takes a peer from: fcitx5 itself, where the
+// addon lives.
+constexpr const char *kFcitxService = "org.fcitx.Fcitx5";
+
+constexpr double kDefaultRateHz = 20.0;
+constexpr double kMaxRateHz = 60.0;
+// Anything the bus can deliver to a seat's worth of observers; a runaway
+// client shouldn't grow the table without bound.
+constexpr int kMaxSubscribers = 64;
+
+int intervalForRate(double hz) {
+    return static_cast<int>(std::lround(1000.0 / std::clamp(hz, 1.0, kMaxRateHz)));
+}
 } // namespace
 
-OverlayService::OverlayService(OverlayWindow *window, AsrController *asr, QObject *parent)
-    : QObject(parent), window_(window), asr_(asr) {}
+OverlayService::OverlayService(AsrController *asr, QObject *parent)
+    : QObject(parent), asr_(asr) {
+    subscriberWatcher_.setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(&subscriberWatcher_, &QDBusServiceWatcher::serviceUnregistered, this,
+            [this](const QString &name) {
+                subscribers_.remove(name);
+                subscriberWatcher_.removeWatchedService(name);
+            });
+
+    flushTimer_.setSingleShot(true);
+    connect(&flushTimer_, &QTimer::timeout, this, &OverlayService::flushDue);
+
+    legacyTimer_.setSingleShot(true);
+    connect(&legacyTimer_, &QTimer::timeout, this, &OverlayService::flushLegacy);
+}
 
 bool OverlayService::registerOnBus() {
     auto bus = QDBusConnection::sessionBus();
@@ -31,13 +65,27 @@ bool OverlayService::registerOnBus() {
                    << bus.lastError().message();
         return false;
     }
+    subscriberWatcher_.setConnection(bus);
     return true;
 }
 
+void OverlayService::configure(const OverlayConfig &cfg) {
+    const double hz = cfg.overlay.signalRateHz;
+    legacyIntervalMs_ = hz <= 0.0 ? 0 : intervalForRate(hz);
+}
+
 void OverlayService::ToggleRecording() {
     if (asr_) asr_->toggleRecording();
 }
 
+void OverlayService::ToggleRecordingAt(qlonglong keyPressUs) {
+    if (asr_) asr_->toggleRecordingAt(keyPressUs);
+}
+
+void OverlayService::StartRecordingAt(qlonglong keyPressUs) {
+    if (asr_) asr_->startRecordingAt(keyPressUs);
+}
+
 void OverlayService::StopRecording() {
     if (asr_) asr_->stopRecording();
 }
@@ -52,3 +100,268 @@ void OverlayService::CancelRecording() {
 void OverlayService::OpenSettings() { emit openSettingsRequested(); }
 
 void OverlayService::Acknowledge() { emit ackReceived(); }
+
+QVariantMap OverlayService::GetLastSessionStats() {
+    return asr_ ? asr_->lastSessionStats() : QVariantMap();
+}
+
+bool OverlayService::ResubmitLastSession() {
+    return asr_ && asr_->resubmitLastSession();
+}
+
+void OverlayService::Prewarm() {
+    if (asr_) asr_->prewarm();
+}
+
+void OverlayService::Subscribe(const QVariantMap &options) {
+    if (!calledFromDBus()) return;
+    const QString name = message().service();
+
+    Subscriber sub;
+    if (options.contains(QStringLiteral("topics"))) {
+        sub.topics = 0;
+        for (const QString &t : options.value(QStringLiteral("topics")).toStringList()) {
+            if (t == QLatin1String("state")) sub.topics |= TopicState;
+            else if (t == QLatin1String("level")) sub.topics |= TopicLevel;
+            else if (t == QLatin1String("partial")) sub.topics |= TopicPartial;
+            else if (t == QLatin1String("final")) sub.topics |= TopicFinal;
+            else if (t == QLatin1String("error")) sub.topics |= TopicError;
+            else if (t == QLatin1String("commit")) sub.topics |= TopicCommit;
+            else {
+                sendErrorReply(QDBusError::InvalidArgs,
+                               QStringLiteral("unknown topic: %1").arg(t));
+                return;
+            }
+        }
+    }
+    double hz = kDefaultRateHz;
+    if (options.contains(QStringLiteral("max_rate"))) {
+        bool ok = false;
+        hz = options.value(QStringLiteral("max_rate")).toDouble(&ok);
+        if (!ok || hz <= 0.0) {
+            sendErrorReply(QDBusError::InvalidArgs,
+                           QStringLiteral("max_rate must be a positive number"));
+            return;
+        }
+    }
+    sub.intervalMs = intervalForRate(hz);
+
+    if (!subscribers_.contains(name)) {
+        if (subscribers_.size() >= kMaxSubscribers) {
+            sendErrorReply(QDBusError::LimitsExceeded, QStringLiteral("too many subscribers"));
+            return;
+        }
+        subscriberWatcher_.addWatchedService(name);
+    }
+    auto &slot = subscribers_[name];
+    slot = std::move(sub);
+    // Snapshot so a late subscriber doesn't wait for the next transition.
+    if ((slot.topics & TopicState) && !lastState_.isEmpty()) {
+        slot.pending.insert(QStringLiteral("state"), lastState_);
+        flush(name, slot);
+    }
+}
+
+void OverlayService::Unsubscribe() {
+    if (!calledFromDBus()) return;
+    const QString name = message().service();
+    if (subscribers_.remove(name)) subscriberWatcher_.removeWatchedService(name);
+}
+
+void OverlayService::AttachPeer(const QDBusUnixFileDescriptor &fd) {
+    if (calledFromDBus()) {
+        // A peer drives recording and gets every commit; any other session
+        // bus client would otherwise be able to take it over.
+        const QString owner =
+            connection().interface()->serviceOwner(QLatin1String(kFcitxService)).value();
+        if (owner.isEmpty() || owner != message().service()) {
+            qWarning().noquote() << "AttachPeer refused from" << message().service();
+            sendErrorReply(QDBusError::AccessDenied, QStringLiteral("not fcitx5"));
+            return;
+        }
+    }
+    if (!fd.isValid()) {
+        if (calledFromDBus()) sendErrorReply(QDBusError::InvalidArgs, QStringLiteral("invalid fd"));
+        return;
+    }
+    // QDBusUnixFileDescriptor owns its copy; take our own.
+    const int own = ::fcntl(fd.fileDescriptor(), F_DUPFD_CLOEXEC, 0);
+    if (own < 0) {
+        if (calledFromDBus()) sendErrorReply(QDBusError::Failed, QStringLiteral("dup failed"));
+        return;
+    }
+    if (peer_) peer_->deleteLater();
+    auto *peer = new PeerChannel(own, this);
+    peer_ = peer;
+    connect(peer, &PeerChannel::toggleRequested, this, &OverlayService::ToggleRecordingAt);
+    connect(peer, &PeerChannel::startRequested, this, &OverlayService::StartRecordingAt);
+    connect(peer, &PeerChannel::stopRequested, this, &OverlayService::StopRecording);
+    connect(peer, &PeerChannel::cancelRequested, this, &OverlayService::CancelRecording);
+    connect(peer, &PeerChannel::acknowledged, this, &OverlayService::Acknowledge);
+    connect(peer, &PeerChannel::prewarmRequested, this, &OverlayService::Prewarm);
+    connect(peer, &PeerChannel::closed, this, [this, peer]() {
+        if (peer_ == peer) peer_ = nullptr;
+        peer->deleteLater();
+    });
+}
+
+// ---------- Fan-out ----------
+
+void OverlayService::publishState(const QString &state) {
+    lastState_ = state;
+    flushLegacy();
+    emit StateChanged(state);
+    post(TopicState, QStringLiteral("state"), state, /*urgent=*/true);
+}
+
+void OverlayService::publishUplinkQueue(int queuedMs) {
+    // Not urgent: rides out with the congested / recording state that
+    // AsrController emits right after it.
+    post(TopicState, QStringLiteral("queue_ms"), queuedMs, /*urgent=*/false);
+}
+
+void OverlayService::publishLevel(double level) {
+    legacyLevel_ = level;
+    postLegacy();
+    post(TopicLevel, QStringLiteral("level"), level, /*urgent=*/false);
+}
+
+void OverlayService::publishPartial(const QString &text) {
+    legacyPartial_ = text;
+    postLegacy();
+    post(TopicPartial, QStringLiteral("partial"), text, /*urgent=*/false);
+}
+
+void OverlayService::publishFinal(const QString &text) {
+    flushLegacy();
+    emit TranscriptFinal(text);
+    post(TopicFinal, QStringLiteral("finals"), text, /*urgent=*/true);
+}
+
+void OverlayService::publishError(const QString &text) {
+    flushLegacy();
+    emit ErrorOccurred(text);
+    post(TopicError, QStringLiteral("error"), text, /*urgent=*/true);
+}
+
+void OverlayService::publishCommit(const QString &text) {
+    flushLegacy();
+    // The addon is the only party that acts on CommitText; when its peer
+    // channel takes the packet, skip the broadcast so the text is never
+    // committed twice. On failure the channel closes and the bus carries it.
+    if (!peer_ || !peer_->send(PeerChannel::Outbound::Commit, text)) emit CommitText(text);
+    post(TopicCommit, QStringLiteral("commit"), text, /*urgent=*/true);
+}
+
+void OverlayService::publishCancelled() {
+    flushLegacy();
+    emit Cancelled();
+    post(TopicCommit, QStringLiteral("cancelled"), true, /*urgent=*/true);
+}
+
+void OverlayService::publishStreamCommit(const QString &segment) {
+    flushLegacy();
+    if (!peer_ || !peer_->send(PeerChannel::Outbound::StreamCommit, segment)) {
+        emit StreamCommit(segment);
+    }
+}
+
+void OverlayService::publishStreamPreedit(const QString &text) {
+    if (!text.isEmpty()) {
+        // One per partial otherwise; rides the partials' throttle.
+        legacyPreedit_ = text;
+        postLegacy();
+        return;
+    }
+    // A clear goes out now (it precedes the segment's StreamCommit) and
+    // makes any tail still waiting moot.
+    legacyPreedit_.reset();
+    flushLegacy();
+    sendStreamPreedit(text);
+}
+
+void OverlayService::sendStreamPreedit(const QString &text) {
+    if (!peer_ || !peer_->send(PeerChannel::Outbound::Preedit, text)) emit StreamPreedit(text);
+}
+
+void OverlayService::post(Topic topic, const QString &key, const QVariant &value,
+                          bool urgent) {
+    int nextDue = -1;
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+        Subscriber &sub = it.value();
+        if (!(sub.topics & topic)) continue;
+        // Finals are segments, not a latest-value: keep every one.
+        if (topic == TopicFinal) sub.finals.append(value.toString());
+        else sub.pending.insert(key, value);
+
+        const qint64 since = sub.lastSent.isValid() ? sub.lastSent.elapsed() : sub.intervalMs;
+        if (urgent || since >= sub.intervalMs) {
+            flush(it.key(), sub);
+        } else {
+            const int wait = static_cast<int>(sub.intervalMs - since);
+            nextDue = nextDue < 0 ? wait : std::min(nextDue, wait);
+        }
+    }
+    if (nextDue >= 0) armFlushTimer(nextDue);
+}
+
+void OverlayService::flush(const QString &name, Subscriber &sub) {
+    if (!sub.finals.isEmpty()) {
+        sub.pending.insert(QStringLiteral("finals"), sub.finals);
+        sub.finals.clear();
+    }
+    if (sub.pending.isEmpty()) return;
+    auto msg = QDBusMessage::createTargetedSignal(name, kPath, kInterface,
+                                                  QStringLiteral("Update"));
+    msg << sub.pending;
+    QDBusConnection::sessionBus().send(msg);
+    sub.pending.clear();
+    sub.lastSent.start();
+}
+
+void OverlayService::flushDue() {
+    int nextDue = -1;
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+        Subscriber &sub = it.value();
+        if (sub.pending.isEmpty() && sub.finals.isEmpty()) continue;
+        const qint64 since = sub.lastSent.isValid() ? sub.lastSent.elapsed() : sub.intervalMs;
+        if (since >= sub.intervalMs) {
+            flush(it.key(), sub);
+        } else {
+            const int wait = static_cast<int>(sub.intervalMs - since);
+            nextDue = nextDue < 0 ? wait : std::min(nextDue, wait);
+        }
+    }
+    if (nextDue >= 0) armFlushTimer(nextDue);
+}
+
+void OverlayService::armFlushTimer(int ms) {
+    // One timer for all subscribers, aimed at the earliest deadline.
+    if (flushTimer_.isActive() && flushTimer_.remainingTime() <= ms) return;
+    flushTimer_.start(ms);
+}
+
+// ---------- Legacy broadcast throttle ----------
+
+void OverlayService::postLegacy() {
+    const qint64 since =
+        legacyLastSent_.isValid() ? legacyLastSent_.elapsed() : legacyIntervalMs_;
+    if (since >= legacyIntervalMs_) {
+        flushLegacy();
+    } else if (!legacyTimer_.isActive()) {
+        // Trailing edge: the last level/partial of a burst still goes out.
+        legacyTimer_.start(static_cast<int>(legacyIntervalMs_ - since));
+    }
+}
+
+void OverlayService::flushLegacy() {
+    legacyTimer_.stop();
+    if (!legacyLevel_ && !legacyPartial_ && !legacyPreedit_) return;
+    if (legacyLevel_) emit AudioLevel(*legacyLevel_);
+    if (legacyPartial_) emit TranscriptPartial(*legacyPartial_);
+    if (legacyPreedit_) sendStreamPreedit(*legacyPreedit_);
+    legacyLevel_.reset();
+    legacyPartial_.reset();
+    legacyPreedit_.reset();
+    legacyLastSent_.start();
+}
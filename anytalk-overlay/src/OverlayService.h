@@ -1,10 +1,22 @@
 #pragma once
+#include <QDBusContext>
+#include <QDBusServiceWatcher>
+#include <QDBusUnixFileDescriptor>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <optional>
 
-class OverlayWindow;
 class AsrController;
+class PeerChannel;
+struct OverlayConfig;
 
-/// D-Bus surface of anytalk-overlay (short-lived).
+/// D-Bus surface of anytalk-overlay (short-lived by default).
 ///
 ///   Bus name : org.fcitx.Fcitx5.AnyTalk.Overlay
 ///   Path     : /overlay
@@ -16,40 +28,128 @@ class AsrController;
 /// performs ic->commitString() then calls Acknowledge() to let the
 /// overlay exit. No long-lived in-process state.
 ///
+/// With `[Overlay] Resident = true` the same surface stays registered
+/// after Acknowledge / Cancelled; the process only exits on its idle
+/// timeout or a signal (see main.cpp). The wire protocol is identical, so
+/// the addon does not need to know which mode is active.
+///
 /// Methods:
 ///   ToggleRecording()      idempotent: start if idle, stop if active
+///   ToggleRecordingAt(x)   same, for a key press the caller stamped with
+///                          CLOCK_MONOTONIC µs; the stamp anchors the
+///                          session trace (the addon uses this for F2)
 ///   StopRecording()        explicit stop (drain server finals → CommitText)
 ///   CancelRecording()      drop in-flight session, no commit; also serves
 ///                          as the user/addon "exit immediately" escape
 ///                          while the overlay is waiting for the post-
 ///                          commit Acknowledge
 ///   Acknowledge()          addon-→-overlay: commitString done, please exit
+///                          (resident: go back to standby)
 ///   OpenSettings()         bring up the SettingsDialog (synchronous)
+///   Subscribe(a{sv})       opt into targeted, coalesced Update signals
+///                          (see below); calling again replaces options
+///   Unsubscribe()          stop Update delivery to the caller
+///   AttachPeer(h)          addon hands over one end of a socketpair; key
+///                          forwarding and commit/ack then bypass the bus
+///                          (see PeerChannel). Replaces any earlier peer.
+///                          Only the owner of org.fcitx.Fcitx5 may call it.
+///   GetLastSessionStats()  → a{sv}: latency trace of the last finished
+///                          session (SessionTrace::toVariantMap); empty
+///                          before the first. A short-lived overlay exits
+///                          with its only session — use [Overlay] StatsFile.
+///   ResubmitLastSession()  → b: run the newest [Audio] Record recording
+///                          through the current backend again (faster than
+///                          real time) and commit it like a live session.
+///                          Idle only; false when there is nothing to send.
+///                          Returns once the read is queued; the session
+///                          starts when the file is in.
+///   Prewarm()              a session is likely soon: open the spare socket
+///                          and the mic stream corked, no UI, no audio sent.
+///                          Lapses after [Overlay] PrewarmSec; a short-lived
+///                          overlay it activated then exits. The addon sends
+///                          it on focus of a [Addon] PrewarmPrograms app
 ///
-/// Signals:
-///   StateChanged(s)        idle / connecting / recording / error
-///   TranscriptPartial(s)   streaming preedit text
+/// Signals (broadcast):
+///   StateChanged(s)        idle / connecting / recording / error, plus
+///                          congested: still recording, but the uplink is
+///                          backed up so partials lag (back to recording
+///                          once it drains)
+///   TranscriptPartial(s)   streaming preedit text     (throttled)
 ///   TranscriptFinal(s)     committed segment (server-side final)
-///   AudioLevel(d)          0..1, ~20 Hz
+///   AudioLevel(d)          0..1                       (throttled)
 ///   ErrorOccurred(s)       human-readable error
 ///   CommitText(s)          final text ready to commit; addon must call
-///                          Acknowledge() after handling so overlay can exit
+///                          Acknowledge() after handling so overlay can exit.
+///                          Not broadcast when it went out over the peer
+///                          channel — each commit takes exactly one path
 ///   Cancelled()            cancel/Esc completed; overlay will exit
-class OverlayService : public QObject {
+///   StreamCommit(s)        [Overlay] StreamCommit only: finished segment
+///                          for the addon to commit immediately
+///   StreamPreedit(s)       [Overlay] StreamCommit only: in-progress tail
+///                          for client preedit; empty clears it (throttled)
+/// Like CommitText, the two Stream* signals skip the broadcast while a
+/// peer channel is attached.
+///
+/// The two throttled signals, and StreamPreedit however it is sent, carry
+/// the latest value at most `[Overlay] SignalRateHz` times a second
+/// (default 20, 0 = unthrottled); the last value of a burst is always
+/// delivered, and a StreamPreedit clear goes out at once.
+///
+/// Subscriptions: Update(a{sv}) is sent only to subscribed unique names
+/// (a targeted signal — no match rule, no fan-out to other peers).
+/// Options:
+///   "topics"   as   any of state, level, partial, final, error, commit
+///                   (commit covers CommitText and Cancelled); default all
+///   "max_rate" d    Hz cap for level/partial updates, 1..60, default 20
+/// Update keys, each present only when it changed since the last Update:
+///   "state" s, "level" d, "partial" s, "finals" as (in order),
+///   "error" s, "commit" s, "cancelled" b,
+///   "queue_ms" i (state topic: audio waiting in the uplink send queue,
+///                 sent with each congested / recovered transition)
+/// level/partial are coalesced to the latest value per interval; every
+/// other key flushes immediately, carrying whatever is pending with it.
+/// A fresh subscription gets the current state right away. Subscriptions
+/// end when the caller drops off the bus.
+class OverlayService : public QObject, protected QDBusContext {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.fcitx.Fcitx5.AnyTalk.Overlay")
 public:
-    OverlayService(OverlayWindow *window, AsrController *asr, QObject *parent = nullptr);
+    explicit OverlayService(AsrController *asr, QObject *parent = nullptr);
 
     bool registerOnBus();
+    /// Reads `[Overlay] SignalRateHz`.
+    void configure(const OverlayConfig &cfg);
 
 public slots:
     Q_SCRIPTABLE void ToggleRecording();
+    Q_SCRIPTABLE void ToggleRecordingAt(qlonglong keyPressUs);
+    /// Push-to-talk press: starts, or queues behind a draining session;
+    /// never stops (see AsrController::startRecordingAt).
+    Q_SCRIPTABLE void StartRecordingAt(qlonglong keyPressUs);
     Q_SCRIPTABLE void StopRecording();
     Q_SCRIPTABLE void CancelRecording();
     Q_SCRIPTABLE void OpenSettings();
     /// Addon → overlay: ic->commitString() finished, overlay can exit.
     Q_SCRIPTABLE void Acknowledge();
+    Q_SCRIPTABLE void Subscribe(const QVariantMap &options);
+    Q_SCRIPTABLE void Unsubscribe();
+    Q_SCRIPTABLE void AttachPeer(const QDBusUnixFileDescriptor &fd);
+    Q_SCRIPTABLE QVariantMap GetLastSessionStats();
+    Q_SCRIPTABLE bool ResubmitLastSession();
+    Q_SCRIPTABLE void Prewarm();
+
+    /// In-process entry points: main() wires AsrController here, and they
+    /// fan out to the broadcast signals and the subscribers.
+    void publishState(const QString &state);
+    void publishLevel(double level);
+    void publishPartial(const QString &text);
+    void publishFinal(const QString &text);
+    void publishError(const QString &text);
+    void publishCommit(const QString &text);
+    void publishCancelled();
+    void publishStreamCommit(const QString &segment);
+    void publishStreamPreedit(const QString &text);
+    void publishUplinkQueue(int queuedMs);
 
 signals:
     Q_SCRIPTABLE void StateChanged(const QString &state);
@@ -61,6 +161,11 @@ signals:
     Q_SCRIPTABLE void CommitText(const QString &text);
     /// Cancel completed (Esc or addon-initiated CancelRecording).
     Q_SCRIPTABLE void Cancelled();
+    Q_SCRIPTABLE void StreamCommit(const QString &segment);
+    Q_SCRIPTABLE void StreamPreedit(const QString &text);
+    /// Never emitted as a broadcast — declared for introspection only;
+    /// subscribers receive it as a targeted signal.
+    Q_SCRIPTABLE void Update(const QVariantMap &update);
 
     /// In-process only: D-Bus method `OpenSettings` routes here; main()
     /// runs the local SettingsDialog.
@@ -71,6 +176,51 @@ signals:
     void cancelEscape();
 
 private:
-    OverlayWindow *window_;
+    enum Topic : quint32 {
+        TopicState = 1u << 0,
+        TopicLevel = 1u << 1,
+        TopicPartial = 1u << 2,
+        TopicFinal = 1u << 3,
+        TopicError = 1u << 4,
+        TopicCommit = 1u << 5,
+        TopicAll = (1u << 6) - 1,
+    };
+
+    struct Subscriber {
+        quint32 topics = TopicAll;
+        int intervalMs = 50;
+        QElapsedTimer lastSent;  // invalid until the first Update
+        QVariantMap pending;
+        QStringList finals;
+    };
+
+    /// Queue `value` under `key` for every subscriber of `topic`; urgent
+    /// keys are sent right away, the rest wait out the subscriber's rate.
+    void post(Topic topic, const QString &key, const QVariant &value, bool urgent);
+    void flush(const QString &name, Subscriber &sub);
+    void flushDue();
+    void armFlushTimer(int ms);
+
+    /// Broadcast the pending throttled legacy signals now. Called before
+    /// any unthrottled signal so observers keep seeing them in order.
+    void flushLegacy();
+    void postLegacy();
+    /// StreamPreedit over the peer channel, or broadcast without one.
+    void sendStreamPreedit(const QString &text);
+
     AsrController *asr_;
+
+    QHash<QString, Subscriber> subscribers_;  // keyed by unique bus name
+    QDBusServiceWatcher subscriberWatcher_;
+    QTimer flushTimer_;
+    QString lastState_;
+
+    int legacyIntervalMs_ = 50;  // 0 = unthrottled
+    QElapsedTimer legacyLastSent_;
+    QTimer legacyTimer_;
+    std::optional<double> legacyLevel_;
+    std::optional<QString> legacyPartial_;
+    std::optional<QString> legacyPreedit_;
+
+    QPointer<PeerChannel> peer_;
 };
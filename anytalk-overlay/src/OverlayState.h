@@ -12,6 +12,11 @@
 ///     subscribers (waybar custom modules, the fcitx5 addon).
 ///
 /// Convert enum → string at signal-emission time via `state::toString()`.
+///
+/// `state::Congested` is wire-only: a sub-state of Recording (the uplink is
+/// backed up, partials lag) with no enum value of its own. It's only ever
+/// emitted between two Recording states, and subscribers that don't know
+/// it can treat it as Recording.
 namespace state {
 
 enum class State { Idle, Connecting, Recording, Error };
@@ -20,6 +25,7 @@ inline const QString Idle       = QStringLiteral("idle");
 inline const QString Connecting = QStringLiteral("connecting");
 inline const QString Recording  = QStringLiteral("recording");
 inline const QString Error      = QStringLiteral("error");
+inline const QString Congested  = QStringLiteral("congested");
 
 inline const QString &toString(State s) {
     switch (s) {
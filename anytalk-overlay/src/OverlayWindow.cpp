@@ -18,9 +18,13 @@
 #include <QPropertyAnimation>
 #include <QScreen>
 #include <QShowEvent>
+#include <QTextLine>
+#include <QTextOption>
 #include <QVBoxLayout>
 #include <QWindow>
 
+#include <algorithm>
+#include <cmath>
 
 #if __has_include(<LayerShellQt/Window>)
 #  include <LayerShellQt/Window>
@@ -33,6 +37,15 @@
 // the manual-position path (which works on X11/XWayland; on GNOME Wayland the
 // window degrades to a floating toplevel — best we can do without ext-layer-
 // shell support upstream).
+namespace {
+// Partials are coalesced to at most one relayout per ~frame.
+constexpr int kTranscriptFrameMs = 16;
+// Single-line transcripts widen the card in steps of this, not per glyph.
+constexpr int kWidthStep = 48;
+// QLabel's own text margin inside its width.
+constexpr int kLabelSlack = 4;
+} // namespace
+
 static bool isLayerShellViable() {
     if (QGuiApplication::platformName() != QLatin1String("wayland")) return false;
     const QByteArray desktop = qgetenv("XDG_CURRENT_DESKTOP").toLower();
@@ -67,10 +80,7 @@ OverlayWindow::OverlayWindow(QWidget *parent) : QWidget(parent) {
     hintLabel_ = new QLabel(this);
     hintLabel_->setAlignment(Qt::AlignVCenter | Qt::AlignRight);
     hintLabel_->setTextFormat(Qt::RichText);
-    hintLabel_->setText(QStringLiteral(
-        "<span style='color:rgba(255,255,255,110); font-family:\"JetBrains Mono\",monospace; font-size:11px;'>"
-        "F2&nbsp;·&nbsp;Esc"
-        "</span>"));
+    hintLabel_->setText(hintHtml(QStringLiteral("F2&nbsp;·&nbsp;Esc")));
     topRow->addWidget(hintLabel_, 0, Qt::AlignVCenter);
 
     root->addLayout(topRow);
@@ -91,6 +101,18 @@ OverlayWindow::OverlayWindow(QWidget *parent) : QWidget(parent) {
     }
     root->addWidget(transcriptLabel_);
 
+    {
+        QTextOption opt(Qt::AlignLeft | Qt::AlignTop);
+        opt.setWrapMode(QTextOption::WordWrap);  // what QLabel::setWordWrap uses
+        lineBreaker_.setFont(transcriptLabel_->font());
+        lineBreaker_.setTextOption(opt);
+    }
+    pendingText_ = shownText_ = transcriptLabel_->text();
+    wrapWidth_ = Theme::TRANSCRIPT_MIN_WIDTH;
+    transcriptTimer_.setSingleShot(true);
+    transcriptTimer_.setInterval(kTranscriptFrameMs);
+    connect(&transcriptTimer_, &QTimer::timeout, this, &OverlayWindow::flushTranscript);
+
     fadeEffect_ = new QGraphicsOpacityEffect(this);
     fadeEffect_->setOpacity(0.0);
     setGraphicsEffect(fadeEffect_);
@@ -101,11 +123,17 @@ OverlayWindow::OverlayWindow(QWidget *parent) : QWidget(parent) {
 // ---------- State transitions ----------
 
 void OverlayWindow::onStateChanged(const QString &newState) {
-    if (newState == state::Recording) {
+    if (newState == state::Congested) {
+        setCongested(true);
+    } else if (newState == state::Recording && congested_) {
+        // Same session, uplink drained: keep the transcript.
+        setCongested(false);
+    } else if (newState == state::Recording) {
         enterListening(/*connecting=*/false);
     } else if (newState == state::Connecting) {
         enterListening(/*connecting=*/true);
     } else if (newState == state::Error) {
+        setCongested(false);
         if (vis_ != Vis::Error) vis_ = Vis::Error;
     } else {
         enterHidden();
@@ -114,85 +142,169 @@ void OverlayWindow::onStateChanged(const QString &newState) {
 
 void OverlayWindow::onErrorOccurred(const QString &text) { enterError(text); }
 
+void OverlayWindow::setCongested(bool congested) {
+    if ((congested && vis_ != Vis::Active) || congested == congested_) return;
+    congested_ = congested;
+    // Amber dot as while connecting: the network is what's holding
+    // partials back, not the mic.
+    statusDot_->setMode(congested ? StatusDot::Mode::Connecting : StatusDot::Mode::Recording);
+    hintLabel_->setText(hintHtml(congested ? QStringLiteral("网络拥堵·识别延迟")
+                                           : QStringLiteral("F2&nbsp;·&nbsp;Esc")));
+}
+
 void OverlayWindow::enterListening(bool connecting) {
+    setCongested(false);
     vis_ = Vis::Active;
     statusDot_->setMode(connecting ? StatusDot::Mode::Connecting
                                     : StatusDot::Mode::Recording);
     partialText_.clear();
-    finalText_.clear();
+    finals_.clear();
     bars_->setLevel(0.0);
-    setTranscript(connecting ? QStringLiteral("正在连接…")
-                              : QStringLiteral("说点什么…"),
-                  /*dim=*/true);
+    setTranscriptNow(connecting ? QStringLiteral("正在连接…")
+                                 : QStringLiteral("说点什么…"),
+                     Tone::Placeholder);
     fadeIn();
 }
 
 void OverlayWindow::enterError(const QString &text) {
+    setCongested(false);
     vis_ = Vis::Error;
     statusDot_->setMode(StatusDot::Mode::Error);
     bars_->setLevel(0.0);
-    setTranscript(text.isEmpty() ? QStringLiteral("⚠ 麦克风不可用")
-                                  : QStringLiteral("⚠ ") + text,
-                  /*dim=*/false);
-    transcriptLabel_->setStyleSheet(
-        QString("color: %1;").arg(Theme::errorColor().name()));
+    setTranscriptNow(text.isEmpty() ? QStringLiteral("⚠ 麦克风不可用")
+                                     : QStringLiteral("⚠ ") + text,
+                     Tone::Error);
     // No auto-hide — user dismisses with F2 / Esc.
     fadeIn();
 }
 
 void OverlayWindow::enterHidden() {
+    setCongested(false);
     vis_ = Vis::Hidden;
     statusDot_->setMode(StatusDot::Mode::Idle);
     fadeOut();
 }
 
-// Truncate from the front so wrapped text fits in TRANSCRIPT_MAX_LINES.
-// Returns the (possibly trimmed) string. The full utterance is preserved
-// elsewhere — this function only affects what the label renders.
-static QString fitToLines(const QString &text, const QFont &font, int wrapWidth, int maxLines) {
-    QFontMetrics fm(font);
-    const int maxH = fm.lineSpacing() * maxLines;
-    auto fits = [&](const QString &s) {
-        const QRect r = fm.boundingRect(0, 0, wrapWidth, INT_MAX,
-                                         Qt::TextWordWrap, s);
-        return r.height() <= maxH;
-    };
-    if (fits(text)) return text;
-    // Binary search the longest tail that still fits, then prepend "…".
-    int lo = 0;
-    int hi = text.length();
-    while (lo < hi) {
-        const int mid = (lo + hi) / 2;
-        const QString candidate = QStringLiteral("…") + text.right(text.length() - mid);
-        if (fits(candidate)) {
-            hi = mid;
+QString OverlayWindow::hintHtml(const QString &text) {
+    return QStringLiteral("<span style='color:rgba(255,255,255,110); font-family:\"JetBrains "
+                          "Mono\",monospace; font-size:11px;'>%1</span>")
+        .arg(text);
+}
+
+// Break `text` at `width`; line count, plus where each line starts and the
+// widest line's natural width when asked for.
+static int breakLines(QTextLayout &layout, const QString &text, qreal width,
+                      QList<int> *starts, qreal *naturalWidth) {
+    layout.setText(text);
+    layout.beginLayout();
+    int n = 0;
+    qreal natural = 0;
+    for (QTextLine line = layout.createLine(); line.isValid(); line = layout.createLine()) {
+        line.setLineWidth(width);
+        if (starts) starts->append(line.textStart());
+        natural = std::max(natural, line.naturalTextWidth());
+        ++n;
+    }
+    layout.endLayout();
+    if (naturalWidth) *naturalWidth = natural;
+    return std::max(n, 1);
+}
+
+struct TranscriptFit {
+    QString display;
+    int lines = 1;
+    qreal naturalWidth = 0;
+};
+
+// Truncate from the front so wrapped text fits in TRANSCRIPT_MAX_LINES:
+// keep the last maxLines lines and prepend "…". One layout pass in the
+// common case. The full utterance is preserved elsewhere — this only
+// affects what the label renders. `clipped`: `text` is already a tail,
+// so it gets the "…" even if it fits.
+static TranscriptFit fitToLines(QTextLayout &layout, const QString &text, int wrapWidth,
+                                int maxLines, bool clipped) {
+    TranscriptFit fit;
+    QList<int> starts;
+    fit.lines = breakLines(layout, text, wrapWidth, &starts, &fit.naturalWidth);
+    if (fit.lines <= maxLines && !clipped) {
+        fit.display = text;
+        return fit;
+    }
+    // The ellipsis can push the first kept line over by a glyph; drop
+    // leading characters until the tail fits.
+    int from = fit.lines > maxLines ? starts.at(starts.size() - maxLines) : 0;
+    while (from < text.size()) {
+        fit.display = QStringLiteral("…") + text.mid(from);
+        fit.lines = breakLines(layout, fit.display, wrapWidth, nullptr, &fit.naturalWidth);
+        if (fit.lines <= maxLines) return fit;
+        ++from;
+        if (from < text.size() && text.at(from).isLowSurrogate()) ++from;
+    }
+    fit.display = QStringLiteral("…");
+    fit.lines = 1;
+    return fit;
+}
+
+void OverlayWindow::setTranscript(const QString &text, Tone tone) {
+    pendingText_ = text;
+    pendingTone_ = tone;
+    pendingClipped_ = false;
+    if (!transcriptTimer_.isActive()) transcriptTimer_.start();
+}
+
+void OverlayWindow::setTranscriptNow(const QString &text, Tone tone) {
+    pendingText_ = text;
+    pendingTone_ = tone;
+    pendingClipped_ = false;
+    flushTranscript();
+}
+
+void OverlayWindow::flushTranscript() {
+    transcriptTimer_.stop();
+    const TranscriptFit fit =
+        fitToLines(lineBreaker_, pendingText_, wrapWidth_, Theme::TRANSCRIPT_MAX_LINES,
+                   pendingClipped_);
+    if (fit.display != shownText_) {
+        shownText_ = fit.display;
+        transcriptLabel_->setText(fit.display);
+    }
+    if (pendingTone_ != shownTone_) {
+        // setStyleSheet repolishes the label — only on an actual change.
+        shownTone_ = pendingTone_;
+        if (pendingTone_ == Tone::Error) {
+            transcriptLabel_->setStyleSheet(
+                QString("color: %1;").arg(Theme::errorColor().name()));
         } else {
-            lo = mid + 1;
+            const int alpha = pendingTone_ == Tone::Primary ? Theme::textPrimary().alpha()
+                                                            : Theme::textPlaceholder().alpha();
+            transcriptLabel_->setStyleSheet(QString("color: rgba(255,255,255,%1);").arg(alpha));
         }
     }
-    return QStringLiteral("…") + text.right(text.length() - lo);
-}
 
-void OverlayWindow::setTranscript(const QString &text, bool dim) {
-    const int wrapWidth = transcriptLabel_->maximumWidth() > 0
-                              ? transcriptLabel_->maximumWidth() - 4
-                              : Theme::TRANSCRIPT_MIN_WIDTH;
-    const QString display =
-        fitToLines(text, transcriptLabel_->font(), wrapWidth,
-                   Theme::TRANSCRIPT_MAX_LINES);
-    transcriptLabel_->setText(display);
-    if (dim) {
-        transcriptLabel_->setStyleSheet(
-            QString("color: rgba(255,255,255,%1);")
-                .arg(Theme::textPlaceholder().alpha()));
-    } else {
-        transcriptLabel_->setStyleSheet(
-            QString("color: rgba(255,255,255,%1);")
-                .arg(Theme::textPrimary().alpha()));
+    int width = wrapWidth_;
+    if (fit.lines == 1) {
+        const int natural = static_cast<int>(std::ceil(fit.naturalWidth));
+        width = std::min(wrapWidth_, (natural + kWidthStep - 1) / kWidthStep * kWidthStep);
     }
+    const int lineHeight = QFontMetrics(transcriptLabel_->font()).lineSpacing();
+    const QSize box(std::max(Theme::TRANSCRIPT_MIN_WIDTH, width + kLabelSlack),
+                    fit.lines * lineHeight);
+    if (box == labelBox_) return;
+    // Pinning the label's minimum to the quantized box keeps its per-glyph
+    // sizeHint changes from growing the window between boundaries.
+    labelBox_ = box;
+    transcriptLabel_->setMinimumSize(box);
     adjustSize();
 }
 
+void OverlayWindow::setWrapWidth(int wrap) {
+    transcriptLabel_->setMaximumWidth(wrap);
+    setMaximumWidth(wrap + Theme::CARD_PAD_X * 2);
+    wrapWidth_ = wrap - kLabelSlack;
+    labelBox_ = {};
+    flushTranscript();
+}
+
 // ---------- Streaming inputs ----------
 
 void OverlayWindow::onAudioLevel(double level) {
@@ -203,14 +315,23 @@ void OverlayWindow::onAudioLevel(double level) {
 void OverlayWindow::onTranscriptPartial(const QString &text) {
     if (vis_ != Vis::Active) return;
     partialText_ = text;
-    setTranscript(finalText_ + partialText_, /*dim=*/false);
+    showTranscript();
 }
 
 void OverlayWindow::onTranscriptFinal(const QString &text) {
     if (vis_ != Vis::Active) return;
-    finalText_ += text;
+    finals_.append(text);
     partialText_.clear();
-    setTranscript(finalText_, /*dim=*/false);
+    showTranscript();
+}
+
+void OverlayWindow::showTranscript() {
+    // The label shows the last few lines, and no glyph is narrower than
+    // 2 px: this many characters always fill them, so the text laid out per
+    // partial stays the same size however long the session runs.
+    const qsizetype cap = qsizetype(Theme::TRANSCRIPT_MAX_LINES) * std::max(wrapWidth_ / 2, 1);
+    setTranscript(finals_.tail(cap, partialText_), Tone::Primary);
+    pendingClipped_ = finals_.size() > cap;
 }
 
 // ---------- Window plumbing ----------
@@ -226,10 +347,7 @@ void OverlayWindow::positionAtBottom() {
     const int wrap = std::max(Theme::TRANSCRIPT_MIN_WIDTH,
                                static_cast<int>(avail.width() *
                                                 Theme::TRANSCRIPT_WIDTH_FRACTION));
-    transcriptLabel_->setMaximumWidth(wrap);
-    setMaximumWidth(wrap + Theme::CARD_PAD_X * 2);
-
-    adjustSize();
+    setWrapWidth(wrap);
     const int x = avail.x() + (avail.width() - width()) / 2;
     const int y = avail.y() + avail.height() - height() - Theme::CARD_BOTTOM_MARGIN;
     move(x, y);
@@ -270,9 +388,7 @@ void OverlayWindow::configureLayerShell() {
         const int wrap = std::max(Theme::TRANSCRIPT_MIN_WIDTH,
                                    static_cast<int>(primary->geometry().width() *
                                                     Theme::TRANSCRIPT_WIDTH_FRACTION));
-        transcriptLabel_->setMaximumWidth(wrap);
-        setMaximumWidth(wrap + Theme::CARD_PAD_X * 2);
-        adjustSize();
+        setWrapWidth(wrap);
     }
 #endif
 }
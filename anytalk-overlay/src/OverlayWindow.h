@@ -1,5 +1,9 @@
 #pragma once
+#include "TranscriptBuffer.h"
+
 #include <QString>
+#include <QTextLayout>
+#include <QTimer>
 #include <QWidget>
 
 class AuroraBars;
@@ -30,12 +34,28 @@ protected:
 
 private:
     enum class Vis { Hidden, Active, Error };
+    enum class Tone { Placeholder, Primary, Error };
 
     void enterListening(bool connecting);
     void enterError(const QString &text);
     void enterHidden();
+    /// state::Congested sub-state of Recording: dot + hint only, the
+    /// transcript is left alone.
+    void setCongested(bool congested);
+    static QString hintHtml(const QString &text);
 
-    void setTranscript(const QString &text, bool dim);
+    /// Queue `text` for the transcript label. Streaming partials arrive
+    /// faster than the compositor shows frames, so updates are coalesced
+    /// to one relayout per frame (flushTranscript).
+    void setTranscript(const QString &text, Tone tone);
+    /// setTranscript() applied immediately — state transitions, where the
+    /// card must not show a frame of the previous state's text.
+    void setTranscriptNow(const QString &text, Tone tone);
+    /// The session's finals and the partial after them, as much as fits.
+    void showTranscript();
+    void flushTranscript();
+    /// Wrap width changed (output switch / first show): re-fit and resize.
+    void setWrapWidth(int wrap);
 
     void fadeIn();
     void fadeOut();
@@ -51,6 +71,20 @@ private:
     QPropertyAnimation *fadeAnim_ = nullptr;
 
     Vis vis_ = Vis::Hidden;
+    bool congested_ = false;
     QString partialText_;
-    QString finalText_;
+    TranscriptBuffer finals_;
+
+    // Transcript layout. The label box only changes at line-count
+    // boundaries (height) or in kWidthStep steps (single-line width), so
+    // a growing partial doesn't resize the surface on every glyph.
+    QTimer transcriptTimer_;
+    QTextLayout lineBreaker_;  // font fixed; text swapped per fit
+    QString pendingText_;
+    Tone pendingTone_ = Tone::Placeholder;
+    bool pendingClipped_ = false;  // pendingText_ is a tail of the transcript
+    QString shownText_;
+    Tone shownTone_ = Tone::Placeholder;
+    QSize labelBox_;
+    int wrapWidth_ = 0;        // layout width for the transcript, px
 };
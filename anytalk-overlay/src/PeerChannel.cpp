@@ -0,0 +1,83 @@
+#include "PeerChannel.h"
+
+#include <QDebug>
+#include <QSocketNotifier>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+constexpr char kPeerToggle = 'T';
+constexpr char kPeerStart = 'R';
+constexpr char kPeerStop = 'S';
+constexpr char kPeerCancel = 'X';
+constexpr char kPeerAck = 'A';
+constexpr char kPeerPrewarm = 'W';
+// Inbound packets are an opcode and at most a short decimal stamp;
+// anything longer is truncated by recv().
+constexpr int kInboundBytes = 64;
+} // namespace
+
+PeerChannel::PeerChannel(int fd, QObject *parent) : QObject(parent), fd_(fd) {
+    ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    ::fcntl(fd_, F_SETFD, FD_CLOEXEC);
+    notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated, this, &PeerChannel::onReadable);
+}
+
+PeerChannel::~PeerChannel() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool PeerChannel::send(Outbound op, const QString &text) {
+    if (fd_ < 0) return false;
+    QByteArray packet;
+    packet.reserve(1 + text.size() * 3);
+    packet.append(static_cast<char>(op));
+    packet.append(text.toUtf8());
+    // MSG_NOSIGNAL: a vanished addon must not SIGPIPE the overlay.
+    const ssize_t n = ::send(fd_, packet.constData(), static_cast<size_t>(packet.size()),
+                             MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n == packet.size()) return true;
+    qWarning() << "PeerChannel: send failed —" << qt_error_string(errno);
+    close();
+    return false;
+}
+
+void PeerChannel::onReadable() {
+    char buf[kInboundBytes];
+    for (;;) {
+        const ssize_t n = ::recv(fd_, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            // 0 = orderly hangup (fcitx5 restarted / addon dropped the peer).
+            close();
+            return;
+        }
+        switch (buf[0]) {
+        case kPeerToggle:
+            emit toggleRequested(QByteArray(buf + 1, static_cast<int>(n - 1)).toLongLong());
+            break;
+        case kPeerStart:
+            emit startRequested(QByteArray(buf + 1, static_cast<int>(n - 1)).toLongLong());
+            break;
+        case kPeerStop: emit stopRequested(); break;
+        case kPeerCancel: emit cancelRequested(); break;
+        case kPeerAck: emit acknowledged(); break;
+        case kPeerPrewarm: emit prewarmRequested(); break;
+        default: break;
+        }
+        if (fd_ < 0) return;  // a handler dropped the channel
+    }
+}
+
+void PeerChannel::close() {
+    if (fd_ < 0) return;
+    notifier_->setEnabled(false);
+    ::close(fd_);
+    fd_ = -1;
+    emit closed();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+
+/// Private addon ↔ overlay link over one end of an AF_UNIX SOCK_SEQPACKET
+/// socketpair the addon hands over with OverlayService::AttachPeer(h).
+///
+/// Carries the per-session hot path — key forwarding and CommitText /
+/// Acknowledge — without two dbus-daemon hops and match-rule evaluation
+/// per message. One packet per message: an opcode byte, then UTF-8
+/// payload. Keep in sync with src/addon.cpp (kPeer*).
+///
+///   addon → overlay: 'T' toggle, optionally + decimal CLOCK_MONOTONIC µs
+///                        of the key press (see ToggleRecordingAt)
+///                    'R' start only (push-to-talk), same optional stamp
+///                    'S' stop, 'X' cancel, 'A' acknowledge, 'W' prewarm
+///   overlay → addon: 'C' + text   commit
+///                    'c' + text   StreamCommit segment
+///                    'p' + text   StreamPreedit (empty clears)
+///
+/// Unknown opcodes are ignored so either side can grow the protocol.
+/// The socket is non-blocking on our end; a hangup or error closes the
+/// channel and the service falls back to the bus.
+class PeerChannel : public QObject {
+    Q_OBJECT
+public:
+    /// Takes ownership of `fd`.
+    explicit PeerChannel(int fd, QObject *parent = nullptr);
+    ~PeerChannel() override;
+
+    enum class Outbound : char { Commit = 'C', StreamCommit = 'c', Preedit = 'p' };
+
+    bool isOpen() const { return fd_ >= 0; }
+    /// False when the packet could not be queued (peer gone, oversized) —
+    /// the channel is closed and the caller should use the bus instead.
+    bool send(Outbound op, const QString &text);
+
+signals:
+    /// `keyPressUs` 0 = the packet carried no stamp.
+    void toggleRequested(qint64 keyPressUs);
+    void startRequested(qint64 keyPressUs);
+    void stopRequested();
+    void cancelRequested();
+    void prewarmRequested();
+    void acknowledged();
+    void closed();
+
+private:
+    void onReadable();
+    void close();
+
+    int fd_ = -1;
+    QSocketNotifier *notifier_ = nullptr;
+};
@@ -0,0 +1,185 @@
+#include "SessionTrace.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <cmath>
+#include <ctime>
+
+namespace {
+
+constexpr const char *kMarkNames[SessionTrace::kMarkCount] = {
+    "key_press", "process_start", "start",     "audio_open", "warmed_up", "connected",
+    "first_partial", "stop",      "last_final", "commit",    "ack",
+};
+
+// A stamp older than this (or from the future) is not this session's key
+// press: a stale peer packet, or a client that made one up.
+constexpr std::int64_t kMaxKeyAgeUs = 60'000'000;
+
+std::int64_t gProcessStartUs = 0;
+bool gServedSession = false;
+
+const char *outcomeName(SessionTrace::Outcome o) {
+    switch (o) {
+    case SessionTrace::Outcome::None: return "none";
+    case SessionTrace::Outcome::Commit: return "commit";
+    case SessionTrace::Outcome::Empty: return "empty";
+    case SessionTrace::Outcome::Cancelled: return "cancelled";
+    case SessionTrace::Outcome::Error: return "error";
+    }
+    return "none";
+}
+
+// 0.1 ms is finer than anything on this path is repeatable to.
+double toMs(std::int64_t us) { return std::round(static_cast<double>(us) / 100.0) / 10.0; }
+
+} // namespace
+
+std::int64_t SessionTrace::nowUs() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000 + ts.tv_nsec / 1'000;
+}
+
+void SessionTrace::noteProcessStart() {
+    if (gProcessStartUs == 0) gProcessStartUs = nowUs();
+}
+
+std::int64_t SessionTrace::processStartUs() { return gProcessStartUs; }
+
+void SessionTrace::begin(std::int64_t keyPressUs, const QString &backend) {
+    *this = SessionTrace();
+    active_ = true;
+    backend_ = backend;
+    startedAt_ = QDateTime::currentDateTimeUtc();
+    const std::int64_t now = nowUs();
+    if (keyPressUs > 0 && keyPressUs <= now && now - keyPressUs < kMaxKeyAgeUs) {
+        marks_[static_cast<int>(Mark::KeyPress)] = keyPressUs;
+    }
+    if (!gServedSession) {
+        gServedSession = true;
+        cold_ = gProcessStartUs != 0;
+        marks_[static_cast<int>(Mark::ProcessStart)] = gProcessStartUs;
+    }
+    marks_[static_cast<int>(Mark::Start)] = now;
+}
+
+void SessionTrace::mark(Mark m, std::int64_t atUs) {
+    if (!active_) return;
+    auto &slot = marks_[static_cast<int>(m)];
+    if (slot != 0 && m != Mark::LastFinal) return;
+    slot = atUs > 0 ? atUs : nowUs();
+}
+
+QVariantMap SessionTrace::toVariantMap() const {
+    QVariantMap map;
+    if (!startedAt_.isValid()) return map;
+    const std::int64_t origin = has(Mark::KeyPress) ? marks_[static_cast<int>(Mark::KeyPress)]
+                                                    : marks_[static_cast<int>(Mark::Start)];
+    for (int i = 0; i < kMarkCount; ++i) {
+        if (marks_[i] == 0) continue;
+        map.insert(QStringLiteral("%1_ms").arg(QLatin1String(kMarkNames[i])),
+                   toMs(marks_[i] - origin));
+    }
+    map.insert(QStringLiteral("started_at"), startedAt_.toString(Qt::ISODateWithMs));
+    map.insert(QStringLiteral("outcome"), QString::fromLatin1(outcomeName(outcome_)));
+    map.insert(QStringLiteral("backend"), backend_);
+    map.insert(QStringLiteral("cold"), cold_);
+    map.insert(QStringLiteral("chars"), chars_);
+    map.insert(QStringLiteral("frames_sent"), transport_.framesSent);
+    map.insert(QStringLiteral("bytes_sent"), transport_.bytesSent);
+    map.insert(QStringLiteral("frames_received"), transport_.framesReceived);
+    map.insert(QStringLiteral("bytes_received"), transport_.bytesReceived);
+    map.insert(QStringLiteral("peak_queue_ms"), transport_.peakQueuedMs);
+    map.insert(QStringLiteral("dropped_audio_ms"), transport_.droppedAudioMs);
+    return map;
+}
+
+QByteArray SessionTrace::toJsonLine() const {
+    return QJsonDocument(QJsonObject::fromVariantMap(toVariantMap()))
+        .toJson(QJsonDocument::Compact);
+}
+
+QByteArray SessionTrace::toPrometheus() const {
+    QByteArray out;
+    const auto line = [&out](const QByteArray &name, const QByteArray &labels, double value) {
+        out += name;
+        if (!labels.isEmpty()) out += '{' + labels + '}';
+        out += ' ' + QByteArray::number(value, 'g', 12) + '\n';
+    };
+    const auto header = [&out](const QByteArray &name, const QByteArray &help) {
+        out += "# HELP " + name + ' ' + help + "\n# TYPE " + name + " gauge\n";
+    };
+
+    const std::int64_t origin = has(Mark::KeyPress) ? marks_[static_cast<int>(Mark::KeyPress)]
+                                                    : marks_[static_cast<int>(Mark::Start)];
+    header("anytalk_session_mark_seconds",
+           "Milestones of the last session, from the key press (or start).");
+    for (int i = 0; i < kMarkCount; ++i) {
+        if (marks_[i] == 0) continue;
+        line("anytalk_session_mark_seconds", QByteArray("mark=\"") + kMarkNames[i] + '"',
+             static_cast<double>(marks_[i] - origin) / 1e6);
+    }
+    header("anytalk_session_frames", "WebSocket frames in the last session.");
+    line("anytalk_session_frames", "direction=\"sent\"",
+         static_cast<double>(transport_.framesSent));
+    line("anytalk_session_frames", "direction=\"received\"",
+         static_cast<double>(transport_.framesReceived));
+    header("anytalk_session_bytes", "WebSocket bytes in the last session.");
+    line("anytalk_session_bytes", "direction=\"sent\"", static_cast<double>(transport_.bytesSent));
+    line("anytalk_session_bytes", "direction=\"received\"",
+         static_cast<double>(transport_.bytesReceived));
+    header("anytalk_session_peak_queue_seconds", "Send-queue high point in the last session.");
+    line("anytalk_session_peak_queue_seconds", {}, transport_.peakQueuedMs / 1000.0);
+    header("anytalk_session_dropped_audio_seconds", "Audio that never went upstream.");
+    line("anytalk_session_dropped_audio_seconds", {},
+         static_cast<double>(transport_.droppedAudioMs) / 1000.0);
+    header("anytalk_session_committed_chars", "Characters committed by the last session.");
+    line("anytalk_session_committed_chars", {}, chars_);
+    header("anytalk_session_info", "Backend and outcome of the last session.");
+    QByteArray backend = backend_.toUtf8();
+    backend.replace('\\', "\\\\").replace('"', "\\\"");
+    line("anytalk_session_info",
+         "backend=\"" + backend + "\",outcome=\"" + outcomeName(outcome_) + "\",cold=\"" +
+             (cold_ ? "1" : "0") + '"',
+         1);
+    header("anytalk_session_timestamp_seconds", "When the last session started.");
+    line("anytalk_session_timestamp_seconds", {},
+         static_cast<double>(startedAt_.toMSecsSinceEpoch()) / 1000.0);
+    return out;
+}
+
+void SessionStatsSink::configure(const QString &jsonlPath, const QString &textfilePath) {
+    jsonlPath_ = jsonlPath;
+    textfilePath_ = textfilePath;
+}
+
+void SessionStatsSink::record(const SessionTrace &trace) {
+    if (!jsonlPath_.isEmpty()) {
+        QDir().mkpath(QFileInfo(jsonlPath_).absolutePath());
+        QFile f(jsonlPath_);
+        // One write() per line on an O_APPEND file: an old and a new
+        // overlay overlapping on a restart can't interleave lines.
+        if (f.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+            f.write(trace.toJsonLine() + '\n');
+        } else {
+            qWarning().noquote() << "SessionStatsSink: cannot append to" << jsonlPath_ << "—"
+                                 << f.errorString();
+        }
+    }
+    if (!textfilePath_.isEmpty()) {
+        QDir().mkpath(QFileInfo(textfilePath_).absolutePath());
+        // Rename into place so the collector never scrapes half a file.
+        QSaveFile f(textfilePath_);
+        if (!f.open(QIODevice::WriteOnly) || f.write(trace.toPrometheus()) < 0 || !f.commit()) {
+            qWarning().noquote() << "SessionStatsSink: cannot write" << textfilePath_ << "—"
+                                 << f.errorString();
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "asr/AsrBackend.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QVariantMap>
+
+#include <array>
+#include <cstdint>
+
+/// Latency trace of one session, F2 to Acknowledge, plus the backend's
+/// transport counters. AsrController fills it in; main() exports it.
+///
+/// Marks are CLOCK_MONOTONIC microseconds, the same clock the fcitx5 addon
+/// stamps its key event with (ToggleRecordingAt / peer 'T' payload), so
+/// the trace spans both processes. Exported times are milliseconds from
+/// the key press, or from Start when the session wasn't started by a
+/// stamped key (Enter, D-Bus clients). ProcessStart is only set on a
+/// process's first session — the cold-start case.
+class SessionTrace {
+public:
+    enum class Mark {
+        KeyPress,      // addon saw F2
+        ProcessStart,  // main() entered
+        Start,         // AsrController::startRecording
+        AudioOpen,     // capture stream open (pa_simple_new returned)
+        WarmedUp,      // first non-silent chunk
+        Connected,     // backend ready (WebSocket handshake done)
+        FirstPartial,
+        Stop,          // stop requested (key press time when stamped)
+        LastFinal,
+        Commit,        // CommitText emitted
+        Ack,           // addon's Acknowledge
+    };
+    static constexpr int kMarkCount = static_cast<int>(Mark::Ack) + 1;
+
+    enum class Outcome { None, Commit, Empty, Cancelled, Error };
+
+    static std::int64_t nowUs();
+    /// Call first thing in main().
+    static void noteProcessStart();
+    static std::int64_t processStartUs();
+
+    /// New session; drops whatever was recorded before. `keyPressUs` 0 =
+    /// not started by a stamped key.
+    void begin(std::int64_t keyPressUs, const QString &backend);
+    bool active() const { return active_; }
+    /// First call wins; LastFinal keeps the latest.
+    void mark(Mark m, std::int64_t atUs = 0);
+    bool has(Mark m) const { return marks_[static_cast<int>(m)] != 0; }
+
+    void setTransport(const AsrTransportStats &stats) { transport_ = stats; }
+    void addCommittedChars(int chars) { chars_ += chars; }
+    void setOutcome(Outcome outcome) { outcome_ = outcome; }
+    Outcome outcome() const { return outcome_; }
+    /// Recorded and done with: later marks are ignored.
+    void close() { active_ = false; }
+
+    /// Flat key → value map: "<mark>_ms" (absent marks are left out),
+    /// outcome, backend, cold, chars, started_at and the transport counters.
+    /// Also the D-Bus GetLastSessionStats() reply.
+    QVariantMap toVariantMap() const;
+    /// toVariantMap() as one compact JSON line (no trailing newline).
+    QByteArray toJsonLine() const;
+    /// Prometheus text exposition of this session, for node_exporter's
+    /// textfile collector.
+    QByteArray toPrometheus() const;
+
+private:
+    std::array<std::int64_t, kMarkCount> marks_{};
+    bool active_ = false;
+    bool cold_ = false;
+    Outcome outcome_ = Outcome::None;
+    QString backend_;
+    QDateTime startedAt_;
+    AsrTransportStats transport_;
+    int chars_ = 0;
+};
+
+/// Where finished traces go: `[Overlay] StatsFile` gets one JSON line per
+/// session (append-only, never truncated), `[Overlay] StatsTextfile` is
+/// rewritten atomically with the last session's Prometheus metrics. Both
+/// off when unset. Writes are synchronous: a short-lived overlay exits
+/// right after the Acknowledge that closes the trace.
+class SessionStatsSink {
+public:
+    void configure(const QString &jsonlPath, const QString &textfilePath);
+    void record(const SessionTrace &trace);
+
+private:
+    QString jsonlPath_;
+    QString textfilePath_;
+};
@@ -89,6 +89,10 @@ SettingsDialog::SettingsDialog(OverlayConfig cfg, QWidget *parent)
     trimCheck_->setChecked(cfg_.removeTrailingPunctuation);
     form->addRow(QString(), trimCheck_);
 
+    residentCheck_ = new QCheckBox(QStringLiteral("常驻后台（F2 秒开，空闲后自动退出）"), this);
+    residentCheck_->setChecked(cfg_.resident);
+    form->addRow(QString(), residentCheck_);
+
     root->addLayout(form);
 
     auto *buttons = new QDialogButtonBox(QDialogButtonBox::Save | QDialogButtonBox::Cancel, this);
@@ -100,6 +104,7 @@ SettingsDialog::SettingsDialog(OverlayConfig cfg, QWidget *parent)
 void SettingsDialog::onAccept() {
     cfg_.backend = backendCombo_->currentData().toString();
     cfg_.removeTrailingPunctuation = trimCheck_->isChecked();
+    cfg_.resident = residentCheck_->isChecked();
     cfg_.backendOptions.insert(QStringLiteral("Volcengine/AppID"), appIdEdit_->text().trimmed());
     cfg_.backendOptions.insert(QStringLiteral("Volcengine/AccessToken"), tokenEdit_->text().trimmed());
     {
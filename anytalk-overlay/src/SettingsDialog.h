@@ -29,4 +29,5 @@ private:
     QLineEdit *tokenEdit_ = nullptr;
     QComboBox *volcModeCombo_ = nullptr;
     QCheckBox *trimCheck_ = nullptr;
+    QCheckBox *residentCheck_ = nullptr;
 };
@@ -0,0 +1,92 @@
+#include "StartupTrace.h"
+#include "SessionTrace.h"
+
+#include <QDebug>
+#include <QEvent>
+#include <QTimer>
+#include <QWidget>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace startup {
+
+namespace {
+
+struct Phase {
+    const char *name;
+    std::int64_t atUs;
+};
+
+bool gEnabled = false;
+bool gReported = false;
+std::vector<Phase> gPhases;
+
+// Nothing past this is startup any more; log what there is.
+constexpr int kReportFallbackMs = 10'000;
+
+class PaintWatcher : public QObject {
+public:
+    using QObject::QObject;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override {
+        if (event->type() == QEvent::Show) {
+            mark("window-shown");
+        } else if (event->type() == QEvent::Paint) {
+            mark("first-paint");
+            // After this paint has gone out, not before it.
+            QTimer::singleShot(0, []() { report(); });
+            watched->removeEventFilter(this);
+            deleteLater();
+        }
+        return false;
+    }
+};
+
+double ms(std::int64_t us) { return static_cast<double>(us) / 1000.0; }
+
+} // namespace
+
+void enable() {
+    if (gEnabled) return;
+    gEnabled = true;
+    gPhases.reserve(16);
+    QTimer::singleShot(kReportFallbackMs, []() { report(); });
+}
+
+bool enabled() { return gEnabled; }
+
+void mark(const char *phase) {
+    if (!gEnabled || gReported) return;
+    for (const Phase &p : gPhases) {
+        if (std::strcmp(p.name, phase) == 0) return;
+    }
+    gPhases.push_back({phase, SessionTrace::nowUs()});
+}
+
+void watch(QWidget *window) {
+    if (!gEnabled || gReported) return;
+    window->installEventFilter(new PaintWatcher(window));
+}
+
+void report() {
+    if (!gEnabled || gReported) return;
+    gReported = true;
+    const std::int64_t t0 = SessionTrace::processStartUs();
+    std::int64_t prev = t0;
+    qInfo().noquote() << "anytalk-overlay: startup trace (ms since main, +delta)";
+    for (const Phase &p : gPhases) {
+        qInfo().noquote() << QStringLiteral("  %1 %2  %3")
+                                 .arg(ms(p.atUs - t0), 8, 'f', 1)
+                                 .arg(QStringLiteral("+%1").arg(ms(p.atUs - prev), 0, 'f', 1),
+                                      -8)
+                                 .arg(QLatin1String(p.name));
+        prev = p.atUs;
+    }
+    gPhases.clear();
+    gPhases.shrink_to_fit();
+}
+
+} // namespace startup
@@ -0,0 +1,27 @@
+#pragma once
+
+class QWidget;
+
+/// `--trace-startup`: where a cold start's time goes, from main() to the
+/// overlay's first painted frame. Phases are CLOCK_MONOTONIC stamps
+/// (SessionTrace's clock) relative to SessionTrace::noteProcessStart().
+///
+/// Everything is a no-op until enable(). report() logs the breakdown once:
+/// on the first paint, or from the fallback timer when no session comes
+/// (resident start, --settings).
+namespace startup {
+
+void enable();
+bool enabled();
+
+/// Record `phase` now; the first call per phase wins. `phase` must be a
+/// string literal (kept by pointer).
+void mark(const char *phase);
+
+/// Mark "window-shown" and "first-paint" from `window`'s own events, then
+/// report().
+void watch(QWidget *window);
+
+void report();
+
+} // namespace startup
@@ -0,0 +1,44 @@
+#include "TranscriptBuffer.h"
+
+#include <algorithm>
+
+void TranscriptBuffer::append(const QString &segment) {
+    if (segment.isEmpty()) return;
+    segments_.append(segment);
+    size_ += segment.size();
+}
+
+void TranscriptBuffer::clear() {
+    segments_.clear();
+    size_ = 0;
+}
+
+QString TranscriptBuffer::text() const {
+    if (segments_.size() == 1) return segments_.first();  // shared, no copy
+    QString out;
+    out.reserve(size_);
+    for (const QString &s : segments_) out += s;
+    return out;
+}
+
+QString TranscriptBuffer::tail(qsizetype maxChars, const QString &suffix) const {
+    // Walk back to the segment the tail starts in.
+    qsizetype first = segments_.size();
+    qsizetype kept = 0;
+    while (first > 0 && kept < maxChars) kept += segments_.at(--first).size();
+
+    QString out;
+    out.reserve(std::min(kept, maxChars) + suffix.size());
+    for (qsizetype i = first; i < segments_.size(); ++i) {
+        const QString &s = segments_.at(i);
+        if (i == first && kept > maxChars) {
+            qsizetype from = kept - maxChars;
+            if (s.at(from).isLowSurrogate()) ++from;
+            out += QStringView(s).mid(from);
+        } else {
+            out += s;
+        }
+    }
+    out += suffix;
+    return out;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <QList>
+#include <QString>
+
+/// A session's final text, kept as the segments it arrived in rather than
+/// one growing concatenation. Each segment is the QString the backend's
+/// final_() carried, so AsrController, the window and the D-Bus layer
+/// hold one (implicitly shared) copy of it between them; only text()
+/// builds the whole, once, for the commit. A long dictation costs one
+/// allocation per segment, not a reallocating copy of everything so far.
+class TranscriptBuffer {
+public:
+    void append(const QString &segment);
+    void clear();
+
+    bool isEmpty() const { return size_ == 0; }
+    /// UTF-16 code units, as QString::size().
+    qsizetype size() const { return size_; }
+
+    /// Everything, joined.
+    QString text() const;
+    /// The last `maxChars` code units (never half a surrogate pair) with
+    /// `suffix` appended: for a view that only shows the end. Builds
+    /// nothing from the segments before them.
+    QString tail(qsizetype maxChars, const QString &suffix = {}) const;
+
+private:
+    QList<QString> segments_;
+    qsizetype size_ = 0;
+};
@@ -3,6 +3,18 @@
 #include <QObject>
 #include <QString>
 
+/// Transport counters for one session, for SessionTrace. Frames are what
+/// went over the wire (protocol frames, not capture chunks); bytes include
+/// framing.
+struct AsrTransportStats {
+    qint64 framesSent = 0;
+    qint64 bytesSent = 0;
+    qint64 framesReceived = 0;
+    qint64 bytesReceived = 0;
+    int peakQueuedMs = 0;         // send-queue high point
+    qint64 droppedAudioMs = 0;    // audio that never went out (buffer caps)
+};
+
 /// Abstract ASR engine. Concrete backends (Volcengine, OpenAI, local
 /// whisper.cpp, …) implement this. AsrController owns one instance, drives
 /// it from AudioCapture, and forwards its signals to the rest of the app.
@@ -10,6 +22,7 @@
 /// Lifecycle invariants:
 ///   start() → 0+ pushPcm() → stop()  (final) emitted, then idle
 ///   start() → 0+ pushPcm() → cancel()  (no final emitted)
+///   submitBuffer()  → (final) emitted, then idle; cancel() as above
 ///   error()  may fire at any time; backend transitions back to idle.
 class AsrBackend : public QObject {
     Q_OBJECT
@@ -30,6 +43,24 @@ public:
     /// Discard the in-flight session without producing a final.
     virtual void cancel() = 0;
 
+    /// Recognise pre-recorded PCM (16 kHz mono S16LE) as one session, with
+    /// no live clock behind it: backends with an uplink push it as fast as
+    /// the server takes it. Same signals as start() … stop(); stop() has
+    /// nothing left to do. Default: exactly that sequence, all at once.
+    virtual void submitBuffer(const QByteArray &pcm) {
+        start();
+        pushPcm(pcm);
+        stop();
+    }
+
+    /// Hint that a session is likely soon: backends with a connect step may
+    /// open it ahead of start(). Never emits anything. Default: no-op.
+    virtual void prewarm() {}
+
+    /// Counters for the session in progress or, once idle, the last one;
+    /// start() resets them. Backends without a transport report zeros.
+    virtual AsrTransportStats transportStats() const { return {}; }
+
 signals:
     /// Streaming partial transcript. Backends without partial support never emit.
     void partial(const QString &text);
@@ -45,4 +76,8 @@ signals:
     /// the backend is idle. AsrController commits the accumulated text on
     /// receiving this. Mutually exclusive with error().
     void finished();
+    /// The uplink crossed its send-queue high (true) or low (false)
+    /// watermark. Backends without a send queue never emit. `queuedMs` is
+    /// the audio still waiting to go out at that moment.
+    void congestion(bool congested, int queuedMs);
 };
@@ -1,33 +1,183 @@
 #include "AsrBackendFactory.h"
+#include "BatchTranscriber.h"
+#include "BrokerBackend.h"
 #include "Config.h"
+#include "HedgedBackend.h"
 #include "VolcengineBackend.h"
+#ifdef ANYTALK_HAS_WHISPER
+#include "WhisperBackend.h"
+#endif
 
 #include <QDebug>
+#include <QDir>
+
+#include <algorithm>
+#include <optional>
 
 namespace asr {
 
-std::unique_ptr<AsrBackend> create(const OverlayConfig &cfg, QObject *parent) {
-    if (cfg.backend == QLatin1String("volcengine")) {
-        VolcengineBackend::Settings s;
-        s.appId = cfg.str(QStringLiteral("Volcengine"), QStringLiteral("AppID"));
-        s.accessToken = cfg.str(QStringLiteral("Volcengine"), QStringLiteral("AccessToken"));
-        const auto resourceId = cfg.str(QStringLiteral("Volcengine"),
-                                         QStringLiteral("ResourceId"));
-        if (!resourceId.isEmpty()) s.resourceId = resourceId;
-        const auto mode = cfg.str(QStringLiteral("Volcengine"), QStringLiteral("Mode"));
-        if (!mode.isEmpty()) s.mode = mode;
-        s.enableNonstream = cfg.boolean(QStringLiteral("Volcengine"),
-                                         QStringLiteral("EnableNonstream"), false);
-
-        if (s.appId.isEmpty() || s.accessToken.isEmpty()) {
-            qWarning() << "asr::create: Volcengine credentials missing — open SettingsDialog.";
-            return nullptr;
-        }
-        auto backend = std::make_unique<VolcengineBackend>(s, parent);
-        return backend;
-    }
-    qWarning() << "asr::create: unknown backend" << cfg.backend;
+namespace {
+
+// One backend's keys: its own section, with an optional override section
+// layered on top (the hedge leg's [Hedge]). Empty override = plain lookup.
+struct Keys {
+    const OverlayConfig &cfg;
+    QString section;
+    QString override;
+
+    QString str(const QString &key) const {
+        const QString base = cfg.str(section, key);
+        return override.isEmpty() ? base : cfg.str(override, key, base);
+    }
+    bool boolean(const QString &key, bool fallback) const {
+        const bool base = cfg.boolean(section, key, fallback);
+        return override.isEmpty() ? base : cfg.boolean(override, key, base);
+    }
+};
+
+std::optional<VolcengineBackend::Settings> volcengineSettings(const Keys &k, bool resident) {
+    VolcengineBackend::Settings s;
+    s.appId = k.str(QStringLiteral("AppID"));
+    s.accessToken = k.str(QStringLiteral("AccessToken"));
+    const auto resourceId = k.str(QStringLiteral("ResourceId"));
+    if (!resourceId.isEmpty()) s.resourceId = resourceId;
+    s.endpoint = k.str(QStringLiteral("Endpoint"));
+    while (s.endpoint.endsWith(QLatin1Char('/'))) s.endpoint.chop(1);
+    const auto mode = k.str(QStringLiteral("Mode"));
+    if (!mode.isEmpty()) s.mode = mode;
+    s.enableNonstream = k.boolean(QStringLiteral("EnableNonstream"), false);
+    // A spare socket only pays off if the process outlives the session,
+    // so default it on exactly when the overlay is resident.
+    s.spareConnections = k.boolean(QStringLiteral("SpareConnection"), resident) ? 1 : 0;
+    bool ok = false;
+    const int idleSec = k.str(QStringLiteral("SpareIdleSec")).toInt(&ok);
+    if (ok && idleSec > 0) s.spareMaxIdleMs = idleSec * 1000;
+    const int warmSec = k.str(QStringLiteral("SpareWarmSec")).toInt(&ok);
+    if (ok && warmSec >= 0) s.spareWarmWindowMs = warmSec * 1000;
+    const auto frameMs = k.str(QStringLiteral("FrameMs"));
+    if (frameMs == QLatin1String("adaptive")) {
+        s.adaptiveFrames = true;
+    } else if (const int ms = frameMs.toInt(&ok); ok && ms > 0) {
+        s.frameMs = ms;
+    }
+    const auto encoding = k.str(QStringLiteral("AudioEncoding"));
+    if (const auto e = volcengine::parseAudioEncoding(encoding)) {
+        s.audioEncoding = *e;
+    } else {
+        qWarning() << "asr::create: unknown AudioEncoding" << encoding << "— using pcm";
+    }
+    s.incrementalResults = k.str(QStringLiteral("ResultType")) == QLatin1String("single");
+
+    if (s.appId.isEmpty() || s.accessToken.isEmpty()) {
+        qWarning() << "asr::create: Volcengine credentials missing — open SettingsDialog.";
+        return std::nullopt;
+    }
+    return s;
+}
+
+std::unique_ptr<AsrBackend> createVolcengine(const Keys &k, bool resident, QObject *parent) {
+    const auto s = volcengineSettings(k, resident);
+    if (!s) return nullptr;
+    return std::make_unique<VolcengineBackend>(*s, parent);
+}
+
+std::unique_ptr<AsrBackend> createWhisper(const Keys &k, QObject *parent) {
+#ifdef ANYTALK_HAS_WHISPER
+    WhisperBackend::Settings s;
+    s.modelPath = k.str(QStringLiteral("Model"));
+    if (s.modelPath.startsWith(QLatin1String("~/"))) {
+        s.modelPath.replace(0, 1, QDir::homePath());
+    }
+    const auto language = k.str(QStringLiteral("Language"));
+    if (!language.isEmpty()) s.language = language;
+    bool ok = false;
+    const int threads = k.str(QStringLiteral("Threads")).toInt(&ok);
+    if (ok && threads > 0) s.threads = threads;
+    const int stepMs = k.str(QStringLiteral("StepMs")).toInt(&ok);
+    if (ok && stepMs > 0) s.stepMs = stepMs;
+    const int windowSec = k.str(QStringLiteral("WindowSec")).toInt(&ok);
+    if (ok && windowSec > 0) s.windowMs = windowSec * 1000;
+    s.useGpu = k.boolean(QStringLiteral("Gpu"), false);
+
+    if (s.modelPath.isEmpty()) {
+        qWarning() << "asr::create: [LocalWhisper] Model not set.";
+        return nullptr;
+    }
+    return std::make_unique<WhisperBackend>(s, parent);
+#else
+    (void)k;
+    (void)parent;
+    qWarning() << "asr::create: built without whisper.cpp — local-whisper unavailable";
     return nullptr;
+#endif
+}
+
+std::unique_ptr<AsrBackend> createBroker(const Keys &k, QObject *parent) {
+    BrokerBackend::Settings s;
+    const auto socket = k.str(QStringLiteral("Socket"));
+    if (!socket.isEmpty()) s.socketPath = socket;
+    return std::make_unique<BrokerBackend>(s, parent);
+}
+
+std::unique_ptr<AsrBackend> createNamed(const OverlayConfig &cfg, const QString &name,
+                                        const QString &override, QObject *parent) {
+    if (name == QLatin1String("volcengine")) {
+        // The addon's Prewarm() starts a short-lived overlay ahead of the
+        // session too, and a spare is what it is there to open.
+        const bool outlivesStart =
+            cfg.resident ||
+            !cfg.str(QStringLiteral("Addon"), QStringLiteral("PrewarmPrograms")).isEmpty();
+        return createVolcengine({cfg, QStringLiteral("Volcengine"), override}, outlivesStart,
+                                parent);
+    }
+    if (name == QLatin1String("local-whisper")) {
+        return createWhisper({cfg, QStringLiteral("LocalWhisper"), override}, parent);
+    }
+    if (name == QLatin1String("broker")) {
+        return createBroker({cfg, QStringLiteral("Broker"), override}, parent);
+    }
+    qWarning() << "asr::create: unknown backend" << name;
+    return nullptr;
+}
+
+} // namespace
+
+std::unique_ptr<AsrBackend> create(const OverlayConfig &cfg, QObject *parent) {
+    const QString hedge = cfg.str(QStringLiteral("Asr"), QStringLiteral("Hedge"));
+    if (hedge.isEmpty()) return createNamed(cfg, cfg.backend, {}, parent);
+
+    auto primary = createNamed(cfg, cfg.backend, {}, nullptr);
+    if (!primary) return nullptr;
+    auto secondary = createNamed(cfg, hedge, QStringLiteral("Hedge"), nullptr);
+    if (!secondary) {
+        // A broken hedge shouldn't take the working primary down with it.
+        qWarning() << "asr::create: hedge backend" << hedge << "unavailable — not hedging";
+        primary->setParent(parent);
+        return primary;
+    }
+    bool ok = false;
+    const int delayMs = cfg.str(QStringLiteral("Asr"), QStringLiteral("HedgeDelayMs")).toInt(&ok);
+    return std::make_unique<HedgedBackend>(std::move(primary), std::move(secondary),
+                                           ok ? std::clamp(delayMs, 0, 10'000) : 1'500, parent);
+}
+
+std::unique_ptr<AsrBackend> createBatch(const OverlayConfig &cfg, QObject *parent) {
+    if (cfg.backend != QLatin1String("volcengine")) return nullptr;
+    const Keys k{cfg, QStringLiteral("Volcengine"), {}};
+    auto s = volcengineSettings(k, /*resident=*/false);
+    if (!s) return nullptr;
+    // Every piece is a one-off cold session; nothing to keep spares for.
+    s->spareConnections = 0;
+
+    BatchTranscriber::Settings b;
+    bool ok = false;
+    const int parallel = k.str(QStringLiteral("BatchParallel")).toInt(&ok);
+    if (ok) b.maxParallel = std::clamp(parallel, 1, 8);
+    const int pieceSec = k.str(QStringLiteral("BatchPieceSec")).toInt(&ok);
+    if (ok) b.pieceMs = std::clamp(pieceSec, 10, 600) * 1000;
+    b.maxPieceMs = 2 * b.pieceMs;
+    return std::make_unique<BatchTranscriber>(
+        [s = *s]() { return std::make_unique<VolcengineBackend>(s); }, b, parent);
 }
 
 } // namespace asr
@@ -8,6 +8,15 @@ class OverlayConfig;
 namespace asr {
 /// Creates the backend named in `cfg.backend`, configured from the matching
 /// section of `cfg`. Returns nullptr when the backend name is unknown or
-/// required credentials are missing.
+/// required credentials are missing. With `[Asr] Hedge` set, the result is
+/// a HedgedBackend racing it against that second backend, whose keys
+/// `[Hedge]` can override.
 std::unique_ptr<AsrBackend> create(const OverlayConfig &cfg, QObject *parent = nullptr);
+
+/// A BatchTranscriber for recorded audio (AsrBackend::submitBuffer):
+/// parallel cold sessions of `cfg.backend`, sized by `[Volcengine]
+/// BatchParallel` / `BatchPieceSec`. The hedge is not part of it. nullptr
+/// when the backend gains nothing from pieces (local whisper decodes on
+/// one model) or cannot be built — submitBuffer() it directly then.
+std::unique_ptr<AsrBackend> createBatch(const OverlayConfig &cfg, QObject *parent = nullptr);
 } // namespace asr
@@ -0,0 +1,311 @@
+#include "AsrResponseScanner.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace volcengine::scan {
+
+namespace {
+
+// Nesting cap for skipped values; well past anything the server sends and
+// keeps a hostile payload from exhausting the stack.
+constexpr int kMaxDepth = 64;
+
+class Cursor {
+public:
+    Cursor(const char *p, std::size_t n) : p_(p), end_(p + n) {}
+
+    bool atEnd() const { return p_ >= end_; }
+    char peek() const { return p_ < end_ ? *p_ : '\0'; }
+
+    void ws() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+    }
+
+    bool eat(char c) {
+        ws();
+        if (p_ < end_ && *p_ == c) {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    bool literal(const char *word) {
+        const std::size_t n = std::strlen(word);
+        if (static_cast<std::size_t>(end_ - p_) < n || std::memcmp(p_, word, n) != 0) return false;
+        p_ += n;
+        return true;
+    }
+
+    // Positioned after ws on the opening quote.
+    bool string(Span &out) {
+        ws();
+        if (peek() != '"') return false;
+        ++p_;
+        const char *start = p_;
+        bool escaped = false;
+        while (p_ < end_) {
+            const char c = *p_;
+            if (c == '"') {
+                out = {start, static_cast<std::size_t>(p_ - start), escaped, true};
+                ++p_;
+                return true;
+            }
+            if (c == '\\') {
+                escaped = true;
+                if (++p_ >= end_) return false;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                return false;
+            }
+            ++p_;
+        }
+        return false;
+    }
+
+    bool key(const char *name, const Span &k) const {
+        const std::size_t n = std::strlen(name);
+        return !k.escaped && k.size == n && std::memcmp(k.data, name, n) == 0;
+    }
+
+    bool boolean(bool &out) {
+        ws();
+        if (literal("true")) {
+            out = true;
+            return true;
+        }
+        if (literal("false")) {
+            out = false;
+            return true;
+        }
+        return false;
+    }
+
+    // Integers directly; anything with a fraction / exponent through strtod
+    // (QJsonValue::toVariant().toLongLong() truncates the same way).
+    bool number(std::int64_t &out) {
+        ws();
+        const char *start = p_;
+        bool neg = false;
+        if (peek() == '-') {
+            neg = true;
+            ++p_;
+        }
+        if (p_ >= end_ || *p_ < '0' || *p_ > '9') return false;
+        std::int64_t v = 0;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+            v = v * 10 + (*p_ - '0');
+            ++p_;
+        }
+        if (p_ < end_ && (*p_ == '.' || *p_ == 'e' || *p_ == 'E')) {
+            while (p_ < end_ && (std::strchr("0123456789.eE+-", *p_) != nullptr)) ++p_;
+            const std::string tmp(start, static_cast<std::size_t>(p_ - start));
+            out = static_cast<std::int64_t>(std::strtod(tmp.c_str(), nullptr));
+            return true;
+        }
+        out = neg ? -v : v;
+        return true;
+    }
+
+    bool skipValue(int depth = 0) {
+        if (depth > kMaxDepth) return false;
+        ws();
+        Span dummy;
+        switch (peek()) {
+        case '"':
+            return string(dummy);
+        case '{':
+            ++p_;
+            if (eat('}')) return true;
+            do {
+                if (!string(dummy) || !eat(':') || !skipValue(depth + 1)) return false;
+            } while (eat(','));
+            return eat('}');
+        case '[':
+            ++p_;
+            if (eat(']')) return true;
+            do {
+                if (!skipValue(depth + 1)) return false;
+            } while (eat(','));
+            return eat(']');
+        case 't':
+            return literal("true");
+        case 'f':
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default: {
+            std::int64_t n;
+            return number(n);
+        }
+        }
+    }
+
+private:
+    const char *p_;
+    const char *end_;
+};
+
+bool scanUtterance(Cursor &c, std::int64_t committedEndTime, Result &out) {
+    if (!c.eat('{')) {
+        // Non-object entries are ignored, like the DOM walk does.
+        return c.skipValue();
+    }
+    Utterance u;
+    if (!c.eat('}')) {
+        do {
+            Span k;
+            if (!c.string(k) || !c.eat(':')) return false;
+            c.ws();
+            if (c.key("text", k) && c.peek() == '"') {
+                if (!c.string(u.text)) return false;
+            } else if (c.key("definite", k) && (c.peek() == 't' || c.peek() == 'f')) {
+                if (!c.boolean(u.definite)) return false;
+            } else if (c.key("end_time", k) && c.peek() != '"' && c.peek() != 'n') {
+                if (!c.number(u.endTime)) return false;
+            } else if (!c.skipValue(1)) {
+                return false;
+            }
+        } while (c.eat(','));
+        if (!c.eat('}')) return false;
+    }
+    // The committed-end_time filter runs here so definites the caller has
+    // already emitted never make it into the result.
+    if (u.definite && u.endTime <= committedEndTime) return true;
+    out.utterances.push_back(u);
+    return true;
+}
+
+bool scanResult(Cursor &c, std::int64_t committedEndTime, Result &out) {
+    out.hasResult = true;
+    if (c.eat('}')) return true;
+    do {
+        Span k;
+        if (!c.string(k) || !c.eat(':')) return false;
+        c.ws();
+        if (c.key("utterances", k) && c.peek() == '[') {
+            c.eat('[');
+            out.hasUtterances = true;
+            if (!c.eat(']')) {
+                do {
+                    if (!scanUtterance(c, committedEndTime, out)) return false;
+                } while (c.eat(','));
+                if (!c.eat(']')) return false;
+            }
+        } else if (c.key("text", k) && c.peek() == '"') {
+            if (!c.string(out.text)) return false;
+        } else if (!c.skipValue(1)) {
+            return false;
+        }
+    } while (c.eat(','));
+    return c.eat('}');
+}
+
+void appendUtf8(std::string &out, std::uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+bool hex4(const char *p, const char *end, std::uint32_t &out) {
+    if (end - p < 4) return false;
+    out = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = p[i];
+        out <<= 4;
+        if (c >= '0' && c <= '9') out |= static_cast<std::uint32_t>(c - '0');
+        else if (c >= 'a' && c <= 'f') out |= static_cast<std::uint32_t>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') out |= static_cast<std::uint32_t>(c - 'A' + 10);
+        else return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool scanResponse(const char *json, std::size_t size, std::int64_t committedEndTime,
+                  Result &out) {
+    out.clear();
+    Cursor c(json, size);
+    if (!c.eat('{')) return false;
+    if (c.eat('}')) return true;
+    do {
+        Span k;
+        if (!c.string(k) || !c.eat(':')) return false;
+        c.ws();
+        if (c.key("result", k) && c.peek() == '{' && !out.hasResult) {
+            c.eat('{');
+            if (!scanResult(c, committedEndTime, out)) return false;
+        } else if (!c.skipValue(1)) {
+            return false;
+        }
+    } while (c.eat(','));
+    if (!c.eat('}')) return false;
+    c.ws();
+    return c.atEnd();
+}
+
+std::string decode(const Span &s) {
+    if (!s.escaped) return std::string(s.data, s.size);
+    std::string out;
+    out.reserve(s.size);
+    const char *p = s.data;
+    const char *end = s.data + s.size;
+    while (p < end) {
+        if (*p != '\\') {
+            out += *p++;
+            continue;
+        }
+        if (++p >= end) break;
+        const char e = *p++;
+        switch (e) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            std::uint32_t cp = 0;
+            if (!hex4(p, end, cp)) {
+                appendUtf8(out, 0xFFFD);
+                break;
+            }
+            p += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                std::uint32_t lo = 0;
+                if (end - p >= 6 && p[0] == '\\' && p[1] == 'u' && hex4(p + 2, end, lo) &&
+                    lo >= 0xDC00 && lo <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    p += 6;
+                } else {
+                    cp = 0xFFFD;
+                }
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                cp = 0xFFFD;
+            }
+            appendUtf8(out, cp);
+            break;
+        }
+        default:
+            appendUtf8(out, 0xFFFD);
+        }
+    }
+    return out;
+}
+
+} // namespace volcengine::scan
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace volcengine {
+
+/// Single-pass scanner for the ASR response JSON, pulling out only what
+/// parseAsrResponse() uses: result.text and, per utterance, `definite`,
+/// `end_time` and `text`. Everything else (words, additions, audio_info…)
+/// is skipped without being decoded.
+///
+/// Strings come back as spans into the input; decode() is only paid for
+/// the ones the caller actually keeps. Plain C++, no Qt.
+namespace scan {
+
+struct Span {
+    const char *data = nullptr;  // between the quotes, still escaped
+    std::size_t size = 0;
+    bool escaped = false;        // contains a backslash — needs decode()
+    bool present = false;
+};
+
+struct Utterance {
+    Span text;
+    bool definite = false;
+    std::int64_t endTime = 0;
+};
+
+struct Result {
+    bool hasResult = false;      // "result" is an object
+    bool hasUtterances = false;  // result.utterances is an array
+    Span text;                   // result.text
+    /// Non-definite utterances, plus definite ones past the caller's
+    /// committed end_time — in array order. Older definites are skipped.
+    std::vector<Utterance> utterances;
+
+    void clear() {
+        hasResult = hasUtterances = false;
+        text = {};
+        utterances.clear();  // keeps capacity across messages
+    }
+};
+
+/// Scan `json`; `committedEndTime` filters out already-committed definite
+/// utterances. Returns false on malformed input or unexpected types for
+/// the fields above, so the caller can fall back to a DOM parser.
+bool scanResponse(const char *json, std::size_t size, std::int64_t committedEndTime,
+                  Result &out);
+
+/// Unescape a span to UTF-8 (\uXXXX surrogate pairs included). Invalid
+/// escapes decode to U+FFFD rather than failing.
+std::string decode(const Span &s);
+
+} // namespace scan
+} // namespace volcengine
@@ -0,0 +1,268 @@
+#include "AudioEncoder.h"
+
+#include <QDebug>
+#include <QRandomGenerator>
+#include <QtEndian>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <zlib.h>
+
+#ifdef ANYTALK_HAS_OPUS
+#include <opus.h>
+#endif
+
+namespace volcengine {
+
+std::optional<AudioEncoding> parseAudioEncoding(const QString &name) {
+    const auto n = name.trimmed().toLower();
+    if (n.isEmpty() || n == QLatin1String("pcm")) return AudioEncoding::Pcm;
+    if (n == QLatin1String("gzip")) return AudioEncoding::Gzip;
+    if (n == QLatin1String("opus")) return AudioEncoding::Opus;
+    return std::nullopt;
+}
+
+namespace {
+
+// Each frame is compressed on its own (the server inflates frame by frame),
+// but the z_stream is kept and deflateReset() between frames so the ~256 KB
+// of zlib state is allocated once per session, not per 40 ms chunk.
+class GzipEncoder final : public AudioEncoder {
+public:
+    GzipEncoder() {
+        // windowBits 15 + 16 → gzip wrapper. Level 1: speech PCM barely
+        // compresses better at higher levels, and this runs per chunk.
+        ok_ = deflateInit2(&zs_, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8,
+                           Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~GzipEncoder() override {
+        if (ok_) deflateEnd(&zs_);
+    }
+
+    bool ok() const { return ok_; }
+    AudioEncoding encoding() const override { return AudioEncoding::Gzip; }
+    QString format() const override { return QStringLiteral("pcm"); }
+    bool gzipFramed() const override { return true; }
+
+    void encode(const char *pcm, int bytes, QByteArray &out) override {
+        deflateReset(&zs_);
+        out.resize(static_cast<qsizetype>(deflateBound(&zs_, static_cast<uLong>(bytes))));
+        zs_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(pcm));
+        zs_.avail_in = static_cast<uInt>(bytes);
+        zs_.next_out = reinterpret_cast<Bytef *>(out.data());
+        zs_.avail_out = static_cast<uInt>(out.size());
+        // deflateBound guarantees a single Z_FINISH call completes.
+        deflate(&zs_, Z_FINISH);
+        out.resize(static_cast<qsizetype>(zs_.total_out));
+    }
+    // Gzip holds nothing back; the LAST frame is an empty gzip member.
+    void finish(QByteArray &out) override { encode(nullptr, 0, out); }
+    void reset() override {}
+
+private:
+    z_stream zs_{};
+    bool ok_ = false;
+};
+
+#ifdef ANYTALK_HAS_OPUS
+
+// Ogg page CRC: polynomial 0x04c11db7, MSB-first, zero init, no final xor.
+constexpr std::array<quint32, 256> makeOggCrcTable() {
+    std::array<quint32, 256> t{};
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 r = i << 24;
+        for (int k = 0; k < 8; ++k) r = (r & 0x80000000u) ? (r << 1) ^ 0x04c11db7u : (r << 1);
+        t[i] = r;
+    }
+    return t;
+}
+constexpr auto kOggCrc = makeOggCrcTable();
+
+quint32 oggCrc(const char *data, qsizetype n) {
+    quint32 crc = 0;
+    for (qsizetype i = 0; i < n; ++i) {
+        crc = (crc << 8) ^ kOggCrc[((crc >> 24) ^ static_cast<quint8>(data[i])) & 0xFF];
+    }
+    return crc;
+}
+
+// Ogg/Opus (RFC 7845) written by hand — one page per audio_only frame, so
+// the server can demux every frame as it arrives. libogg would only save
+// the ~40 lines below.
+class OggOpusEncoder final : public AudioEncoder {
+public:
+    OggOpusEncoder() {
+        int err = OPUS_OK;
+        enc_ = opus_encoder_create(kRate, 1, OPUS_APPLICATION_VOIP, &err);
+        if (err != OPUS_OK || !enc_) {
+            enc_ = nullptr;
+            return;
+        }
+        // 32 kbit/s wideband keeps recognition accuracy on par with raw PCM
+        // while cutting upstream ~8x.
+        opus_encoder_ctl(enc_, OPUS_SET_BITRATE(32000));
+        opus_encoder_ctl(enc_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+        opus_encoder_ctl(enc_, OPUS_SET_COMPLEXITY(5));
+        opus_int32 lookahead = 0;
+        opus_encoder_ctl(enc_, OPUS_GET_LOOKAHEAD(&lookahead));
+        preSkip48k_ = static_cast<quint16>(lookahead * (48000 / kRate));
+        reset();
+    }
+    ~OggOpusEncoder() override {
+        if (enc_) opus_encoder_destroy(enc_);
+    }
+
+    bool ok() const { return enc_ != nullptr; }
+    AudioEncoding encoding() const override { return AudioEncoding::Opus; }
+    QString format() const override { return QStringLiteral("ogg"); }
+    QString codec() const override { return QStringLiteral("opus"); }
+
+    void encode(const char *pcm, int bytes, QByteArray &out) override {
+        out.resize(0);
+        writeHeadersOnce(out);
+        tail_.append(pcm, bytes);
+        qsizetype off = 0;
+        for (; tail_.size() - off >= kFrameBytes; off += kFrameBytes) {
+            encodeFrame(tail_.constData() + off);
+        }
+        tail_.remove(0, off);
+        if (!packets_.empty()) writePage(out, 0);
+    }
+
+    void finish(QByteArray &out) override {
+        out.resize(0);
+        writeHeadersOnce(out);
+        if (!tail_.isEmpty()) {
+            tail_.append(QByteArray(kFrameBytes - tail_.size(), '\0'));
+            encodeFrame(tail_.constData());
+            tail_.clear();
+        }
+        writePage(out, kEos);  // zero segments is a valid EOS page
+    }
+
+    void reset() override {
+        if (enc_) opus_encoder_ctl(enc_, OPUS_RESET_STATE);
+        serial_ = QRandomGenerator::global()->generate();
+        pageSeq_ = 0;
+        granule_ = 0;
+        headersSent_ = false;
+        tail_.clear();
+        packets_.clear();
+    }
+
+private:
+    static constexpr int kRate = 16000;
+    static constexpr int kFrameSamples = kRate / 50;      // 20 ms
+    static constexpr int kFrameBytes = kFrameSamples * 2;
+    static constexpr quint8 kBos = 0x02;
+    static constexpr quint8 kEos = 0x04;
+
+    void encodeFrame(const char *pcm) {
+        unsigned char pkt[1275];  // max Opus packet
+        const int n = opus_encode(enc_, reinterpret_cast<const opus_int16 *>(pcm),
+                                  kFrameSamples, pkt, sizeof pkt);
+        if (n < 0) {
+            qWarning() << "OpusEncoder: opus_encode failed:" << opus_strerror(n);
+            return;
+        }
+        packets_.emplace_back(reinterpret_cast<const char *>(pkt), n);
+        granule_ += kFrameSamples * (48000 / kRate);  // granule is always 48 kHz
+    }
+
+    void writeHeadersOnce(QByteArray &out) {
+        if (headersSent_) return;
+        headersSent_ = true;
+
+        QByteArray head("OpusHead", 8);
+        head.append(char(1));  // version
+        head.append(char(1));  // channels
+        char le[4];
+        qToLittleEndian(preSkip48k_, le);
+        head.append(le, 2);
+        qToLittleEndian(static_cast<quint32>(kRate), le);
+        head.append(le, 4);
+        head.append(2, '\0');  // output gain
+        head.append(char(0));  // mapping family
+        packets_.push_back(head);
+        writePage(out, kBos, /*granule=*/0);
+
+        QByteArray tags("OpusTags", 8);
+        const QByteArray vendor("anytalk");
+        qToLittleEndian(static_cast<quint32>(vendor.size()), le);
+        tags.append(le, 4).append(vendor);
+        tags.append(4, '\0');  // no user comments
+        packets_.push_back(tags);
+        writePage(out, 0, /*granule=*/0);
+    }
+
+    // Append one page holding every queued packet. Pages are capped at 255
+    // lacing values; a 200 ms frame is ten packets, far below that.
+    void writePage(QByteArray &out, quint8 headerType, std::optional<qint64> granule = {}) {
+        QByteArray lacing;
+        qsizetype bodyBytes = 0;
+        for (const auto &p : packets_) {
+            qsizetype n = p.size();
+            for (; n >= 255; n -= 255) lacing.append(char(255));
+            lacing.append(char(n));
+            bodyBytes += p.size();
+        }
+        const qsizetype start = out.size();
+        out.reserve(start + 27 + lacing.size() + bodyBytes);
+        char hdr[27];
+        std::memcpy(hdr, "OggS", 4);
+        hdr[4] = 0;  // stream structure version
+        hdr[5] = static_cast<char>(headerType);
+        qToLittleEndian(static_cast<quint64>(granule.value_or(granule_)), hdr + 6);
+        qToLittleEndian(serial_, hdr + 14);
+        qToLittleEndian(pageSeq_++, hdr + 18);
+        qToLittleEndian(quint32(0), hdr + 22);  // CRC, filled below
+        hdr[26] = static_cast<char>(lacing.size());
+        out.append(hdr, sizeof hdr).append(lacing);
+        for (const auto &p : packets_) out.append(p);
+        packets_.clear();
+
+        const quint32 crc = oggCrc(out.constData() + start, out.size() - start);
+        qToLittleEndian(crc, out.data() + start + 22);
+    }
+
+    OpusEncoder *enc_ = nullptr;  // libopus
+    quint16 preSkip48k_ = 0;
+    quint32 serial_ = 0;
+    quint32 pageSeq_ = 0;
+    qint64 granule_ = 0;
+    bool headersSent_ = false;
+    QByteArray tail_;                  // PCM short of a 20 ms frame
+    std::vector<QByteArray> packets_;  // encoded, not yet paged
+};
+
+#endif // ANYTALK_HAS_OPUS
+
+} // namespace
+
+std::unique_ptr<AudioEncoder> createAudioEncoder(AudioEncoding encoding) {
+    switch (encoding) {
+    case AudioEncoding::Pcm:
+        return nullptr;
+    case AudioEncoding::Gzip: {
+        auto e = std::make_unique<GzipEncoder>();
+        if (e->ok()) return e;
+        qWarning() << "createAudioEncoder: deflateInit2 failed — sending raw PCM";
+        return nullptr;
+    }
+    case AudioEncoding::Opus: {
+#ifdef ANYTALK_HAS_OPUS
+        auto e = std::make_unique<OggOpusEncoder>();
+        if (e->ok()) return e;
+        qWarning() << "createAudioEncoder: opus_encoder_create failed — sending raw PCM";
+#else
+        qWarning() << "createAudioEncoder: built without libopus — sending raw PCM";
+#endif
+        return nullptr;
+    }
+    }
+    return nullptr;
+}
+
+} // namespace volcengine
@@ -0,0 +1,49 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <memory>
+#include <optional>
+
+namespace volcengine {
+
+/// Upload encoding for audio_only payloads — `[Volcengine] AudioEncoding`.
+///   pcm   raw 16 kHz S16LE (256 kbit/s), zero extra work on the hot path
+///   gzip  raw PCM per frame, gzip-compressed with the protocol's flag
+///   opus  Ogg/Opus at ~32 kbit/s (only when built with libopus)
+enum class AudioEncoding { Pcm, Gzip, Opus };
+
+std::optional<AudioEncoding> parseAudioEncoding(const QString &name);
+
+/// Encoder stage between capture and the audio_only frames. Input is always
+/// the capture format (16 kHz S16LE mono); what comes out, and what the
+/// FULL_CLIENT_REQUEST has to announce for it, depends on the encoding.
+///
+/// Stateful across one stream: reset() before each new session — including
+/// the cold retry after a dead spare, which replays the audio from scratch.
+class AudioEncoder {
+public:
+    virtual ~AudioEncoder() = default;
+
+    virtual AudioEncoding encoding() const = 0;
+    /// `audio.format` / `audio.codec` of the initial request JSON.
+    virtual QString format() const = 0;
+    virtual QString codec() const { return QStringLiteral("raw"); }
+    /// Whether audio_only headers carry the gzip compression flag.
+    virtual bool gzipFramed() const { return false; }
+
+    /// Replace `out` with the payload for the next audio_only frame. May be
+    /// empty when the input does not complete a codec frame yet; the tail is
+    /// held back for the next call or finish().
+    virtual void encode(const char *pcm, int bytes, QByteArray &out) = 0;
+    /// Replace `out` with the payload of the LAST frame: anything held back
+    /// plus the stream trailer, if the format has one.
+    virtual void finish(QByteArray &out) = 0;
+    virtual void reset() = 0;
+};
+
+/// nullptr for Pcm — raw audio needs no stage. Also nullptr, with a warning,
+/// when the requested encoder is not compiled in or fails to initialise, so
+/// callers fall back to raw PCM rather than failing the session.
+std::unique_ptr<AudioEncoder> createAudioEncoder(AudioEncoding encoding);
+
+} // namespace volcengine
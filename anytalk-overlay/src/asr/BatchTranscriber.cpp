@@ -0,0 +1,199 @@
+#include "BatchTranscriber.h"
+#include "audio/VoiceActivityDetector.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int kSampleRate = 16000;
+constexpr int kPcmBytesPerMs = kSampleRate * 2 / 1000;  // S16LE mono
+constexpr int kChunkBytes = 40 * kPcmBytesPerMs;         // VAD granularity
+} // namespace
+
+BatchTranscriber::BatchTranscriber(Factory factory, Settings settings, QObject *parent)
+    : AsrBackend(parent), factory_(std::move(factory)), settings_(settings) {
+    settings_.maxParallel = std::max(settings_.maxParallel, 1);
+    settings_.maxPieceMs = std::max(settings_.maxPieceMs, settings_.pieceMs);
+}
+
+BatchTranscriber::~BatchTranscriber() {
+    // Pieces still running go with this object; nothing they report on the
+    // way out may reach it.
+    for (auto &p : pieces_) {
+        if (p.backend) p.backend->disconnect(this);
+    }
+}
+
+std::vector<qsizetype> BatchTranscriber::cutPoints(const QByteArray &pcm,
+                                                   const Settings &settings) {
+    std::vector<qsizetype> cuts;
+    const qsizetype pieceBytes = qsizetype(settings.pieceMs) * kPcmBytesPerMs;
+    const qsizetype maxBytes = qsizetype(std::max(settings.maxPieceMs, settings.pieceMs)) *
+                               kPcmBytesPerMs;
+    if (pieceBytes <= 0 || pcm.size() <= pieceBytes) return cuts;
+
+    // The capture-side gate, run offline: once its hangover has run out
+    // the speaker has been quiet for pauseMs, and a cut there splits no
+    // word.
+    VoiceActivityDetector::Settings vs;
+    vs.enabled = true;
+    vs.hangoverMs = settings.pauseMs;
+    VoiceActivityDetector vad(vs, kChunkBytes, kSampleRate);
+
+    qsizetype pieceStart = 0;
+    for (qsizetype at = 0; at + kChunkBytes <= pcm.size(); at += kChunkBytes) {
+        vad.feed(pcm.constData() + at, kChunkBytes);
+        const qsizetype cut = at + kChunkBytes;
+        const qsizetype len = cut - pieceStart;
+        // Not worth a session of its own: leave a short tail on this piece.
+        if (pcm.size() - cut < qsizetype(settings.pauseMs) * kPcmBytesPerMs) break;
+        if ((len >= pieceBytes && !vad.inSpeech()) || len >= maxBytes) {
+            cuts.push_back(cut);
+            pieceStart = cut;
+        }
+    }
+    return cuts;
+}
+
+void BatchTranscriber::start() {
+    if (active_ || collecting_) return;
+    collecting_ = true;
+    pcm_.clear();
+}
+
+void BatchTranscriber::pushPcm(const QByteArray &chunk) {
+    if (collecting_) pcm_.append(chunk);
+}
+
+void BatchTranscriber::stop() {
+    if (!collecting_) return;
+    collecting_ = false;
+    const QByteArray pcm = std::exchange(pcm_, {});
+    submitBuffer(pcm);
+}
+
+void BatchTranscriber::cancel() {
+    collecting_ = false;
+    pcm_.clear();
+    if (active_) abort();
+}
+
+void BatchTranscriber::submitBuffer(const QByteArray &pcm) {
+    if (active_) return;
+    collecting_ = false;
+    pcm_ = pcm;
+    pieces_.clear();
+    qsizetype begin = 0;
+    for (const qsizetype cut : cutPoints(pcm_, settings_)) {
+        pieces_.push_back({begin, cut, {}, {}, false, {}});
+        begin = cut;
+    }
+    pieces_.push_back({begin, pcm_.size(), {}, {}, false, {}});
+    if (pieces_.size() > 1) {
+        qInfo() << "BatchTranscriber:" << pcm_.size() / kPcmBytesPerMs << "ms in"
+                << pieces_.size() << "pieces," << settings_.maxParallel << "at a time";
+    }
+    active_ = true;
+    connectedSent_ = false;
+    nextLaunch_ = nextEmit_ = 0;
+    running_ = 0;
+    launch();
+}
+
+void BatchTranscriber::launch() {
+    // A backend may report back from inside submitBuffer(); every pass
+    // re-checks what that left behind.
+    while (active_ && running_ < settings_.maxParallel && nextLaunch_ < pieces_.size()) {
+        const std::size_t i = nextLaunch_++;
+        Piece &p = pieces_[i];
+        p.backend = factory_();
+        if (!p.backend) {
+            onPieceError(i, QStringLiteral("batch: backend unavailable"));
+            return;
+        }
+        AsrBackend *b = p.backend.get();
+        connect(b, &AsrBackend::connected, this, [this, i]() { onPieceConnected(i); });
+        connect(b, &AsrBackend::final_, this, [this, i](const QString &t) {
+            if (active_) pieces_[i].finals.append(t);
+        });
+        connect(b, &AsrBackend::finished, this, [this, i]() { onPieceFinished(i); });
+        connect(b, &AsrBackend::error, this,
+                [this, i](const QString &m) { onPieceError(i, m); });
+        ++running_;
+        b->submitBuffer(pcm_.mid(p.begin, p.end - p.begin));
+    }
+}
+
+void BatchTranscriber::onPieceConnected(std::size_t) {
+    if (!active_ || connectedSent_) return;
+    connectedSent_ = true;
+    emit connected();
+}
+
+void BatchTranscriber::onPieceFinished(std::size_t i) {
+    if (!active_) return;
+    Piece &p = pieces_[i];
+    p.done = true;
+    release(p);
+    --running_;
+    emitReady();
+    launch();
+}
+
+void BatchTranscriber::onPieceError(std::size_t i, const QString &message) {
+    if (!active_) return;
+    qWarning().noquote() << "BatchTranscriber: piece" << i + 1 << "of" << pieces_.size()
+                         << "failed:" << message;
+    abort();
+    emit error(message);
+}
+
+void BatchTranscriber::release(Piece &p) {
+    if (!p.backend) return;
+    p.stats = p.backend->transportStats();
+    p.backend->disconnect(this);
+    p.backend.release()->deleteLater();
+}
+
+void BatchTranscriber::emitReady() {
+    while (active_ && nextEmit_ < pieces_.size() && pieces_[nextEmit_].done) {
+        const QStringList finals = std::exchange(pieces_[nextEmit_].finals, {});
+        ++nextEmit_;
+        for (const auto &f : finals) {
+            emit final_(f);
+            if (!active_) return;  // cancelled from a slot
+        }
+    }
+    if (!active_ || nextEmit_ < pieces_.size()) return;
+    active_ = false;
+    pcm_.clear();
+    emit finished();
+}
+
+void BatchTranscriber::abort() {
+    // Inactive first: a piece's cancel may report synchronously.
+    active_ = false;
+    for (auto &p : pieces_) {
+        if (!p.backend) continue;
+        p.backend->disconnect(this);
+        p.backend->cancel();
+        release(p);
+    }
+    running_ = 0;
+    pcm_.clear();
+}
+
+AsrTransportStats BatchTranscriber::transportStats() const {
+    AsrTransportStats sum;
+    for (const auto &p : pieces_) {
+        const AsrTransportStats s = p.backend ? p.backend->transportStats() : p.stats;
+        sum.framesSent += s.framesSent;
+        sum.bytesSent += s.bytesSent;
+        sum.framesReceived += s.framesReceived;
+        sum.bytesReceived += s.bytesReceived;
+        sum.peakQueuedMs = std::max(sum.peakQueuedMs, s.peakQueuedMs);
+        sum.droppedAudioMs += s.droppedAudioMs;
+    }
+    return sum;
+}
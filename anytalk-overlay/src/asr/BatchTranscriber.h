@@ -0,0 +1,85 @@
+#pragma once
+#include "AsrBackend.h"
+
+#include <QByteArray>
+#include <QStringList>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// Composite backend for pre-recorded audio: cuts a long buffer at pauses
+/// and recognises the pieces as parallel submitBuffer() sessions, each on
+/// a fresh backend from `factory`, then reports the finals in audio order.
+///
+/// One ten-minute session is bounded by one socket and the server's pace
+/// for one stream; ten one-minute pieces, four at a time, are back in the
+/// time of the slowest few. Cuts fall where VoiceActivityDetector sees a
+/// pause, so no word is split between two pieces; audio that never pauses
+/// long enough is cut hard at maxPieceMs.
+///
+///   connected()  once, when the first piece connects
+///   final_()     per piece in order, once every earlier piece is done
+///   finished()   after the last piece
+///   error()      from the first piece that fails; the rest are cancelled
+/// No partials. start() / pushPcm() / stop() collect the audio and submit
+/// it on stop(), so it can stand in wherever a backend is driven live.
+class BatchTranscriber : public AsrBackend {
+    Q_OBJECT
+public:
+    using Factory = std::function<std::unique_ptr<AsrBackend>()>;
+
+    struct Settings {
+        int maxParallel = 4;
+        int pieceMs = 60'000;      // cut at the first pause past this
+        int maxPieceMs = 120'000;  // cut regardless past this
+        int pauseMs = 500;         // silence that counts as a pause
+    };
+
+    BatchTranscriber(Factory factory, Settings settings, QObject *parent = nullptr);
+    ~BatchTranscriber() override;
+
+    void start() override;
+    void pushPcm(const QByteArray &chunk) override;
+    void stop() override;
+    void cancel() override;
+    void submitBuffer(const QByteArray &pcm) override;
+    /// Every piece's traffic summed.
+    AsrTransportStats transportStats() const override;
+
+    /// Where `pcm` is cut (byte offsets, ascending, excluding 0 and the
+    /// end). Empty when it fits in one piece.
+    static std::vector<qsizetype> cutPoints(const QByteArray &pcm, const Settings &settings);
+
+private:
+    struct Piece {
+        qsizetype begin = 0;
+        qsizetype end = 0;
+        std::unique_ptr<AsrBackend> backend;  // while it runs
+        QStringList finals;
+        bool done = false;
+        AsrTransportStats stats;  // taken when the backend goes
+    };
+
+    void launch();
+    void onPieceConnected(std::size_t i);
+    void onPieceFinished(std::size_t i);
+    void onPieceError(std::size_t i, const QString &message);
+    /// Keep the piece's counters, drop its backend (deferred: it may be
+    /// the sender of the signal being handled).
+    void release(Piece &p);
+    /// Finals of the done pieces at the head, and finished() after the last.
+    void emitReady();
+    void abort();
+
+    Factory factory_;
+    Settings settings_;
+    bool collecting_ = false;
+    bool active_ = false;
+    bool connectedSent_ = false;
+    QByteArray pcm_;
+    std::vector<Piece> pieces_;
+    std::size_t nextLaunch_ = 0;
+    std::size_t nextEmit_ = 0;
+    int running_ = 0;
+};
@@ -0,0 +1,151 @@
+#include "BrokerBackend.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <utility>
+
+BrokerBackend::BrokerBackend(Settings settings, QObject *parent)
+    : AsrBackend(parent), settings_(std::move(settings)) {
+    connect(&socket_, &QLocalSocket::connected, this, &BrokerBackend::onConnected);
+    connect(&socket_, &QLocalSocket::readyRead, this, &BrokerBackend::onReadyRead);
+    connect(&socket_, &QLocalSocket::disconnected, this, &BrokerBackend::onDisconnected);
+    connect(&socket_, &QLocalSocket::errorOccurred, this, &BrokerBackend::onSocketError);
+}
+
+BrokerBackend::~BrokerBackend() {
+    // Nothing the socket reports on the way out may reach this object.
+    socket_.disconnect(this);
+}
+
+void BrokerBackend::ensureConnected() {
+    if (socket_.state() != QLocalSocket::UnconnectedState) return;
+    reader_.clear();
+    socket_.connectToServer(settings_.socketPath);
+}
+
+void BrokerBackend::send(const QByteArray &frameBytes) {
+    if (socket_.state() == QLocalSocket::ConnectedState) {
+        socket_.write(frameBytes);
+    } else {
+        outbox_.append(frameBytes);
+        ensureConnected();
+    }
+}
+
+void BrokerBackend::start() {
+    if (active_) return;
+    active_ = true;
+    stats_ = {};
+    send(broker::frame(broker::kStart, broker::tagged(++session_)));
+}
+
+void BrokerBackend::pushPcm(const QByteArray &chunk) {
+    if (!active_ || chunk.isEmpty()) return;
+    send(broker::frame(broker::kAudio, chunk));
+}
+
+void BrokerBackend::stop() {
+    if (!active_) return;
+    send(broker::frame(broker::kStop));
+}
+
+void BrokerBackend::cancel() {
+    if (!active_) return;
+    active_ = false;
+    send(broker::frame(broker::kCancel));
+}
+
+void BrokerBackend::submitBuffer(const QByteArray &pcm) {
+    if (active_) return;
+    active_ = true;
+    stats_ = {};
+    ++session_;
+    for (qsizetype at = 0; at < pcm.size(); at += broker::kBufferPieceBytes) {
+        const qsizetype n = std::min<qsizetype>(broker::kBufferPieceBytes, pcm.size() - at);
+        send(broker::frame(broker::kBufferPiece, pcm.constData() + at, n));
+    }
+    send(broker::frame(broker::kBufferEnd, broker::tagged(session_)));
+}
+
+void BrokerBackend::prewarm() {
+    // Opens our socket and has the broker top up its own warm pool; the
+    // round trips are paid here, not on the first word.
+    send(broker::frame(broker::kPrewarm));
+}
+
+void BrokerBackend::onConnected() {
+    if (outbox_.isEmpty()) return;
+    socket_.write(std::exchange(outbox_, {}));
+}
+
+void BrokerBackend::onReadyRead() {
+    reader_.append(socket_.readAll());
+    char op = 0;
+    QByteArray payload;
+    while (reader_.next(op, payload)) {
+        handleFrame(op, payload);
+        if (socket_.state() != QLocalSocket::ConnectedState) return;
+    }
+    if (reader_.bad()) {
+        qWarning() << "BrokerBackend: malformed frame from" << settings_.socketPath;
+        socket_.abort();
+    }
+}
+
+void BrokerBackend::handleFrame(char op, const QByteArray &raw) {
+    // A cancelled session's late frames still arrive, possibly after the
+    // next session started; they carry its number and go nowhere.
+    QByteArray payload = raw;
+    quint32 seq = 0;
+    if (!broker::untag(payload, seq) || seq != session_) return;
+    switch (op) {
+    case broker::kConnected:
+        if (active_) emit connected();
+        break;
+    case broker::kPartial:
+        if (active_) emit partial(QString::fromUtf8(payload));
+        break;
+    case broker::kFinal:
+        if (active_) emit final_(QString::fromUtf8(payload));
+        break;
+    case broker::kCongestion: {
+        if (!active_) break;
+        const QList<QByteArray> parts = payload.split(' ');
+        emit congestion(parts.value(0) == "1", parts.value(1).toInt());
+        break;
+    }
+    case broker::kFinished:
+        stats_ = broker::decodeStats(payload);
+        if (!active_) break;
+        active_ = false;
+        emit finished();
+        break;
+    case broker::kError:
+        if (!active_) break;
+        active_ = false;
+        emit error(QString::fromUtf8(payload));
+        break;
+    default: break;
+    }
+}
+
+void BrokerBackend::onDisconnected() {
+    outbox_.clear();
+    if (active_) fail(QStringLiteral("识别服务连接中断（anytalk-broker）"));
+}
+
+void BrokerBackend::onSocketError(QLocalSocket::LocalSocketError err) {
+    if (err == QLocalSocket::PeerClosedError) return;  // onDisconnected has it
+    qWarning().noquote() << "BrokerBackend:" << settings_.socketPath << "—"
+                         << socket_.errorString();
+    outbox_.clear();
+    if (active_) {
+        fail(QStringLiteral("识别服务不可用（anytalk-broker）：%1").arg(socket_.errorString()));
+    }
+}
+
+void BrokerBackend::fail(const QString &message) {
+    active_ = false;
+    emit error(message);
+}
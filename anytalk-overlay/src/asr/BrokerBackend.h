@@ -0,0 +1,58 @@
+#pragma once
+#include "AsrBackend.h"
+#include "broker/BrokerProtocol.h"
+
+#include <QByteArray>
+#include <QLocalSocket>
+#include <QString>
+
+/// Backend that hands the session to anytalk-broker, the optional per-host
+/// recognition service ([Asr] Backend = broker). On a terminal server
+/// with many seats, each overlay keeps only its UI and capture; the
+/// broker holds the warm sockets, the TLS stack and any local model once
+/// for everyone. Frames: broker/BrokerProtocol.h.
+///
+/// The socket connects on prewarm() or start() and stays open between
+/// sessions. Frames written before it is up wait in an outbox. Losing
+/// the broker mid-session is an error(); idle, it's just reconnected next
+/// time.
+class BrokerBackend : public AsrBackend {
+    Q_OBJECT
+public:
+    struct Settings {
+        QString socketPath = QString::fromLatin1(broker::kDefaultSocket);
+    };
+
+    explicit BrokerBackend(Settings settings, QObject *parent = nullptr);
+    ~BrokerBackend() override;
+
+    void start() override;
+    void pushPcm(const QByteArray &chunk) override;
+    void stop() override;
+    void cancel() override;
+    /// Sent in pieces, recognised by the broker's own backend.
+    void submitBuffer(const QByteArray &pcm) override;
+    void prewarm() override;
+    /// The broker's counters for its leg, as reported with finished().
+    AsrTransportStats transportStats() const override { return stats_; }
+
+private:
+    void ensureConnected();
+    void send(const QByteArray &frameBytes);
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    void onSocketError(QLocalSocket::LocalSocketError err);
+    void handleFrame(char op, const QByteArray &raw);
+    void fail(const QString &message);
+
+    Settings settings_;
+    QLocalSocket socket_;
+    broker::FrameReader reader_;
+    QByteArray outbox_;
+    bool active_ = false;
+    // Number of the latest session this side started; the broker's frames
+    // carry the one they belong to, and older ones are dropped.
+    quint32 session_ = 0;
+    AsrTransportStats stats_;
+};
@@ -0,0 +1,248 @@
+#include "HedgedBackend.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Replay buffer cap: 10 s @ 16 kHz S16LE, like VolcengineBackend's
+// handshake buffer. Nobody hedges with a delay anywhere near that.
+constexpr int kMaxReplayBytes = 16000 * 2 * 10;
+
+const char *legName(int leg) { return leg == 0 ? "primary" : "secondary"; }
+} // namespace
+
+HedgedBackend::HedgedBackend(std::unique_ptr<AsrBackend> primary,
+                             std::unique_ptr<AsrBackend> secondary, int hedgeDelayMs,
+                             QObject *parent)
+    : AsrBackend(parent), hedgeDelayMs_(hedgeDelayMs) {
+    leg(Leg::Primary).backend = std::move(primary);
+    leg(Leg::Secondary).backend = std::move(secondary);
+    wire(Leg::Primary);
+    wire(Leg::Secondary);
+
+    hedgeTimer_.setSingleShot(true);
+    connect(&hedgeTimer_, &QTimer::timeout, this, [this]() {
+        if (!active_ || decided_ || leg(Leg::Primary).connected) return;
+        qInfo() << "HedgedBackend: primary not connected after" << hedgeDelayMs_
+                << "ms — starting secondary";
+        startSecondary();
+    });
+}
+
+HedgedBackend::~HedgedBackend() {
+    // The legs go away after the rest of this object; nothing they emit on
+    // the way out may reach it.
+    for (auto &l : legs_) {
+        if (l.backend) l.backend->disconnect(this);
+    }
+}
+
+void HedgedBackend::wire(Leg l) {
+    AsrBackend *b = leg(l).backend.get();
+    connect(b, &AsrBackend::connected, this, [this, l]() { onConnected(l); });
+    connect(b, &AsrBackend::partial, this, [this, l](const QString &t) { onPartial(l, t); });
+    connect(b, &AsrBackend::final_, this, [this, l](const QString &t) { onFinal(l, t); });
+    connect(b, &AsrBackend::finished, this, [this, l]() { onFinished(l); });
+    connect(b, &AsrBackend::error, this, [this, l](const QString &m) { onError(l, m); });
+    connect(b, &AsrBackend::congestion, this,
+            [this, l](bool on, int ms) { onCongestion(l, on, ms); });
+}
+
+void HedgedBackend::prewarm() {
+    // Both: a hedge that has to cold-start its secondary is slower than it
+    // needs to be.
+    for (auto &l : legs_) l.backend->prewarm();
+}
+
+AsrTransportStats HedgedBackend::transportStats() const {
+    AsrTransportStats sum;
+    for (const auto &l : legs_) {
+        if (!l.used) continue;
+        const AsrTransportStats s = l.backend->transportStats();
+        sum.framesSent += s.framesSent;
+        sum.bytesSent += s.bytesSent;
+        sum.framesReceived += s.framesReceived;
+        sum.bytesReceived += s.bytesReceived;
+        sum.peakQueuedMs = std::max(sum.peakQueuedMs, s.peakQueuedMs);
+        sum.droppedAudioMs += s.droppedAudioMs;
+    }
+    return sum;
+}
+
+void HedgedBackend::start() {
+    if (active_) return;
+    reset();
+    active_ = true;
+    leg(Leg::Primary).started = leg(Leg::Primary).used = true;
+    leg(Leg::Secondary).used = false;
+    hedgeTimer_.start(hedgeDelayMs_);
+    leg(Leg::Primary).backend->start();
+}
+
+void HedgedBackend::submitBuffer(const QByteArray &pcm) {
+    if (active_) return;
+    reset();
+    active_ = true;
+    buffer_ = pcm;
+    leg(Leg::Primary).started = leg(Leg::Primary).used = true;
+    leg(Leg::Secondary).used = false;
+    leg(Leg::Primary).backend->submitBuffer(pcm);
+}
+
+void HedgedBackend::startSecondary() {
+    LegState &s = leg(Leg::Secondary);
+    if (s.started) return;
+    s.started = s.used = true;
+    if (!buffer_.isEmpty()) {
+        s.backend->submitBuffer(buffer_);
+        return;
+    }
+    s.backend->start();
+    if (!active_ || s.failed) return;
+    // Everything the primary has had so far, as one chunk: both backends
+    // re-slice on the way out.
+    if (!replay_.isEmpty()) s.backend->pushPcm(replay_);
+    replay_.clear();
+    if (stopping_) s.backend->stop();
+}
+
+void HedgedBackend::pushPcm(const QByteArray &chunk) {
+    if (!active_) return;
+    for (auto &l : legs_) {
+        if (l.started && !l.failed) l.backend->pushPcm(chunk);
+    }
+    if (!decided_ && !leg(Leg::Secondary).started) {
+        const int room = kMaxReplayBytes - static_cast<int>(replay_.size());
+        if (room > 0) {
+            replay_.append(chunk.constData(), std::min(room, static_cast<int>(chunk.size())));
+        }
+    }
+}
+
+void HedgedBackend::stop() {
+    if (!active_ || stopping_) return;
+    stopping_ = true;
+    // The hedge timer keeps running: a primary that is still connecting
+    // when the user stops is exactly the case the secondary is for.
+    for (auto &l : legs_) {
+        if (l.started && !l.failed) l.backend->stop();
+    }
+}
+
+void HedgedBackend::cancel() {
+    if (!active_) return;
+    // Inactive first: a leg's cancel may report finished() synchronously.
+    active_ = false;
+    hedgeTimer_.stop();
+    for (auto &l : legs_) {
+        if (l.started && !l.failed) l.backend->cancel();
+    }
+    reset();
+}
+
+void HedgedBackend::decide(Leg l) {
+    if (decided_) return;
+    decided_ = true;
+    winner_ = l;
+    hedgeTimer_.stop();
+    replay_.clear();
+    if (leg(Leg::Secondary).started) {
+        qInfo() << "HedgedBackend:" << legName(static_cast<int>(l)) << "wins";
+    }
+    // The overlay may still show the other leg's partial.
+    if (leader_ != l && connectedSent_) emit partial(QString());
+    leader_ = l;
+
+    LegState &loser = leg(other(l));
+    loser.finals.clear();
+    if (loser.started && !loser.failed) {
+        loser.failed = true;  // out of the race; ignore what it still reports
+        loser.backend->cancel();
+    }
+    const QStringList held = std::exchange(leg(l).finals, {});
+    for (const auto &f : held) emit final_(f);
+}
+
+void HedgedBackend::onConnected(Leg l) {
+    if (!active_ || leg(l).failed) return;
+    leg(l).connected = true;
+    if (!connectedSent_) {
+        connectedSent_ = true;
+        if (!decided_) leader_ = l;
+        emit connected();
+    }
+    // In time: no hedge needed.
+    if (l == Leg::Primary && !leg(Leg::Secondary).started) decide(Leg::Primary);
+}
+
+void HedgedBackend::onPartial(Leg l, const QString &text) {
+    if (!active_ || leg(l).failed) return;
+    if (l == (decided_ ? winner_ : leader_)) emit partial(text);
+}
+
+void HedgedBackend::onFinal(Leg l, const QString &text) {
+    if (!active_ || leg(l).failed) return;
+    if (!decided_) {
+        leg(l).finals.append(text);
+        return;
+    }
+    if (l == winner_) emit final_(text);
+}
+
+void HedgedBackend::onFinished(Leg l) {
+    if (!active_ || leg(l).failed) return;
+    decide(l);
+    active_ = false;
+    reset();
+    emit finished();
+}
+
+void HedgedBackend::onError(Leg l, const QString &message) {
+    if (!active_ || leg(l).failed) return;
+    leg(l).failed = true;
+    qWarning().noquote() << "HedgedBackend:" << legName(static_cast<int>(l)) << "failed:"
+                         << message;
+    const Leg o = other(l);
+    // Only while the race is open: a winner that fails mid-session has
+    // already handed out audio and finals the other leg never saw.
+    if (!decided_ && l == Leg::Primary && !leg(o).started) {
+        // Fail over now instead of waiting out the hedge delay.
+        startSecondary();
+        if (!active_) return;
+    }
+    if (!decided_ && leg(o).started && !leg(o).failed) {
+        decide(o);
+        return;
+    }
+    // Inactive first, as in cancel(); no leg may keep a session open past
+    // this one, or the next start() would find it still running.
+    active_ = false;
+    hedgeTimer_.stop();
+    for (auto &live : legs_) {
+        if (live.started && !live.failed) {
+            live.failed = true;
+            live.backend->cancel();
+        }
+    }
+    reset();
+    emit error(message);
+}
+
+void HedgedBackend::onCongestion(Leg l, bool congested, int queuedMs) {
+    if (!active_ || leg(l).failed) return;
+    if (l == (decided_ ? winner_ : leader_)) emit congestion(congested, queuedMs);
+}
+
+void HedgedBackend::reset() {
+    for (auto &l : legs_) {
+        l.started = l.connected = l.failed = false;
+        l.finals.clear();
+    }
+    stopping_ = false;
+    connectedSent_ = false;
+    decided_ = false;
+    winner_ = leader_ = Leg::Primary;
+    replay_.clear();
+    buffer_.clear();
+}
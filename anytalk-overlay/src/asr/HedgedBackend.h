@@ -0,0 +1,91 @@
+#pragma once
+#include "AsrBackend.h"
+
+#include <QByteArray>
+#include <QStringList>
+#include <QTimer>
+#include <array>
+#include <memory>
+
+/// Composite backend that hedges a primary against a secondary.
+///
+/// start() starts only the primary. If it hasn't connected after
+/// `hedgeDelayMs` (or fails before that), the secondary is started too and
+/// gets the session's audio so far, then the same live stream. From then on
+/// it's a race:
+///   - connected() is forwarded once, for whichever leg gets there first.
+///   - Partials come from the leg that connected first (the leader).
+///   - Finals are held per leg until the race is decided, because the two
+///     legs would otherwise both end up in the commit. The first leg to
+///     deliver finished() wins: its finals go out, then finished(), and the
+///     other leg is cancelled. A leg that errors leaves the race; when only
+///     one is left it wins outright and is forwarded live.
+///   - error() only surfaces once both legs have failed, or the winner
+///     fails after the race was decided; any leg still running is
+///     cancelled first.
+/// A primary that connects before the hedge delay wins straight away, so a
+/// healthy endpoint costs nothing but the timer.
+///
+/// submitBuffer() doesn't race: with nothing live there is no first word
+/// to be late for. The primary gets the buffer, and the secondary only if
+/// the primary fails.
+class HedgedBackend : public AsrBackend {
+    Q_OBJECT
+public:
+    HedgedBackend(std::unique_ptr<AsrBackend> primary, std::unique_ptr<AsrBackend> secondary,
+                  int hedgeDelayMs, QObject *parent = nullptr);
+    ~HedgedBackend() override;
+
+    void start() override;
+    void pushPcm(const QByteArray &chunk) override;
+    void stop() override;
+    void cancel() override;
+    void submitBuffer(const QByteArray &pcm) override;
+    void prewarm() override;
+    /// Both legs' traffic summed: a hedge costs what it sends.
+    AsrTransportStats transportStats() const override;
+
+private:
+    enum class Leg { Primary = 0, Secondary = 1 };
+    struct LegState {
+        std::unique_ptr<AsrBackend> backend;
+        bool started = false;
+        bool connected = false;
+        bool failed = false;
+        QStringList finals;  // held until this leg wins
+        // Started during the last session; outlives reset() so
+        // transportStats() skips a leg that kept an older session's counts.
+        bool used = false;
+    };
+
+    void wire(Leg leg);
+    void startSecondary();
+    /// `leg` is the only one left, or finished first: make it the one.
+    void decide(Leg leg);
+    void onConnected(Leg leg);
+    void onPartial(Leg leg, const QString &text);
+    void onFinal(Leg leg, const QString &text);
+    void onFinished(Leg leg);
+    void onError(Leg leg, const QString &message);
+    void onCongestion(Leg leg, bool congested, int queuedMs);
+    void reset();
+
+    LegState &leg(Leg l) { return legs_[static_cast<int>(l)]; }
+    static Leg other(Leg l) { return l == Leg::Primary ? Leg::Secondary : Leg::Primary; }
+
+    std::array<LegState, 2> legs_;
+    bool active_ = false;
+    bool stopping_ = false;
+    bool connectedSent_ = false;
+    bool decided_ = false;
+    Leg winner_ = Leg::Primary;  // valid once decided_
+    Leg leader_ = Leg::Primary;  // partial source
+
+    // Session audio until the secondary has started (or the primary won),
+    // replayed into the secondary on a late start.
+    QByteArray replay_;
+    // submitBuffer() session: the whole buffer, for a failover.
+    QByteArray buffer_;
+    QTimer hedgeTimer_;
+    const int hedgeDelayMs_;
+};
@@ -8,9 +8,26 @@
 #include <QUrl>
 #include <QWebSocket>
 
+#include <algorithm>
+
 namespace {
 // 10 s — fail fast on bad token / DNS, survive Wi-Fi roaming.
 constexpr int kHandshakeTimeoutMs = 10'000;
+constexpr int kPcmBytesPerMs = 16000 * 2 / 1000;  // 16 kHz S16LE
+// Handshake buffer cap: as long as the handshake may take.
+constexpr int kMaxPendingBytes = kHandshakeTimeoutMs * kPcmBytesPerMs;
+// Send queue (QWebSocket's unsent bytes, in audio time): congested above
+// the high mark until it drains below the low one; past the cap new audio
+// is dropped instead of queued, so a dead uplink can't grow it unbounded.
+constexpr int kQueueHighMs = 1'000;
+constexpr int kQueueLowMs = 250;
+constexpr int kQueueMaxMs = 10'000;
+// Largest audio_only payload we send (see onWsConnected).
+constexpr int kFlushSliceBytes = 16000 * 2 * 200 / 1000;  // 200ms @ 16kHz S16LE
+// submitBuffer() flow-control window: audio kept in the send queue ahead
+// of the socket. Enough that the link never idles between bytesWritten
+// wakeups; anything more is memory and a slower cancel().
+constexpr int kBufferWindowMs = 2'000;
 
 template <typename E>
 QString enumName(E v) {
@@ -31,16 +48,47 @@ QString pathForMode(const QString &mode) {
 } // namespace
 
 VolcengineBackend::VolcengineBackend(Settings settings, QObject *parent)
-    : AsrBackend(parent), settings_(std::move(settings)) {
+    : AsrBackend(parent), settings_(std::move(settings)), frameWriter_(kFlushSliceBytes),
+      encoder_(volcengine::createAudioEncoder(settings_.audioEncoding)) {
+    frameWriter_.setGzip(encoder_ && encoder_->gzipFramed());
     handshakeTimer_.setSingleShot(true);
     connect(&handshakeTimer_, &QTimer::timeout,
             this, &VolcengineBackend::onHandshakeTimeout);
+    if (settings_.spareConnections > 0) {
+        pool_ = std::make_unique<VolcengineSocketPool>(
+            [this]() { return buildRequest(settings_.mode); }, settings_.spareConnections,
+            settings_.spareMaxIdleMs, settings_.spareWarmWindowMs);
+    }
 }
 
 VolcengineBackend::~VolcengineBackend() = default;
 
+QString VolcengineBackend::sessionMode() const {
+    return bufferMode_ ? QStringLiteral("nostream") : settings_.mode;
+}
+
+QNetworkRequest VolcengineBackend::buildRequest(const QString &mode) const {
+    const QString base =
+        settings_.endpoint.isEmpty() ? QStringLiteral("wss://%1").arg(kHost) : settings_.endpoint;
+    QNetworkRequest req(QUrl(base + pathForMode(mode)));
+    req.setRawHeader("X-Api-App-Key", settings_.appId.toUtf8());
+    req.setRawHeader("X-Api-Access-Key", settings_.accessToken.toUtf8());
+    req.setRawHeader("X-Api-Resource-Id", settings_.resourceId.toUtf8());
+    // Fresh per socket — spares included. The server keys the session on it.
+    req.setRawHeader("X-Api-Connect-Id",
+                     QUuid::createUuid().toString(QUuid::WithoutBraces).toUtf8());
+    return req;
+}
+
 void VolcengineBackend::openWebSocket() {
     ws_ = std::make_unique<QWebSocket>();
+    wireSocket();
+    ws_->open(buildRequest(sessionMode()));
+
+    handshakeTimer_.start(kHandshakeTimeoutMs);
+}
+
+void VolcengineBackend::wireSocket() {
     connect(ws_.get(), &QWebSocket::connected, this, &VolcengineBackend::onWsConnected);
     connect(ws_.get(), &QWebSocket::binaryMessageReceived, this, &VolcengineBackend::onWsBinary);
     connect(ws_.get(), &QWebSocket::errorOccurred, this, &VolcengineBackend::onWsError);
@@ -50,50 +98,262 @@ void VolcengineBackend::openWebSocket() {
     connect(ws_.get(), &QWebSocket::sslErrors, this, &VolcengineBackend::onWsSslErrors);
     connect(ws_.get(), &QWebSocket::stateChanged,
             this, &VolcengineBackend::onWsStateChanged);
+    connect(ws_.get(), &QWebSocket::bytesWritten, this, &VolcengineBackend::onWsBytesWritten);
+}
 
-    QNetworkRequest req(QUrl(QStringLiteral("wss://%1%2").arg(kHost, pathForMode(settings_.mode))));
-    req.setRawHeader("X-Api-App-Key", settings_.appId.toUtf8());
-    req.setRawHeader("X-Api-Access-Key", settings_.accessToken.toUtf8());
-    req.setRawHeader("X-Api-Resource-Id", settings_.resourceId.toUtf8());
-    req.setRawHeader("X-Api-Connect-Id",
-                     QUuid::createUuid().toString(QUuid::WithoutBraces).toUtf8());
-    ws_->open(req);
-
-    handshakeTimer_.start(kHandshakeTimeoutMs);
+void VolcengineBackend::resetSession() {
+    parseState_ = {};
+    parseState_.incremental = settings_.incrementalResults;
+    pendingAudio_.clear();
+    pendingDroppedBytes_ = 0;
+    resetQueueStats();
+    stats_ = {};
+    spareReplay_.clear();
+    sendAccum_.resize(0);
+    if (encoder_) encoder_->reset();
+    nextSeq_ = 1;
 }
 
 void VolcengineBackend::start() {
     if (state_ != State::Idle) return;
+    resetSession();
+    state_ = State::Connecting;
+
+    if (pool_) ws_ = pool_->take();
+    if (!ws_) {
+        spareUnconfirmed_ = false;
+        openWebSocket();
+        return;
+    }
+    spareUnconfirmed_ = true;
+    wireSocket();
+    if (ws_->state() == QAbstractSocket::ConnectedState) {
+        qInfo() << "VolcengineBackend: using pre-connected spare socket";
+        onWsConnected();
+    } else {
+        // Still mid-handshake: it started earlier than a cold open would
+        // have, so just wait for it under the usual timeout.
+        qInfo() << "VolcengineBackend: adopting spare socket mid-handshake";
+        handshakeTimer_.start(kHandshakeTimeoutMs);
+    }
+}
+
+void VolcengineBackend::submitBuffer(const QByteArray &pcm) {
+    if (state_ != State::Idle) return;
+    resetSession();
+    bufferMode_ = true;
+    buffer_ = pcm;
+    bufferPos_ = 0;
+    state_ = State::Connecting;
+    spareUnconfirmed_ = false;
+    openWebSocket();
+}
+
+void VolcengineBackend::pumpBuffer() {
+    if (!bufferMode_ || state_ != State::Recording || !ws_) return;
+    while (bufferPos_ < buffer_.size() && queuedMs() < kBufferWindowMs) {
+        const int len = static_cast<int>(
+            std::min<qsizetype>(kFlushSliceBytes, buffer_.size() - bufferPos_));
+        sendAudio(buffer_.constData() + bufferPos_, len);
+        bufferPos_ += len;
+    }
+    if (bufferPos_ < buffer_.size()) return;
+    buffer_.clear();
+    state_ = State::Stopping;
+    finishUpload();
+}
+
+void VolcengineBackend::onWsBytesWritten() {
+    updateCongestion();
+    pumpBuffer();
+}
+
+void VolcengineBackend::prewarm() {
+    if (pool_ && state_ == State::Idle) pool_->refill();
+}
+
+bool VolcengineBackend::retryColdAfterDeadSpare() {
+    if (!spareUnconfirmed_) return false;
+    if (state_ != State::Connecting && state_ != State::Recording) return false;
+    qInfo() << "VolcengineBackend: spare socket died before first response — "
+               "cold reconnect";
+    spareUnconfirmed_ = false;
+    QWebSocket *raw = ws_.release();
+    raw->disconnect(this);
+    if (raw->state() != QAbstractSocket::UnconnectedState) raw->close();
+    raw->deleteLater();
+    // Everything pushed so far goes back through the handshake buffer and
+    // gets re-sequenced from 1 on the new connection.
+    QByteArray queued;
+    queued.swap(pendingAudio_);
+    pendingAudio_.swap(spareReplay_);
+    bufferPending(queued.constData(), static_cast<int>(queued.size()));
+    if (pendingAudio_.size() > kMaxPendingBytes) {
+        pendingDroppedBytes_ += pendingAudio_.size() - kMaxPendingBytes;
+        pendingAudio_.truncate(kMaxPendingBytes);
+    }
     parseState_ = {};
-    pendingAudio_.clear();
+    parseState_.incremental = settings_.incrementalResults;
     nextSeq_ = 1;
     state_ = State::Connecting;
+    // Already copied into spareReplay_ (now pendingAudio_) on its way in.
+    sendAccum_.resize(0);
+    // The replay is a new stream for the server: Ogg headers and all.
+    if (encoder_) encoder_->reset();
     openWebSocket();
+    return true;
 }
 
 void VolcengineBackend::pushPcm(const QByteArray &chunk) {
+    if (bufferMode_) return;
     if (state_ == State::Connecting) {
-        // Buffer for onWsConnected() to flush. Cap so a stuck handshake
-        // (network down) can't grow the buffer unbounded.
-        constexpr int kMaxPendingBytes = 16000 * 2 * 10;  // 10s @ 16kHz S16LE
-        if (pendingAudio_.size() < kMaxPendingBytes) {
-            pendingAudio_.append(chunk);
-        }
+        bufferPending(chunk.constData(), static_cast<int>(chunk.size()));
         return;
     }
     if (state_ != State::Recording) return;
     if (!ws_ || ws_->state() != QAbstractSocket::ConnectedState) return;
-    ws_->sendBinaryMessage(volcengine::buildAudioOnlyRequest(
-        chunk, /*last=*/false, nextSeq_++));
+    if (queuedMs() >= kQueueMaxMs) {
+        if (queueDroppedBytes_ == 0) {
+            qWarning() << "VolcengineBackend: send queue over" << kQueueMaxMs
+                       << "ms — dropping audio until the uplink drains";
+        }
+        queueDroppedBytes_ += chunk.size();
+        return;
+    }
+    if (spareUnconfirmed_) spareReplay_.append(chunk);
+
+    const int target = targetFrameBytes();
+    if (sendAccum_.isEmpty() && chunk.size() >= target) {
+        // Healthy link at the default 40 ms: straight through, no staging copy.
+        sendAudio(chunk.constData(), chunk.size());
+        updateCongestion();
+        return;
+    }
+    sendAccum_.append(chunk);
+    if (sendAccum_.size() >= target) {
+        flushAccum();
+        updateCongestion();
+    }
+}
+
+int VolcengineBackend::queuedMs() const {
+    if (!ws_) return 0;
+    const qint64 backlog = ws_->bytesToWrite();
+    if (backlog <= 0) return 0;
+    // Scale wire bytes back to audio time by this session's encoding
+    // ratio, so the marks mean the same with gzip / Opus as with PCM.
+    const double pcmPerWire =
+        wireBytes_ > 0 ? static_cast<double>(wirePcmBytes_) / static_cast<double>(wireBytes_) : 1.0;
+    return static_cast<int>(static_cast<double>(backlog) * pcmPerWire / kPcmBytesPerMs);
+}
+
+void VolcengineBackend::updateCongestion() {
+    if (state_ != State::Recording && state_ != State::Stopping) return;
+    // A buffer upload keeps the queue full on purpose; nothing live lags.
+    if (bufferMode_) return;
+    const int ms = queuedMs();
+    peakQueuedMs_ = std::max(peakQueuedMs_, ms);
+    if (!congested_ && ms >= kQueueHighMs) {
+        congested_ = true;
+        qInfo() << "VolcengineBackend: uplink congested," << ms
+                << "ms queued — coalescing into 200 ms frames";
+        emit congestion(true, ms);
+    } else if (congested_ && ms <= kQueueLowMs) {
+        congested_ = false;
+        qInfo() << "VolcengineBackend: uplink recovered," << ms << "ms queued";
+        emit congestion(false, ms);
+    }
+}
+
+void VolcengineBackend::resetQueueStats() {
+    congested_ = false;
+    wireBytes_ = 0;
+    wirePcmBytes_ = 0;
+    peakQueuedMs_ = 0;
+    queueDroppedBytes_ = 0;
+}
+
+void VolcengineBackend::bufferPending(const char *pcm, int bytes) {
+    // Keep-head: see pendingAudio_. Cut on a sample boundary so the
+    // flushed audio stays aligned.
+    const int room = std::max(0, kMaxPendingBytes - static_cast<int>(pendingAudio_.size()));
+    const int take = std::min(bytes, room) & ~1;
+    if (take > 0) pendingAudio_.append(pcm, take);
+    if (take < bytes) {
+        if (pendingDroppedBytes_ == 0) {
+            qWarning() << "VolcengineBackend: handshake buffer full ("
+                       << kMaxPendingBytes / kPcmBytesPerMs
+                       << "ms) — dropping newer audio until connected";
+        }
+        pendingDroppedBytes_ += bytes - take;
+    }
+}
+
+int VolcengineBackend::targetFrameBytes() const {
+    // Past the high watermark every frame is as large as the server takes:
+    // fewest headers / TLS records for the audio that still has to go.
+    if (congested_) return kFlushSliceBytes;
+    if (!settings_.adaptiveFrames) {
+        return std::clamp(settings_.frameMs, 40, 200) * kPcmBytesPerMs;
+    }
+    // Adaptive: frame size follows QWebSocket's unsent backlog. Healthy
+    // links drain each frame before the next chunk arrives, so stay at
+    // 40 ms for the lowest partial latency; once a frame's worth queues
+    // up, grow frames so each TLS record / syscall carries more audio,
+    // capped at the server's ~200 ms limit.
+    const qint64 backlog = ws_ ? ws_->bytesToWrite() : 0;
+    if (backlog >= kFlushSliceBytes) return kFlushSliceBytes;  // 200 ms
+    if (backlog >= 40 * kPcmBytesPerMs) return 100 * kPcmBytesPerMs;
+    return 40 * kPcmBytesPerMs;
+}
+
+void VolcengineBackend::sendAudio(const char *pcm, int bytes) {
+    for (int off = 0; off < bytes; off += kFlushSliceBytes) {
+        const int len = std::min(kFlushSliceBytes, bytes - off);
+        wirePcmBytes_ += len;
+        if (!encoder_) {
+            wireBytes_ += len;
+            sendFrame(frameWriter_.build(pcm + off, len, /*last=*/false, nextSeq_++));
+            continue;
+        }
+        // Opus holds back a sub-20 ms tail, so a slice may not produce a
+        // payload yet — no frame, no seq consumed.
+        encoder_->encode(pcm + off, len, encoded_);
+        if (encoded_.isEmpty()) continue;
+        wireBytes_ += encoded_.size();
+        sendFrame(frameWriter_.build(encoded_.constData(), static_cast<int>(encoded_.size()),
+                                     /*last=*/false, nextSeq_++));
+    }
+}
+
+void VolcengineBackend::sendFrame(const QByteArray &frame) {
+    ++stats_.framesSent;
+    stats_.bytesSent += frame.size();
+    ws_->sendBinaryMessage(frame);
+}
+
+void VolcengineBackend::flushAccum() {
+    if (sendAccum_.isEmpty()) return;
+    sendAudio(sendAccum_.constData(), static_cast<int>(sendAccum_.size()));
+    sendAccum_.resize(0);  // keep the capacity for the next batch
 }
 
 void VolcengineBackend::stop() {
-    if (state_ != State::Recording) return;
+    // A buffer upload ends itself once the last of it is queued.
+    if (state_ != State::Recording || bufferMode_) return;
     state_ = State::Stopping;
+    finishUpload();
+}
+
+void VolcengineBackend::finishUpload() {
     if (ws_ && ws_->state() == QAbstractSocket::ConnectedState) {
+        flushAccum();
         // Send a final audio frame with the LAST flag so the server knows to drain.
-        ws_->sendBinaryMessage(volcengine::buildAudioOnlyRequest(
-            QByteArray(), /*last=*/true, nextSeq_++));
+        // With an encoder the LAST frame carries its held-back tail and trailer.
+        if (encoder_) encoder_->finish(encoded_);
+        else encoded_.resize(0);
+        sendFrame(frameWriter_.build(encoded_.constData(), static_cast<int>(encoded_.size()),
+                                     /*last=*/true, nextSeq_++));
     }
     // Server will deliver one or more responses + close; teardown happens in
     // onWsDisconnected / on a final response frame (flags & 0x3 == 0x3).
@@ -109,24 +369,31 @@ void VolcengineBackend::onWsConnected() {
     if (state_ != State::Connecting) return;
     emit connected();
     state_ = State::Recording;
-    const auto initial = volcengine::buildInitialRequestJson(settings_.mode,
-                                                              settings_.enableNonstream);
-    ws_->sendBinaryMessage(volcengine::buildFullClientRequest(initial, nextSeq_++));
+    const auto initial = volcengine::buildInitialRequestJson(
+        sessionMode(), settings_.enableNonstream && !bufferMode_,
+        encoder_ ? encoder_->format() : QStringLiteral("pcm"),
+        encoder_ ? encoder_->codec() : QStringLiteral("raw"), settings_.incrementalResults);
+    sendFrame(volcengine::buildFullClientRequest(initial, nextSeq_++));
+    if (bufferMode_) {
+        pumpBuffer();
+        return;
+    }
     // Flush handshake-buffered audio in 200ms slices — Doubao silently
     // drops audio_only frames much larger than that.
     if (!pendingAudio_.isEmpty()) {
-        constexpr int kFlushSliceBytes = 16000 * 2 * 200 / 1000;  // 200ms @ 16kHz S16LE
-        for (int off = 0; off < pendingAudio_.size(); off += kFlushSliceBytes) {
-            const int len = std::min<int>(kFlushSliceBytes,
-                                          pendingAudio_.size() - off);
-            ws_->sendBinaryMessage(volcengine::buildAudioOnlyRequest(
-                pendingAudio_.mid(off, len), /*last=*/false, nextSeq_++));
-        }
+        sendAudio(pendingAudio_.constData(), static_cast<int>(pendingAudio_.size()));
+        if (spareUnconfirmed_) spareReplay_.append(pendingAudio_);
         pendingAudio_.clear();
+        updateCongestion();
     }
 }
 
 void VolcengineBackend::onWsBinary(const QByteArray &data) {
+    ++stats_.framesReceived;
+    stats_.bytesReceived += data.size();
+    // Any server frame proves the socket is live; stop keeping a replay copy.
+    spareUnconfirmed_ = false;
+    spareReplay_.clear();
     const auto parsed = volcengine::parseServerFrame(data);
     if (parsed.kind == volcengine::ParsedFrame::Kind::Error) {
         const QString msg = parsed.errorMessage.isEmpty() ? QStringLiteral("server error")
@@ -136,7 +403,7 @@ void VolcengineBackend::onWsBinary(const QByteArray &data) {
     }
     if (parsed.kind != volcengine::ParsedFrame::Kind::Response) return;
 
-    const auto asr = volcengine::parseAsrResponse(parsed.jsonText, parseState_, settings_.mode);
+    const auto asr = volcengine::parseAsrResponse(parsed.jsonText, parseState_, sessionMode());
     if (asr.partial.has_value()) emit partial(*asr.partial);
     for (const auto &f : asr.finals) emit final_(f);
 
@@ -150,11 +417,13 @@ void VolcengineBackend::onWsError(QAbstractSocket::SocketError err) {
     qWarning().noquote() << "VolcengineBackend: ws error" << enumName(err)
                          << "—" << (ws_ ? ws_->errorString() : QStringLiteral("(no ws)"));
     if (state_ == State::Idle) return;
+    if (retryColdAfterDeadSpare()) return;
     teardown(ws_ ? ws_->errorString() : QStringLiteral("WebSocket error"));
 }
 
 void VolcengineBackend::onWsDisconnected() {
     if (state_ == State::Idle) return;
+    if (retryColdAfterDeadSpare()) return;
     // Normal close after the final frame: state already moved through Stopping.
     teardown({});
 }
@@ -195,9 +464,30 @@ void VolcengineBackend::teardown(const QString &errorMessage) {
         raw->deleteLater();
     }
     const bool wasError = !errorMessage.isEmpty();
+    stats_.peakQueuedMs = peakQueuedMs_;
+    stats_.droppedAudioMs = (pendingDroppedBytes_ + queueDroppedBytes_) / kPcmBytesPerMs;
+    if (pendingDroppedBytes_ > 0) {
+        qWarning() << "VolcengineBackend:" << pendingDroppedBytes_ / kPcmBytesPerMs
+                   << "ms of audio dropped this session — handshake buffer overflowed";
+        pendingDroppedBytes_ = 0;
+    }
+    if (peakQueuedMs_ >= kQueueHighMs || queueDroppedBytes_ > 0) {
+        qWarning() << "VolcengineBackend: send queue peaked at" << peakQueuedMs_ << "ms,"
+                   << queueDroppedBytes_ / kPcmBytesPerMs << "ms of audio dropped";
+    }
+    resetQueueStats();
     state_ = State::Idle;
     parseState_ = {};
     pendingAudio_.clear();
+    sendAccum_.resize(0);
+    spareUnconfirmed_ = false;
+    spareReplay_.clear();
+    bufferMode_ = false;
+    buffer_.clear();
+    bufferPos_ = 0;
+    // Refill for the next session only after a clean one: after an error
+    // (bad token, endpoint down) a spare would just fail the same way.
+    if (pool_ && !wasError) pool_->refill();
     if (wasError) emit error(errorMessage);
     else emit finished();
 }
@@ -1,10 +1,13 @@
 #pragma once
 #include "AsrBackend.h"
+#include "AudioEncoder.h"
 #include "VolcengineProtocol.h"
+#include "VolcengineSocketPool.h"
 
 #include <QAbstractSocket>
 #include <QByteArray>
 #include <QList>
+#include <QNetworkRequest>
 #include <QSslError>
 #include <QString>
 #include <QTimer>
@@ -25,6 +28,10 @@ public:
         QString appId;
         QString accessToken;
         QString resourceId = QStringLiteral("volc.seedasr.sauc.duration");
+        // scheme://host[:port] to talk to instead of the production
+        // endpoint (a proxy, anytalk-bench's mock server); the mode's path
+        // is appended. Empty = wss://openspeech.bytedance.com.
+        QString endpoint;
         // Wire-level mode passed to the SAUC endpoint: "bidi" | "bidi_async"
         // | "nostream". The SettingsDialog combobox exposes a fourth UI-only
         // synthetic key "bidi_2pass" which is split into mode="bidi" plus
@@ -35,6 +42,27 @@ public:
         // is only supported on the optimized bidi path; the protocol layer
         // gates the JSON insertion to enforce that server-side rule.
         bool enableNonstream = false;
+        // Pre-handshaken spare sockets (VolcengineSocketPool). 0 keeps the
+        // old behaviour: every session cold-connects in start().
+        int spareConnections = 0;
+        // Expire a spare this long after it was opened — before the server
+        // drops it as idle.
+        int spareMaxIdleMs = 5'000;
+        // After a session ends, keep rotating expired spares for this long.
+        int spareWarmWindowMs = 30'000;
+        // Audio per audio_only frame once recording: 40 (one capture
+        // chunk, lowest latency) .. 200 (server limit, fewest TLS records).
+        int frameMs = 40;
+        // Ignore frameMs and size frames from the socket's unsent backlog:
+        // 40 ms while the link keeps up, up to 200 ms as it falls behind.
+        bool adaptiveFrames = false;
+        // audio_only payload encoding (see AudioEncoder). Unavailable
+        // encoders fall back to raw PCM at construction.
+        volcengine::AudioEncoding audioEncoding = volcengine::AudioEncoding::Pcm;
+        // result_type "single": responses carry only the live segment
+        // instead of the whole session so far. Output is unchanged — the
+        // parser stitches finished segments back in (AsrParseState).
+        bool incrementalResults = false;
     };
 
     explicit VolcengineBackend(Settings settings, QObject *parent = nullptr);
@@ -44,6 +72,12 @@ public:
     void pushPcm(const QByteArray &chunk) override;
     void stop() override;
     void cancel() override;
+    /// Always a cold socket on the nostream endpoint: a spare was
+    /// handshaken for the streaming one, and nostream is the server's
+    /// whole-utterance model. The upload is paced by the send queue only.
+    void submitBuffer(const QByteArray &pcm) override;
+    void prewarm() override;
+    AsrTransportStats transportStats() const override { return stats_; }
 
 private slots:
     void onWsConnected();
@@ -53,28 +87,98 @@ private slots:
     void onWsSslErrors(const QList<QSslError> &errors);
     void onWsStateChanged(QAbstractSocket::SocketState state);
     void onHandshakeTimeout();
+    void onWsBytesWritten();
+    /// Re-check the send queue against the watermarks (after each send
+    /// and whenever the socket drains some of it).
+    void updateCongestion();
 
 private:
     enum class State { Idle, Connecting, Recording, Stopping };
 
+    QNetworkRequest buildRequest(const QString &mode) const;
+    /// settings_.mode, or "nostream" for a submitBuffer() session.
+    QString sessionMode() const;
     void openWebSocket();
+    /// Hook ws_ up to the session slots (cold-opened or taken from pool_).
+    void wireSocket();
+    /// Adopted spare died before the server answered anything: reopen
+    /// cold and replay the audio sent on it. Returns false when the
+    /// failure is not one the retry can cover.
+    bool retryColdAfterDeadSpare();
+    /// Audio time still sitting in QWebSocket's write buffer.
+    int queuedMs() const;
+    void resetQueueStats();
+    /// Frame size (bytes) the next send should reach before going out.
+    int targetFrameBytes() const;
+    /// Queue audio for onWsConnected(), subject to kMaxPendingBytes.
+    void bufferPending(const char *pcm, int bytes);
+    /// Send `bytes` of PCM as one or more ≤200 ms audio_only frames.
+    void sendAudio(const char *pcm, int bytes);
+    /// Every outgoing frame goes through here, for stats_.
+    void sendFrame(const QByteArray &frame);
+    void flushAccum();
+    /// Send the LAST frame (with the encoder's tail) and start draining.
+    void finishUpload();
+    /// submitBuffer(): top the send queue back up to kBufferWindowMs.
+    void pumpBuffer();
+    /// Per-session state back to a fresh start().
     void resetSession();
     void teardown(const QString &errorMessage);
 
     Settings settings_;
     std::unique_ptr<QWebSocket> ws_;
+    std::unique_ptr<VolcengineSocketPool> pool_;
     State state_ = State::Idle;
 
     volcengine::AsrParseState parseState_;
 
     // Audio captured during ws handshake; flushed in onWsConnected() so the
-    // user's leading words aren't dropped.
+    // user's leading words aren't dropped. Overflow policy: the head is
+    // kept and audio past kMaxPendingBytes is dropped, because the start
+    // of an utterance is the part a later retry can't recover and the
+    // cap only trips when the handshake is about to time out anyway.
+    // Dropped bytes are counted per session and logged at teardown.
     QByteArray pendingAudio_;
+    qint64 pendingDroppedBytes_ = 0;
 
     // Per-connection sequence: full client request gets 1, audio frames 2..N.
     // The protocol rejects mixed seq/no-seq frames within one connection.
     qint32 nextSeq_ = 1;
 
+    // Reused for every audio_only frame: header stamped in place, no
+    // per-chunk allocation once it has grown to the largest slice.
+    volcengine::AudioFrameWriter frameWriter_;
+    // Capture chunks waiting to be coalesced into one frame (FrameMs > 40
+    // or adaptive mode under backlog). Flushed before the last frame.
+    QByteArray sendAccum_;
+    // nullptr = raw PCM straight into frameWriter_. Otherwise every frame
+    // goes through encode() into encoded_ first.
+    std::unique_ptr<volcengine::AudioEncoder> encoder_;
+    QByteArray encoded_;
+
+    // Send-queue watermarks (see kQueueHighMs in the .cpp). The wire/PCM
+    // byte totals give the session's encoding ratio for queuedMs().
+    bool congested_ = false;
+    qint64 wireBytes_ = 0;
+    qint64 wirePcmBytes_ = 0;
+    int peakQueuedMs_ = 0;
+    qint64 queueDroppedBytes_ = 0;
+    // This session's totals; the queue figures are folded in at teardown.
+    AsrTransportStats stats_;
+
+    // Set while ws_ came from pool_ and the server has not replied yet. A
+    // spare can die between take() and its first use (server idle kick
+    // racing our cork); everything sent on it is kept in spareReplay_ so
+    // a cold reconnect can resend it without losing the first words.
+    bool spareUnconfirmed_ = false;
+    QByteArray spareReplay_;
+
+    // submitBuffer() session: the whole recording, and how much of it has
+    // gone into the send queue.
+    bool bufferMode_ = false;
+    QByteArray buffer_;
+    qsizetype bufferPos_ = 0;
+
     // QWebSocket has no built-in handshake timeout — a TLS-completed but
     // upgrade-stuck server would hang in Connecting forever. Fires
     // teardown() with a clear error so the UI can recover.
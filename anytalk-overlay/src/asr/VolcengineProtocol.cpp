@@ -1,4 +1,5 @@
 #include "VolcengineProtocol.h"
+#include "AsrResponseScanner.h"
 
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -6,6 +7,11 @@
 #include <QJsonValue>
 #include <QtEndian>
 
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
 namespace volcengine {
 
 namespace {
@@ -20,21 +26,48 @@ constexpr quint8 kFlagNegWithSeq   = 0b0011;  // last frame, seq negated
 constexpr quint8 kSerJson          = 0b0001;
 constexpr quint8 kSerNone          = 0b0000;
 constexpr quint8 kCompressionNone  = 0b0000;
+constexpr quint8 kCompressionGzip  = 0b0001;
 
-QByteArray buildHeader(quint8 messageType, quint8 flags, quint8 serialization,
-                       quint8 compression) {
-    QByteArray h(4, 0);
-    h[0] = static_cast<char>(((kVersion & 0xF) << 4) | (kHeaderSize4B & 0xF));
-    h[1] = static_cast<char>(((messageType & 0xF) << 4) | (flags & 0xF));
-    h[2] = static_cast<char>(((serialization & 0xF) << 4) | (compression & 0xF));
-    h[3] = 0;
-    return h;
+// Write the 12-byte client prefix into dst: 4B header + 4B BE sequence +
+// 4B BE payload size.
+void writePrefix(char *dst, quint8 messageType, quint8 flags, quint8 serialization,
+                 quint8 compression, qint32 wireSeq, quint32 payloadSize) {
+    dst[0] = static_cast<char>(((kVersion & 0xF) << 4) | (kHeaderSize4B & 0xF));
+    dst[1] = static_cast<char>(((messageType & 0xF) << 4) | (flags & 0xF));
+    dst[2] = static_cast<char>(((serialization & 0xF) << 4) | (compression & 0xF));
+    dst[3] = 0;
+    qToBigEndian(static_cast<quint32>(wireSeq), dst + 4);
+    qToBigEndian(payloadSize, dst + 8);
 }
 
-QByteArray u32be(quint32 n) {
-    QByteArray b(4, 0);
-    qToBigEndian(n, b.data());
-    return b;
+void writeAudioPrefix(char *dst, quint32 payloadSize, bool last, qint32 seq,
+                      quint8 compression = kCompressionNone) {
+    // NEG_WITH_SEQUENCE on last so the server sees a clear end-of-stream;
+    // POS_SEQUENCE on intermediate frames so burst-flushed audio doesn't get
+    // reordered/dropped.
+    writePrefix(dst, kMsgAudioOnly, last ? kFlagNegWithSeq : kFlagPosSeq, kSerNone,
+                compression, last ? -seq : seq, payloadSize);
+}
+
+// Inflate a gzip payload; empty on corrupt input (callers then see an
+// unparsable response, same as any other garbage frame).
+QByteArray gunzip(const char *data, qsizetype size) {
+    z_stream zs{};
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) return {};
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    zs.avail_in = static_cast<uInt>(size);
+    QByteArray out;
+    int rc = Z_OK;
+    while (rc == Z_OK) {
+        const qsizetype have = out.size();
+        out.resize(have + std::max<qsizetype>(4096, size * 4));
+        zs.next_out = reinterpret_cast<Bytef *>(out.data() + have);
+        zs.avail_out = static_cast<uInt>(out.size() - have);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        out.resize(out.size() - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : QByteArray();
 }
 } // namespace
 
@@ -44,32 +77,47 @@ QByteArray buildFullClientRequest(const QByteArray &json, qint32 seq) {
     // frame in the same connection uses POS_SEQUENCE — otherwise the server
     // tries to auto-assign one and fails with "decode V1 protocol message
     // autoAssignedSequence".
-    QByteArray out;
-    out.reserve(12 + json.size());
-    out.append(buildHeader(kMsgFullClientReq, kFlagPosSeq, kSerJson, kCompressionNone));
-    out.append(u32be(static_cast<quint32>(seq)));
-    out.append(u32be(static_cast<quint32>(json.size())));
-    out.append(json);
+    QByteArray out(kFrameHeaderBytes + json.size(), Qt::Uninitialized);
+    writePrefix(out.data(), kMsgFullClientReq, kFlagPosSeq, kSerJson, kCompressionNone, seq,
+                static_cast<quint32>(json.size()));
+    std::memcpy(out.data() + kFrameHeaderBytes, json.constData(), json.size());
     return out;
 }
 
 QByteArray buildAudioOnlyRequest(const QByteArray &pcm, bool last, qint32 seq) {
     // Wire layout: 4B header + 4B sequence (BE int32, negated on last frame)
-    // + 4B payload size + raw PCM. NEG_WITH_SEQUENCE on last so the server
-    // sees a clear end-of-stream; POS_SEQUENCE on intermediate frames so
-    // burst-flushed audio doesn't get reordered/dropped.
-    const quint8 flags = last ? kFlagNegWithSeq : kFlagPosSeq;
-    const qint32 wireSeq = last ? -seq : seq;
-
-    QByteArray out;
-    out.reserve(12 + pcm.size());
-    out.append(buildHeader(kMsgAudioOnly, flags, kSerNone, kCompressionNone));
-    out.append(u32be(static_cast<quint32>(wireSeq)));
-    out.append(u32be(static_cast<quint32>(pcm.size())));
-    out.append(pcm);
+    // + 4B payload size + raw PCM. One allocation; AudioFrameWriter is the
+    // allocation-free variant for the streaming path.
+    QByteArray out(kFrameHeaderBytes + pcm.size(), Qt::Uninitialized);
+    writeAudioPrefix(out.data(), static_cast<quint32>(pcm.size()), last, seq);
+    std::memcpy(out.data() + kFrameHeaderBytes, pcm.constData(), pcm.size());
     return out;
 }
 
+AudioFrameWriter::AudioFrameWriter(int reservePayloadBytes) {
+    buf_.reserve(kFrameHeaderBytes + std::max(reservePayloadBytes, 0));
+}
+
+char *AudioFrameWriter::payload(int bytes) {
+    // resize() within capacity on an unshared buffer neither allocates nor
+    // touches the bytes; it only moves size().
+    buf_.resize(kFrameHeaderBytes + std::max(bytes, 0));
+    return buf_.data() + kFrameHeaderBytes;
+}
+
+const QByteArray &AudioFrameWriter::finish(bool last, qint32 seq) {
+    if (buf_.size() < kFrameHeaderBytes) payload(0);
+    writeAudioPrefix(buf_.data(), static_cast<quint32>(buf_.size() - kFrameHeaderBytes),
+                     last, seq, gzip_ ? kCompressionGzip : kCompressionNone);
+    return buf_;
+}
+
+const QByteArray &AudioFrameWriter::build(const char *pcm, int bytes, bool last, qint32 seq) {
+    char *dst = payload(bytes);
+    if (bytes > 0) std::memcpy(dst, pcm, static_cast<size_t>(bytes));
+    return finish(last, seq);
+}
+
 ParsedFrame parseServerFrame(const QByteArray &data) {
     ParsedFrame f;
     if (data.size() < 4) return f;
@@ -80,6 +128,7 @@ ParsedFrame parseServerFrame(const QByteArray &data) {
 
     const quint8 messageType = (b1 >> 4) & 0xF;
     f.flags = b1 & 0xF;
+    const bool gzipped = (static_cast<uint8_t>(data[2]) & 0xF) == kCompressionGzip;
 
     if (data.size() < 12) return f;
 
@@ -88,7 +137,8 @@ ParsedFrame parseServerFrame(const QByteArray &data) {
             qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(data.constData() + 8));
         if (data.size() < static_cast<int>(12 + payloadSize)) return f;
         f.kind = ParsedFrame::Kind::Response;
-        f.jsonText = data.mid(12, payloadSize);
+        f.jsonText = gzipped ? gunzip(data.constData() + 12, payloadSize)
+                             : data.mid(12, payloadSize);
         return f;
     }
 
@@ -100,16 +150,20 @@ ParsedFrame parseServerFrame(const QByteArray &data) {
         if (data.size() < static_cast<int>(12 + msgSize)) return f;
         f.kind = ParsedFrame::Kind::Error;
         f.errorCode = code;
-        f.errorMessage = QString::fromUtf8(data.mid(12, msgSize));
+        f.errorMessage = QString::fromUtf8(gzipped ? gunzip(data.constData() + 12, msgSize)
+                                                   : data.mid(12, msgSize));
         return f;
     }
     return f;
 }
 
-QByteArray buildInitialRequestJson(const QString &mode, bool enableNonstream) {
+QByteArray buildInitialRequestJson(const QString &mode, bool enableNonstream,
+                                   const QString &format, const QString &codec,
+                                   bool incrementalResults) {
     const bool isNoStream = (mode == QLatin1String("nostream"));
     QJsonObject audio{
-        {"format", "pcm"}, {"rate", 16000}, {"bits", 16}, {"channel", 1}};
+        {"format", format}, {"rate", 16000}, {"bits", 16}, {"channel", 1}};
+    if (codec != QLatin1String("raw")) audio.insert("codec", codec);
     if (isNoStream) audio.insert("language", "zh-CN");
 
     QJsonObject request{
@@ -128,6 +182,12 @@ QByteArray buildInitialRequestJson(const QString &mode, bool enableNonstream) {
     if (enableNonstream && mode == QLatin1String("bidi")) {
         request.insert("enable_nonstream", true);
     }
+    // Incremental results only say which text is settled through the
+    // utterances' definite flags, so those have to come along.
+    if (incrementalResults) {
+        request.insert("result_type", "single");
+        request.insert("show_utterances", true);
+    }
 
     QJsonObject root{
         {"user", QJsonObject{{"uid", "anytalk"}}},
@@ -137,8 +197,29 @@ QByteArray buildInitialRequestJson(const QString &mode, bool enableNonstream) {
     return QJsonDocument(root).toJson(QJsonDocument::Compact);
 }
 
-AsrParsed parseAsrResponse(const QByteArray &jsonBytes, AsrParseState &state,
-                            const QString &mode) {
+namespace {
+
+// result.text-only responses (no utterances array).
+void applyFullText(const QString &fullText, AsrParseState &state, const QString &mode,
+                   AsrParsed &result) {
+    if (fullText.isEmpty()) return;
+
+    if (mode == QLatin1String("bidi_async")) {
+        result.partial = fullText;
+        result.finals.append(fullText);
+    } else if (!state.lastFullText.isEmpty() && fullText.startsWith(state.lastFullText)) {
+        const QString suffix = fullText.mid(state.lastFullText.size()).trimmed();
+        if (!suffix.isEmpty()) result.finals.append(suffix);
+    } else if (fullText != state.lastFullText) {
+        result.finals.append(fullText);
+    }
+    state.lastFullText = fullText;
+}
+
+} // namespace
+
+AsrParsed parseAsrResponseDom(const QByteArray &jsonBytes, AsrParseState &state,
+                              const QString &mode) {
     AsrParsed result;
 
     QJsonParseError perr{};
@@ -187,19 +268,96 @@ AsrParsed parseAsrResponse(const QByteArray &jsonBytes, AsrParseState &state,
     }
 
     // Fallback: result.text (no utterances array).
-    const auto fullText = trim(resultObj.value(QStringLiteral("text")).toString());
-    if (fullText.isEmpty()) return result;
+    applyFullText(trim(resultObj.value(QStringLiteral("text")).toString()), state, mode, result);
+    return result;
+}
 
-    if (mode == QLatin1String("bidi_async")) {
-        result.partial = fullText;
-        result.finals.append(fullText);
-    } else if (!state.lastFullText.isEmpty() && fullText.startsWith(state.lastFullText)) {
-        const QString suffix = trim(fullText.mid(state.lastFullText.size()));
-        if (!suffix.isEmpty()) result.finals.append(suffix);
-    } else if (fullText != state.lastFullText) {
-        result.finals.append(fullText);
+namespace {
+
+QString spanRaw(const scan::Span &s) {
+    if (!s.present) return {};
+    if (!s.escaped) return QString::fromUtf8(s.data, static_cast<qsizetype>(s.size));
+    const std::string decoded = scan::decode(s);
+    return QString::fromUtf8(decoded.data(), static_cast<qsizetype>(decoded.size()));
+}
+
+// Rebuild the result.text a result_type "full" response would have carried:
+// every finished segment, then whatever is still live.
+QString spanText(const scan::Span &s) { return spanRaw(s).trimmed(); }
+
+QString stitchIncremental(const scan::Result &scanned, AsrParseState &state) {
+    if (!scanned.hasUtterances) {
+        return (state.finishedSegments + spanRaw(scanned.text)).trimmed();
     }
-    state.lastFullText = fullText;
+    QString live;
+    for (const auto &u : scanned.utterances) {
+        if (u.definite) {
+            if (u.endTime <= state.lastSegmentEndTime) continue;
+            state.finishedSegments += spanRaw(u.text);
+            state.lastSegmentEndTime = u.endTime;
+        } else {
+            live += spanRaw(u.text);
+        }
+    }
+    return (state.finishedSegments + live).trimmed();
+}
+
+} // namespace
+
+AsrParsed parseAsrResponse(const QByteArray &jsonBytes, AsrParseState &state,
+                            const QString &mode) {
+    // Reused so the utterance vector keeps its capacity across frames.
+    static thread_local scan::Result scanned;
+    const qint64 settledEndTime =
+        state.incremental ? state.lastSegmentEndTime : state.lastCommittedEndTime;
+    if (!scan::scanResponse(jsonBytes.constData(), static_cast<std::size_t>(jsonBytes.size()),
+                            settledEndTime, scanned)) {
+        // The DOM path only knows full-mode payloads; an incremental one it
+        // can't stitch is dropped rather than committed as if it were whole.
+        if (state.incremental) return {};
+        return parseAsrResponseDom(jsonBytes, state, mode);
+    }
+
+    AsrParsed result;
+    if (!scanned.hasResult) return result;
+
+    if (state.incremental) {
+        // Kept up to date either way, for a later response without
+        // utterances.
+        const QString stitched = stitchIncremental(scanned, state);
+        if (!scanned.hasUtterances) {
+            applyFullText(stitched, state, mode, result);
+            return result;
+        }
+        // With utterances a "single" response is a "full" one minus the
+        // definite segments already sent, which the loop below skips by
+        // end_time anyway: same finals, same partial. (Through
+        // applyFullText, bidi_async would commit the whole text again on
+        // every response.)
+    }
+
+    if (scanned.hasUtterances) {
+        // The scanner already dropped definites at or before the committed
+        // end_time; the check stays for dedup within this one message.
+        for (const auto &u : scanned.utterances) {
+            if (!u.definite || u.endTime <= state.lastCommittedEndTime) continue;
+            const QString text = spanText(u.text);
+            if (text.isEmpty()) continue;
+            result.finals.append(text);
+            state.lastCommittedEndTime = u.endTime;
+        }
+        // Only the partial we keep gets decoded.
+        for (auto it = scanned.utterances.crbegin(); it != scanned.utterances.crend(); ++it) {
+            if (it->definite) continue;
+            QString text = spanText(it->text);
+            if (text.isEmpty()) continue;
+            result.partial = std::move(text);
+            break;
+        }
+        return result;
+    }
+
+    applyFullText(spanText(scanned.text), state, mode, result);
     return result;
 }
 
@@ -12,6 +12,41 @@ namespace volcengine {
 QByteArray buildFullClientRequest(const QByteArray &json, qint32 seq);
 QByteArray buildAudioOnlyRequest(const QByteArray &pcm, bool last, qint32 seq);
 
+/// Every client frame starts with 4B header + 4B sequence + 4B payload size.
+inline constexpr int kFrameHeaderBytes = 12;
+
+/// Reusable AUDIO_ONLY_REQUEST buffer for the per-chunk hot path.
+///
+/// The 12-byte prefix is stamped in place ahead of the payload, so a frame
+/// costs one memcpy of the PCM and — once the buffer has grown to the
+/// largest frame seen — no allocation at all. QWebSocket masks the
+/// payload into its own frame buffer inside sendBinaryMessage(), so the
+/// returned array can be reused as soon as that call returns.
+///
+///   char *dst = w.payload(n); fill(dst, n); ws->sendBinaryMessage(w.finish(last, seq));
+/// or
+///   ws->sendBinaryMessage(w.build(pcm, n, last, seq));
+class AudioFrameWriter {
+public:
+    explicit AudioFrameWriter(int reservePayloadBytes = 0);
+
+    /// Mark subsequent frames' payloads as gzip-compressed (header flag only;
+    /// the caller hands in already-compressed bytes).
+    void setGzip(bool gzip) { gzip_ = gzip; }
+
+    /// Size the frame for `bytes` of payload and return where it goes.
+    /// Invalidates the result of the previous finish()/build().
+    char *payload(int bytes);
+    /// Stamp the header for the payload sized by the last payload() call.
+    const QByteArray &finish(bool last, qint32 seq);
+    /// payload() + memcpy + finish().
+    const QByteArray &build(const char *pcm, int bytes, bool last, qint32 seq);
+
+private:
+    QByteArray buf_;
+    bool gzip_ = false;
+};
+
 struct ParsedFrame {
     enum class Kind { Unknown, Response, Error };
     Kind kind = Kind::Unknown;
@@ -22,17 +57,35 @@ struct ParsedFrame {
     bool isFinalFrame() const { return (flags & 0x3) == 0x3; } // 0b0011
 };
 
+/// Gzip-compressed payloads (the server mirrors the client's compression)
+/// are inflated, so jsonText / errorMessage are always plain.
 ParsedFrame parseServerFrame(const QByteArray &data);
 
 /// Build the initial FULL_CLIENT_REQUEST JSON. `enableNonstream` toggles
 /// Doubao's two-pass recognition (partials over bidi + finals re-run via
 /// nostream). Server-side: only honored when mode == "bidi"; ignored
-/// silently elsewhere per docs.
-QByteArray buildInitialRequestJson(const QString &mode, bool enableNonstream = false);
+/// silently elsewhere per docs. `format` / `codec` describe the audio_only
+/// payloads (see AudioEncoder); "raw" is the server default and omitted.
+/// `incrementalResults` asks for result_type "single" (see AsrParseState).
+QByteArray buildInitialRequestJson(const QString &mode, bool enableNonstream = false,
+                                   const QString &format = QStringLiteral("pcm"),
+                                   const QString &codec = QStringLiteral("raw"),
+                                   bool incrementalResults = false);
 
 struct AsrParseState {
     qint64 lastCommittedEndTime = -1;
     QString lastFullText;
+
+    // result_type "single": the server stops resending segments once they
+    // are definite, so each response only carries the live one. The
+    // request then also enables show_utterances to learn where segments
+    // end, and parseAsrResponse() stitches finished segments back in front
+    // of the live text — the caller sees the same partial / finals as with
+    // result_type "full", without the response growing with the session
+    // (checked by anytalk-bench --diff-result-type).
+    bool incremental = false;
+    QString finishedSegments;     // raw text of definite segments, in order
+    qint64 lastSegmentEndTime = -1;
 };
 
 struct AsrParsed {
@@ -43,5 +96,9 @@ struct AsrParsed {
 /// Parse a server JSON payload, extracting partial / finals.
 /// Stateful: caller persists `state` across messages within a session.
 AsrParsed parseAsrResponse(const QByteArray &json, AsrParseState &state, const QString &mode);
+/// The same over QJsonDocument: what parseAsrResponse() falls back to when
+/// its scanner rejects a payload, and the reference anytalk-bench --micro
+/// times it against. result_type "full" payloads only.
+AsrParsed parseAsrResponseDom(const QByteArray &json, AsrParseState &state, const QString &mode);
 
 } // namespace volcengine
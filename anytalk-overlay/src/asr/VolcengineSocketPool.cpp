@@ -0,0 +1,102 @@
+#include "VolcengineSocketPool.h"
+
+#include <QDebug>
+#include <QWebSocket>
+#include <algorithm>
+
+VolcengineSocketPool::VolcengineSocketPool(RequestFactory makeRequest, int capacity,
+                                           int maxIdleMs, int warmWindowMs, QObject *parent)
+    : QObject(parent),
+      makeRequest_(std::move(makeRequest)),
+      capacity_(std::max(0, capacity)),
+      maxIdleMs_(std::max(1000, maxIdleMs)),
+      warmWindowMs_(std::max(0, warmWindowMs)) {
+    sweepTimer_.setSingleShot(true);
+    connect(&sweepTimer_, &QTimer::timeout, this, &VolcengineSocketPool::sweep);
+}
+
+VolcengineSocketPool::~VolcengineSocketPool() { clear(); }
+
+void VolcengineSocketPool::discard(std::unique_ptr<QWebSocket> ws) {
+    if (!ws) return;
+    // Same deferred-destruction rule as VolcengineBackend::teardown: we may
+    // be inside one of this socket's own signal emissions.
+    QWebSocket *raw = ws.release();
+    raw->disconnect();
+    if (raw->state() != QAbstractSocket::UnconnectedState) raw->close();
+    raw->deleteLater();
+}
+
+void VolcengineSocketPool::openSpare() {
+    Spare spare;
+    spare.ws = std::make_unique<QWebSocket>();
+    // Only lifecycle signals: a spare never carries session traffic. A
+    // dead spare is reaped on the next event-loop turn rather than inside
+    // the socket's own emit.
+    auto reap = [this]() {
+        QMetaObject::invokeMethod(this, &VolcengineSocketPool::sweep, Qt::QueuedConnection);
+    };
+    connect(spare.ws.get(), &QWebSocket::disconnected, this, reap);
+    connect(spare.ws.get(), &QWebSocket::errorOccurred, this, reap);
+    spare.ws->open(makeRequest_());
+    spare.age.start();
+    spares_.push_back(std::move(spare));
+}
+
+std::unique_ptr<QWebSocket> VolcengineSocketPool::take() {
+    sweep();
+    auto pick = [this](QAbstractSocket::SocketState wanted) -> std::unique_ptr<QWebSocket> {
+        for (auto it = spares_.begin(); it != spares_.end(); ++it) {
+            if (it->ws->state() != wanted) continue;
+            std::unique_ptr<QWebSocket> ws = std::move(it->ws);
+            spares_.erase(it);
+            ws->disconnect(this);
+            return ws;
+        }
+        return nullptr;
+    };
+    if (auto ws = pick(QAbstractSocket::ConnectedState)) return ws;
+    return pick(QAbstractSocket::ConnectingState);
+}
+
+void VolcengineSocketPool::refill() {
+    if (capacity_ == 0) return;
+    warmSince_.start();
+    sweep();
+}
+
+void VolcengineSocketPool::clear() {
+    sweepTimer_.stop();
+    warmSince_.invalidate();
+    for (auto &spare : spares_) discard(std::move(spare.ws));
+    spares_.clear();
+}
+
+void VolcengineSocketPool::sweep() {
+    // 1. Reap the dead (server closed / network dropped) and the expired —
+    //    expire a bit before the server's own idle kick would.
+    spares_.erase(std::remove_if(spares_.begin(), spares_.end(), [this](Spare &s) {
+        const auto st = s.ws->state();
+        const bool alive = st == QAbstractSocket::ConnectedState ||
+                           st == QAbstractSocket::ConnectingState ||
+                           st == QAbstractSocket::HostLookupState;
+        if (alive && s.age.elapsed() < maxIdleMs_) return false;
+        discard(std::move(s.ws));
+        return true;
+    }), spares_.end());
+
+    // 2. Rotate fresh ones in while the warm window is open.
+    const bool warm = warmSince_.isValid() && warmSince_.elapsed() < warmWindowMs_;
+    if (warm) {
+        while (static_cast<int>(spares_.size()) < capacity_) openSpare();
+    }
+
+    // 3. Wake up again at the next expiry.
+    if (spares_.empty()) {
+        sweepTimer_.stop();
+        return;
+    }
+    qint64 nextMs = maxIdleMs_;
+    for (const auto &s : spares_) nextMs = std::min(nextMs, maxIdleMs_ - s.age.elapsed());
+    sweepTimer_.start(static_cast<int>(std::max<qint64>(nextMs, 0)) + 1);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QTimer>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QWebSocket;
+
+/// Keeps a small number of WebSocket connections to the SAUC endpoint
+/// already through DNS + TCP + TLS + HTTP upgrade, so the next session can
+/// skip the 150–600 ms handshake.
+///
+/// Spares are never reused across sessions: the server binds one ws to one
+/// recognition session (and kicks idle sockets within seconds), so each
+/// spare is opened with a fresh request — fresh X-Api-Connect-Id — from
+/// `makeRequest`, handed out once by take(), and expired after
+/// `maxIdleMs` if nobody claims it. Expired spares are rotated (closed and
+/// re-opened) only inside the warm window that follows a refill(); past
+/// that the pool drains to empty and the next session cold-connects.
+class VolcengineSocketPool : public QObject {
+    Q_OBJECT
+public:
+    using RequestFactory = std::function<QNetworkRequest()>;
+
+    VolcengineSocketPool(RequestFactory makeRequest, int capacity, int maxIdleMs,
+                         int warmWindowMs, QObject *parent = nullptr);
+    ~VolcengineSocketPool() override;
+
+    /// Hand out a spare — preferring one that finished its handshake, else
+    /// one still connecting. nullptr means "nothing usable, cold-connect".
+    /// The caller owns the socket; the pool no longer watches it.
+    std::unique_ptr<QWebSocket> take();
+
+    /// Top up to capacity and (re)start the warm window.
+    void refill();
+
+    /// Close every spare and stop rotating.
+    void clear();
+
+    int size() const { return static_cast<int>(spares_.size()); }
+
+private:
+    struct Spare {
+        std::unique_ptr<QWebSocket> ws;
+        QElapsedTimer age; // since open(); covers stuck handshakes too
+    };
+
+    void openSpare();
+    /// Drop dead / expired spares, rotate inside the warm window, and
+    /// re-arm sweepTimer_ for the next expiry.
+    void sweep();
+    static void discard(std::unique_ptr<QWebSocket> ws);
+
+    RequestFactory makeRequest_;
+    int capacity_;
+    int maxIdleMs_;
+    int warmWindowMs_;
+    std::vector<Spare> spares_;
+    QElapsedTimer warmSince_;
+    QTimer sweepTimer_;
+};
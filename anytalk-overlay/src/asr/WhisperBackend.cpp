@@ -0,0 +1,321 @@
+#include "WhisperBackend.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QPointer>
+#include <QThreadPool>
+
+#include <whisper.h>
+
+#include <algorithm>
+#include <fcntl.h>
+#include <map>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+struct WhisperModel {
+    whisper_context *ctx = nullptr;
+    ~WhisperModel() {
+        if (ctx) whisper_free(ctx);
+    }
+};
+
+// Per-backend decode state on a shared model: whisper_full_with_state lets
+// several of these use one context, but each one only serially.
+struct WhisperDecoder {
+    std::shared_ptr<WhisperModel> model;
+    whisper_state *state = nullptr;
+    ~WhisperDecoder() {
+        if (state) whisper_free_state(state);
+    }
+};
+
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr int kSamplesPerMs = kSampleRate / 1000;
+// whisper timestamps are in 10 ms units.
+constexpr int kSamplesPerTick = kSampleRate / 100;
+// Below this there is nothing whisper can usefully decode.
+constexpr int kMinDecodeSamples = kSampleRate / 10;
+// Kept when a window with no segments at all is dropped.
+constexpr int kSilenceTailSamples = kSampleRate;
+
+// Main thread only. Weak: the model lives exactly as long as some backend
+// holds it. A config re-apply only finds it still loaded because
+// AsrController prewarms the new backend before it drops the old one.
+std::map<QString, std::weak_ptr<WhisperModel>> &modelCache() {
+    static std::map<QString, std::weak_ptr<WhisperModel>> cache;
+    return cache;
+}
+
+// Worker thread. whisper.cpp copies the weights into its own ggml buffers,
+// so the mapping only has to outlive init; reading through it skips the
+// per-tensor fread calls and shares the page cache with a previous load.
+std::shared_ptr<WhisperModel> loadModel(const QString &path, bool useGpu, QString &error) {
+    const QByteArray file = path.toLocal8Bit();
+    const int fd = ::open(file.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = QStringLiteral("无法打开本地模型：%1").arg(path);
+        return nullptr;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        error = QStringLiteral("本地模型文件无效：%1").arg(path);
+        return nullptr;
+    }
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = QStringLiteral("无法映射本地模型：%1").arg(path);
+        return nullptr;
+    }
+    whisper_context_params params = whisper_context_default_params();
+    params.use_gpu = useGpu;
+    auto model = std::make_shared<WhisperModel>();
+    model->ctx = whisper_init_from_buffer_with_params(data, size, params);
+    ::munmap(data, size);
+    if (!model->ctx) {
+        error = QStringLiteral("本地模型加载失败：%1").arg(path);
+        return nullptr;
+    }
+    return model;
+}
+
+// Run `fn` on the main thread if `guard` is still alive by then.
+template <typename Fn>
+void postBack(QPointer<WhisperBackend> guard, Fn fn) {
+    QMetaObject::invokeMethod(
+        QCoreApplication::instance(),
+        [guard, fn = std::move(fn)]() mutable {
+            if (guard) fn(guard.data());
+        },
+        Qt::QueuedConnection);
+}
+
+} // namespace
+
+WhisperBackend::WhisperBackend(Settings settings, QObject *parent)
+    : AsrBackend(parent), settings_(std::move(settings)) {
+    if (settings_.threads <= 0) {
+        settings_.threads =
+            static_cast<int>(std::clamp(std::thread::hardware_concurrency(), 1u, 4u));
+    }
+    settings_.stepMs = std::clamp(settings_.stepMs, 200, 5'000);
+    // whisper's encoder sees 30 s at most.
+    settings_.windowMs = std::clamp(settings_.windowMs, 5'000, 28'000);
+    if (!settings_.language.startsWith(QLatin1String("zh"))) settings_.initialPrompt.clear();
+}
+
+WhisperBackend::~WhisperBackend() {
+    // An in-flight decode keeps decoder_ alive on its own; just make it
+    // return early.
+    if (abort_) abort_->store(true);
+}
+
+void WhisperBackend::prewarm() { ensureModel(); }
+
+void WhisperBackend::ensureModel() {
+    if (decoder_ || loading_) return;
+    auto &cache = modelCache();
+    if (auto it = cache.find(settings_.modelPath); it != cache.end()) {
+        if (auto model = it->second.lock()) {
+            onModelLoaded(std::move(model), {});
+            return;
+        }
+    }
+    loading_ = true;
+    loadError_.clear();
+    qInfo().noquote() << "WhisperBackend: loading" << settings_.modelPath;
+    QThreadPool::globalInstance()->start(
+        [guard = QPointer<WhisperBackend>(this), path = settings_.modelPath,
+         gpu = settings_.useGpu]() {
+            QString error;
+            auto model = loadModel(path, gpu, error);
+            postBack(guard, [model = std::move(model), error](WhisperBackend *self) {
+                self->onModelLoaded(model, error);
+            });
+        });
+}
+
+void WhisperBackend::onModelLoaded(std::shared_ptr<WhisperModel> model, const QString &error) {
+    loading_ = false;
+    if (model) {
+        modelCache()[settings_.modelPath] = model;
+        auto decoder = std::make_shared<WhisperDecoder>();
+        decoder->model = model;
+        decoder->state = whisper_init_state(model->ctx);
+        if (decoder->state) {
+            decoder_ = std::move(decoder);
+            maybeDecode();
+            return;
+        }
+        loadError_ = QStringLiteral("本地模型初始化失败");
+    } else {
+        loadError_ = error;
+    }
+    qWarning().noquote() << "WhisperBackend:" << loadError_;
+    // Outside a session this waits for the next start() to report it.
+    if (state_ != State::Idle) fail(loadError_);
+}
+
+void WhisperBackend::start() {
+    if (state_ != State::Idle) return;
+    ++generation_;
+    abort_ = std::make_shared<std::atomic_bool>(false);
+    window_.clear();
+    sinceDecode_ = 0;
+    state_ = State::Recording;
+    // Nothing to connect to: only the mic gates Recording.
+    emit connected();
+    // No-op once loaded; after a failed load this retries it.
+    ensureModel();
+}
+
+void WhisperBackend::pushPcm(const QByteArray &chunk) {
+    if (state_ != State::Recording) return;
+    const auto *s = reinterpret_cast<const std::int16_t *>(chunk.constData());
+    const int n = static_cast<int>(chunk.size() / 2);
+    window_.reserve(window_.size() + static_cast<std::size_t>(n));
+    for (int i = 0; i < n; ++i) window_.push_back(static_cast<float>(s[i]) / 32768.0f);
+    sinceDecode_ += n;
+    maybeDecode();
+}
+
+void WhisperBackend::stop() {
+    if (state_ != State::Recording) return;
+    state_ = State::Stopping;
+    maybeDecode();
+}
+
+void WhisperBackend::cancel() {
+    if (state_ == State::Idle) return;
+    // A decode in flight keeps running to its abort check; decoding_ stays
+    // set until it reports back, because the whisper_state is still busy.
+    if (abort_) abort_->store(true);
+    ++generation_;
+    window_.clear();
+    sinceDecode_ = 0;
+    state_ = State::Idle;
+}
+
+void WhisperBackend::maybeDecode() {
+    if (!decoder_ || decoding_ || state_ == State::Idle) return;
+    const bool last = state_ == State::Stopping;
+    if (last && static_cast<int>(window_.size()) < kMinDecodeSamples) {
+        finishSession();
+        return;
+    }
+    if (!last && sinceDecode_ < settings_.stepMs * kSamplesPerMs) return;
+
+    decoding_ = true;
+    sinceDecode_ = 0;
+    QThreadPool::globalInstance()->start(
+        [guard = QPointer<WhisperBackend>(this), decoder = decoder_, abort = abort_,
+         generation = generation_, last, pcm = window_, settings = settings_]() {
+            Decoded r;
+            r.windowSamples = static_cast<int>(pcm.size());
+            const QByteArray language = settings.language.toUtf8();
+            const QByteArray prompt = settings.initialPrompt.toUtf8();
+            whisper_full_params p = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+            p.n_threads = settings.threads;
+            p.language = language.constData();
+            p.translate = false;
+            p.no_context = true;
+            p.suppress_blank = true;
+            p.print_progress = false;
+            p.print_realtime = false;
+            p.print_special = false;
+            p.print_timestamps = false;
+            p.initial_prompt = prompt.isEmpty() ? nullptr : prompt.constData();
+            p.abort_callback = [](void *flag) {
+                return static_cast<std::atomic_bool *>(flag)->load();
+            };
+            p.abort_callback_user_data = abort.get();
+            r.ok = whisper_full_with_state(decoder->model->ctx, decoder->state, p, pcm.data(),
+                                           static_cast<int>(pcm.size())) == 0;
+            if (r.ok) {
+                const int n = whisper_full_n_segments_from_state(decoder->state);
+                for (int i = 0; i < n; ++i) {
+                    r.segments.append(QString::fromUtf8(
+                        whisper_full_get_segment_text_from_state(decoder->state, i)));
+                    r.ends.push_back(
+                        whisper_full_get_segment_t1_from_state(decoder->state, i) *
+                        kSamplesPerTick);
+                }
+            }
+            postBack(guard, [generation, last, r = std::move(r)](WhisperBackend *self) mutable {
+                self->onDecoded(generation, std::move(r), last);
+            });
+        });
+}
+
+void WhisperBackend::onDecoded(std::uint64_t generation, Decoded r, bool last) {
+    decoding_ = false;
+    if (generation != generation_) {
+        // Cancelled mid-decode; a new session may be waiting for the state.
+        maybeDecode();
+        return;
+    }
+    if (!r.ok) {
+        fail(QStringLiteral("本地识别失败"));
+        return;
+    }
+
+    const int n = static_cast<int>(r.segments.size());
+    int stable = last ? n : n - 1;
+    if (!last && n == 1 && r.windowSamples >= settings_.windowMs * kSamplesPerMs) {
+        // One long segment and no break in sight: cut it here.
+        stable = 1;
+    }
+    if (stable > 0) {
+        QString text;
+        for (int i = 0; i < stable; ++i) text += r.segments.at(i);
+        text = text.trimmed();
+        // Audio up to the last stable segment's end leaves the window;
+        // everything pushed since this decode started stays.
+        const bool whole = last || stable == n;
+        const auto cut = static_cast<std::size_t>(std::clamp<std::int64_t>(
+            whole ? r.windowSamples : r.ends[static_cast<std::size_t>(stable - 1)], 0,
+            r.windowSamples));
+        window_.erase(window_.begin(), window_.begin() + static_cast<std::ptrdiff_t>(cut));
+        if (!text.isEmpty()) emit final_(text);
+    }
+    if (stable < n) emit partial(r.segments.last().trimmed());
+    if (!last && n == 0 && r.windowSamples >= settings_.windowMs * kSamplesPerMs) {
+        // A full window of nothing (silence, noise): without a segment to
+        // cut at it would only grow, and every decode re-reads all of it.
+        // The tail may hold the start of a word.
+        const auto cut = static_cast<std::size_t>(
+            std::min<std::int64_t>(r.windowSamples - kSilenceTailSamples,
+                                   static_cast<std::int64_t>(window_.size())));
+        window_.erase(window_.begin(), window_.begin() + static_cast<std::ptrdiff_t>(cut));
+    }
+
+    if (last) {
+        finishSession();
+        return;
+    }
+    maybeDecode();
+}
+
+void WhisperBackend::finishSession() {
+    state_ = State::Idle;
+    window_.clear();
+    sinceDecode_ = 0;
+    emit finished();
+}
+
+void WhisperBackend::fail(const QString &message) {
+    if (abort_) abort_->store(true);
+    ++generation_;
+    state_ = State::Idle;
+    window_.clear();
+    sinceDecode_ = 0;
+    emit error(message);
+}
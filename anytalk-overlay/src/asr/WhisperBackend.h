@@ -0,0 +1,91 @@
+#pragma once
+#include "AsrBackend.h"
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct WhisperModel;
+struct WhisperDecoder;
+
+/// Offline ASR on a whisper.cpp / ggml model, in-process. Only built when
+/// whisper.cpp is found (ANYTALK_HAS_WHISPER).
+///
+/// There is no connect step, so start() emits connected() at once and the
+/// session only waits on the mic. Audio accumulates in a window; every
+/// stepMs of new audio the whole window is decoded on the global thread
+/// pool: one decode in flight, whisper parallelises inside it, and tasks
+/// hold their own references so a backend never waits on one to die. All
+/// segments but the last are stable: they go out as final_ and their audio
+/// leaves the window; the last one is the partial. A window that reaches
+/// windowMs without a segment break is finalised whole; one with no
+/// segment at all is dropped but for its last second. stop() runs one
+/// last decode over what is left.
+///
+/// The model file is mmap'd for loading and the context is shared between
+/// backends with the same path, so a resident overlay loads it once —
+/// on prewarm(), ahead of the first F2 — and keeps it across sessions and
+/// config re-applies (as long as the replacement is prewarmed while the
+/// old backend is still alive).
+class WhisperBackend : public AsrBackend {
+    Q_OBJECT
+public:
+    struct Settings {
+        QString modelPath;                     // ggml model file
+        QString language = QStringLiteral("zh");
+        int threads = 0;                       // 0 = min(4, cores)
+        int stepMs = 800;                      // new audio between decodes
+        int windowMs = 15'000;                 // force a final past this
+        // Nudges the multilingual models toward simplified Chinese with
+        // punctuation; cleared for other languages.
+        QString initialPrompt = QStringLiteral("以下是普通话的句子。");
+        bool useGpu = false;
+    };
+
+    explicit WhisperBackend(Settings settings, QObject *parent = nullptr);
+    ~WhisperBackend() override;
+
+    void start() override;
+    void pushPcm(const QByteArray &chunk) override;
+    void stop() override;
+    void cancel() override;
+    void prewarm() override;
+
+private:
+    enum class State { Idle, Recording, Stopping };
+
+    struct Decoded {
+        bool ok = false;
+        QStringList segments;
+        std::vector<std::int64_t> ends;  // segment end, in samples
+        int windowSamples = 0;           // how much of window_ was decoded
+    };
+
+    /// Look up / start loading the model; decoders are created on load.
+    void ensureModel();
+    void onModelLoaded(std::shared_ptr<WhisperModel> model, const QString &error);
+    /// Launch a decode if one is due and none is in flight.
+    void maybeDecode();
+    void onDecoded(std::uint64_t generation, Decoded result, bool last);
+    void finishSession();
+    void fail(const QString &message);
+
+    Settings settings_;
+    State state_ = State::Idle;
+
+    std::shared_ptr<WhisperDecoder> decoder_;  // holds the model too
+    bool loading_ = false;
+    QString loadError_;
+
+    // 16 kHz mono float, as whisper wants it. Front = oldest unfinalised
+    // audio; decodes only ever read a copy.
+    std::vector<float> window_;
+    int sinceDecode_ = 0;  // samples pushed since the last decode launched
+    bool decoding_ = false;
+    // Bumped per session / cancel: results from an older one are dropped.
+    std::uint64_t generation_ = 0;
+    std::shared_ptr<std::atomic_bool> abort_;
+};
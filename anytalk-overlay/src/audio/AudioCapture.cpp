@@ -1,15 +1,35 @@
 #include "AudioCapture.h"
+#include "LevelKernel.h"
+#include "PcmRing.h"
 
 #include <QDebug>
+#include <QSocketNotifier>
+#include <QTimer>
 #include <pulse/error.h>
 #include <pulse/simple.h>
-#include <cmath>
+#include <algorithm>
 
-AudioCapture::AudioCapture(QObject *parent) : QObject(parent) {}
+namespace {
+// Cap how long teardown waits for PA to let go; see teardownStream().
+constexpr int kShutdownTimeoutMs = 2000;
+// One PcmRing slot per pre-rolled chunk when a session starts, so keep
+// the replay well inside kRingSlots.
+constexpr int kMaxPreRollMs = 1000;
+// openStandby(): when to re-check a source that learns isBluetooth() late.
+constexpr int kStandbyProbeMs = 1000;
+} // namespace
+
+AudioCapture::AudioCapture(QObject *parent) : QObject(parent) {
+    qInfo() << "AudioCapture: level kernel" << level::kernelName();
+}
 
 AudioCapture::~AudioCapture() {
     active_.store(false, std::memory_order_release);
+    closeSource();
     teardownStream();
+    // Before ring_ (and its eventfd) goes away with the members.
+    delete ringNotifier_;
+    ringNotifier_ = nullptr;
 }
 
 void AudioCapture::teardownStream() {
@@ -21,13 +41,13 @@ void AudioCapture::teardownStream() {
         // wait() pins the entire overlay process. Better to leak the
         // thread + pa_simple_t and let the kernel clean up at exit() than
         // to deadlock here.
-        constexpr unsigned long kShutdownTimeoutMs = 2000;
-        if (!thread_->wait(kShutdownTimeoutMs)) {
+        if (!thread_->wait(static_cast<unsigned long>(kShutdownTimeoutMs))) {
             qWarning() << "AudioCapture: capture thread did not exit in"
                        << kShutdownTimeoutMs << "ms (PA likely stuck);"
                        << "leaking thread, kernel will reclaim at exit";
             thread_ = nullptr;
             pa_ = nullptr;
+            leaked_.store(true, std::memory_order_release);
             warmedUp_.store(false, std::memory_order_release);
             return;
         }
@@ -42,13 +62,16 @@ void AudioCapture::teardownStream() {
 }
 
 bool AudioCapture::start() {
+    if ((hotStandby_ || backend_ != CaptureBackend::Pulse) && startSource()) return true;
     // Idempotent: if a previous start() left a live stream, just flip the
     // forwarding flag.
     if (pa_ && running_.load(std::memory_order_acquire)) {
         active_.store(true, std::memory_order_release);
+        emit streamOpened();
         return true;
     }
     teardownStream();
+    ensureRing();
 
     // Don't open the PA stream here — pa_simple_new() blocks for ~200 ms
     // building the connection to the PA daemon, which would serialize
@@ -58,7 +81,9 @@ bool AudioCapture::start() {
     // overlaps with both PA open and PA warm-up.
     running_.store(true, std::memory_order_release);
     active_.store(true, std::memory_order_release);
-    thread_ = QThread::create([this] { captureLoop(); });
+    thread_ = QThread::create([this, ring = ring_, vad = vadSettings_] {
+        captureLoop(*ring, vad);
+    });
     thread_->setObjectName(QStringLiteral("anytalk-capture"));
     thread_->start();
     return true;
@@ -66,20 +91,192 @@ bool AudioCapture::start() {
 
 void AudioCapture::stop() {
     active_.store(false, std::memory_order_release);
+    if (source_) {
+        if (hotStandby_ && !source_->failed() && !source_->isBluetooth()) {
+            // With a pre-roll the stream keeps running; processChunk() now
+            // only cycles it through preRoll_.
+            sourceIdling_ = preRoll_ != nullptr && preRollSlots_ > 0;
+            if (!sourceIdling_) source_->setCorked(true);
+        } else {
+            closeSource();
+        }
+    }
     teardownStream();
+    finishSession();
+}
+
+void AudioCapture::setCaptureBackend(CaptureBackend backend, int quantumMs) {
+    quantumMs_ = quantumMs;
+    if (backend == backend_) return;
+    backend_ = backend;
+    // A held stream of the old kind would outlive the switch.
+    if (source_ && !isActive()) closeSource();
+}
+
+void AudioCapture::setPreRollMs(int ms) {
+    ms = std::clamp(ms, 0, kMaxPreRollMs);
+    constexpr int kChunkMs = kChunkBytes * 1000 / (kSampleRate * 2);
+    preRollSlots_ = (ms + kChunkMs - 1) / kChunkMs;
+    if (preRollSlots_ == 0 && sourceIdling_ && !isActive()) {
+        source_->setCorked(true);
+        sourceIdling_ = false;
+    }
+}
+
+void AudioCapture::setHotStandby(bool enabled) {
+    hotStandby_ = enabled;
+    if (!enabled && source_ && !isActive()) closeSource();
+}
+
+bool AudioCapture::openStandby() {
+    if (!hotStandby_ || isActive()) return false;
+    if (source_ && source_->failed()) closeSource();
+    // Already held — corked, or idling into a pre-roll — from a session.
+    if (source_) return true;
+    if (!openSource(/*corked=*/true)) return false;
+    // Same policy as stop(): a Bluetooth mic is never held between
+    // sessions (the headset would sit in its call profile).
+    if (source_->isBluetooth()) {
+        closeSource();
+        return false;
+    }
+    // Pulse learns the source's kind asynchronously; look again once it
+    // has connected.
+    QTimer::singleShot(kStandbyProbeMs, this, [this, held = source_.get()]() {
+        if (source_.get() == held && !isActive() && source_->isBluetooth()) {
+            qInfo() << "AudioCapture: prewarm source is Bluetooth — closed";
+            closeSource();
+        }
+    });
+    return true;
+}
+
+bool AudioCapture::openSource(bool corked) {
+    source_ = createCaptureSource(
+        backend_, kSampleRate, kChunkBytes, quantumMs_, [this](const std::string &what) {
+            // Source loop thread; `error` is queued to the controller.
+            qWarning() << "AudioCapture: capture stream failed:" << what.c_str();
+            if (active_.load(std::memory_order_acquire)) {
+                emit error(QStringLiteral("麦克风不可用，请检查 PulseAudio/PipeWire 或音频设备"));
+            }
+        });
+    if (!source_->open(corked) || source_->failed()) {
+        qWarning() << "AudioCapture:" << source_->name() << "source unavailable — using pa_simple";
+        closeSource();
+        return false;
+    }
+    return true;
+}
+
+bool AudioCapture::startSource() {
+    if (source_ && source_->failed()) closeSource();
+    ensureRing();
+    if (!source_ && !openSource(/*corked=*/false)) return false;
+    // A resumed source may still ship its zero-padding ramp; re-arm the
+    // warm-up edge so the controller waits for real audio again.
+    warmedUp_.store(false, std::memory_order_release);
+    if (preRollSlots_ == 0) {
+        preRoll_.reset();
+    } else if (!preRoll_ || preRoll_->slotCount() != preRollSlots_) {
+        // Allocated here, never on the loop thread. A resize drops what the
+        // old buffer held; the retired closure keeps it alive until then.
+        preRoll_ = std::make_shared<PreRollBuffer>(preRollSlots_, kChunkBytes);
+    }
+    auto vad = std::make_shared<VoiceActivityDetector>(vadSettings_, kChunkBytes, kSampleRate);
+    source_->setConsumer(
+        [this, ring = ring_, vad, preRoll = preRoll_](const char *data, int bytes) {
+            processChunk(*ring, *vad, preRoll.get(), data, bytes);
+        });
+    // After the swap: the next chunk the loop sees is the first of the
+    // session and carries the pre-roll with it.
+    active_.store(true, std::memory_order_release);
+    // An idling stream is already running; uncorking would flush it.
+    if (!sourceIdling_) source_->setCorked(false);
+    sourceIdling_ = false;
+    emit streamOpened();
+    return true;
+}
+
+void AudioCapture::closeSource() {
+    if (!source_) return;
+    if (!source_->close(kShutdownTimeoutMs)) {
+        qWarning() << "AudioCapture:" << source_->name() << "loop did not stop in"
+                   << kShutdownTimeoutMs
+                   << "ms; leaking stream, kernel will reclaim at exit";
+        // The stuck teardown thread still owns it.
+        (void)source_.release();
+        leaked_.store(true, std::memory_order_release);
+    }
+    source_.reset();
+    sourceIdling_ = false;
+    warmedUp_.store(false, std::memory_order_release);
+}
+
+void AudioCapture::finishSession() {
+    if (ring_) {
+        // Whatever the GUI thread hadn't drained yet belongs to the session
+        // that just ended; don't let it leak into the next one.
+        ring_->discardAll();
+        const auto clipped = clippedSamples_.exchange(0, std::memory_order_relaxed);
+        if (clipped > 0) {
+            qInfo() << "AudioCapture:" << clipped
+                    << "sample(s) clipped this session — mic gain may be too high";
+        }
+        const auto over = ring_->overruns();
+        if (over != reportedOverruns_) {
+            qWarning() << "AudioCapture:" << (over - reportedOverruns_)
+                       << "chunk(s) dropped — consumer fell behind the capture ring";
+            reportedOverruns_ = over;
+        }
+    }
+}
+
+std::uint64_t AudioCapture::overruns() const {
+    return ring_ ? ring_->overruns() : 0;
+}
+
+void AudioCapture::ensureRing() {
+    if (ring_ && !leaked_.load(std::memory_order_acquire)) return;
+    delete ringNotifier_;
+    ringNotifier_ = nullptr;
+    reportedOverruns_ = 0;
+    ring_ = std::make_shared<PcmRing>(kRingSlots, kChunkBytes);
+    if (ring_->notifyFd() < 0) {
+        qWarning() << "AudioCapture: eventfd unavailable — audio will not be delivered";
+        return;
+    }
+    ringNotifier_ = new QSocketNotifier(ring_->notifyFd(), QSocketNotifier::Read, this);
+    connect(ringNotifier_, &QSocketNotifier::activated, this, &AudioCapture::drainRing);
+}
+
+void AudioCapture::drainRing() {
+    if (!ring_) return;
+    ring_->acknowledgeWakeup();
+    PcmRing::View v;
+    bool any = false;
+    double lastLevel = 0.0;
+    while (ring_->peek(v)) {
+        // fromRawData: no copy, no allocation of the payload. Valid until
+        // pop(), which is exactly the lifetime of the emit below.
+        // bytes == 0: a chunk the VAD held back — level only.
+        if (v.bytes > 0) emit pcm(QByteArray::fromRawData(v.data, v.bytes));
+        lastLevel = v.level;
+        any = true;
+        ring_->pop();
+    }
+    if (any) emit level(lastLevel);
 }
 
 // captureLoop runs on a dedicated QThread (created by start()). AudioCapture
-// itself is parented to AsrController on the main thread, so every signal we
-// emit here crosses a thread boundary. Qt's Auto Connection detects
-// QThread::currentThread() != receiver->thread() and queues the call —
-// QByteArray/QString arguments are deep-copied across threads, and slots
-// run on the main event loop where they share a single ordering with all
-// other AsrController state mutations (no lock needed). The matching
-// connect() calls in AsrController::applyConfig pin Qt::QueuedConnection
-// explicitly so the thread contract is visible at the call site, not just
-// implied by AutoConnection.
-void AudioCapture::captureLoop() {
+// itself is parented to AsrController on the main thread. The hot path —
+// PCM + level — goes through `ring` and is re-emitted by drainRing() on
+// the main thread. The rare signals emitted here (error, warmedUp) still
+// cross the thread boundary the Qt way: the matching connect() calls in
+// AsrController::applyConfig pin Qt::QueuedConnection explicitly so the
+// thread contract is visible at the call site, and their slots run on the
+// main event loop in a single ordering with all other AsrController state
+// mutations (no lock needed).
+void AudioCapture::captureLoop(PcmRing &ring, VoiceActivityDetector::Settings vadSettings) {
     pa_sample_spec spec{};
     spec.format = PA_SAMPLE_S16LE;
     spec.rate = kSampleRate;
@@ -102,9 +299,13 @@ void AudioCapture::captureLoop() {
         return;
     }
     pa_ = pa;
+    emit streamOpened();
 
     QByteArray buf;
     buf.resize(kChunkBytes);
+    // Runs here rather than on the main thread so withheld silence never
+    // costs a ring slot copy, a wakeup or a WebSocket frame.
+    VoiceActivityDetector vad(vadSettings, kChunkBytes, kSampleRate);
     while (running_.load(std::memory_order_acquire)) {
         int err = 0;
         if (pa_simple_read(pa, buf.data(), buf.size(), &err) < 0) {
@@ -115,30 +316,51 @@ void AudioCapture::captureLoop() {
             running_.store(false, std::memory_order_release);
             break;
         }
-        const double rms = computeRms(buf);
-        if (!warmedUp_.load(std::memory_order_acquire) && rms > 1e-4) {
-            warmedUp_.store(true, std::memory_order_release);
-            emit warmedUp();
-        }
-        if (active_.load(std::memory_order_acquire)) {
-            emit pcm(buf);
-            emit level(rms);
-        }
+        processChunk(ring, vad, nullptr, buf.constData(), static_cast<int>(buf.size()));
+    }
+}
+
+void AudioCapture::processChunk(PcmRing &ring, VoiceActivityDetector &vad,
+                                PreRollBuffer *preRoll, const char *data, int bytes) {
+    if (!active_.load(std::memory_order_acquire)) {
+        if (preRoll) preRoll->push(data, bytes);
+        return;
     }
+    if (preRoll && !preRoll->empty()) {
+        // Oldest first, through the same gate, so the pre-roll reaches the
+        // backend as the session's leading audio and is sequenced as such.
+        preRoll->drain([&](const char *d, int n) { gateChunk(ring, vad, d, n); });
+    }
+    gateChunk(ring, vad, data, bytes);
 }
 
-double AudioCapture::computeRms(const QByteArray &pcm16le) {
-    const qsizetype n = pcm16le.size() / 2;
-    if (n == 0) return 0.0;
-    // S16LE matches host int16_t on x86 / aarch64. If we ever ship on a
-    // big-endian target, swap to qFromLittleEndian here.
-    const auto *data = reinterpret_cast<const int16_t *>(pcm16le.constData());
-    double sumSq = 0.0;
-    for (qsizetype i = 0; i < n; ++i) {
-        const double v = static_cast<double>(data[i]) / 32768.0;
-        sumSq += v * v;
+void AudioCapture::gateChunk(PcmRing &ring, VoiceActivityDetector &vad, const char *data,
+                             int bytes) {
+    // One fused integer pass, the only one per chunk: energy and peak for
+    // the bars / warm-up and the VAD, clipping for the session log.
+    const auto stats = level::measure(reinterpret_cast<const int16_t *>(data), bytes / 2);
+    const double bars = levelFromStats(stats);
+    if (stats.clipped > 0) clippedSamples_.fetch_add(stats.clipped, std::memory_order_relaxed);
+    if (!warmedUp_.load(std::memory_order_acquire) && bars > 1e-4) {
+        warmedUp_.store(true, std::memory_order_release);
+        emit warmedUp();
+    }
+    const auto gate = vad.feed(data, bytes, stats);
+    if (gate.flushPreRoll || gate.keepalive) {
+        vad.drainPreRoll([&ring, bars](const char *d, int n) { ring.push(d, n, bars); },
+                         gate.flushPreRoll ? 1 << 30 : 1);
     }
-    const double rms = std::sqrt(sumSq / static_cast<double>(n));
-    // Map typical voice RMS [0, 0.4] → [0, 1] for the bars.
-    return std::clamp(rms / 0.4, 0.0, 1.0);
+    if (gate.send) {
+        ring.push(data, bytes, bars);
+    } else if (!gate.keepalive) {
+        ring.push(nullptr, 0, bars);
+    }
+    if (gate.autoStop) emit trailingSilence();
+}
+
+double AudioCapture::levelFromStats(const level::Stats &stats) {
+    // Map typical voice RMS [0, 0.4] → [0, 1] for the bars. A plosive or
+    // a click lasts a few ms and barely moves the RMS of a 40 ms chunk;
+    // the peak, weighted for speech's ~4× crest factor, lets it show.
+    return std::clamp(std::max(stats.rms() / 0.4, stats.peakNormalized() / 1.6), 0.0, 1.0);
 }
@@ -1,18 +1,55 @@
 #pragma once
+#include "CaptureSource.h"
+#include "LevelKernel.h"
+#include "PreRollBuffer.h"
+#include "VoiceActivityDetector.h"
+
 #include <QByteArray>
 #include <QObject>
 #include <QThread>
 #include <atomic>
+#include <cstdint>
+#include <memory>
+
+class PcmRing;
+class QSocketNotifier;
 
 /// 16-bit little-endian, 16 kHz, mono PCM capture.
-/// Emits 40 ms (1280 byte / 640 sample) chunks; emits an RMS level
+/// Emits 40 ms (1280 byte / 640 sample) chunks; emits an RMS / peak level
 /// estimate (~25 Hz). Backed by libpulse-simple on Linux.
-/// One PA stream per object lifetime: start() opens, stop()/dtor release.
+/// One PA stream per session: start() opens, stop()/dtor release.
+///
+/// Callback-driven sources (CaptureSource) replace the read thread when
+/// either the PipeWire backend is selected (setCaptureBackend) or hot-mic
+/// standby is on (setHotStandby, resident overlay only). In standby,
+/// stop() corks the stream rather than closing it, so the next start() is
+/// a single uncork. Bluetooth sources and failed streams are still closed
+/// after every session, and closing keeps the bounded-wait /
+/// leak-on-wedge guarantee below. A source that can't be created falls
+/// back to pa_simple.
+///
+/// With a pre-roll (setPreRollMs) a held stream is left running instead of
+/// corked: between sessions its chunks only cycle through a PreRollBuffer,
+/// and the next session sends that buffer ahead of live audio, so the word
+/// spoken as the hotkey goes down isn't lost.
+///
+/// Delivery: the capture thread writes chunks into a PcmRing (no
+/// allocation, no Qt event per chunk) and kicks its eventfd; a
+/// QSocketNotifier on the owning (main) thread drains every queued chunk
+/// per wakeup and emits `pcm` / `level` from there. A GUI stall therefore
+/// delays delivery but never blocks or reorders the capture thread; if
+/// the stall outlasts the ring (~kRingSlots × 40 ms) chunks are dropped
+/// and counted in overruns().
+///
+/// With the VAD enabled (setVadSettings), silence never reaches the ring
+/// as audio: held chunks are queued as level-only entries so the bars keep
+/// moving, and `pcm` fires only for what should go upstream.
 class AudioCapture : public QObject {
     Q_OBJECT
 public:
     static constexpr int kSampleRate = 16000;
     static constexpr int kChunkBytes = 1280; // 40 ms @ 16 kHz mono S16LE
+    static constexpr int kRingSlots = 64;    // ~2.5 s of backlog
 
     explicit AudioCapture(QObject *parent = nullptr);
     ~AudioCapture() override;
@@ -29,30 +66,116 @@ public:
 
     bool isActive() const { return active_.load(std::memory_order_acquire); }
 
+    /// Allow stop() to keep the stream corked instead of closing it. Takes
+    /// effect from the next start(); switching it off while idle closes a
+    /// held stream straight away.
+    void setHotStandby(bool enabled);
+    /// A corked (or pre-rolling) stream is currently being held between
+    /// sessions.
+    bool inHotStandby() const { return source_ != nullptr && !isActive(); }
+    /// Open the standby stream corked ahead of any session (Prewarm), so
+    /// the first start() is an uncork too. Needs setHotStandby(true); false
+    /// when that's off, a session is running, the source can't be opened or
+    /// is Bluetooth (start() then opens as usual).
+    bool openStandby();
+
+    /// Keep the last `ms` of audio from between sessions and send it first
+    /// on start(). Needs hot standby; 0 = cork as before. Takes effect from
+    /// the next start().
+    void setPreRollMs(int ms);
+
+    /// Capture API for the next session. `quantumMs` is the graph quantum
+    /// the PipeWire source asks for; upstream chunks stay kChunkBytes.
+    void setCaptureBackend(CaptureBackend backend, int quantumMs);
+
+    /// Takes effect at the next start(); the running thread keeps its copy.
+    void setVadSettings(const VoiceActivityDetector::Settings &s) { vadSettings_ = s; }
+
     /// True once the underlying PA stream has produced its first non-silent
     /// chunk (i.e. the source has finished its zero-padding ramp-up). Sticky.
     bool isWarmedUp() const { return warmedUp_.load(std::memory_order_acquire); }
 
+    /// True once teardownStream() had to abandon a wedged capture thread.
+    /// Sticky: the leaked pa_simple stream keeps the source open until the
+    /// process exits, so a long-lived (resident) overlay must not keep
+    /// running after this flips.
+    bool hasLeakedStream() const { return leaked_.load(std::memory_order_acquire); }
+
+    /// Chunks dropped because the consumer fell a full ring behind.
+    /// Monotonic across sessions.
+    std::uint64_t overruns() const;
+
 signals:
+    /// Emitted on this object's thread. `chunk` aliases ring storage and is
+    /// only valid for the duration of the call — receivers that keep audio
+    /// must copy it (QByteArray::append / assignment + detach do).
     void pcm(const QByteArray &chunk);
-    void level(double rms);  // 0..1
+    void level(double bars);  // 0..1, latest chunk of each drained batch
     void error(const QString &msg);
+    /// The session's stream is open (pa_simple_new returned, or a
+    /// CaptureSource is running). From the capture thread or from start().
+    void streamOpened();
     /// Emitted once, when the first non-silent PCM chunk arrives. Lets the
     /// controller hold off the "Recording" UI state until the mic is really
     /// awake.
     void warmedUp();
+    /// VAD auto-stop: speech was followed by Settings::autoStopMs of
+    /// silence. Once per session, from the capture thread.
+    void trailingSilence();
 
 private:
-    void captureLoop();
+    void captureLoop(PcmRing &ring, VoiceActivityDetector::Settings vadSettings);
+    /// Entry point for every captured chunk. Runs on whichever thread
+    /// produces audio (capture QThread or the source loop). Between
+    /// sessions it only feeds `preRoll` (if any); the first chunk of a
+    /// session replays it through gateChunk() ahead of itself.
+    void processChunk(PcmRing &ring, VoiceActivityDetector &vad, PreRollBuffer *preRoll,
+                      const char *data, int bytes);
+    /// Level / warm-up / VAD / ring push for one chunk of the session.
+    void gateChunk(PcmRing &ring, VoiceActivityDetector &vad, const char *data, int bytes);
+    /// Create and open source_; false (and none) if it can't be opened.
+    bool openSource(bool corked);
+    /// Session on a CaptureSource; false = fall back to pa_simple.
+    bool startSource();
+    /// Close the CaptureSource, bounded like teardownStream().
+    void closeSource();
+    /// Per-session bookkeeping shared by both stop paths.
+    void finishSession();
+    /// Main-thread side of the ring: re-arm the wakeup, emit everything
+    /// queued.
+    void drainRing();
+    /// (Re)create ring_ and its notifier. Only needed after a leaked
+    /// thread — that thread keeps writing into its own (old) ring.
+    void ensureRing();
     /// Stop the read thread and release the pa_simple stream. Bounded
     /// wait — leaks the thread + pa_simple if PA is wedged so the caller
     /// (stop() or ~AudioCapture()) doesn't deadlock.
     void teardownStream();
-    static double computeRms(const QByteArray &pcm16le);
+    /// A chunk's level::Stats → 0..1 bar level: the RMS, lifted by the
+    /// peak for transients.
+    static double levelFromStats(const level::Stats &stats);
 
     QThread *thread_ = nullptr;
     std::atomic_bool running_{false};  // thread should keep reading
     std::atomic_bool active_{false};   // forward reads to listeners
     std::atomic_bool warmedUp_{false}; // first non-silent chunk seen, sticky
+    std::atomic_bool leaked_{false};   // a wedged thread was abandoned, sticky
+    std::atomic<std::uint64_t> clippedSamples_{0};  // this session, logged at stop()
     void *pa_ = nullptr;               // pa_simple* (kept opaque)
+    std::unique_ptr<CaptureSource> source_;  // callback-driven capture stream
+    bool hotStandby_ = false;
+    CaptureBackend backend_ = CaptureBackend::Pulse;
+    int quantumMs_ = 20;
+    // Shared with the source's consumer closures; swapped only by
+    // startSource(), after setConsumer() has retired the old closure.
+    std::shared_ptr<PreRollBuffer> preRoll_;
+    int preRollSlots_ = 0;
+    bool sourceIdling_ = false;        // held source left uncorked into preRoll_
+
+    // Shared with the capture thread so a leaked thread can never write
+    // into a ring (or eventfd) we already freed.
+    std::shared_ptr<PcmRing> ring_;
+    QSocketNotifier *ringNotifier_ = nullptr;
+    std::uint64_t reportedOverruns_ = 0;
+    VoiceActivityDetector::Settings vadSettings_;
 };
@@ -0,0 +1,47 @@
+#include "CaptureSource.h"
+#include "PulseAsyncStream.h"
+#ifdef ANYTALK_HAS_PIPEWIRE
+#include "PipeWireStream.h"
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+void CaptureSource::deliver(const char *data, std::size_t bytes) {
+    while (bytes > 0) {
+        const std::size_t take =
+            std::min(bytes, static_cast<std::size_t>(chunkBytes_ - pendingBytes_));
+        std::memcpy(pending_.data() + pendingBytes_, data, take);
+        pendingBytes_ += static_cast<int>(take);
+        data += take;
+        bytes -= take;
+        if (pendingBytes_ == chunkBytes_) {
+            if (consumer_) consumer_(pending_.data(), chunkBytes_);
+            pendingBytes_ = 0;
+        }
+    }
+}
+
+CaptureBackend parseCaptureBackend(const std::string &name) {
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (lower == "pipewire") return CaptureBackend::PipeWire;
+    return CaptureBackend::Pulse;
+}
+
+std::unique_ptr<CaptureSource> createCaptureSource(CaptureBackend backend, int sampleRate,
+                                                   int chunkBytes, int quantumMs,
+                                                   CaptureSource::ErrorFn onError) {
+#ifdef ANYTALK_HAS_PIPEWIRE
+    if (backend == CaptureBackend::PipeWire) {
+        return std::make_unique<PipeWireStream>(sampleRate, chunkBytes, quantumMs,
+                                                std::move(onError));
+    }
+#else
+    (void)backend;
+    (void)quantumMs;
+#endif
+    return std::make_unique<PulseAsyncStream>(sampleRate, chunkBytes, std::move(onError));
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Callback-driven capture stream, the alternative to AudioCapture's
+/// blocking pa_simple_read thread. The implementation's own loop thread
+/// calls the consumer with fixed `chunkBytes` chunks, whatever quantum the
+/// server delivers in — the upstream frame size and the capture quantum
+/// are independent.
+///
+/// Implementations: PulseAsyncStream (pa_threaded_mainloop; the hot-mic
+/// standby path) and PipeWireStream (native pw_stream, optional build).
+///
+/// Plain C++, no Qt.
+class CaptureSource {
+public:
+    using ChunkFn = std::function<void(const char *data, int bytes)>;
+    using ErrorFn = std::function<void(const std::string &what)>;
+
+    virtual ~CaptureSource() = default;
+    CaptureSource(const CaptureSource &) = delete;
+    CaptureSource &operator=(const CaptureSource &) = delete;
+
+    /// Start the loop and begin connecting; everything after is async.
+    /// Returns false only if the loop itself could not be created.
+    virtual bool open(bool corked) = 0;
+
+    /// Swap the chunk consumer under the loop lock, so the previous one is
+    /// never called again once this returns.
+    virtual void setConsumer(ChunkFn fn) = 0;
+
+    /// Pause / resume delivery without closing the stream. Resuming drops
+    /// anything captured before the pause.
+    virtual void setCorked(bool corked) = 0;
+
+    /// A failure was reported through ErrorFn; close and recreate.
+    virtual bool failed() const = 0;
+
+    /// The capturing source is Bluetooth — never hold it between sessions.
+    virtual bool isBluetooth() const = 0;
+
+    /// Disconnect and stop the loop, waiting at most `timeoutMs`. False
+    /// means the server did not let go in time: the caller must leak the
+    /// object rather than destroy it.
+    virtual bool close(int timeoutMs) = 0;
+
+    virtual const char *name() const = 0;
+
+protected:
+    explicit CaptureSource(int chunkBytes)
+        : chunkBytes_(chunkBytes), pending_(static_cast<std::size_t>(chunkBytes)) {}
+
+    /// Re-slice server buffers into chunkBytes_ chunks for consumer_.
+    /// Loop thread, lock held.
+    void deliver(const char *data, std::size_t bytes);
+
+    const int chunkBytes_;
+    ChunkFn consumer_;        // loop lock
+    std::vector<char> pending_;
+    int pendingBytes_ = 0;    // loop lock
+};
+
+enum class CaptureBackend { Pulse, PipeWire };
+
+/// `pulse` / `pipewire` (case-insensitive); anything else is Pulse.
+CaptureBackend parseCaptureBackend(const std::string &name);
+
+/// PipeWire asks the graph for a `quantumMs` quantum; PulseAudio keeps
+/// its single-chunk fragsize. Falls back to Pulse when PipeWire support
+/// wasn't compiled in.
+std::unique_ptr<CaptureSource> createCaptureSource(CaptureBackend backend, int sampleRate,
+                                                   int chunkBytes, int quantumMs,
+                                                   CaptureSource::ErrorFn onError);
@@ -0,0 +1,195 @@
+#include "LevelKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ANYTALK_LEVEL_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ANYTALK_LEVEL_NEON 1
+#endif
+
+namespace level {
+
+double Stats::rms() const {
+    if (samples <= 0) return 0.0;
+    return std::sqrt(static_cast<double>(sumSquares) / samples) / 32768.0;
+}
+
+namespace {
+
+// Shared tail / fallback. Scalar in-place so remainders of the vector
+// loops land in the same Stats.
+void accumulateScalar(const std::int16_t *s, int n, Stats &st) {
+    for (int i = 0; i < n; ++i) {
+        const int v = s[i];
+        const int a = std::abs(v);
+        st.sumSquares += static_cast<std::uint64_t>(v * v);
+        st.peak = std::max(st.peak, a);
+        st.clipped += a >= kClipThreshold;
+    }
+}
+
+#ifdef ANYTALK_LEVEL_X86
+
+// madd_epi16(v, v) sums two squares per 32-bit lane: at most 2·32768² = 2³¹,
+// which only fits UNSIGNED — so lanes are zero-extended into the 64-bit
+// accumulators, never sign-extended.
+__attribute__((target("sse2"))) Stats measureSse2(const std::int16_t *s, int n) {
+    Stats st;
+    st.samples = n;
+    __m128i acc = _mm_setzero_si128();
+    __m128i vmax = _mm_set1_epi16(0);
+    __m128i vmin = _mm_set1_epi16(0);
+    const __m128i hi = _mm_set1_epi16(kClipThreshold - 1);
+    const __m128i lo = _mm_set1_epi16(-(kClipThreshold - 1));
+    const __m128i zero = _mm_setzero_si128();
+    int clipped = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        const __m128i sq = _mm_madd_epi16(v, v);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+        vmax = _mm_max_epi16(vmax, v);
+        vmin = _mm_min_epi16(vmin, v);
+        const __m128i clip = _mm_or_si128(_mm_cmpgt_epi16(v, hi), _mm_cmplt_epi16(v, lo));
+        // movemask yields two bits per 16-bit lane.
+        clipped += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(clip))) / 2;
+    }
+    alignas(16) std::uint64_t a64[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(a64), acc);
+    alignas(16) std::int16_t mx[8], mn[8];
+    _mm_store_si128(reinterpret_cast<__m128i *>(mx), vmax);
+    _mm_store_si128(reinterpret_cast<__m128i *>(mn), vmin);
+    int peakPos = 0, peakNeg = 0;
+    for (int k = 0; k < 8; ++k) {
+        peakPos = std::max<int>(peakPos, mx[k]);
+        peakNeg = std::min<int>(peakNeg, mn[k]);
+    }
+    st.sumSquares = a64[0] + a64[1];
+    st.peak = std::max(peakPos, -peakNeg);
+    st.clipped = clipped;
+    accumulateScalar(s + i, n - i, st);
+    return st;
+}
+
+__attribute__((target("avx2"))) Stats measureAvx2(const std::int16_t *s, int n) {
+    Stats st;
+    st.samples = n;
+    __m256i acc = _mm256_setzero_si256();
+    __m256i vmax = _mm256_setzero_si256();
+    __m256i vmin = _mm256_setzero_si256();
+    const __m256i hi = _mm256_set1_epi16(kClipThreshold - 1);
+    const __m256i lo = _mm256_set1_epi16(-(kClipThreshold - 1));
+    const __m256i zero = _mm256_setzero_si256();
+    int clipped = 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+        const __m256i sq = _mm256_madd_epi16(v, v);
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(sq, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(sq, zero));
+        vmax = _mm256_max_epi16(vmax, v);
+        vmin = _mm256_min_epi16(vmin, v);
+        const __m256i clip =
+            _mm256_or_si256(_mm256_cmpgt_epi16(v, hi), _mm256_cmpgt_epi16(lo, v));
+        clipped += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(clip))) / 2;
+    }
+    alignas(32) std::uint64_t a64[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(a64), acc);
+    alignas(32) std::int16_t mx[16], mn[16];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(mx), vmax);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(mn), vmin);
+    int peakPos = 0, peakNeg = 0;
+    for (int k = 0; k < 16; ++k) {
+        peakPos = std::max<int>(peakPos, mx[k]);
+        peakNeg = std::min<int>(peakNeg, mn[k]);
+    }
+    st.sumSquares = a64[0] + a64[1] + a64[2] + a64[3];
+    st.peak = std::max(peakPos, -peakNeg);
+    st.clipped = clipped;
+    accumulateScalar(s + i, n - i, st);
+    return st;
+}
+
+#endif // ANYTALK_LEVEL_X86
+
+#ifdef ANYTALK_LEVEL_NEON
+
+Stats measureNeon(const std::int16_t *s, int n) {
+    Stats st;
+    st.samples = n;
+    uint64x2_t acc = vdupq_n_u64(0);
+    int16x8_t vmax = vdupq_n_s16(0);
+    int16x8_t vmin = vdupq_n_s16(0);
+    const int16x8_t hi = vdupq_n_s16(kClipThreshold);
+    const int16x8_t lo = vdupq_n_s16(-kClipThreshold);
+    std::uint64_t clipped = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(s + i);
+        // vmull_s16 squares fit in 32 bits (≤ 2³⁰), pairwise-add into u64.
+        const int32x4_t sqLo = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+        const int32x4_t sqHi = vmull_s16(vget_high_s16(v), vget_high_s16(v));
+        acc = vpadalq_u32(acc, vreinterpretq_u32_s32(sqLo));
+        acc = vpadalq_u32(acc, vreinterpretq_u32_s32(sqHi));
+        vmax = vmaxq_s16(vmax, v);
+        vmin = vminq_s16(vmin, v);
+        const uint16x8_t clip = vorrq_u16(vcgeq_s16(v, hi), vcleq_s16(v, lo));
+        clipped += vaddvq_u16(vshrq_n_u16(clip, 15));
+    }
+    st.sumSquares = vaddvq_u64(acc);
+    st.peak = std::max<int>(vmaxvq_s16(vmax), -static_cast<int>(vminvq_s16(vmin)));
+    st.clipped = static_cast<int>(clipped);
+    accumulateScalar(s + i, n - i, st);
+    return st;
+}
+
+#endif // ANYTALK_LEVEL_NEON
+
+using Kernel = Stats (*)(const std::int16_t *, int);
+
+struct Dispatch {
+    Kernel fn;
+    const char *name;
+};
+
+Dispatch pick() {
+#ifdef ANYTALK_LEVEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {measureAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {measureSse2, "sse2"};
+#endif
+#ifdef ANYTALK_LEVEL_NEON
+    return {measureNeon, "neon"};  // mandatory on AArch64
+#else
+    return {measureScalar, "scalar"};
+#endif
+}
+
+const Dispatch &dispatch() {
+    static const Dispatch d = pick();
+    return d;
+}
+
+} // namespace
+
+Stats measureScalar(const std::int16_t *samples, int count) {
+    Stats st;
+    st.samples = std::max(count, 0);
+    accumulateScalar(samples, st.samples, st);
+    return st;
+}
+
+Stats measure(const std::int16_t *samples, int count) {
+    if (count <= 0) return {};
+    return dispatch().fn(samples, count);
+}
+
+const char *kernelName() { return dispatch().name; }
+
+} // namespace level
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+/// One-pass level statistics over S16 mono PCM: energy, peak and clipping.
+///
+/// Integer accumulation throughout (squares summed exactly in 64 bits), so
+/// the SIMD paths agree bit-for-bit with the scalar one. The best kernel
+/// for the running CPU — AVX2, SSE2 or NEON — is picked once on first use.
+/// Plain C++, no Qt.
+namespace level {
+
+/// |sample| at or above this counts as clipped (the top step of S16, so
+/// converters that saturate at ±32767 are caught too).
+inline constexpr int kClipThreshold = 32767;
+
+struct Stats {
+    std::uint64_t sumSquares = 0;  // Σ sample², exact
+    int peak = 0;                  // max |sample|, 0..32768
+    int clipped = 0;               // samples with |sample| ≥ kClipThreshold
+    int samples = 0;
+
+    /// RMS normalized to 0..1 full scale.
+    double rms() const;
+    double peakNormalized() const { return peak / 32768.0; }
+};
+
+Stats measure(const std::int16_t *samples, int count);
+
+/// Scalar reference; what measure() falls back to without SIMD.
+Stats measureScalar(const std::int16_t *samples, int count);
+
+/// Name of the kernel measure() dispatches to ("avx2", "sse2", "neon",
+/// "scalar") — for the startup log.
+const char *kernelName();
+
+} // namespace level
@@ -0,0 +1,38 @@
+#include "PcmRing.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+PcmRing::PcmRing(int slotCount, int slotBytes)
+    : slotCount_(static_cast<std::size_t>(std::max(slotCount, 2))),
+      slotBytes_(std::max(slotBytes, 1)),
+      data_(std::make_unique<char[]>(slotCount_ * static_cast<std::size_t>(slotBytes_))),
+      meta_(std::make_unique<Meta[]>(slotCount_)),
+      wakeFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+PcmRing::~PcmRing() {
+    if (wakeFd_ >= 0) ::close(wakeFd_);
+}
+
+void PcmRing::signal() {
+    if (wakeFd_ < 0) return;
+    const std::uint64_t one = 1;
+    [[maybe_unused]] auto _ = ::write(wakeFd_, &one, sizeof(one));
+}
+
+void PcmRing::acknowledgeWakeup() {
+    // Drain the fd before re-arming: the other way round, a push landing
+    // in between sets the flag and writes the fd, the read eats that
+    // write, and the flag stays set with nothing left to wake us — every
+    // later push then skips signal().
+    if (wakeFd_ >= 0) {
+        std::uint64_t count = 0;
+        [[maybe_unused]] auto _ = ::read(wakeFd_, &count, sizeof(count));
+    }
+    wakePending_.store(false, std::memory_order_release);
+    // A push that still saw the flag set didn't signal, but its chunk is
+    // visible to the drain that follows; a later one sees the flag clear.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
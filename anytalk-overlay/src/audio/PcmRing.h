@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/// Fixed-capacity single-producer / single-consumer ring of PCM chunks,
+/// with an eventfd the consumer can poll for "something arrived".
+///
+/// Producer (the capture thread) never allocates, locks or blocks: push()
+/// copies one chunk into a preallocated slot. When the consumer has fallen
+/// so far behind that every slot is full, the NEW chunk is dropped and
+/// overruns() ticks — the producer cannot touch slots the consumer may be
+/// reading.
+///
+/// Wakeups are coalesced: the first push after the consumer acknowledged
+/// writes the eventfd; further pushes before the next acknowledge don't,
+/// so a busy GUI thread gets one wakeup for a whole backlog of chunks.
+///
+/// Consumer protocol (one thread only):
+///   acknowledgeWakeup();            // re-arm BEFORE draining
+///   while (peek(v)) { use(v); pop(); }
+class PcmRing {
+public:
+    struct View {
+        const char *data = nullptr;
+        int bytes = 0;
+        double level = 0.0; // producer-computed bar level for this chunk
+    };
+
+    PcmRing(int slotCount, int slotBytes);
+    ~PcmRing();
+    PcmRing(const PcmRing &) = delete;
+    PcmRing &operator=(const PcmRing &) = delete;
+
+    int slotBytes() const { return slotBytes_; }
+
+    /// eventfd (non-blocking) signalled on new data; -1 if eventfd failed,
+    /// in which case the consumer has to poll.
+    int notifyFd() const { return wakeFd_; }
+
+    // ---- Producer side ----
+
+    /// Copy `bytes` (≤ slotBytes()) into the next free slot. Returns false
+    /// and counts an overrun when the ring is full. bytes == 0 (data may be
+    /// null) queues a level-only entry.
+    bool push(const char *data, int bytes, double level) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        const std::size_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail >= slotCount_) {
+            overruns_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (bytes > slotBytes_) bytes = slotBytes_;
+        const std::size_t idx = head % slotCount_;
+        if (bytes > 0) {
+            std::memcpy(data_.get() + idx * static_cast<std::size_t>(slotBytes_), data,
+                        static_cast<std::size_t>(bytes));
+        }
+        meta_[idx] = {bytes, level};
+        head_.store(head + 1, std::memory_order_release);
+        // Pairs with the fence in acknowledgeWakeup(): either the drain
+        // after it sees this chunk, or this push sees the flag cleared and
+        // signals.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!wakePending_.exchange(true, std::memory_order_acq_rel)) signal();
+        return true;
+    }
+
+    // ---- Consumer side ----
+
+    /// Clear the eventfd and re-arm wakeups. Call before draining so a
+    /// push racing the drain still produces a fresh wakeup. Re-signals
+    /// itself if chunks are already queued when it re-arms.
+    void acknowledgeWakeup();
+
+    /// Oldest unread chunk, valid until pop().
+    bool peek(View &out) const {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        const std::size_t idx = tail % slotCount_;
+        out.data = data_.get() + idx * static_cast<std::size_t>(slotBytes_);
+        out.bytes = meta_[idx].bytes;
+        out.level = meta_[idx].level;
+        return true;
+    }
+
+    void pop() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /// Drop everything unread (consumer-side; safe with a live producer).
+    void discardAll() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+    /// Chunks currently queued (approximate from either side).
+    std::size_t depth() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    /// Total chunks dropped because the ring was full. Monotonic.
+    std::uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+
+private:
+    struct Meta {
+        int bytes;
+        double level;
+    };
+
+    void signal();
+
+    const std::size_t slotCount_;
+    const int slotBytes_;
+    std::unique_ptr<char[]> data_;
+    std::unique_ptr<Meta[]> meta_;
+    int wakeFd_ = -1;
+
+    // Producer and consumer indices on separate cache lines so the two
+    // threads don't false-share. Monotonic; slot = index % slotCount_.
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::atomic_bool wakePending_{false};
+    std::atomic<std::uint64_t> overruns_{0};
+};
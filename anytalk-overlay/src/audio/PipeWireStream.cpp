@@ -0,0 +1,317 @@
+#include "PipeWireStream.h"
+
+#include <spa/param/audio/format-utils.h>
+#include <spa/utils/dict.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Value of "default.audio.source" is JSON: {"name":"alsa_input..."}.
+std::string jsonName(const char *value) {
+    if (!value) return {};
+    const char *key = std::strstr(value, "\"name\"");
+    if (!key) return {};
+    const char *open = std::strchr(key + 6, '"');
+    if (!open) return {};
+    const char *close = std::strchr(open + 1, '"');
+    if (!close) return {};
+    return std::string(open + 1, static_cast<std::size_t>(close - open - 1));
+}
+
+} // namespace
+
+PipeWireStream::PipeWireStream(int sampleRate, int chunkBytes, int quantumMs, ErrorFn onError)
+    : CaptureSource(chunkBytes), sampleRate_(sampleRate), quantumMs_(quantumMs),
+      onError_(std::move(onError)) {
+    static std::once_flag init;
+    std::call_once(init, [] { pw_init(nullptr, nullptr); });
+}
+
+PipeWireStream::~PipeWireStream() {
+    if (loop_) pw_thread_loop_destroy(loop_);
+}
+
+bool PipeWireStream::open(bool corked) {
+    loop_ = pw_thread_loop_new("anytalk-pw", nullptr);
+    if (!loop_) return false;
+    context_ = pw_context_new(pw_thread_loop_get_loop(loop_), nullptr, 0);
+    if (!context_) return false;
+
+    pw_thread_loop_lock(loop_);
+    core_ = pw_context_connect(context_, nullptr, 0);
+    if (!core_) {
+        pw_thread_loop_unlock(loop_);
+        fail("cannot connect to the PipeWire daemon");
+        return true;  // failed() tells the owner
+    }
+
+    static const pw_core_events coreEvents = [] {
+        pw_core_events ev{};
+        ev.version = PW_VERSION_CORE_EVENTS;
+        ev.error = &PipeWireStream::onCoreError;
+        ev.done = &PipeWireStream::onCoreDone;
+        return ev;
+    }();
+    pw_core_add_listener(core_, &coreListener_, &coreEvents, this);
+
+    static const pw_registry_events registryEvents = [] {
+        pw_registry_events ev{};
+        ev.version = PW_VERSION_REGISTRY_EVENTS;
+        ev.global = &PipeWireStream::onGlobal;
+        ev.global_remove = &PipeWireStream::onGlobalRemove;
+        return ev;
+    }();
+    registry_ = pw_core_get_registry(core_, PW_VERSION_REGISTRY, 0);
+    pw_registry_add_listener(registry_, &registryListener_, &registryEvents, this);
+    if (corked) syncSeq_ = pw_core_sync(core_, PW_ID_CORE, 0);
+
+    const int quantumFrames = std::max(1, sampleRate_ * quantumMs_ / 1000);
+    auto *props = pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY,
+                                    "Capture", PW_KEY_MEDIA_ROLE, "Communication",
+                                    PW_KEY_APP_NAME, "anytalk", nullptr);
+    pw_properties_setf(props, PW_KEY_NODE_LATENCY, "%d/%d", quantumFrames, sampleRate_);
+
+    static const pw_stream_events streamEvents = [] {
+        pw_stream_events ev{};
+        ev.version = PW_VERSION_STREAM_EVENTS;
+        ev.state_changed = &PipeWireStream::onStreamState;
+        ev.process = &PipeWireStream::onProcess;
+        return ev;
+    }();
+    stream_ = pw_stream_new(core_, "Voice Input", props);
+    if (!stream_) {
+        pw_thread_loop_unlock(loop_);
+        fail("pw_stream_new failed");
+        return true;
+    }
+    pw_stream_add_listener(stream_, &streamListener_, &streamEvents, this);
+
+    // Ask for our format; the adapter converts whatever the source runs at.
+    uint8_t podBuffer[1024];
+    spa_pod_builder b = SPA_POD_BUILDER_INIT(podBuffer, sizeof(podBuffer));
+    spa_audio_info_raw info{};
+    info.format = SPA_AUDIO_FORMAT_S16_LE;
+    info.rate = static_cast<uint32_t>(sampleRate_);
+    info.channels = 1;
+    const spa_pod *params[1] = {spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat, &info)};
+    auto flags = static_cast<pw_stream_flags>(PW_STREAM_FLAG_AUTOCONNECT |
+                                              PW_STREAM_FLAG_MAP_BUFFERS |
+                                              (corked ? PW_STREAM_FLAG_INACTIVE : 0));
+    if (pw_stream_connect(stream_, PW_DIRECTION_INPUT, PW_ID_ANY, flags, params, 1) < 0) {
+        pw_thread_loop_unlock(loop_);
+        fail("pw_stream_connect failed");
+        return true;
+    }
+    pw_thread_loop_unlock(loop_);
+    if (pw_thread_loop_start(loop_) < 0) return false;
+    if (corked) {
+        // A standby stream is judged by isBluetooth() as soon as this
+        // returns; a couple of round trips, bounded in case the daemon
+        // is stuck.
+        pw_thread_loop_lock(loop_);
+        while (!synced_ && !failed()) {
+            if (pw_thread_loop_timed_wait(loop_, 1) != 0) break;
+        }
+        pw_thread_loop_unlock(loop_);
+    }
+    return true;
+}
+
+void PipeWireStream::setConsumer(ChunkFn fn) {
+    pw_thread_loop_lock(loop_);
+    consumer_ = std::move(fn);
+    pendingBytes_ = 0;
+    pw_thread_loop_unlock(loop_);
+}
+
+void PipeWireStream::setCorked(bool corked) {
+    pw_thread_loop_lock(loop_);
+    if (stream_) {
+        if (!corked) pw_stream_flush(stream_, false);
+        pw_stream_set_active(stream_, !corked);
+    }
+    pendingBytes_ = 0;
+    pw_thread_loop_unlock(loop_);
+}
+
+bool PipeWireStream::isBluetooth() const {
+    pw_thread_loop_lock(loop_);
+    // Unknown counts as Bluetooth: holding a headset mic open by mistake
+    // costs more than closing a wired one.
+    bool bt = true;
+    bool linked = false;
+    const uint32_t self = stream_ ? pw_stream_get_node_id(stream_) : SPA_ID_INVALID;
+    if (self != SPA_ID_INVALID) {
+        for (const auto &[link, nodes] : links_) {
+            if (nodes.second != self) continue;
+            if (const auto it = sourceIds_.find(nodes.first); it != sourceIds_.end()) {
+                bt = it->second;
+                linked = true;
+                break;
+            }
+        }
+    }
+    if (!linked) {
+        if (const auto it = sources_.find(defaultSource_); it != sources_.end()) {
+            bt = it->second;
+        }
+    }
+    pw_thread_loop_unlock(loop_);
+    return bt;
+}
+
+bool PipeWireStream::close(int timeoutMs) {
+    if (!loop_) return true;
+    // Same bounded teardown as PulseAsyncStream::close().
+    auto done = std::make_shared<std::promise<void>>();
+    auto finished = done->get_future();
+    std::thread([this, done]() {
+        pw_thread_loop_lock(loop_);
+        teardownLocked();
+        pw_thread_loop_unlock(loop_);
+        pw_thread_loop_stop(loop_);
+        done->set_value();
+    }).detach();
+    return finished.wait_for(std::chrono::milliseconds(timeoutMs)) == std::future_status::ready;
+}
+
+void PipeWireStream::teardownLocked() {
+    consumer_ = nullptr;
+    if (stream_) {
+        spa_hook_remove(&streamListener_);
+        pw_stream_destroy(stream_);
+        stream_ = nullptr;
+    }
+    if (metadata_) {
+        spa_hook_remove(&metadataListener_);
+        pw_proxy_destroy(reinterpret_cast<pw_proxy *>(metadata_));
+        metadata_ = nullptr;
+    }
+    if (registry_) {
+        spa_hook_remove(&registryListener_);
+        pw_proxy_destroy(reinterpret_cast<pw_proxy *>(registry_));
+        registry_ = nullptr;
+    }
+    if (core_) {
+        spa_hook_remove(&coreListener_);
+        pw_core_disconnect(core_);
+        core_ = nullptr;
+    }
+    if (context_) {
+        pw_context_destroy(context_);
+        context_ = nullptr;
+    }
+}
+
+void PipeWireStream::fail(const std::string &what) {
+    if (failed_.exchange(true, std::memory_order_acq_rel)) return;
+    if (onError_) onError_(what);
+}
+
+// ---- Loop callbacks (thread loop, lock held) ----
+
+void PipeWireStream::onStreamState(void *self, pw_stream_state, pw_stream_state state,
+                                   const char *error) {
+    if (state == PW_STREAM_STATE_ERROR) {
+        static_cast<PipeWireStream *>(self)->fail(error ? error : "stream error");
+    }
+}
+
+void PipeWireStream::onCoreError(void *self, uint32_t id, int, int res, const char *message) {
+    // Only a core-level error means the connection is gone (daemon
+    // restarted); per-object errors surface through the stream state.
+    if (id == PW_ID_CORE && res == -EPIPE) {
+        static_cast<PipeWireStream *>(self)->fail(message ? message : "PipeWire disconnected");
+    }
+}
+
+void PipeWireStream::onCoreDone(void *self, uint32_t id, int seq) {
+    auto *me = static_cast<PipeWireStream *>(self);
+    if (id != PW_ID_CORE || seq != me->syncSeq_) return;
+    // The first round brings the globals and binds the metadata; its
+    // properties arrive by the second.
+    if (me->syncRounds_++ == 0 && me->metadata_) {
+        me->syncSeq_ = pw_core_sync(me->core_, PW_ID_CORE, seq);
+        return;
+    }
+    me->synced_ = true;
+    pw_thread_loop_signal(me->loop_, false);
+}
+
+void PipeWireStream::onProcess(void *self) {
+    auto *me = static_cast<PipeWireStream *>(self);
+    pw_buffer *b = pw_stream_dequeue_buffer(me->stream_);
+    if (!b) return;
+    const spa_data &d = b->buffer->datas[0];
+    if (d.data && d.chunk) {
+        const uint32_t offset = std::min(d.chunk->offset, d.maxsize);
+        const uint32_t size = std::min(d.chunk->size, d.maxsize - offset);
+        me->deliver(static_cast<const char *>(d.data) + offset, size);
+    }
+    pw_stream_queue_buffer(me->stream_, b);
+}
+
+void PipeWireStream::onGlobal(void *self, uint32_t id, uint32_t, const char *type, uint32_t,
+                              const spa_dict *props) {
+    auto *me = static_cast<PipeWireStream *>(self);
+    if (!props) return;
+    if (std::strcmp(type, PW_TYPE_INTERFACE_Node) == 0) {
+        const char *cls = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
+        const char *name = spa_dict_lookup(props, PW_KEY_NODE_NAME);
+        if (!cls || !name || std::strcmp(cls, "Audio/Source") != 0) return;
+        const char *api = spa_dict_lookup(props, "device.api");
+        const bool bt =
+            (api && std::strstr(api, "bluez")) || std::strncmp(name, "bluez_", 6) == 0;
+        me->sources_[name] = bt;
+        me->sourceIds_[id] = bt;
+        return;
+    }
+    if (std::strcmp(type, PW_TYPE_INTERFACE_Link) == 0) {
+        const char *out = spa_dict_lookup(props, PW_KEY_LINK_OUTPUT_NODE);
+        const char *in = spa_dict_lookup(props, PW_KEY_LINK_INPUT_NODE);
+        if (!out || !in) return;
+        me->links_[id] = {static_cast<uint32_t>(std::strtoul(out, nullptr, 10)),
+                          static_cast<uint32_t>(std::strtoul(in, nullptr, 10))};
+        return;
+    }
+    if (std::strcmp(type, PW_TYPE_INTERFACE_Metadata) == 0 && !me->metadata_) {
+        const char *mdName = spa_dict_lookup(props, PW_KEY_METADATA_NAME);
+        if (!mdName || std::strcmp(mdName, "default") != 0) return;
+        static const pw_metadata_events metadataEvents = [] {
+            pw_metadata_events ev{};
+            ev.version = PW_VERSION_METADATA_EVENTS;
+            ev.property = &PipeWireStream::onMetadataProperty;
+            return ev;
+        }();
+        me->metadata_ = static_cast<pw_metadata *>(
+            pw_registry_bind(me->registry_, id, type, PW_VERSION_METADATA, 0));
+        if (me->metadata_) {
+            pw_metadata_add_listener(me->metadata_, &me->metadataListener_, &metadataEvents, me);
+        }
+    }
+}
+
+void PipeWireStream::onGlobalRemove(void *self, uint32_t id) {
+    // Relinked after a default change, or the source went away. Names in
+    // sources_ stay: the default is looked up by name and they are reused.
+    auto *me = static_cast<PipeWireStream *>(self);
+    me->links_.erase(id);
+    me->sourceIds_.erase(id);
+}
+
+int PipeWireStream::onMetadataProperty(void *self, uint32_t, const char *key, const char *,
+                                       const char *value) {
+    if (key && std::strcmp(key, "default.audio.source") == 0) {
+        static_cast<PipeWireStream *>(self)->defaultSource_ = jsonName(value);
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "CaptureSource.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/extensions/metadata.h>
+
+/// Native PipeWire capture (pw_thread_loop + pw_stream), built when
+/// libpipewire-0.3 is found (ANYTALK_HAS_PIPEWIRE).
+///
+/// Asks the graph for a small quantum through node.latency (quantumMs,
+/// 10–20 ms is the useful range) instead of inheriting whatever the
+/// pulse compatibility layer negotiates; buffers are re-sliced into
+/// chunkBytes by CaptureSource::deliver() straight from the process
+/// callback — no blocking read anywhere. The process callback runs on the
+/// thread loop (not PW_STREAM_FLAG_RT_PROCESS), so setConsumer() can swap
+/// consumers under the loop lock.
+///
+/// Bluetooth detection checks device.api / node.name of the source node
+/// our stream is linked to, or of the "default" metadata's
+/// default.audio.source before the link shows up. Neither known counts as
+/// Bluetooth; a corked open() waits (briefly) for the registry and the
+/// metadata so a standby stream can be judged right away.
+class PipeWireStream : public CaptureSource {
+public:
+    PipeWireStream(int sampleRate, int chunkBytes, int quantumMs, ErrorFn onError);
+    ~PipeWireStream() override;
+
+    bool open(bool corked) override;
+    void setConsumer(ChunkFn fn) override;
+    void setCorked(bool corked) override;
+    bool failed() const override { return failed_.load(std::memory_order_acquire); }
+    bool isBluetooth() const override;
+    bool close(int timeoutMs) override;
+    const char *name() const override { return "pipewire"; }
+
+private:
+    static void onStreamState(void *self, pw_stream_state old, pw_stream_state state,
+                              const char *error);
+    static void onProcess(void *self);
+    static void onCoreError(void *self, uint32_t id, int seq, int res, const char *message);
+    static void onCoreDone(void *self, uint32_t id, int seq);
+    static void onGlobal(void *self, uint32_t id, uint32_t permissions, const char *type,
+                         uint32_t version, const spa_dict *props);
+    static void onGlobalRemove(void *self, uint32_t id);
+    static int onMetadataProperty(void *self, uint32_t subject, const char *key,
+                                  const char *type, const char *value);
+
+    void fail(const std::string &what);
+    void teardownLocked();
+
+    const int sampleRate_;
+    const int quantumMs_;
+    ErrorFn onError_;
+
+    pw_thread_loop *loop_ = nullptr;
+    pw_context *context_ = nullptr;
+    pw_core *core_ = nullptr;
+    pw_registry *registry_ = nullptr;
+    pw_metadata *metadata_ = nullptr;
+    pw_stream *stream_ = nullptr;
+    spa_hook coreListener_{};
+    spa_hook registryListener_{};
+    spa_hook metadataListener_{};
+    spa_hook streamListener_{};
+
+    // Loop lock: Audio/Source node.name / id → is Bluetooth, the default,
+    // and link id → (output node, input node).
+    std::map<std::string, bool> sources_;
+    std::map<uint32_t, bool> sourceIds_;
+    std::map<uint32_t, std::pair<uint32_t, uint32_t>> links_;
+    std::string defaultSource_;
+    // Corked open(): core sync rounds until registry + metadata are in.
+    int syncSeq_ = -1;
+    int syncRounds_ = 0;
+    bool synced_ = false;
+
+    std::atomic_bool failed_{false};
+};
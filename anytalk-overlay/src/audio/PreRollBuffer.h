@@ -0,0 +1,60 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+/// The last few capture chunks from between sessions, so speech that
+/// starts a beat before the hotkey still reaches the server.
+///
+/// Fixed number of chunk slots allocated once; push() overwrites the
+/// oldest chunk when full and never allocates. Single-threaded: only the
+/// capture source's loop thread touches it (consumers are serialized under
+/// the loop lock, see CaptureSource::setConsumer).
+///
+/// Plain C++, no Qt.
+class PreRollBuffer {
+public:
+    PreRollBuffer(int slotCount, int slotBytes)
+        : slotCount_(std::max(slotCount, 1)), slotBytes_(slotBytes),
+          data_(std::make_unique<char[]>(static_cast<std::size_t>(slotCount_) * slotBytes_)),
+          bytes_(std::make_unique<int[]>(static_cast<std::size_t>(slotCount_))) {}
+
+    int slotCount() const { return slotCount_; }
+    bool empty() const { return count_ == 0; }
+
+    void push(const char *pcm, int bytes) {
+        bytes = std::min(bytes, slotBytes_);
+        int slot;
+        if (count_ < slotCount_) {
+            slot = (head_ + count_) % slotCount_;
+            ++count_;
+        } else {
+            slot = head_;
+            head_ = (head_ + 1) % slotCount_;
+        }
+        std::memcpy(data_.get() + static_cast<std::size_t>(slot) * slotBytes_, pcm,
+                    static_cast<std::size_t>(bytes));
+        bytes_[slot] = bytes;
+    }
+
+    /// Visit every held chunk oldest first, then empty the buffer.
+    template <typename Fn>
+    void drain(Fn &&fn) {
+        for (; count_ > 0; --count_) {
+            fn(data_.get() + static_cast<std::size_t>(head_) * slotBytes_, bytes_[head_]);
+            head_ = (head_ + 1) % slotCount_;
+        }
+        head_ = 0;
+    }
+
+    void clear() { head_ = count_ = 0; }
+
+private:
+    const int slotCount_;
+    const int slotBytes_;
+    std::unique_ptr<char[]> data_;
+    std::unique_ptr<int[]> bytes_;
+    int head_ = 0;
+    int count_ = 0;
+};
@@ -0,0 +1,215 @@
+#include "PulseAsyncStream.h"
+
+#include <pulse/context.h>
+#include <pulse/error.h>
+#include <pulse/introspect.h>
+#include <pulse/proplist.h>
+#include <pulse/stream.h>
+#include <pulse/thread-mainloop.h>
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <thread>
+
+namespace {
+
+// Same signals AudioCapture's docs list for the pa_simple path: any one
+// is enough. PipeWire says "bluez5", raw BlueZ "bluez".
+bool looksBluetooth(const pa_source_info *info) {
+    if (info->name && std::strncmp(info->name, "bluez_", 6) == 0) return true;
+    if (const char *api = pa_proplist_gets(info->proplist, "device.api");
+        api && std::strstr(api, "bluez")) {
+        return true;
+    }
+    const char *bus = pa_proplist_gets(info->proplist, PA_PROP_DEVICE_BUS);
+    return bus && std::strcmp(bus, "bluetooth") == 0;
+}
+
+} // namespace
+
+PulseAsyncStream::PulseAsyncStream(int sampleRate, int chunkBytes, ErrorFn onError)
+    : CaptureSource(chunkBytes), sampleRate_(sampleRate), onError_(std::move(onError)) {}
+
+PulseAsyncStream::~PulseAsyncStream() {
+    if (loop_) pa_threaded_mainloop_free(loop_);
+}
+
+bool PulseAsyncStream::open(bool corked) {
+    loop_ = pa_threaded_mainloop_new();
+    if (!loop_) return false;
+    pa_threaded_mainloop_set_name(loop_, "anytalk-pulse");
+    ctx_ = pa_context_new(pa_threaded_mainloop_get_api(loop_), "anytalk");
+    if (!ctx_) return false;
+    wantCorked_ = corked;
+    pa_context_set_state_callback(ctx_, &PulseAsyncStream::onContextState, this);
+    if (pa_context_connect(ctx_, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
+        fail(pa_strerror(pa_context_errno(ctx_)));
+        return true;  // failed() tells the owner; no loop thread to stop yet
+    }
+    if (pa_threaded_mainloop_start(loop_) < 0) return false;
+    return true;
+}
+
+void PulseAsyncStream::setConsumer(ChunkFn fn) {
+    pa_threaded_mainloop_lock(loop_);
+    consumer_ = std::move(fn);
+    pendingBytes_ = 0;
+    pa_threaded_mainloop_unlock(loop_);
+}
+
+void PulseAsyncStream::setCorked(bool corked) {
+    pa_threaded_mainloop_lock(loop_);
+    wantCorked_ = corked;
+    if (stream_ && pa_stream_get_state(stream_) == PA_STREAM_READY) {
+        if (!corked) {
+            if (auto *op = pa_stream_flush(stream_, nullptr, nullptr)) pa_operation_unref(op);
+        }
+        if (auto *op = pa_stream_cork(stream_, corked ? 1 : 0, nullptr, nullptr)) {
+            pa_operation_unref(op);
+        }
+        pendingBytes_ = 0;
+    }
+    // Not ready yet: connectStream() picks wantCorked_ up.
+    pa_threaded_mainloop_unlock(loop_);
+}
+
+bool PulseAsyncStream::close(int timeoutMs) {
+    if (!loop_) return true;
+    // pa_threaded_mainloop_lock()/stop() have no timeout of their own. Run
+    // the teardown on a throwaway thread and give up on it past the
+    // deadline, exactly like AudioCapture::teardownStream does for a
+    // pa_simple_read that never returns.
+    auto done = std::make_shared<std::promise<void>>();
+    auto finished = done->get_future();
+    std::thread([this, done]() {
+        pa_threaded_mainloop_lock(loop_);
+        teardownLocked();
+        pa_threaded_mainloop_unlock(loop_);
+        pa_threaded_mainloop_stop(loop_);
+        done->set_value();
+    }).detach();
+    return finished.wait_for(std::chrono::milliseconds(timeoutMs)) == std::future_status::ready;
+}
+
+void PulseAsyncStream::teardownLocked() {
+    consumer_ = nullptr;
+    if (stream_) {
+        pa_stream_set_state_callback(stream_, nullptr, nullptr);
+        pa_stream_set_read_callback(stream_, nullptr, nullptr);
+        pa_stream_disconnect(stream_);
+        pa_stream_unref(stream_);
+        stream_ = nullptr;
+    }
+    if (ctx_) {
+        pa_context_set_state_callback(ctx_, nullptr, nullptr);
+        pa_context_disconnect(ctx_);
+        pa_context_unref(ctx_);
+        ctx_ = nullptr;
+    }
+}
+
+void PulseAsyncStream::fail(const std::string &what) {
+    if (failed_.exchange(true, std::memory_order_acq_rel)) return;
+    if (onError_) onError_(what);
+}
+
+// ---- Loop callbacks (PA thread, lock held) ----
+
+void PulseAsyncStream::onContextState(pa_context *c, void *self) {
+    auto *me = static_cast<PulseAsyncStream *>(self);
+    switch (pa_context_get_state(c)) {
+    case PA_CONTEXT_READY:
+        // Probe the default source first: a Bluetooth mic must never be
+        // held open between sessions (kernel SCO teardown race).
+        if (auto *op = pa_context_get_source_info_by_name(c, "@DEFAULT_SOURCE@",
+                                                          &PulseAsyncStream::onSourceInfo, me)) {
+            pa_operation_unref(op);
+        } else {
+            me->connectStream();
+        }
+        break;
+    case PA_CONTEXT_FAILED:
+    case PA_CONTEXT_TERMINATED:
+        me->fail(pa_strerror(pa_context_errno(c)));
+        break;
+    default:
+        break;
+    }
+}
+
+void PulseAsyncStream::onSourceInfo(pa_context *, const pa_source_info *info, int eol,
+                                    void *self) {
+    auto *me = static_cast<PulseAsyncStream *>(self);
+    if (info && !eol) {
+        if (looksBluetooth(info)) me->bluetooth_.store(true, std::memory_order_release);
+        return;
+    }
+    // eol (> 0 done, < 0 lookup failed — record anyway, default source).
+    me->connectStream();
+}
+
+void PulseAsyncStream::connectStream() {
+    if (stream_) return;
+    pa_sample_spec spec{};
+    spec.format = PA_SAMPLE_S16LE;
+    spec.rate = static_cast<uint32_t>(sampleRate_);
+    spec.channels = 1;
+
+    pa_buffer_attr attr{};
+    attr.maxlength = static_cast<uint32_t>(-1);
+    attr.tlength = static_cast<uint32_t>(-1);
+    attr.prebuf = static_cast<uint32_t>(-1);
+    attr.minreq = static_cast<uint32_t>(-1);
+    attr.fragsize = static_cast<uint32_t>(chunkBytes_);
+
+    stream_ = pa_stream_new(ctx_, "Voice Input", &spec, nullptr);
+    if (!stream_) {
+        fail(pa_strerror(pa_context_errno(ctx_)));
+        return;
+    }
+    pa_stream_set_state_callback(stream_, &PulseAsyncStream::onStreamState, this);
+    pa_stream_set_read_callback(stream_, &PulseAsyncStream::onStreamRead, this);
+    auto flags = static_cast<pa_stream_flags_t>(PA_STREAM_ADJUST_LATENCY |
+                                                (wantCorked_ ? PA_STREAM_START_CORKED : 0));
+    if (pa_stream_connect_record(stream_, nullptr, &attr, flags) < 0) {
+        fail(pa_strerror(pa_context_errno(ctx_)));
+    }
+}
+
+void PulseAsyncStream::onStreamState(pa_stream *s, void *self) {
+    auto *me = static_cast<PulseAsyncStream *>(self);
+    switch (pa_stream_get_state(s)) {
+    case PA_STREAM_READY:
+        // setCorked() may have flipped the wish while we were connecting.
+        if (pa_stream_is_corked(s) != (me->wantCorked_ ? 1 : 0)) {
+            if (auto *op = pa_stream_cork(s, me->wantCorked_ ? 1 : 0, nullptr, nullptr)) {
+                pa_operation_unref(op);
+            }
+        }
+        break;
+    case PA_STREAM_FAILED:
+    case PA_STREAM_TERMINATED:
+        me->fail(pa_strerror(pa_context_errno(pa_stream_get_context(s))));
+        break;
+    default:
+        break;
+    }
+}
+
+void PulseAsyncStream::onStreamRead(pa_stream *s, std::size_t, void *self) {
+    auto *me = static_cast<PulseAsyncStream *>(self);
+    while (pa_stream_readable_size(s) > 0) {
+        const void *data = nullptr;
+        std::size_t n = 0;
+        if (pa_stream_peek(s, &data, &n) < 0) {
+            me->fail(pa_strerror(pa_context_errno(pa_stream_get_context(s))));
+            return;
+        }
+        if (n == 0) break;
+        // data == nullptr with n > 0 is a hole in the record buffer: skip.
+        if (data && !me->wantCorked_) me->deliver(static_cast<const char *>(data), n);
+        pa_stream_drop(s);
+    }
+}
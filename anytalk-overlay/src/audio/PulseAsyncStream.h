@@ -0,0 +1,55 @@
+#pragma once
+#include "CaptureSource.h"
+
+#include <atomic>
+
+struct pa_context;
+struct pa_source_info;
+struct pa_stream;
+struct pa_threaded_mainloop;
+
+/// S16LE mono record stream on the asynchronous PulseAudio API
+/// (pa_threaded_mainloop + pa_context + pa_stream), for the hot-mic
+/// standby path: the stream stays connected across sessions and is merely
+/// corked in between, so resuming is one pa_stream_cork(0) instead of a
+/// pa_simple_new() round trip.
+///
+/// Connection, source probing and reads run on the PA mainloop thread.
+/// Uncorking flushes whatever the server still held from before the cork.
+/// isBluetooth() is known once the stream is connected; false before.
+class PulseAsyncStream : public CaptureSource {
+public:
+    PulseAsyncStream(int sampleRate, int chunkBytes, ErrorFn onError);
+    /// Only after close() returned true; a wedged stream is leaked instead.
+    ~PulseAsyncStream() override;
+
+    bool open(bool corked) override;
+    void setConsumer(ChunkFn fn) override;
+    void setCorked(bool corked) override;
+    bool failed() const override { return failed_.load(std::memory_order_acquire); }
+    bool isBluetooth() const override { return bluetooth_.load(std::memory_order_acquire); }
+    bool close(int timeoutMs) override;
+    const char *name() const override { return "pulse"; }
+
+private:
+    static void onContextState(pa_context *c, void *self);
+    static void onSourceInfo(pa_context *c, const pa_source_info *info, int eol, void *self);
+    static void onStreamState(pa_stream *s, void *self);
+    static void onStreamRead(pa_stream *s, std::size_t nbytes, void *self);
+
+    void connectStream();
+    void fail(const std::string &what);
+    void teardownLocked();
+
+    const int sampleRate_;
+    ErrorFn onError_;
+
+    pa_threaded_mainloop *loop_ = nullptr;
+    pa_context *ctx_ = nullptr;
+    pa_stream *stream_ = nullptr;
+
+    bool wantCorked_ = true;  // loop lock
+
+    std::atomic_bool failed_{false};
+    std::atomic_bool bluetooth_{false};
+};
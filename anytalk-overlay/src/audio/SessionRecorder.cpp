@@ -0,0 +1,436 @@
+#include "SessionRecorder.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr int kBytesPerMs = 32;                      // 16 kHz S16LE mono
+constexpr int kSegmentBytes = 1000 * kBytesPerMs;    // 1 s per segment
+constexpr char kFileMagic[8] = {'A', 'T', 'R', 'E', 'C', '1', '\0', '\0'};
+constexpr int kFileHeaderBytes = 16;
+constexpr int kSegmentHeaderBytes = 20;
+// Speech barely compresses faster, and the I/O thread has time to spare.
+constexpr int kDeflateLevel = 6;
+
+constexpr QFileDevice::Permissions kOwnerOnly = QFileDevice::ReadOwner | QFileDevice::WriteOwner;
+const QString kSuffix = QStringLiteral(".atrec");
+const QString kPartSuffix = QStringLiteral(".atrec.part");
+
+void putU32(QByteArray &out, quint32 v) {
+    char b[4];
+    qToLittleEndian(v, b);
+    out.append(b, 4);
+}
+
+quint32 getU32(const char *p) { return qFromLittleEndian<quint32>(p); }
+
+// First-order delta per sample (wrapping), then deflate: neighbouring
+// samples of speech are close, so the residual packs far better than raw
+// PCM does.
+QByteArray encodeSegment(const QByteArray &pcm) {
+    const int n = static_cast<int>(pcm.size() / 2);
+    QByteArray delta(n * 2, Qt::Uninitialized);
+    quint16 prev = 0;
+    for (int i = 0; i < n; ++i) {
+        const quint16 s = qFromLittleEndian<quint16>(pcm.constData() + 2 * i);
+        qToLittleEndian(static_cast<quint16>(s - prev), delta.data() + 2 * i);
+        prev = s;
+    }
+    uLongf bound = compressBound(static_cast<uLong>(delta.size()));
+    QByteArray out(static_cast<qsizetype>(bound), Qt::Uninitialized);
+    if (compress2(reinterpret_cast<Bytef *>(out.data()), &bound,
+                  reinterpret_cast<const Bytef *>(delta.constData()),
+                  static_cast<uLong>(delta.size()), kDeflateLevel) != Z_OK) {
+        return {};
+    }
+    out.truncate(static_cast<qsizetype>(bound));
+    return out;
+}
+
+bool decodeSegment(const char *stored, quint32 storedBytes, quint32 pcmBytes, quint32 crc,
+                   QByteArray &out) {
+    QByteArray pcm(pcmBytes, Qt::Uninitialized);
+    uLongf len = pcmBytes;
+    if (uncompress(reinterpret_cast<Bytef *>(pcm.data()), &len,
+                   reinterpret_cast<const Bytef *>(stored), storedBytes) != Z_OK ||
+        len != pcmBytes) {
+        return false;
+    }
+    quint16 prev = 0;
+    for (quint32 i = 0; i + 1 < pcmBytes; i += 2) {
+        prev = static_cast<quint16>(prev + qFromLittleEndian<quint16>(pcm.constData() + i));
+        qToLittleEndian(prev, pcm.data() + i);
+    }
+    if (crc32(0, reinterpret_cast<const Bytef *>(pcm.constData()), pcmBytes) != crc) return false;
+    out.append(pcm);
+    return true;
+}
+
+// The I/O thread's side: one open session file at a time.
+class Writer {
+public:
+    explicit Writer(QString dir) : dir_(std::move(dir)) {}
+    ~Writer() { finish(); }
+
+    void begin(std::int64_t capBytes) {
+        finish();
+        cap_ = capBytes;
+        // What was said is nobody else's business: the store is 0700 (also
+        // one made before this, under the umask) and its files 0600.
+        const QFileInfo dirInfo(dir_);
+        const bool made = dirInfo.isDir() || (QDir().mkpath(dirInfo.absolutePath()) &&
+                                               QDir().mkdir(dir_, kOwnerOnly | QFileDevice::ExeOwner));
+        if (!made || !QFile::setPermissions(dir_, kOwnerOnly | QFileDevice::ExeOwner)) {
+            qWarning() << "SessionRecorder: cannot create" << dir_;
+            return;
+        }
+        const QString name =
+            QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-HHmmss-zzz"));
+        file_.setFileName(dir_ + QLatin1Char('/') + name + kPartSuffix);
+        if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate, kOwnerOnly)) {
+            qWarning() << "SessionRecorder:" << file_.fileName() << file_.errorString();
+            return;
+        }
+        QByteArray hdr(kFileMagic, sizeof kFileMagic);
+        putU32(hdr, kSampleRate);
+        hdr.append(char(1)).append(char(0));    // u16 channels
+        hdr.append(char(16)).append(char(0));   // u16 bits per sample
+        write(hdr);
+        pending_.reserve(kSegmentBytes);
+    }
+
+    void data(const QByteArray &pcm) {
+        if (!file_.isOpen()) return;
+        qsizetype at = 0;
+        while (at < pcm.size()) {
+            const qsizetype n = std::min<qsizetype>(kSegmentBytes - pending_.size(),
+                                                    pcm.size() - at);
+            pending_.append(pcm.constData() + at, n);
+            at += n;
+            if (pending_.size() == kSegmentBytes) flushSegment();
+        }
+    }
+
+    /// Close the session; the finished file's path, or empty.
+    QString end() {
+        QString done = finish();
+        if (!done.isEmpty()) prune(done);
+        return done;
+    }
+
+    /// Session files torn off by a crash or _Exit are still readable
+    /// segment by segment: give them their final name.
+    void recover() {
+        const QDir dir(dir_);
+        for (const QFileInfo &fi : dir.entryInfoList({QLatin1Char('*') + kPartSuffix}, QDir::Files)) {
+            QString target = fi.absoluteFilePath();
+            target.chop(kPartSuffix.size() - kSuffix.size());
+            QFile::rename(fi.absoluteFilePath(), target);
+        }
+    }
+
+    QString newest() const {
+        const auto files = QDir(dir_).entryInfoList({QLatin1Char('*') + kSuffix}, QDir::Files,
+                                                    QDir::Name | QDir::Reversed);
+        return files.isEmpty() ? QString() : files.first().absoluteFilePath();
+    }
+
+private:
+    void write(const QByteArray &bytes) {
+        if (file_.write(bytes) != bytes.size()) {
+            qWarning() << "SessionRecorder: write failed:" << file_.errorString();
+            file_.close();
+        }
+        written_ += bytes.size();
+    }
+
+    void flushSegment() {
+        if (pending_.isEmpty() || !file_.isOpen()) return;
+        // One session alone may not outgrow the store; the rest is dropped.
+        if (written_ >= cap_) {
+            if (!capped_) qWarning() << "SessionRecorder: session over the store size, truncated";
+            capped_ = true;
+            pending_.clear();
+            return;
+        }
+        const QByteArray stored = encodeSegment(pending_);
+        if (stored.isEmpty()) {
+            pending_.clear();
+            return;
+        }
+        index_.push_back({static_cast<quint32>(written_), startMs_});
+        QByteArray hdr("SEGM", 4);
+        putU32(hdr, startMs_);
+        putU32(hdr, static_cast<quint32>(pending_.size()));
+        putU32(hdr, static_cast<quint32>(stored.size()));
+        putU32(hdr, static_cast<quint32>(crc32(0, reinterpret_cast<const Bytef *>(
+                                                      pending_.constData()),
+                                                  static_cast<uInt>(pending_.size()))));
+        write(hdr + stored);
+        startMs_ += static_cast<quint32>(pending_.size() / kBytesPerMs);
+        pending_.clear();
+    }
+
+    QString finish() {
+        QString done;
+        if (file_.isOpen()) {
+            flushSegment();
+            if (index_.empty()) {
+                file_.close();
+                file_.remove();  // nothing went upstream: not worth a file
+            } else {
+                QByteArray tail("ATIX", 4);
+                putU32(tail, static_cast<quint32>(index_.size()));
+                for (const auto &[offset, ms] : index_) {
+                    putU32(tail, offset);
+                    putU32(tail, ms);
+                }
+                putU32(tail, static_cast<quint32>(written_));
+                write(tail);
+                const QString part = file_.fileName();
+                file_.close();
+                done = part.chopped(kPartSuffix.size() - kSuffix.size());
+                if (!QFile::rename(part, done)) done.clear();
+            }
+        }
+        pending_.clear();
+        index_.clear();
+        written_ = 0;
+        startMs_ = 0;
+        capped_ = false;
+        return done;
+    }
+
+    // Oldest first until the store fits; the session just written stays.
+    void prune(const QString &keep) {
+        const auto files = QDir(dir_).entryInfoList({QLatin1Char('*') + kSuffix}, QDir::Files,
+                                                    QDir::Name);
+        std::int64_t total = 0;
+        for (const QFileInfo &fi : files) total += fi.size();
+        for (const QFileInfo &fi : files) {
+            if (total <= cap_) break;
+            if (fi.absoluteFilePath() == keep) continue;
+            if (QFile::remove(fi.absoluteFilePath())) total -= fi.size();
+        }
+    }
+
+    QString dir_;
+    QFile file_;
+    QByteArray pending_;
+    std::vector<std::pair<quint32, quint32>> index_;  // offset, start ms
+    std::int64_t written_ = 0;
+    std::int64_t cap_ = 0;
+    quint32 startMs_ = 0;
+    bool capped_ = false;
+};
+
+} // namespace
+
+SessionRecorder::SessionRecorder() = default;
+
+SessionRecorder::~SessionRecorder() {
+    if (!thread_) return;
+    {
+        QMutexLocker lock(&mutex_);
+        quit_ = true;
+    }
+    wake_.wakeOne();
+    thread_->wait();
+    delete thread_;
+}
+
+QString SessionRecorder::storeDir() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+           QStringLiteral("/anytalk/sessions");
+}
+
+void SessionRecorder::configure(const Settings &settings) {
+    settings_ = settings;
+    {
+        QMutexLocker lock(&mutex_);
+        maxStoreBytes_ = settings.maxStoreBytes;
+    }
+    if (settings_.enabled && !thread_) {
+        thread_ = QThread::create([this] { run(); });
+        thread_->setObjectName(QStringLiteral("anytalk-recorder"));
+        thread_->start(QThread::LowPriority);
+    }
+}
+
+void SessionRecorder::push(Op::Kind kind) {
+    {
+        QMutexLocker lock(&mutex_);
+        ops_.push_back({kind, {}});
+    }
+    wake_.wakeOne();
+}
+
+void SessionRecorder::begin() {
+    if (!settings_.enabled || !thread_) return;
+    recording_ = true;
+    push(Op::Kind::Begin);
+}
+
+void SessionRecorder::append(const char *pcm, int bytes) {
+    if (!recording_ || bytes <= 0) return;
+    bool full = false;
+    {
+        QMutexLocker lock(&mutex_);
+        while (bytes > 0) {
+            if (ops_.empty() || ops_.back().kind != Op::Kind::Data ||
+                ops_.back().pcm.size() >= kSegmentBytes) {
+                ops_.push_back({Op::Kind::Data, {}});
+                ops_.back().pcm.reserve(kSegmentBytes);
+            }
+            QByteArray &seg = ops_.back().pcm;
+            const int n = std::min(bytes, static_cast<int>(kSegmentBytes - seg.size()));
+            seg.append(pcm, n);
+            pcm += n;
+            bytes -= n;
+            full = full || seg.size() >= kSegmentBytes;
+        }
+    }
+    // One wakeup per second of audio, not per chunk.
+    if (full) wake_.wakeOne();
+}
+
+void SessionRecorder::end() {
+    if (!recording_) return;
+    recording_ = false;
+    push(Op::Kind::End);
+}
+
+bool SessionRecorder::readLast(QObject *context, ReadFn done) {
+    if (!thread_) return false;
+    {
+        QMutexLocker lock(&mutex_);
+        ops_.push_back({Op::Kind::Read, {}, context, std::move(done)});
+    }
+    wake_.wakeOne();
+    return true;
+}
+
+QString SessionRecorder::lastSessionPath() const {
+    QMutexLocker lock(&mutex_);
+    return lastPath_;
+}
+
+void SessionRecorder::run() {
+    Writer writer(storeDir());
+    writer.recover();
+    const QString newest = writer.newest();
+
+    QMutexLocker lock(&mutex_);
+    if (lastPath_.isEmpty()) lastPath_ = newest;
+    for (;;) {
+        // A partly filled Data op at the back may still grow; leave it
+        // until it is full or something comes after it.
+        while (!quit_ && (ops_.empty() || (ops_.size() == 1 &&
+                                           ops_.front().kind == Op::Kind::Data &&
+                                           ops_.front().pcm.size() < kSegmentBytes))) {
+            wake_.wait(&mutex_);
+        }
+        if (ops_.empty()) break;  // quit_, all written
+        Op op = std::move(ops_.front());
+        ops_.pop_front();
+        const std::int64_t cap = maxStoreBytes_;
+        const QString last = lastPath_;
+        lock.unlock();
+
+        QString finished;
+        switch (op.kind) {
+        case Op::Kind::Begin: writer.begin(cap); break;
+        case Op::Kind::Data: writer.data(op.pcm); break;
+        case Op::Kind::End: finished = writer.end(); break;
+        case Op::Kind::Read: {
+            QString error;
+            QByteArray pcm = last.isEmpty() ? QByteArray() : read(last, error);
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [context = op.context, done = std::move(op.done), pcm = std::move(pcm), last,
+                 error]() mutable {
+                    if (context) done(std::move(pcm), last, error);
+                },
+                Qt::QueuedConnection);
+            break;
+        }
+        }
+
+        lock.relock();
+        if (!finished.isEmpty()) lastPath_ = finished;
+    }
+}
+
+QByteArray SessionRecorder::read(const QString &path, QString &error) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        error = f.errorString();
+        return {};
+    }
+    const QByteArray file = f.readAll();
+    if (file.size() < kFileHeaderBytes ||
+        std::memcmp(file.constData(), kFileMagic, sizeof kFileMagic) != 0) {
+        error = QStringLiteral("not an anytalk recording");
+        return {};
+    }
+
+    // Segment offsets from the index when the file was closed properly;
+    // otherwise walk them from the header on.
+    std::vector<quint32> offsets;
+    if (file.size() >= kFileHeaderBytes + 12) {
+        // In qint64: a stored offset near 4 GiB must not wrap past the check.
+        const qint64 ix = getU32(file.constData() + file.size() - 4);
+        if (ix + 8 <= file.size() && std::memcmp(file.constData() + ix, "ATIX", 4) == 0) {
+            const qint64 count = getU32(file.constData() + ix + 4);
+            if (ix + 8 + count * 8 + 4 == file.size()) {
+                for (qint64 i = 0; i < count; ++i) {
+                    offsets.push_back(getU32(file.constData() + ix + 8 + i * 8));
+                }
+            }
+        }
+    }
+    const bool indexed = !offsets.empty();
+
+    QByteArray pcm;
+    qsizetype at = kFileHeaderBytes;
+    for (std::size_t i = 0;; ++i) {
+        if (indexed) {
+            if (i >= offsets.size()) break;
+            at = offsets[i];
+        }
+        if (at + kSegmentHeaderBytes > file.size()) break;
+        const char *h = file.constData() + at;
+        if (std::memcmp(h, "SEGM", 4) != 0) {
+            if (indexed) continue;
+            break;  // index or garbage: end of the segments
+        }
+        const quint32 pcmBytes = getU32(h + 8);
+        const quint32 storedBytes = getU32(h + 12);
+        const quint32 crc = getU32(h + 16);
+        if (at + kSegmentHeaderBytes + storedBytes > file.size() || pcmBytes > kSegmentBytes) {
+            break;
+        }
+        if (!decodeSegment(h + kSegmentHeaderBytes, storedBytes, pcmBytes, crc, pcm)) {
+            qWarning() << "SessionRecorder: skipping corrupt segment at" << at << "in" << path;
+        }
+        at += kSegmentHeaderBytes + storedBytes;
+    }
+    if (pcm.isEmpty()) error = QStringLiteral("no readable audio");
+    return pcm;
+}
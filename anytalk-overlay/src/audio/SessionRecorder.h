@@ -0,0 +1,94 @@
+#pragma once
+#include <QByteArray>
+#include <QMutex>
+#include <QPointer>
+#include <QString>
+#include <QWaitCondition>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+class QThread;
+
+/// Keeps the audio of recent sessions on disk, so a session that was
+/// misrecognised or died mid-dictation can be sent again
+/// (AsrController::resubmitLastSession). Fed with what went upstream —
+/// post-VAD, post-pre-roll — from the main thread's ring drain.
+///
+/// Nothing here touches the disk on the caller's thread: append() copies
+/// into a pending segment under a short lock, and an I/O thread encodes,
+/// writes and prunes. Files live in $XDG_CACHE_HOME/anytalk/sessions/
+/// (one per session, named by start time) and the directory is kept under
+/// the configured size by deleting the oldest sessions.
+///
+/// File format (.atrec, little-endian):
+///   header   "ATREC1\0\0", u32 sample rate, u16 channels, u16 bits
+///   segment  "SEGM", u32 start ms, u32 PCM bytes, u32 stored bytes,
+///            u32 CRC-32 of the PCM, stored bytes
+///   index    "ATIX", u32 count, count × (u32 file offset, u32 start ms)
+///   trailer  u32 offset of "ATIX"
+/// A segment is ≤ 1 s of audio, delta-coded per sample then deflated, and
+/// decodes on its own. A file cut short (crash, power loss) has no index;
+/// read() then walks the segments and keeps every intact one.
+class SessionRecorder {
+public:
+    struct Settings {
+        bool enabled = false;
+        std::int64_t maxStoreBytes = 64LL * 1024 * 1024;
+    };
+
+    SessionRecorder();
+    /// Finishes whatever was queued, then joins the I/O thread.
+    ~SessionRecorder();
+    SessionRecorder(const SessionRecorder &) = delete;
+    SessionRecorder &operator=(const SessionRecorder &) = delete;
+
+    /// Takes effect from the next begin().
+    void configure(const Settings &settings);
+    bool enabled() const { return settings_.enabled; }
+
+    /// Session boundaries. No-ops while disabled.
+    void begin();
+    void append(const char *pcm, int bytes);
+    void end();
+
+    /// Newest completed recording; empty when there is none.
+    QString lastSessionPath() const;
+
+    /// Whole file as 16 kHz mono S16LE PCM. Corrupt segments are skipped;
+    /// empty + `error` when nothing is readable.
+    static QByteArray read(const QString &path, QString &error);
+
+    /// (pcm, path, error) as read() leaves them; empty path: no recording.
+    using ReadFn = std::function<void(QByteArray, QString, QString)>;
+    /// read() the newest recording on the I/O thread, after the sessions
+    /// queued before it are written, and hand the result to `done` on the
+    /// main thread — dropped if `context` is gone by then. False when
+    /// there is no I/O thread ([Audio] Record never on).
+    bool readLast(QObject *context, ReadFn done);
+
+    static QString storeDir();
+
+private:
+    struct Op {
+        enum class Kind { Begin, Data, End, Read } kind;
+        QByteArray pcm;  // Data: ≤ kSegmentBytes
+        QPointer<QObject> context;  // Read
+        ReadFn done;                // Read
+    };
+
+    void run();
+    void push(Op::Kind kind);
+
+    Settings settings_;
+    bool recording_ = false;
+    QThread *thread_ = nullptr;
+
+    mutable QMutex mutex_;
+    QWaitCondition wake_;
+    std::deque<Op> ops_;       // main → I/O thread, guarded by mutex_
+    bool quit_ = false;        // guarded by mutex_
+    std::int64_t maxStoreBytes_ = 0;  // the session's cap, guarded by mutex_
+    QString lastPath_;         // guarded by mutex_
+};
@@ -0,0 +1,134 @@
+#include "VoiceActivityDetector.h"
+#include "LevelKernel.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Below this normalized RMS (~-46 dBFS) nothing counts as speech, however
+// quiet the room: keeps the floor tracker from treating mic hiss in a
+// silent room as a signal.
+constexpr double kAbsoluteMinRms = 0.005;
+// Speech must sit this far above the tracked noise floor (~10 dB).
+constexpr double kFloorRatio = 3.0;
+// Broadband hiss / fan noise crosses zero on most samples; voiced speech
+// at 16 kHz stays well under this. Only applied near the threshold so
+// fricatives in loud speech still pass.
+constexpr double kNoiseZcr = 0.45;
+// Consecutive speech chunks before an onset is declared (80 ms); the
+// pre-roll covers what this delay would otherwise clip.
+constexpr int kOnsetChunks = 2;
+} // namespace
+
+VoiceActivityDetector::VoiceActivityDetector(const Settings &settings, int chunkBytes,
+                                             int sampleRate)
+    : settings_(settings),
+      chunkBytes_(std::max(chunkBytes, 2)),
+      chunkMs_(std::max(1, chunkBytes_ / 2 * 1000 / std::max(sampleRate, 1))),
+      preRollSlots_(std::max(1, settings.preRollMs / chunkMs_)),
+      preRoll_(std::make_unique<char[]>(static_cast<std::size_t>(preRollSlots_) * chunkBytes_)),
+      preRollBytes_(std::make_unique<int[]>(static_cast<std::size_t>(preRollSlots_))) {
+    reset();
+}
+
+VoiceActivityDetector::~VoiceActivityDetector() = default;
+
+void VoiceActivityDetector::reset() {
+    preRollHead_ = 0;
+    preRollCount_ = 0;
+    noiseFloor_ = kAbsoluteMinRms;
+    onsetRun_ = 0;
+    speech_ = false;
+    heardSpeech_ = false;
+    autoStopped_ = false;
+    silenceMs_ = 0;
+    sinceSentMs_ = 0;
+    dropped_ = 0;
+}
+
+bool VoiceActivityDetector::isSpeech(const char *pcm, int bytes, double rms) {
+    const int n = bytes / 2;
+    if (n <= 0) return false;
+    const auto *s = reinterpret_cast<const int16_t *>(pcm);
+    int crossings = 0;
+    for (int i = 1; i < n; ++i) crossings += (s[i] >= 0) != (s[i - 1] >= 0);
+    const double zcr = static_cast<double>(crossings) / n;
+
+    const double threshold = std::max(kAbsoluteMinRms, noiseFloor_ * kFloorRatio);
+    bool voiced = rms > threshold;
+    if (voiced && zcr > kNoiseZcr && rms < threshold * 2.0) voiced = false;
+
+    if (!voiced) {
+        // Fall fast (a door closing stops being "the floor" quickly), rise
+        // slowly (a steady background hum is learned over ~2 s).
+        const double a = rms < noiseFloor_ ? 0.3 : 0.02;
+        noiseFloor_ = std::max(kAbsoluteMinRms, noiseFloor_ + a * (rms - noiseFloor_));
+    }
+    return voiced;
+}
+
+void VoiceActivityDetector::holdForPreRoll(const char *pcm, int bytes) {
+    bytes = std::min(bytes, chunkBytes_);
+    int slot;
+    if (preRollCount_ < preRollSlots_) {
+        slot = (preRollHead_ + preRollCount_) % preRollSlots_;
+        ++preRollCount_;
+    } else {
+        // Full: the oldest held chunk falls out for good.
+        slot = preRollHead_;
+        preRollHead_ = (preRollHead_ + 1) % preRollSlots_;
+        ++dropped_;
+    }
+    std::memcpy(preRoll_.get() + static_cast<std::size_t>(slot) * chunkBytes_, pcm,
+                static_cast<std::size_t>(bytes));
+    preRollBytes_[slot] = bytes;
+}
+
+VoiceActivityDetector::Result VoiceActivityDetector::feed(const char *pcm, int bytes) {
+    if (!settings_.enabled) return feed(pcm, bytes, level::Stats{});
+    return feed(pcm, bytes, level::measure(reinterpret_cast<const int16_t *>(pcm), bytes / 2));
+}
+
+VoiceActivityDetector::Result VoiceActivityDetector::feed(const char *pcm, int bytes,
+                                                          const level::Stats &stats) {
+    Result r;
+    if (!settings_.enabled) {
+        r.send = true;
+        return r;
+    }
+
+    const bool voiced = isSpeech(pcm, bytes, stats.rms());
+    onsetRun_ = voiced ? onsetRun_ + 1 : 0;
+
+    if (voiced && (speech_ || onsetRun_ >= kOnsetChunks)) {
+        r.flushPreRoll = !speech_ && preRollCount_ > 0;
+        speech_ = true;
+        heardSpeech_ = true;
+        silenceMs_ = 0;
+    } else {
+        silenceMs_ += chunkMs_;
+        if (speech_ && silenceMs_ > settings_.hangoverMs) speech_ = false;
+    }
+
+    if (heardSpeech_ && !autoStopped_ && settings_.autoStopMs > 0 &&
+        silenceMs_ >= settings_.autoStopMs) {
+        autoStopped_ = true;
+        r.autoStop = true;
+    }
+
+    sinceSentMs_ += chunkMs_;
+    if (speech_) {
+        r.send = true;
+        sinceSentMs_ = 0;
+        return r;
+    }
+    holdForPreRoll(pcm, bytes);
+    if (sinceSentMs_ >= settings_.keepaliveMs) {
+        // Keepalive from the tail of the pre-roll rather than this chunk:
+        // audio stays in order and the pre-roll keeps the newest audio for
+        // an onset that may follow.
+        r.keepalive = true;
+        sinceSentMs_ = 0;
+    }
+    return r;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "LevelKernel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// Energy + zero-crossing voice activity gate for the capture thread.
+///
+/// Decides per 40 ms chunk whether it goes upstream. Leading silence is
+/// held in a short pre-roll (so the first syllable's onset isn't clipped
+/// when speech is detected a chunk late), pauses longer than the hangover
+/// are dropped except for one keepalive chunk per keepaliveMs (the server
+/// kicks sockets that go quiet for a few seconds), and an optional
+/// auto-stop fires once after autoStopMs of silence following speech.
+///
+/// Plain C++, no Qt; not thread-safe — one instance per capture thread,
+/// reset() per session.
+class VoiceActivityDetector {
+public:
+    struct Settings {
+        bool enabled = false;
+        int preRollMs = 300;     // leading audio replayed when speech starts
+        int hangoverMs = 800;    // keep sending this long into a pause, so the
+                                 // server's own VAD still sees the utterance end
+        int keepaliveMs = 1000;  // max gap between chunks while dropping
+        int autoStopMs = 0;      // 0 = never auto-stop
+    };
+
+    /// What to do with the chunk just fed.
+    struct Result {
+        bool flushPreRoll = false; // emit the whole pre-roll first, oldest first
+        bool keepalive = false;    // emit just the oldest pre-roll chunk
+        bool send = false;         // then the chunk itself
+        bool autoStop = false;     // trailing silence reached autoStopMs (once)
+    };
+
+    VoiceActivityDetector(const Settings &settings, int chunkBytes, int sampleRate);
+    ~VoiceActivityDetector();
+    VoiceActivityDetector(const VoiceActivityDetector &) = delete;
+    VoiceActivityDetector &operator=(const VoiceActivityDetector &) = delete;
+
+    /// Classify `bytes` of S16LE mono (≤ chunkBytes). Chunks that are not
+    /// sent are copied into the pre-roll.
+    Result feed(const char *pcm, int bytes);
+    /// feed() for a chunk the caller already ran level::measure() over.
+    Result feed(const char *pcm, int bytes, const level::Stats &stats);
+
+    /// Visit and release up to `maxChunks` held pre-roll chunks, oldest
+    /// first: all of them on Result::flushPreRoll (before sending the
+    /// current chunk), one on Result::keepalive.
+    template <typename Fn>
+    void drainPreRoll(Fn &&fn, int maxChunks = 1 << 30) {
+        for (; preRollCount_ > 0 && maxChunks > 0; --preRollCount_, --maxChunks) {
+            const int slot = preRollHead_;
+            fn(preRoll_.get() + static_cast<std::size_t>(slot) * chunkBytes_, preRollBytes_[slot]);
+            preRollHead_ = (preRollHead_ + 1) % preRollSlots_;
+        }
+        if (preRollCount_ == 0) preRollHead_ = 0;
+    }
+
+    void reset();
+
+    bool inSpeech() const { return speech_; }
+    /// Chunks withheld so far this session (dropped, not pre-rolled).
+    std::uint64_t droppedChunks() const { return dropped_; }
+
+private:
+    bool isSpeech(const char *pcm, int bytes, double rms);
+    void holdForPreRoll(const char *pcm, int bytes);
+
+    const Settings settings_;
+    const int chunkBytes_;
+    const int chunkMs_;
+    const int preRollSlots_;
+
+    std::unique_ptr<char[]> preRoll_;
+    std::unique_ptr<int[]> preRollBytes_;
+    int preRollHead_ = 0;
+    int preRollCount_ = 0;
+
+    double noiseFloor_ = 0.0;   // normalized RMS of recent non-speech
+    int onsetRun_ = 0;          // consecutive speech-classified chunks
+    bool speech_ = false;       // inside an utterance (incl. hangover)
+    bool heardSpeech_ = false;  // any speech this session
+    bool autoStopped_ = false;
+    int silenceMs_ = 0;         // since the last speech chunk
+    int sinceSentMs_ = 0;       // since the last chunk that went upstream
+    std::uint64_t dropped_ = 0;
+};
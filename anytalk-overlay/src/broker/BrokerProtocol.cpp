@@ -0,0 +1,85 @@
+#include "BrokerProtocol.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace broker {
+
+QByteArray frame(char op, const char *data, qsizetype size) {
+    QByteArray out(4 + 1 + size, Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(1 + size), out.data());
+    out[4] = op;
+    if (size > 0) std::memcpy(out.data() + 5, data, size_t(size));
+    return out;
+}
+
+QByteArray tagged(quint32 seq, const QByteArray &payload) {
+    return QByteArray::number(seq) + ' ' + payload;
+}
+
+bool untag(QByteArray &payload, quint32 &seq) {
+    const qsizetype space = payload.indexOf(' ');
+    bool ok = false;
+    const quint32 n = payload.left(space < 0 ? payload.size() : space).toUInt(&ok);
+    if (!ok) return false;
+    seq = n;
+    payload.remove(0, space < 0 ? payload.size() : space + 1);
+    return true;
+}
+
+QByteArray encodeStats(const AsrTransportStats &s) {
+    const QJsonObject o{
+        {QStringLiteral("frames_sent"), s.framesSent},
+        {QStringLiteral("bytes_sent"), s.bytesSent},
+        {QStringLiteral("frames_received"), s.framesReceived},
+        {QStringLiteral("bytes_received"), s.bytesReceived},
+        {QStringLiteral("peak_queued_ms"), s.peakQueuedMs},
+        {QStringLiteral("dropped_audio_ms"), s.droppedAudioMs},
+    };
+    return QJsonDocument(o).toJson(QJsonDocument::Compact);
+}
+
+AsrTransportStats decodeStats(const QByteArray &json) {
+    const QJsonObject o = QJsonDocument::fromJson(json).object();
+    AsrTransportStats s;
+    s.framesSent = o.value(QLatin1String("frames_sent")).toInteger();
+    s.bytesSent = o.value(QLatin1String("bytes_sent")).toInteger();
+    s.framesReceived = o.value(QLatin1String("frames_received")).toInteger();
+    s.bytesReceived = o.value(QLatin1String("bytes_received")).toInteger();
+    s.peakQueuedMs = o.value(QLatin1String("peak_queued_ms")).toInt();
+    s.droppedAudioMs = o.value(QLatin1String("dropped_audio_ms")).toInteger();
+    return s;
+}
+
+void FrameReader::append(const QByteArray &bytes) {
+    if (pos_ > 0) {
+        buf_.remove(0, pos_);
+        pos_ = 0;
+    }
+    buf_.append(bytes);
+}
+
+bool FrameReader::next(char &op, QByteArray &payload) {
+    if (bad_ || buf_.size() - pos_ < 4) return false;
+    const quint32 len = qFromLittleEndian<quint32>(buf_.constData() + pos_);
+    if (len < 1 || len > quint32(kMaxFrameBytes)) {
+        bad_ = true;
+        return false;
+    }
+    if (buf_.size() - pos_ - 4 < qsizetype(len)) return false;
+    op = buf_.at(pos_ + 4);
+    payload = buf_.mid(pos_ + 5, qsizetype(len) - 1);
+    pos_ += 4 + qsizetype(len);
+    return true;
+}
+
+void FrameReader::clear() {
+    buf_.clear();
+    pos_ = 0;
+    bad_ = false;
+}
+
+} // namespace broker
@@ -0,0 +1,89 @@
+#pragma once
+#include "asr/AsrBackend.h"
+
+#include <QByteArray>
+#include <QString>
+
+/// Wire format between BrokerBackend (in each overlay) and anytalk-broker,
+/// over a local stream socket. Each frame is a u32 LE length of what
+/// follows, an opcode byte, then the payload: PCM is 16 kHz mono S16LE,
+/// text is UTF-8.
+///
+///   overlay → broker: 'W'            prewarm
+///                     'T' + seq      start
+///                     'a' + PCM      pushPcm
+///                     'S'            stop
+///                     'X'            cancel
+///                     'b' + PCM      a piece of a submitBuffer() buffer
+///                     'E' + seq      submit the pieces sent so far
+///   broker → overlay: 'c' + seq            connected
+///                     'p' + seq + text     partial
+///                     'f' + seq + text     final
+///                     'g' + seq + "1 850"  congestion on / off, queued ms
+///                     'F' + seq + JSON     finished, with the session's transport stats
+///                     'e' + seq + text     error
+///
+/// One session at a time per connection; the connection outlives it.
+/// seq is the overlay's session number in decimal, followed by a space
+/// before any payload (tagged()). The broker echoes the one from 'T' / 'E'
+/// on everything the session sends back, so the overlay can drop what a
+/// cancelled session still had in flight when the next one started.
+/// Unknown opcodes are ignored so either side can grow the protocol.
+namespace broker {
+
+inline constexpr char kPrewarm = 'W';
+inline constexpr char kStart = 'T';
+inline constexpr char kAudio = 'a';
+inline constexpr char kStop = 'S';
+inline constexpr char kCancel = 'X';
+inline constexpr char kBufferPiece = 'b';
+inline constexpr char kBufferEnd = 'E';
+
+inline constexpr char kConnected = 'c';
+inline constexpr char kPartial = 'p';
+inline constexpr char kFinal = 'f';
+inline constexpr char kCongestion = 'g';
+inline constexpr char kFinished = 'F';
+inline constexpr char kError = 'e';
+
+/// Larger frames are a protocol error; submitBuffer() audio goes in
+/// pieces well under it.
+inline constexpr int kMaxFrameBytes = 1 << 20;
+inline constexpr int kBufferPieceBytes = 256 * 1024;
+
+/// [Broker] Socket when unset; the systemd unit's RuntimeDirectory.
+inline constexpr const char *kDefaultSocket = "/run/anytalk/broker.sock";
+
+QByteArray frame(char op, const char *data = nullptr, qsizetype size = 0);
+inline QByteArray frame(char op, const QByteArray &payload) {
+    return frame(op, payload.constData(), payload.size());
+}
+inline QByteArray frame(char op, const QString &text) { return frame(op, text.toUtf8()); }
+
+/// "<seq> " + payload, and back: false (payload left alone) when there
+/// is no number in front.
+QByteArray tagged(quint32 seq, const QByteArray &payload = {});
+inline QByteArray tagged(quint32 seq, const QString &text) { return tagged(seq, text.toUtf8()); }
+bool untag(QByteArray &payload, quint32 &seq);
+
+QByteArray encodeStats(const AsrTransportStats &stats);
+AsrTransportStats decodeStats(const QByteArray &json);
+
+/// Splits a byte stream back into frames. Reads in place and compacts
+/// once per append, so a burst of small frames isn't copied per frame.
+class FrameReader {
+public:
+    void append(const QByteArray &bytes);
+    /// The next complete frame, if there is one.
+    bool next(char &op, QByteArray &payload);
+    /// A length out of range was seen; the stream can't be resynced.
+    bool bad() const { return bad_; }
+    void clear();
+
+private:
+    QByteArray buf_;
+    qsizetype pos_ = 0;
+    bool bad_ = false;
+};
+
+} // namespace broker
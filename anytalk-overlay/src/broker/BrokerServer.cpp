@@ -0,0 +1,238 @@
+#include "BrokerServer.h"
+#include "BrokerProtocol.h"
+#include "asr/AsrBackend.h"
+#include "asr/AsrBackendFactory.h"
+
+#include <QDebug>
+#include <QLocalSocket>
+
+#include <sys/socket.h>
+#include <utility>
+
+namespace {
+
+// A recording uploaded with 'b' pieces; past this the client is dropped.
+// About 35 minutes of 16 kHz mono S16LE.
+constexpr qsizetype kMaxBufferBytes = 64 * 1024 * 1024;
+
+/// The uid on the other end, for the log; -1 if the kernel won't say.
+qint64 peerUid(const QLocalSocket *socket) {
+    ucred cred{};
+    socklen_t len = sizeof(cred);
+    if (::getsockopt(int(socket->socketDescriptor()), SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return -1;
+    }
+    return cred.uid;
+}
+
+/// One overlay's connection: runs its sessions one at a time on a backend
+/// borrowed from the server, and goes away with the socket.
+class Client : public QObject {
+public:
+    Client(BrokerServer *server, QLocalSocket *socket)
+        : QObject(server), server_(server), socket_(socket), uid_(peerUid(socket)) {
+        socket_->setParent(this);
+        connect(socket_, &QLocalSocket::readyRead, this, &Client::onReadyRead);
+        connect(socket_, &QLocalSocket::disconnected, this, &Client::onDisconnected);
+        qInfo() << "anytalk-broker: client connected, uid" << uid_;
+    }
+
+    ~Client() override { endSession(/*cancel=*/true); }
+
+private:
+    void onReadyRead() {
+        reader_.append(socket_->readAll());
+        char op = 0;
+        QByteArray payload;
+        while (reader_.next(op, payload)) {
+            handle(op, payload);
+            if (closing_) return;
+        }
+        if (reader_.bad()) drop("malformed frame");
+    }
+
+    void handle(char op, const QByteArray &payload) {
+        switch (op) {
+        case broker::kPrewarm: server_->prewarm(); break;
+        case broker::kStart:
+            if (beginSession(payload)) backend_->start();
+            break;
+        case broker::kAudio:
+            if (backend_) backend_->pushPcm(payload);
+            break;
+        case broker::kStop:
+            if (backend_) backend_->stop();
+            break;
+        case broker::kCancel:
+            buffer_.clear();
+            endSession(/*cancel=*/true);
+            break;
+        case broker::kBufferPiece:
+            if (buffer_.size() + payload.size() > kMaxBufferBytes) {
+                drop("recording over the size cap");
+                return;
+            }
+            buffer_.append(payload);
+            break;
+        case broker::kBufferEnd:
+            if (beginSession(payload)) backend_->submitBuffer(std::exchange(buffer_, {}));
+            break;
+        default: break;
+        }
+    }
+
+    /// `tag` is the 'T' / 'E' payload: the overlay's session number, sent
+    /// back in front of everything this session reports.
+    bool beginSession(const QByteArray &tag) {
+        if (backend_) return false;  // one at a time; the overlay knows
+        QByteArray rest = tag;
+        quint32 seq = 0;
+        if (!broker::untag(rest, seq)) {
+            drop("session without a number");
+            return false;
+        }
+        QString error;
+        backend_ = server_->acquire(error);
+        if (!backend_) {
+            send(broker::frame(broker::kError, broker::tagged(seq, error)));
+            return false;
+        }
+        AsrBackend *b = backend_.get();
+        connect(b, &AsrBackend::connected, this,
+                [this, seq]() { send(broker::frame(broker::kConnected, broker::tagged(seq))); });
+        connect(b, &AsrBackend::partial, this, [this, seq](const QString &t) {
+            send(broker::frame(broker::kPartial, broker::tagged(seq, t)));
+        });
+        connect(b, &AsrBackend::final_, this, [this, seq](const QString &t) {
+            send(broker::frame(broker::kFinal, broker::tagged(seq, t)));
+        });
+        connect(b, &AsrBackend::congestion, this, [this, seq](bool on, int queuedMs) {
+            send(broker::frame(broker::kCongestion,
+                               broker::tagged(seq, QByteArray(on ? "1 " : "0 ") +
+                                                       QByteArray::number(queuedMs))));
+        });
+        connect(b, &AsrBackend::finished, this, [this, seq]() {
+            const QByteArray stats = broker::encodeStats(backend_->transportStats());
+            endSession(/*cancel=*/false);
+            send(broker::frame(broker::kFinished, broker::tagged(seq, stats)));
+        });
+        connect(b, &AsrBackend::error, this, [this, seq](const QString &m) {
+            endSession(/*cancel=*/false);
+            send(broker::frame(broker::kError, broker::tagged(seq, m)));
+        });
+        return true;
+    }
+
+    void endSession(bool cancel) {
+        if (!backend_) return;
+        backend_->disconnect(this);
+        if (cancel) backend_->cancel();
+        server_->release(std::move(backend_));
+    }
+
+    void send(const QByteArray &frameBytes) {
+        if (socket_->state() == QLocalSocket::ConnectedState) socket_->write(frameBytes);
+    }
+
+    void drop(const char *why) {
+        qWarning() << "anytalk-broker: dropping client, uid" << uid_ << "—" << why;
+        closing_ = true;
+        socket_->abort();
+    }
+
+    void onDisconnected() {
+        if (std::exchange(gone_, true)) return;
+        closing_ = true;
+        qInfo() << "anytalk-broker: client gone, uid" << uid_;
+        endSession(/*cancel=*/true);
+        deleteLater();
+    }
+
+    BrokerServer *server_;
+    QLocalSocket *socket_;
+    qint64 uid_;
+    broker::FrameReader reader_;
+    std::unique_ptr<AsrBackend> backend_;
+    QByteArray buffer_;
+    bool closing_ = false;
+    bool gone_ = false;
+};
+
+} // namespace
+
+BrokerServer::BrokerServer(OverlayConfig cfg, Settings settings, QObject *parent)
+    : QObject(parent), cfg_(std::move(cfg)), settings_(std::move(settings)) {
+    // Outlives every session by design; spares default on as for a
+    // resident overlay.
+    cfg_.resident = true;
+    server_.setSocketOptions(settings_.worldAccess ? QLocalServer::WorldAccessOption
+                                                   : QLocalServer::UserAccessOption |
+                                                         QLocalServer::GroupAccessOption);
+    connect(&server_, &QLocalServer::newConnection, this, &BrokerServer::onNewConnection);
+}
+
+BrokerServer::~BrokerServer() {
+    // Clients hand their backends back from their destructors.
+    qDeleteAll(findChildren<QObject *>(Qt::FindDirectChildrenOnly));
+}
+
+bool BrokerServer::listen(QString &error) {
+    // A socket file left by a killed broker would block the bind.
+    QLocalServer::removeServer(settings_.socketPath);
+    if (!server_.listen(settings_.socketPath)) {
+        error = server_.errorString();
+        return false;
+    }
+    qInfo().noquote() << "anytalk-broker: listening on" << settings_.socketPath << "— backend"
+                      << cfg_.backend << "," << settings_.warmBackends << "warm";
+    prewarm();
+    return true;
+}
+
+std::unique_ptr<AsrBackend> BrokerServer::acquire(QString &error) {
+    if (busy_ >= settings_.maxSessions) {
+        error = QStringLiteral("识别服务繁忙（anytalk-broker 已有 %1 个会话）")
+                    .arg(settings_.maxSessions);
+        return nullptr;
+    }
+    std::unique_ptr<AsrBackend> b;
+    if (!idle_.empty()) {
+        b = std::move(idle_.back());
+        idle_.pop_back();
+    } else {
+        b = asr::create(cfg_);
+        if (!b) {
+            error = QStringLiteral("识别后端不可用（anytalk-broker：%1）").arg(cfg_.backend);
+            return nullptr;
+        }
+    }
+    ++busy_;
+    return b;
+}
+
+void BrokerServer::release(std::unique_ptr<AsrBackend> backend) {
+    if (!backend) return;
+    --busy_;
+    if (int(idle_.size()) < settings_.warmBackends) {
+        // Its own pool rotates the spare after a session; nothing to kick.
+        idle_.push_back(std::move(backend));
+    } else {
+        backend.release()->deleteLater();
+    }
+}
+
+void BrokerServer::prewarm() {
+    while (int(idle_.size()) < settings_.warmBackends) {
+        auto b = asr::create(cfg_);
+        if (!b) break;
+        idle_.push_back(std::move(b));
+    }
+    // Idempotent per backend: a warm spare isn't opened twice.
+    for (const auto &b : idle_) b->prewarm();
+}
+
+void BrokerServer::onNewConnection() {
+    while (QLocalSocket *socket = server_.nextPendingConnection()) {
+        new Client(this, socket);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Config.h"
+
+#include <QLocalServer>
+#include <QObject>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+class AsrBackend;
+
+/// anytalk-broker's listener: one BrokerBackend connection per overlay,
+/// each driving sessions on a backend built from the broker's own config
+/// (asr::create). Backends go back to a shared idle pool between
+/// sessions, so their spare sockets and any local model serve whichever
+/// seat speaks next instead of one copy per user.
+///
+/// The pool is kept warm: `warmBackends` idle backends prewarmed at
+/// listen(), refilled by the backends that finish sessions and topped up
+/// whenever an overlay sends a prewarm. Beyond that a session runs on a
+/// backend made for it, up to `maxSessions` at once; past that start() is
+/// refused with error().
+class BrokerServer : public QObject {
+    Q_OBJECT
+public:
+    struct Settings {
+        QString socketPath;
+        bool worldAccess = false;  // else owner + group only
+        int warmBackends = 2;
+        int maxSessions = 64;
+    };
+
+    BrokerServer(OverlayConfig cfg, Settings settings, QObject *parent = nullptr);
+    ~BrokerServer() override;
+
+    /// False with `error` set when the socket can't be bound.
+    bool listen(QString &error);
+
+    /// An idle backend, or a new one; nullptr at maxSessions or when the
+    /// config can't produce one. Pair with release().
+    std::unique_ptr<AsrBackend> acquire(QString &error);
+    /// Back into the pool if it's short, else dropped (deferred: it may be
+    /// the sender of the signal being handled).
+    void release(std::unique_ptr<AsrBackend> backend);
+    /// Top the idle pool up to warmBackends and prewarm it.
+    void prewarm();
+
+private:
+    void onNewConnection();
+
+    OverlayConfig cfg_;
+    Settings settings_;
+    QLocalServer server_;
+    std::vector<std::unique_ptr<AsrBackend>> idle_;
+    int busy_ = 0;
+};
@@ -0,0 +1,89 @@
+// anytalk-broker — optional per-host recognition service for terminal
+// servers: the overlays of every seat set [Asr] Backend = broker and it
+// runs their sessions on one shared pool of warm backends. Built with
+// -DANYTALK_BUILD_BROKER=ON; see docs/architecture.md.
+//
+//   anytalk-broker [--config /etc/anytalk/broker.conf] [--socket PATH]
+//                  [--world] [--warm 2] [--max-sessions 64]
+//
+// The config file is an anytalk.conf: [Asr] and the backend's section
+// are read; [Overlay] / [Audio] are ignored. SIGTERM ends it the default
+// way; the next start removes the stale socket.
+
+#include "BrokerProtocol.h"
+#include "BrokerServer.h"
+#include "Config.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cstdio>
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("anytalk-broker");
+    app.setApplicationVersion("0.5.2");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Shared speech recognition broker for anytalk overlays");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption configOption(QStringLiteral("config"),
+                                    QStringLiteral("Backend configuration (anytalk.conf format)."),
+                                    QStringLiteral("file"),
+                                    QStringLiteral("/etc/anytalk/broker.conf"));
+    QCommandLineOption socketOption(
+        QStringLiteral("socket"),
+        QStringLiteral("Socket to listen on (default: [Broker] Socket, else %1).")
+            .arg(QString::fromLatin1(broker::kDefaultSocket)),
+        QStringLiteral("path"));
+    QCommandLineOption worldOption(
+        QStringLiteral("world"),
+        QStringLiteral("Let every local user connect, not only the broker's user and group."));
+    QCommandLineOption warmOption(QStringLiteral("warm"),
+                                  QStringLiteral("Idle backends kept prewarmed (0..16)."),
+                                  QStringLiteral("n"), QStringLiteral("2"));
+    QCommandLineOption maxOption(QStringLiteral("max-sessions"),
+                                 QStringLiteral("Concurrent sessions before start is refused."),
+                                 QStringLiteral("n"), QStringLiteral("64"));
+    parser.addOptions({configOption, socketOption, worldOption, warmOption, maxOption});
+    parser.process(app);
+
+    const QString configPath = parser.value(configOption);
+    if (!QFileInfo::exists(configPath)) {
+        std::fprintf(stderr, "anytalk-broker: %s not found\n", qPrintable(configPath));
+        return 1;
+    }
+    const OverlayConfig cfg = OverlayConfig::load(configPath);
+    if (cfg.backend == QLatin1String("broker")) {
+        std::fprintf(stderr, "anytalk-broker: [Asr] Backend = broker would loop back to itself\n");
+        return 1;
+    }
+    if (!cfg.isUsable()) {
+        std::fprintf(stderr, "anytalk-broker: %s has no credentials for backend %s\n",
+                     qPrintable(configPath), qPrintable(cfg.backend));
+        return 1;
+    }
+
+    BrokerServer::Settings s;
+    s.socketPath = parser.value(socketOption);
+    if (s.socketPath.isEmpty()) {
+        s.socketPath = cfg.str(QStringLiteral("Broker"), QStringLiteral("Socket"),
+                               QString::fromLatin1(broker::kDefaultSocket));
+    }
+    s.worldAccess = parser.isSet(worldOption);
+    s.warmBackends = std::clamp(parser.value(warmOption).toInt(), 0, 16);
+    s.maxSessions = std::max(parser.value(maxOption).toInt(), 1);
+
+    BrokerServer server(cfg, s);
+    QString error;
+    if (!server.listen(error)) {
+        std::fprintf(stderr, "anytalk-broker: cannot listen on %s: %s\n",
+                     qPrintable(s.socketPath), qPrintable(error));
+        return 1;
+    }
+    return app.exec();
+}
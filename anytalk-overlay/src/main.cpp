@@ -1,9 +1,13 @@
 #include "AsrController.h"
 #include "Config.h"
+#include "ConfigWatcher.h"
+#include "MemoryFootprint.h"
 #include "OverlayService.h"
 #include "OverlayState.h"
 #include "OverlayWindow.h"
+#include "SessionTrace.h"
 #include "SettingsDialog.h"
+#include "StartupTrace.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
@@ -11,23 +15,95 @@
 #include <QSocketNotifier>
 #include <QTimer>
 
+#include <algorithm>
 #include <csignal>
 #include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
 #include <sys/socket.h>
 #include <unistd.h>
 
 namespace {
 
+// Resident start: how long the window build waits for a queued first
+// ToggleRecording to claim the event loop.
+constexpr int kResidentWindowDelayMs = 500;
+
+/// Resident-mode knobs, refreshed whenever a new config is applied. Read by
+/// the exit-path lambdas in main() on every session end.
+struct Lifecycle {
+    bool resident = false;
+    int idleTimeoutMs = 0;
+
+    void configure(const OverlayConfig &cfg) {
+        // Bounded both ways: shorter than 30 s defeats the point of staying
+        // resident; a day caps how long an idle overlay can hold the bus
+        // name (and whatever Qt / LayerShellQt state) on a forgotten seat.
+        constexpr int kMinIdleSec = 30;
+        constexpr int kMaxIdleSec = 24 * 60 * 60;
+        resident = cfg.resident;
+        idleTimeoutMs = std::clamp(cfg.residentIdleTimeoutSec, kMinIdleSec, kMaxIdleSec) * 1000;
+    }
+};
+
+/// The overlay window, built on first use rather than before the bus name
+/// is claimed: its widgets, the CJK font lookup and, on first show, the
+/// layer-shell setup are the slowest part of a cold start, and nothing
+/// needs them before the first state change. Calls made until then are
+/// queued and replayed once it exists. The build itself runs on the event
+/// loop turn after the one that asked, so the AsrController::startRecording
+/// that triggered it has already set capture and the handshake going.
+class LazyOverlay {
+public:
+    /// Build on the next event loop turn (no-op once built or scheduled).
+    void prepare() {
+        if (window_ || scheduled_) return;
+        scheduled_ = true;
+        QTimer::singleShot(0, qApp, [this]() { build(); });
+    }
+    /// Run `call` on the window now, or as soon as it is built.
+    void post(std::function<void(OverlayWindow &)> call) {
+        if (window_) {
+            call(*window_);
+            return;
+        }
+        pending_.push_back(std::move(call));
+        prepare();
+    }
+    /// nullptr until built — for updates not worth queueing (levels).
+    OverlayWindow *get() const { return window_.get(); }
+    bool requested() const { return window_ || scheduled_; }
+
+private:
+    void build() {
+        startup::mark("window-build");
+        window_ = std::make_unique<OverlayWindow>();
+        startup::mark("window-built");
+        footprint::sample(QStringLiteral("window built"), /*breakdown=*/true);
+        startup::watch(window_.get());
+        auto pending = std::move(pending_);
+        pending_.clear();
+        for (auto &call : pending) call(*window_);
+    }
+
+    std::unique_ptr<OverlayWindow> window_;
+    std::vector<std::function<void(OverlayWindow &)>> pending_;
+    bool scheduled_ = false;
+};
+
 /// Show the SettingsDialog and, on Save, push the new config into the
 /// running AsrController so the user can record without restarting the
 /// overlay.
-bool runSettingsDialog(AsrController &asr) {
-    SettingsDialog dlg(OverlayConfig::load());
+bool runSettingsDialog(AsrController &asr, ConfigWatcher &config,
+                       Lifecycle *lifecycle = nullptr) {
+    SettingsDialog dlg(config.current());
     if (dlg.exec() != QDialog::Accepted) return false;
-    if (!asr.applyConfig(dlg.config())) {
-        qWarning() << "anytalk-overlay: applyConfig rejected — controller not idle. "
-                      "Saved to file; restart or stop recording first to apply.";
-    }
+    // Applied here (at the next idle point if a session is running), so
+    // the watcher must not apply the same save a second time.
+    config.adopt(dlg.config());
+    asr.applyConfigWhenIdle(dlg.config());
+    if (lifecycle) lifecycle->configure(dlg.config());
     return true;
 }
 
@@ -71,6 +147,13 @@ void installCleanShutdownHandlers(QApplication &app) {
 } // namespace
 
 int main(int argc, char **argv) {
+    // Before anything slow: a cold start's trace measures from here.
+    SessionTrace::noteProcessStart();
+#ifdef ANYTALK_SLIM
+    // Before Qt, PulseAudio or anything else has started a thread.
+    footprint::capArenas(2);
+#endif
+
     // Note: pre-Qt-6.5 used to require LayerShellQt::Shell::useLayerShell()
     // here to make Wayland windows layer-shell surfaces, but that flipped
     // EVERY Qt window — including SettingsDialog, which then displayed as
@@ -91,70 +174,141 @@ int main(int argc, char **argv) {
     QCommandLineOption settingsOption(QStringLiteral("settings"),
                                        QStringLiteral("Open the settings dialog and exit."));
     parser.addOption(settingsOption);
+    QCommandLineOption traceStartupOption(
+        QStringLiteral("trace-startup"),
+        QStringLiteral("Log where startup time goes, up to the first painted frame."));
+    parser.addOption(traceStartupOption);
+    QCommandLineOption measureMemoryOption(
+        QStringLiteral("measure-memory"),
+        QStringLiteral("Log the process's memory use after start, window build and each session."));
+    parser.addOption(measureMemoryOption);
     parser.process(app);
+    if (parser.isSet(traceStartupOption)) startup::enable();
+    if (parser.isSet(measureMemoryOption)) footprint::enable();
+    startup::mark("qapplication");
 
-    OverlayWindow overlay;
-
+    // Startup order: the bus name first, so the queued auto-activation
+    // ToggleRecording is dispatched as soon as the event loop runs and
+    // starts capture + handshake; the window is only built after that
+    // (LazyOverlay). Audio is flowing before the first frame is painted.
     AsrController asr;
-    OverlayConfig cfg = OverlayConfig::load();
+    ConfigWatcher config;
+    const OverlayConfig &cfg = config.current();
+    startup::mark("config");
+    Lifecycle lifecycle;
+    lifecycle.configure(cfg);
     if (!asr.applyConfig(cfg)) {
         qWarning() << "anytalk-overlay: ASR backend not configured. The first F2 will "
                       "open the settings dialog.";
     }
+    startup::mark("controller");
 
     // CLI-driven settings: launch dialog and exit.
     if (parser.isSet(settingsOption)) {
-        return runSettingsDialog(asr) ? 0 : 1;
+        return runSettingsDialog(asr, config) ? 0 : 1;
     }
 
-    OverlayService service(&overlay, &asr);
+    OverlayService service(&asr);
+    service.configure(cfg);
     if (!service.registerOnBus()) {
         qWarning() << "anytalk-overlay: D-Bus registration failed; another "
                       "instance may already own the name.";
         return 1;
     }
+    startup::mark("bus-name");
+    footprint::sample(QStringLiteral("started"));
 
     // Announce liveness so any subscriber holding stale state from a
     // previously-killed overlay (notably the fcitx5 addon's cached
     // current_state_) resets immediately.
-    emit service.StateChanged(state::Idle);
-
-    // Drive local UI from ASR events.
-    QObject::connect(&asr, &AsrController::stateChanged,
-                     &overlay, &OverlayWindow::onStateChanged);
-    QObject::connect(&asr, &AsrController::audioLevel,
-                     &overlay, &OverlayWindow::onAudioLevel);
-    QObject::connect(&asr, &AsrController::transcriptPartial,
-                     &overlay, &OverlayWindow::onTranscriptPartial);
-    QObject::connect(&asr, &AsrController::transcriptFinal,
-                     &overlay, &OverlayWindow::onTranscriptFinal);
-    QObject::connect(&asr, &AsrController::errorOccurred,
-                     &overlay, &OverlayWindow::onErrorOccurred);
-
-    // Re-broadcast on D-Bus.
+    service.publishState(state::Idle);
+
+    // Drive local UI from ASR events. An Idle before anything asked for the
+    // window doesn't need one.
+    LazyOverlay overlay;
+    QObject::connect(&asr, &AsrController::stateChanged, &app,
+                     [&overlay](const QString &s) {
+        if (s == state::Connecting) startup::mark("session-start");
+        else if (s == state::Recording) startup::mark("recording");
+        if (s == state::Idle && !overlay.requested()) return;
+        overlay.post([s](OverlayWindow &w) { w.onStateChanged(s); });
+    });
+    // After each session: what a resident overlay keeps between them.
+    QObject::connect(&asr, &AsrController::stateChanged, &app,
+                     [sessions = 0](const QString &s) mutable {
+        if (s == state::Connecting) ++sessions;
+        if (s != state::Idle || sessions == 0) return;
+#ifdef ANYTALK_SLIM
+        footprint::trim();
+#endif
+        footprint::sample(QStringLiteral("after session %1").arg(sessions));
+    });
+    QObject::connect(&asr, &AsrController::audioLevel, &app, [&overlay](double level) {
+        startup::mark("first-audio");
+        if (auto *w = overlay.get()) w->onAudioLevel(level);
+    });
+    QObject::connect(&asr, &AsrController::transcriptPartial, &app,
+                     [&overlay](const QString &t) {
+        overlay.post([t](OverlayWindow &w) { w.onTranscriptPartial(t); });
+    });
+    QObject::connect(&asr, &AsrController::transcriptFinal, &app,
+                     [&overlay](const QString &t) {
+        overlay.post([t](OverlayWindow &w) { w.onTranscriptFinal(t); });
+    });
+    QObject::connect(&asr, &AsrController::errorOccurred, &app,
+                     [&overlay](const QString &t) {
+        overlay.post([t](OverlayWindow &w) { w.onErrorOccurred(t); });
+    });
+    // Resident: nobody waits on this start, so build the window while idle
+    // — late enough that a queued ToggleRecording gets in first.
+    if (lifecycle.resident) QTimer::singleShot(kResidentWindowDelayMs, &app, [&overlay]() {
+        overlay.prepare();
+    });
+
+    // Re-broadcast on D-Bus: legacy signals (level/partial throttled) plus
+    // coalesced Update fan-out to Subscribe()d clients.
     QObject::connect(&asr, &AsrController::stateChanged, &service,
-                     &OverlayService::StateChanged);
+                     &OverlayService::publishState);
     QObject::connect(&asr, &AsrController::audioLevel, &service,
-                     &OverlayService::AudioLevel);
+                     &OverlayService::publishLevel);
     QObject::connect(&asr, &AsrController::transcriptPartial, &service,
-                     &OverlayService::TranscriptPartial);
+                     &OverlayService::publishPartial);
     QObject::connect(&asr, &AsrController::transcriptFinal, &service,
-                     &OverlayService::TranscriptFinal);
+                     &OverlayService::publishFinal);
     QObject::connect(&asr, &AsrController::errorOccurred, &service,
-                     &OverlayService::ErrorOccurred);
+                     &OverlayService::publishError);
     QObject::connect(&asr, &AsrController::commitText, &service,
-                     &OverlayService::CommitText);
+                     &OverlayService::publishCommit);
     QObject::connect(&asr, &AsrController::cancelled, &service,
-                     &OverlayService::Cancelled);
+                     &OverlayService::publishCancelled);
+    QObject::connect(&asr, &AsrController::streamCommit, &service,
+                     &OverlayService::publishStreamCommit);
+    QObject::connect(&asr, &AsrController::streamPreedit, &service,
+                     &OverlayService::publishStreamPreedit);
+    QObject::connect(&asr, &AsrController::uplinkQueue, &service,
+                     &OverlayService::publishUplinkQueue);
 
     // Settings dialog can be triggered through the addon (or any client) via
     // OverlayService::OpenSettings → openSettingsRequested.
     QObject::connect(&service, &OverlayService::openSettingsRequested, &app,
-                     [&asr]() { runSettingsDialog(asr); });
+                     [&asr, &config, &lifecycle]() {
+        runSettingsDialog(asr, config, &lifecycle);
+    });
+
+    // Resident: follow edits to anytalk.conf. Lifecycle and broadcast
+    // rate take effect at once, the controller at its next idle point. A
+    // short-lived overlay is gone before an edit would matter.
+    QObject::connect(&config, &ConfigWatcher::changed, &app,
+                     [&asr, &service, &lifecycle](const OverlayConfig &next) {
+        lifecycle.configure(next);
+        service.configure(next);
+        asr.applyConfigWhenIdle(next);
+    });
+    if (lifecycle.resident) config.start();
 
-    // ---- Short-lived process exit logic ----
+    // ---- Process exit logic ----
     //
-    // Exit paths:
+    // Short-lived (default) exit paths:
     //   1. CommitText emitted → wait up to 5 s for the addon's
     //      Acknowledge() callback, then QApplication::quit() (clean dtors —
     //      PA stream, layer-shell surface, D-Bus name).
@@ -165,18 +319,65 @@ int main(int argc, char **argv) {
     //      this the overlay sat in error indefinitely and held the D-Bus
     //      name, blocking the next F2.
     //
-    // No idle watchdog. The earlier 3 s timer killed the process before
-    // dbus-daemon could deliver the queued auto-activation method call —
-    // cold startup is ~2.9 s. We accept the small risk that an
-    // accidental introspect or stray method poke leaves a long-lived
-    // idle overlay; in practice nothing on the bus calls our service
-    // except the addon, and the addon only calls during a real F2.
+    // No idle watchdog in short-lived mode. The earlier 3 s timer killed
+    // the process before dbus-daemon could deliver the queued
+    // auto-activation method call — cold startup is ~2.9 s. We accept the
+    // small risk that an accidental introspect or stray method poke leaves
+    // a long-lived idle overlay; in practice nothing on the bus calls our
+    // service except the addon, and the addon only calls during a real F2.
+    //
+    // Resident mode ([Overlay] Resident = true) replaces 1–5 with "go back
+    // to idle": the window stays built but hidden, the controller and the
+    // D-Bus registration stay up, and the next ToggleRecording starts
+    // recording without a cold start. What stays the same:
+    //   - SIGTERM / SIGINT / SIGHUP still _Exit via the self-pipe.
+    //   - A bounded idle timer (IdleTimeoutSec) _Exits once the overlay
+    //     has sat idle that long. _Exit, not quit(), for the same
+    //     pa_simple_read reason as the signal handler.
+    //   - If AudioCapture ever had to leak a wedged PA thread, the next
+    //     return to idle _Exits so the kernel releases the mic instead of
+    //     a resident process holding it indefinitely.
+
+    auto *idleTimer = new QTimer(&app);
+    idleTimer->setSingleShot(true);
+    QObject::connect(idleTimer, &QTimer::timeout, &app, [idleTimer]() {
+        // SettingsDialog runs a nested exec(); don't yank it from under
+        // the user mid-edit.
+        if (QApplication::activeModalWidget()) {
+            idleTimer->start();
+            return;
+        }
+        qInfo() << "anytalk-overlay: resident idle timeout — exiting";
+        ::_Exit(0);
+    });
+    // Session over in resident mode: stay alive, but only while the mic
+    // path is healthy, and only for a bounded idle period.
+    auto backToStandby = [&asr, &lifecycle, idleTimer]() {
+        if (asr.audioWedged()) {
+            qWarning() << "anytalk-overlay: capture thread leaked — exiting "
+                          "so the kernel releases the audio source";
+            ::_Exit(0);
+        }
+        idleTimer->start(lifecycle.idleTimeoutMs);
+    };
+    QObject::connect(&asr, &AsrController::stateChanged, idleTimer,
+                     [idleTimer, &lifecycle, backToStandby](const QString &s) {
+        if (!lifecycle.resident) return;
+        if (s == state::Idle) backToStandby();
+        else idleTimer->stop();
+    });
+    if (lifecycle.resident) idleTimer->start(lifecycle.idleTimeoutMs);
 
     // Error display + exit. 3 s is enough for the user to read the error
-    // tooltip before the overlay disappears.
+    // tooltip before the overlay disappears. Resident: dismiss instead,
+    // which drops back to idle (and arms the idle timer above).
     auto *errorTimer = new QTimer(&app);
     errorTimer->setSingleShot(true);
-    QObject::connect(errorTimer, &QTimer::timeout, &app, []() {
+    QObject::connect(errorTimer, &QTimer::timeout, &app, [&asr, &lifecycle]() {
+        if (lifecycle.resident) {
+            asr.dismissError();
+            return;
+        }
         qInfo() << "anytalk-overlay: error display timeout — exiting";
         ::_Exit(0);
     });
@@ -188,7 +389,18 @@ int main(int argc, char **argv) {
 
     auto *ackTimer = new QTimer(&app);
     ackTimer->setSingleShot(true);
-    QObject::connect(ackTimer, &QTimer::timeout, &app, []() {
+    QObject::connect(ackTimer, &QTimer::timeout, &app, [&asr, &lifecycle]() {
+        asr.flushTrace();
+        if (lifecycle.resident) {
+            // Nothing is blocked on our exit any more; the addon just
+            // didn't answer. Keep serving.
+            qWarning() << "anytalk-overlay: Acknowledge timeout — staying resident";
+            return;
+        }
+        if (!asr.isIdle()) {
+            qWarning() << "anytalk-overlay: Acknowledge timeout — next session running";
+            return;
+        }
         qWarning() << "anytalk-overlay: Acknowledge timeout — force exit";
         ::_Exit(0);
     });
@@ -200,18 +412,42 @@ int main(int argc, char **argv) {
         // blocked by a stale bus name.
         ackTimer->start(5000);
     });
-    QObject::connect(&service, &OverlayService::ackReceived, &app, []() {
-        QApplication::quit();
+    // Ahead of the exit below, so the finished trace is written first.
+    QObject::connect(&service, &OverlayService::ackReceived, &asr,
+                     &AsrController::acknowledged);
+    QObject::connect(&service, &OverlayService::ackReceived, &app,
+                     [ackTimer, &asr, &lifecycle]() {
+        ackTimer->stop();
+        // A push-to-talk press queued behind the commit may already have
+        // started the next session; its own commit ends the process.
+        if (!lifecycle.resident && asr.isIdle()) QApplication::quit();
     });
-    QObject::connect(&service, &OverlayService::cancelEscape, &app, []() {
+    QObject::connect(&service, &OverlayService::cancelEscape, &app,
+                     [ackTimer, &lifecycle]() {
+        // Resident: the addon forwards every Esc, idle or not — treat it as
+        // "stop waiting for Ack" and keep running.
+        ackTimer->stop();
+        if (lifecycle.resident) return;
         // User abort: don't bother with destructors, just go.
         ::_Exit(0);
     });
-    QObject::connect(&asr, &AsrController::cancelled, &app, []() {
+    QObject::connect(&asr, &AsrController::cancelled, &app, [&lifecycle]() {
+        if (lifecycle.resident) return;
         // No commit means addon never gets a CommitText, so it'll never
         // call Acknowledge. Quit on our own.
         QApplication::quit();
     });
+    // A short-lived overlay activated by Prewarm() that no F2 followed.
+    // Once a session has run, its Acknowledge ends the process instead.
+    bool sessionRan = false;
+    QObject::connect(&asr, &AsrController::stateChanged, &app, [&sessionRan](const QString &s) {
+        if (s == state::Connecting) sessionRan = true;
+    });
+    QObject::connect(&asr, &AsrController::prewarmExpired, &app, [&lifecycle, &sessionRan]() {
+        if (lifecycle.resident || sessionRan) return;
+        qInfo() << "anytalk-overlay: prewarm expired unused — exiting";
+        QApplication::quit();
+    });
 
     return app.exec();
 }
@@ -1,10 +1,22 @@
 #include "addon.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <unordered_map>
 
+#include <sys/socket.h>
+#include <sys/stat.h>
+
 #include <fcitx/addonfactory.h>
 #include <fcitx/addonmanager.h>
+#include <fcitx/event.h>
+#include <fcitx/inputpanel.h>
+#include <fcitx/text.h>
 #include <fcitx-utils/log.h>
 #include <fcitx-utils/keysymgen.h>
 #include <fcitx-utils/dbus/bus.h>
@@ -16,6 +28,41 @@ namespace {
 constexpr const char *kOverlayService = "org.fcitx.Fcitx5.AnyTalk.Overlay";
 constexpr const char *kOverlayPath = "/overlay";
 constexpr const char *kOverlayInterface = "org.fcitx.Fcitx5.AnyTalk.Overlay";
+
+// Peer-channel opcodes; keep in sync with anytalk-overlay/src/PeerChannel.cpp.
+constexpr char kPeerToggle = 'T';  // + decimal key-press stamp
+constexpr char kPeerStart = 'R';   // + decimal key-press stamp
+constexpr char kPeerStop = 'S';
+constexpr char kPeerCancel = 'X';
+constexpr char kPeerAck = 'A';
+constexpr char kPeerPrewarm = 'W';
+constexpr char kPeerCommit = 'C';
+constexpr char kPeerStreamCommit = 'c';
+constexpr char kPeerPreedit = 'p';
+
+constexpr const char *kConfigSubpath = "/.config/fcitx5/conf/anytalk.conf";
+// Focus bounces between windows of the same app; one Prewarm covers them.
+constexpr uint64_t kPrewarmMinIntervalUs = 5'000'000;
+// Longer than the gap in an X11 autorepeat release + press pair.
+constexpr uint64_t kPttReleaseDelayUs = 30'000;
+
+std::string configPath() {
+    const char *home = std::getenv("HOME");
+    return home ? std::string(home) + kConfigSubpath : std::string();
+}
+
+std::string trimmed(const std::string &s) {
+    const auto b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return {};
+    const auto e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+// Same truthy spellings as the overlay's Config.cpp.
+bool truthy(std::string v) {
+    std::transform(v.begin(), v.end(), v.begin(), [](unsigned char c) { return std::tolower(c); });
+    return v == "true" || v == "1" || v == "yes" || v == "on";
+}
 } // namespace
 
 AnyTalkEngine::AnyTalkEngine(fcitx::Instance *instance) : instance_(instance) {
@@ -30,6 +77,19 @@ AnyTalkEngine::AnyTalkEngine(fcitx::Instance *instance) : instance_(instance) {
             // Subscribe before any overlay is alive — D-Bus auto-activation
             // can spawn one between F2 and our match-rule registration.
             connectOverlaySignals(bus);
+            // Fires for an overlay that is already up (resident) and for
+            // every freshly activated one.
+            overlayWatcher_ = std::make_unique<fcitx::dbus::ServiceWatcher>(*bus);
+            overlayWatch_ = overlayWatcher_->watchService(
+                kOverlayService,
+                [this, bus](const std::string &, const std::string &,
+                            const std::string &newOwner) {
+                    // An overlay that died mid-dictation can't clear its
+                    // own preedit any more.
+                    setPreedit({});
+                    dropPeer();
+                    if (!newOwner.empty()) attachPeer(bus);
+                });
         }
     }
 
@@ -37,12 +97,120 @@ AnyTalkEngine::AnyTalkEngine(fcitx::Instance *instance) : instance_(instance) {
         fcitx::EventType::InputContextKeyEvent,
         fcitx::EventWatcherPhase::PreInputMethod,
         [this](fcitx::Event &event) { handleGlobalKeyEvent(event); });
+    focusWatcher_ = instance_->watchEvent(
+        fcitx::EventType::InputContextFocusIn,
+        fcitx::EventWatcherPhase::Default,
+        [this](fcitx::Event &event) { handleFocusIn(event); });
+
+    refreshSettings();
 }
 
 AnyTalkEngine::~AnyTalkEngine() = default;
 
+void AnyTalkEngine::reloadConfig() {
+    settingsMtime_ = -1;
+    refreshSettings();
+}
+
+void AnyTalkEngine::refreshSettings() {
+    // The overlay owns the file (and its SettingsDialog rewrites it), so
+    // there is no fcitx config UI for [Addon]: a stat per focus change
+    // picks edits up without a watcher.
+    const std::string path = configPath();
+    struct stat st {};
+    const int64_t mtime = (!path.empty() && ::stat(path.c_str(), &st) == 0)
+        ? int64_t(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec
+        : 0;
+    if (mtime == settingsMtime_) return;
+    settingsMtime_ = mtime;
+
+    Settings next;
+    std::ifstream in(path);
+    std::string line, section;
+    while (std::getline(in, line)) {
+        line = trimmed(line);
+        if (line.empty() || line[0] == '#') continue;
+        if (line.front() == '[' && line.back() == ']') {
+            section = trimmed(line.substr(1, line.size() - 2));
+            continue;
+        }
+        const auto eq = line.find('=');
+        if (section != "Addon" || eq == std::string::npos || eq == 0) continue;
+        const std::string key = trimmed(line.substr(0, eq));
+        const std::string val = trimmed(line.substr(eq + 1));
+        if (key == "PushToTalk") {
+            next.pushToTalk = truthy(val);
+        } else if (key == "PrewarmPrograms") {
+            size_t from = 0;
+            while (from <= val.size()) {
+                const auto comma = std::min(val.find(',', from), val.size());
+                if (auto name = trimmed(val.substr(from, comma - from)); !name.empty())
+                    next.prewarmPrograms.push_back(std::move(name));
+                from = comma + 1;
+            }
+        }
+    }
+    // A key still held down when PushToTalk goes away must not be stranded.
+    if (!next.pushToTalk) {
+        pttHeld_ = false;
+        if (pttRelease_) pttRelease_->setEnabled(false);
+    }
+    settings_ = std::move(next);
+}
+
+void AnyTalkEngine::handleFocusIn(fcitx::Event &event) {
+    refreshSettings();
+    if (settings_.prewarmPrograms.empty()) return;
+    auto *ic = static_cast<fcitx::InputContextEvent &>(event).inputContext();
+    if (!ic) return;
+    const auto &program = ic->program();
+    const auto &list = settings_.prewarmPrograms;
+    if (program.empty() || std::find(list.begin(), list.end(), program) == list.end()) return;
+    const uint64_t nowUs = fcitx::now(CLOCK_MONOTONIC);
+    if (lastPrewarmUs_ && nowUs - lastPrewarmUs_ < kPrewarmMinIntervalUs) return;
+    lastPrewarmUs_ = nowUs;
+    // Over the bus this activates a non-resident overlay; it lets go again
+    // after [Overlay] PrewarmSec if no session starts.
+    overlayCall("Prewarm");
+}
+
+void AnyTalkEngine::handlePushToTalk(fcitx::KeyEvent &keyEvent) {
+    keyEvent.accept();
+    if (!keyEvent.isRelease()) {
+        if (pttRelease_ && pttRelease_->isEnabled()) {
+            // Autorepeat's release + press: the key never went up.
+            pttRelease_->setEnabled(false);
+            return;
+        }
+        if (pttHeld_) return;  // autorepeat press
+        pttHeld_ = true;
+        // Never a toggle: right after a release the overlay is still
+        // draining finals, and a toggle there would be a second stop.
+        overlayStart(fcitx::now(CLOCK_MONOTONIC));
+        return;
+    }
+    if (!pttHeld_) return;
+    const uint64_t at = fcitx::now(CLOCK_MONOTONIC) + kPttReleaseDelayUs;
+    if (!pttRelease_) {
+        pttRelease_ = instance_->eventLoop().addTimeEvent(
+            CLOCK_MONOTONIC, at, 0, [this](fcitx::EventSourceTime *, uint64_t) {
+                pttHeld_ = false;
+                overlayCall("StopRecording");
+                return true;
+            });
+    } else {
+        pttRelease_->setTime(at);
+    }
+    pttRelease_->setOneShot();
+}
+
 void AnyTalkEngine::handleGlobalKeyEvent(fcitx::Event &event) {
     auto &keyEvent = static_cast<fcitx::KeyEvent &>(event);
+    const auto sym = keyEvent.key().sym();
+    if (settings_.pushToTalk && (sym == FcitxKey_F2 || sym == FcitxKey_AudioPlay)) {
+        handlePushToTalk(keyEvent);
+        return;
+    }
     if (keyEvent.isRelease()) return;
 
     // Dumb forward — the overlay is the state owner and decides whether each
@@ -50,9 +218,9 @@ void AnyTalkEngine::handleGlobalKeyEvent(fcitx::Event &event) {
     // are swallowed (unambiguously ours); Esc and Enter pass through to the
     // focused application so the user's natural "cancel and close dialog" /
     // "commit transcript and send the line" expectations both work.
-    const auto sym = keyEvent.key().sym();
     if (sym == FcitxKey_F2 || sym == FcitxKey_AudioPlay) {
-        overlayCall("ToggleRecording");
+        // Stamped on receipt: the overlay's session trace measures from here.
+        overlayToggle(fcitx::now(CLOCK_MONOTONIC));
         keyEvent.accept();
         return;
     }
@@ -67,6 +235,15 @@ void AnyTalkEngine::handleGlobalKeyEvent(fcitx::Event &event) {
 }
 
 void AnyTalkEngine::overlayCall(const char *method) {
+    if (peerReady_) {
+        char op = 0;
+        if (std::strcmp(method, "ToggleRecording") == 0) op = kPeerToggle;
+        else if (std::strcmp(method, "StopRecording") == 0) op = kPeerStop;
+        else if (std::strcmp(method, "CancelRecording") == 0) op = kPeerCancel;
+        else if (std::strcmp(method, "Acknowledge") == 0) op = kPeerAck;
+        else if (std::strcmp(method, "Prewarm") == 0) op = kPeerPrewarm;
+        if (op && sendPeer(op)) return;
+    }
     auto *dbusAddon = dbus();
     if (!dbusAddon) return;
     auto *bus = dbusAddon->call<fcitx::IDBusModule::bus>();
@@ -76,6 +253,26 @@ void AnyTalkEngine::overlayCall(const char *method) {
     msg.send();
 }
 
+void AnyTalkEngine::overlayToggle(uint64_t keyPressUs) {
+    overlayStamped(kPeerToggle, "ToggleRecordingAt", keyPressUs);
+}
+
+void AnyTalkEngine::overlayStart(uint64_t keyPressUs) {
+    overlayStamped(kPeerStart, "StartRecordingAt", keyPressUs);
+}
+
+void AnyTalkEngine::overlayStamped(char peerOp, const char *method, uint64_t keyPressUs) {
+    const std::string stamp = std::to_string(keyPressUs);
+    if (peerReady_ && sendPeer(peerOp, stamp)) return;
+    auto *dbusAddon = dbus();
+    if (!dbusAddon) return;
+    auto *bus = dbusAddon->call<fcitx::IDBusModule::bus>();
+    if (!bus) return;
+    auto msg = bus->createMethodCall(kOverlayService, kOverlayPath, kOverlayInterface, method);
+    msg << static_cast<int64_t>(keyPressUs);
+    msg.send();
+}
+
 void AnyTalkEngine::pushDBusEnv(fcitx::dbus::Bus *bus) {
     if (!bus) return;
     static const char *kVars[] = {
@@ -104,23 +301,60 @@ void AnyTalkEngine::pushDBusEnv(fcitx::dbus::Bus *bus) {
 }
 
 void AnyTalkEngine::connectOverlaySignals(fcitx::dbus::Bus *bus) {
-    // Only signal we care about: CommitText. The transcript ends up in the
+    // Signals we care about: CommitText, plus the StreamCommit mode's
+    // per-segment commit and preedit. The transcript ends up in the
     // focused IC via the one operation only fcitx5 can do — ic->commitString.
-    fcitx::dbus::MatchRule rule(
-        /*service=*/kOverlayService,
-        /*path=*/kOverlayPath,
-        /*interface=*/kOverlayInterface,
-        /*name=*/"CommitText");
-    auto slot = bus->addMatch(rule, [this](fcitx::dbus::Message &msg) {
-        std::string text;
-        msg >> text;
-        dispatcher_.schedule([this, text]() { commitText(text); });
-        return true;
-    });
-    if (slot) signalSlots_.push_back(std::move(slot));
+    auto watch = [this, bus](const char *name, auto handler) {
+        fcitx::dbus::MatchRule rule(
+            /*service=*/kOverlayService,
+            /*path=*/kOverlayPath,
+            /*interface=*/kOverlayInterface,
+            /*name=*/name);
+        auto slot = bus->addMatch(rule, [this, handler](fcitx::dbus::Message &msg) {
+            std::string text;
+            msg >> text;
+            dispatcher_.schedule([this, handler, text]() { (this->*handler)(text); });
+            return true;
+        });
+        if (slot) signalSlots_.push_back(std::move(slot));
+    };
+    watch("CommitText", &AnyTalkEngine::commitTextFromBus);
+    watch("StreamCommit", &AnyTalkEngine::streamCommit);
+    watch("StreamPreedit", &AnyTalkEngine::setPreedit);
+}
+
+void AnyTalkEngine::commitTextFromBus(const std::string &text) {
+    commitText(text, /*viaPeer=*/false);
+}
+
+void AnyTalkEngine::streamCommit(const std::string &text) {
+    setPreedit({});
+    if (auto *ic = instance_->inputContextManager().lastFocusedInputContext()) {
+        ic->commitString(text);
+    }
+}
+
+void AnyTalkEngine::setPreedit(const std::string &text) {
+    auto *ic = instance_->inputContextManager().lastFocusedInputContext();
+    // Focus moved mid-dictation: don't leave a stale preedit behind.
+    if (auto *old = preeditIc_.get(); old && old != ic) {
+        old->inputPanel().setClientPreedit(fcitx::Text());
+        old->updatePreedit();
+    }
+    preeditIc_.unwatch();
+    if (!ic) return;
+    fcitx::Text preedit;
+    if (!text.empty()) {
+        preedit.append(text, fcitx::TextFormatFlag::Underline);
+        preedit.setCursor(static_cast<int>(text.size()));
+        preeditIc_ = ic->watch();
+    }
+    ic->inputPanel().setClientPreedit(preedit);
+    ic->updatePreedit();
 }
 
-void AnyTalkEngine::commitText(const std::string &text) {
+void AnyTalkEngine::commitText(const std::string &text, bool viaPeer) {
+    setPreedit({});
     // Always Acknowledge — empty text or no focused IC still need to
     // release the overlay's exit gate, otherwise it spins on the 5 s
     // ackTimer.
@@ -129,7 +363,98 @@ void AnyTalkEngine::commitText(const std::string &text) {
             ic->commitString(text);
         }
     }
-    overlayCall("Acknowledge");
+    // Ack on the channel the commit came in on: a bus commit means the
+    // overlay had no working peer for it.
+    if (viaPeer && sendPeer(kPeerAck)) return;
+    auto *dbusAddon = dbus();
+    auto *bus = dbusAddon ? dbusAddon->call<fcitx::IDBusModule::bus>() : nullptr;
+    if (!bus) return;
+    bus->createMethodCall(kOverlayService, kOverlayPath, kOverlayInterface, "Acknowledge")
+        .send();
+}
+
+void AnyTalkEngine::attachPeer(fcitx::dbus::Bus *bus) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, fds) < 0) {
+        FCITX_WARN() << "anytalk: socketpair failed: " << std::strerror(errno);
+        return;
+    }
+    ++peerGeneration_;
+    peerFd_.give(fds[0]);
+    // The message dups its fd; ours closes when `theirs` goes out of scope.
+    const auto theirs = fcitx::UnixFD::own(fds[1]);
+    auto msg = bus->createMethodCall(kOverlayService, kOverlayPath, kOverlayInterface,
+                                     "AttachPeer");
+    msg << theirs;
+    // Only route keys over the peer once the overlay has taken it; an
+    // overlay without AttachPeer answers with an error and we stay on the bus.
+    peerCall_ = msg.callAsync(0, [this, gen = peerGeneration_](fcitx::dbus::Message &reply) {
+        if (gen == peerGeneration_) {
+            if (reply.isError()) scheduleDropPeer();
+            else peerReady_ = true;
+        }
+        return true;
+    });
+    peerEvent_ = instance_->eventLoop().addIOEvent(
+        peerFd_.fd(),
+        {fcitx::IOEventFlag::In, fcitx::IOEventFlag::Err, fcitx::IOEventFlag::Hup},
+        [this](fcitx::EventSourceIO *, int, fcitx::IOEventFlags flags) {
+            return onPeerReadable(flags);
+        });
+}
+
+void AnyTalkEngine::dropPeer() {
+    peerReady_ = false;
+    peerCall_.reset();
+    peerEvent_.reset();
+    peerFd_.reset();
+}
+
+void AnyTalkEngine::scheduleDropPeer() {
+    // Deferred: callers may be inside the peer's own IO callback, which
+    // can't destroy its event source. The generation check keeps a late
+    // drop from taking out a peer attached in the meantime.
+    dispatcher_.schedule([this, gen = peerGeneration_]() {
+        if (gen == peerGeneration_) dropPeer();
+    });
+}
+
+bool AnyTalkEngine::sendPeer(char op, const std::string &payload) {
+    if (!peerReady_) return false;
+    std::string packet(1, op);
+    packet += payload;
+    const auto n = ::send(peerFd_.fd(), packet.data(), packet.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n == static_cast<ssize_t>(packet.size())) return true;
+    // Older overlay without AttachPeer, or it just exited: back to the bus.
+    scheduleDropPeer();
+    return false;
+}
+
+bool AnyTalkEngine::onPeerReadable(fcitx::IOEventFlags flags) {
+    for (;;) {
+        // SEQPACKET keeps boundaries; MSG_TRUNC on a peek reports the full
+        // packet size so a long transcript is read in one go.
+        const ssize_t size = ::recv(peerFd_.fd(), nullptr, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+        if (size < 0 && errno == EINTR) continue;
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (size <= 0) {
+            scheduleDropPeer();
+            return false;
+        }
+        std::string packet(static_cast<size_t>(size), '\0');
+        if (::recv(peerFd_.fd(), packet.data(), packet.size(), MSG_DONTWAIT) != size) continue;
+        switch (packet[0]) {
+        case kPeerCommit: commitText(packet.substr(1), /*viaPeer=*/true); break;
+        case kPeerStreamCommit: streamCommit(packet.substr(1)); break;
+        case kPeerPreedit: setPreedit(packet.substr(1)); break;
+        default: break;
+        }
+    }
+    if (flags.test(fcitx::IOEventFlag::Hup) || flags.test(fcitx::IOEventFlag::Err)) {
+        scheduleDropPeer();
+        return false;
+    }
+    return true;
 }
 
 class AnyTalkFactory : public fcitx::AddonFactory {
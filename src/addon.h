@@ -5,7 +5,13 @@
 #include <fcitx/addonmanager.h>
 #include <fcitx-utils/eventdispatcher.h>
 #include <fcitx-utils/dbus/bus.h>
+#include <fcitx-utils/dbus/servicewatcher.h>
+#include <fcitx-utils/event.h>
+#include <fcitx-utils/trackableobject.h>
+#include <fcitx-utils/unixfd.h>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace fcitx {
@@ -16,18 +22,33 @@ class DBusModule;
 ///
 /// All recording state lives in the overlay; this addon only does:
 ///   1. Watch F2 / Esc / Enter globally and forward to the overlay over
-///      D-Bus (`ToggleRecording` / `CancelRecording` / `StopRecording`).
+///      D-Bus (`ToggleRecordingAt` / `CancelRecording` / `StopRecording`;
+///      the toggle carries when F2 arrived, for the overlay's session trace).
 ///      The overlay decides whether each call is a no-op or an action
 ///      based on its own state — we never cache it here. Esc and Enter
 ///      pass through to the focused app too (cancel-dialog / send-line).
 ///   2. Subscribe to the overlay's `CommitText` signal and translate it into
 ///      a single `ic->commitString(text)` on the focused input context —
 ///      the one operation that genuinely requires running inside fcitx5.
-///   3. Push WAYLAND_DISPLAY etc. into the session bus at startup so the
+///      With `[Overlay] StreamCommit = true` the overlay sends finished
+///      segments as they arrive (`StreamCommit`) and the live tail as
+///      client preedit (`StreamPreedit`); cancel only drops the preedit.
+///   3. Once an overlay owns the bus name, hand it one end of a private
+///      socketpair (`AttachPeer`). While that peer is up, key forwarding
+///      and CommitText / Acknowledge go over it instead of through
+///      dbus-daemon; the bus path stays as the fallback and for
+///      activation (see anytalk-overlay/src/PeerChannel.h).
+///   4. Push WAYLAND_DISPLAY etc. into the session bus at startup so the
 ///      D-Bus-activated overlay process inherits a usable graphical env.
+///   5. `[Addon] PrewarmPrograms`: when one of those programs gains focus,
+///      send `Prewarm` so the overlay (activated if need be) opens its
+///      spare socket and a corked mic before the user reaches for F2.
+///      `[Addon] PushToTalk`: F2 press starts (`StartRecordingAt`, never a
+///      toggle), F2 release stops.
 ///
 /// No state caching, no status-area icon, no legacy D-Bus surface.
-/// Configuration lives entirely in the overlay (`~/.config/fcitx5/conf/anytalk.conf`).
+/// Configuration lives in the overlay (`~/.config/fcitx5/conf/anytalk.conf`);
+/// the addon reads only its own [Addon] section of that file.
 class AnyTalkEngine : public fcitx::AddonInstance {
 public:
     AnyTalkEngine(fcitx::Instance *instance);
@@ -35,16 +56,65 @@ public:
 
     FCITX_ADDON_DEPENDENCY_LOADER(dbus, instance_->addonManager());
 
+    void reloadConfig() override;
+
 private:
+    /// [Addon] of anytalk.conf.
+    struct Settings {
+        std::vector<std::string> prewarmPrograms;
+        bool pushToTalk = false;
+    };
+
     void handleGlobalKeyEvent(fcitx::Event &event);
+    /// Push-to-talk F2 / AudioPlay: press starts, release stops.
+    void handlePushToTalk(fcitx::KeyEvent &keyEvent);
+    void handleFocusIn(fcitx::Event &event);
+    /// Re-read [Addon] if the file changed since the last look.
+    void refreshSettings();
 
     void overlayCall(const char *method);
+    /// ToggleRecording carrying the key's CLOCK_MONOTONIC receipt time.
+    void overlayToggle(uint64_t keyPressUs);
+    /// Push-to-talk press: StartRecordingAt, which never stops a session.
+    void overlayStart(uint64_t keyPressUs);
+    void overlayStamped(char peerOp, const char *method, uint64_t keyPressUs);
     void pushDBusEnv(fcitx::dbus::Bus *bus);
     void connectOverlaySignals(fcitx::dbus::Bus *bus);
-    void commitText(const std::string &text);
+    void commitText(const std::string &text, bool viaPeer);
+    void commitTextFromBus(const std::string &text);
+    /// [Overlay] StreamCommit mode: finished segment / in-progress tail.
+    void streamCommit(const std::string &text);
+    void setPreedit(const std::string &text);
+
+    void attachPeer(fcitx::dbus::Bus *bus);
+    void dropPeer();
+    void scheduleDropPeer();
+    bool sendPeer(char op, const std::string &payload = {});
+    bool onPeerReadable(fcitx::IOEventFlags flags);
 
     fcitx::Instance *instance_;
     std::unique_ptr<fcitx::HandlerTableEntry<fcitx::EventHandler>> eventWatcher_;
+    std::unique_ptr<fcitx::HandlerTableEntry<fcitx::EventHandler>> focusWatcher_;
     fcitx::EventDispatcher dispatcher_;
     std::vector<std::unique_ptr<fcitx::dbus::Slot>> signalSlots_;
+
+    std::unique_ptr<fcitx::dbus::ServiceWatcher> overlayWatcher_;
+    std::unique_ptr<fcitx::dbus::ServiceWatcherEntry> overlayWatch_;
+    fcitx::UnixFD peerFd_;  // our end of the socketpair; invalid = no peer
+    std::unique_ptr<fcitx::EventSourceIO> peerEvent_;
+    std::unique_ptr<fcitx::dbus::Slot> peerCall_;  // pending AttachPeer reply
+    bool peerReady_ = false;
+    unsigned peerGeneration_ = 0;
+
+    // IC currently holding our client preedit, so it can be cleared when
+    // focus moves or the overlay goes away.
+    fcitx::TrackableObjectReference<fcitx::InputContext> preeditIc_;
+
+    Settings settings_;
+    int64_t settingsMtime_ = -1;   // ns; -1 = never read
+    uint64_t lastPrewarmUs_ = 0;
+    // Push-to-talk: the release is held back briefly, X11 autorepeat sends
+    // release + press pairs while the key stays down.
+    bool pttHeld_ = false;
+    std::unique_ptr<fcitx::EventSourceTime> pttRelease_;
 };